@@ -0,0 +1,258 @@
+#include "AppAttribution.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define ATTRIBUTION_SSE 1
+#else
+#define ATTRIBUTION_SSE 0
+#endif
+
+namespace
+{
+struct Rect
+{
+    int64_t x0, y0, x1, y1;
+    bool Empty() const { return x0 >= x1 || y0 >= y1; }
+};
+}
+
+static double SumRow(const double* row, size_t count, bool allowSimd)
+{
+    double sum = 0.0;
+    size_t x = 0;
+#if ATTRIBUTION_SSE
+    if (allowSimd)
+    {
+        __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd();
+        for (; x + 4 <= count; x += 4)
+        {
+            a0 = _mm_add_pd(a0, _mm_loadu_pd(row + x));
+            a1 = _mm_add_pd(a1, _mm_loadu_pd(row + x + 2));
+        }
+        alignas(16) double lanes[2];
+        _mm_store_pd(lanes, _mm_add_pd(a0, a1));
+        sum = lanes[0] + lanes[1];
+    }
+#endif
+    (void)allowSimd;
+    for (; x < count; ++x)
+        sum += row[x];
+    return sum;
+}
+
+double SumWearRect(const WearMap& wear, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, bool allowSimd)
+{
+    x1 = (std::min)(x1, wear.Width());
+    y1 = (std::min)(y1, wear.Height());
+    if (x0 >= x1 || y0 >= y1)
+        return 0.0;
+
+    double sum = 0.0;
+    for (int c = 0; c < 3; ++c)
+    {
+        const double* plane = wear.Plane(c);
+        for (uint32_t y = y0; y < y1; ++y)
+            sum += SumRow(plane + size_t(y) * wear.Width() + x0, x1 - x0, allowSimd);
+    }
+    return sum * WearMap::UnitSeconds();
+}
+
+uint32_t AppAttribution::AppId(const std::string& name)
+{
+    auto it = m_appIds.find(name);
+    if (it != m_appIds.end())
+        return it->second;
+    const uint32_t id = uint32_t(m_apps.size());
+    m_apps.emplace_back();
+    m_apps.back().name = name;
+    m_appIds.emplace(name, id);
+    return id;
+}
+
+void AppAttribution::Clear()
+{
+    m_apps.clear();
+    m_appIds.clear();
+    m_pieces.clear();
+    m_visible.clear();
+    m_foreground = UINT32_MAX;
+    m_active = false;
+}
+
+// A new screen size starts a new ledger; cells of the old one would not line up
+void AppAttribution::Resize(const WearMap& wear)
+{
+    if (wear.Width() == m_width && wear.Height() == m_height)
+        return;
+    Clear();
+    m_width = wear.Width();
+    m_height = wear.Height();
+    m_cellsX = (m_width + m_regionSize - 1) / m_regionSize;
+    m_cellsY = (m_height + m_regionSize - 1) / m_regionSize;
+}
+
+void AppAttribution::AddPieces(uint32_t app, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1)
+{
+    std::vector<double>& cells = m_apps[app].cells;
+    if (cells.empty())
+        cells.assign(size_t(m_cellsX) * m_cellsY, 0.0);
+    if (m_visible.empty() || m_visible.back() != app)
+        m_visible.push_back(app);
+
+    for (uint32_t cy = y0 / m_regionSize; cy * m_regionSize < y1; ++cy)
+    {
+        for (uint32_t cx = x0 / m_regionSize; cx * m_regionSize < x1; ++cx)
+        {
+            Piece piece;
+            piece.app = app;
+            piece.cell = cy * m_cellsX + cx;
+            piece.x0 = (std::max)(x0, cx * m_regionSize);
+            piece.y0 = (std::max)(y0, cy * m_regionSize);
+            piece.x1 = (std::min)(x1, (cx + 1) * m_regionSize);
+            piece.y1 = (std::min)(y1, (cy + 1) * m_regionSize);
+            piece.start = 0.0;
+            m_pieces.push_back(piece);
+        }
+    }
+}
+
+void AppAttribution::SetLayout(const WearMap& wear, const std::vector<AppWindow>& windows)
+{
+    Resize(wear);
+    Settle(wear);
+    m_pieces.clear();
+    m_visible.clear();
+    m_foreground = UINT32_MAX;
+
+    // Front to back: each window takes what is still uncovered of its rectangle, and the
+    // uncovered rest is cut around it (up to four rectangles per overlap)
+    std::vector<Rect> uncovered = { { 0, 0, m_width, m_height } };
+    std::vector<Rect> next;
+    for (const AppWindow& window : windows)
+    {
+        const Rect w = { window.x, window.y, int64_t(window.x) + window.width, int64_t(window.y) + window.height };
+        if (w.Empty())
+            continue;
+        const uint32_t app = AppId(window.app);
+        if (window.foreground)
+            m_foreground = app;
+
+        next.clear();
+        for (const Rect& u : uncovered)
+        {
+            const Rect i = { (std::max)(u.x0, w.x0), (std::max)(u.y0, w.y0), (std::min)(u.x1, w.x1),
+                (std::min)(u.y1, w.y1) };
+            if (i.Empty())
+            {
+                next.push_back(u);
+                continue;
+            }
+            AddPieces(app, uint32_t(i.x0), uint32_t(i.y0), uint32_t(i.x1), uint32_t(i.y1));
+            const Rect rest[4] = { { u.x0, u.y0, u.x1, i.y0 }, { u.x0, i.y1, u.x1, u.y1 },
+                { u.x0, i.y0, i.x0, i.y1 }, { i.x1, i.y0, u.x1, i.y1 } };
+            for (const Rect& r : rest)
+                if (!r.Empty())
+                    next.push_back(r);
+        }
+        uncovered.swap(next);
+    }
+    if (!uncovered.empty())
+    {
+        const uint32_t desktop = AppId(DESKTOP);
+        for (const Rect& u : uncovered)
+            AddPieces(desktop, uint32_t(u.x0), uint32_t(u.y0), uint32_t(u.x1), uint32_t(u.y1));
+    }
+    std::sort(m_visible.begin(), m_visible.end());
+    m_visible.erase(std::unique(m_visible.begin(), m_visible.end()), m_visible.end());
+
+    for (Piece& piece : m_pieces)
+        piece.start = SumWearRect(wear, piece.x0, piece.y0, piece.x1, piece.y1);
+    m_layoutStart = wear.TotalSeconds();
+    m_active = true;
+}
+
+void AppAttribution::Settle(const WearMap& wear)
+{
+    if (!m_active || wear.Width() != m_width || wear.Height() != m_height)
+        return;
+
+    for (Piece& piece : m_pieces)
+    {
+        const double now = SumWearRect(wear, piece.x0, piece.y0, piece.x1, piece.y1);
+        const double added = now - piece.start;
+        piece.start = now;
+        App& app = m_apps[piece.app];
+        app.stressSeconds += added;
+        app.cells[piece.cell] += added;
+    }
+
+    const double seconds = wear.TotalSeconds() - m_layoutStart;
+    m_layoutStart = wear.TotalSeconds();
+    for (uint32_t app : m_visible)
+        m_apps[app].visibleSeconds += seconds;
+    if (m_foreground != UINT32_MAX)
+        m_apps[m_foreground].foregroundSeconds += seconds;
+}
+
+std::vector<AppLedgerEntry> AppAttribution::Ledger(size_t topRegions) const
+{
+    double total = 0.0;
+    for (const App& app : m_apps)
+        total += app.stressSeconds;
+
+    std::vector<AppLedgerEntry> ledger;
+    for (const App& app : m_apps)
+    {
+        AppLedgerEntry entry;
+        entry.app = app.name;
+        entry.stressSeconds = app.stressSeconds;
+        entry.share = total > 0.0 ? app.stressSeconds / total : 0.0;
+        entry.visibleSeconds = app.visibleSeconds;
+        entry.foregroundSeconds = app.foregroundSeconds;
+
+        std::vector<uint32_t> order;
+        for (uint32_t cell = 0; cell < app.cells.size(); ++cell)
+            if (app.cells[cell] > 0.0)
+                order.push_back(cell);
+        const size_t count = (std::min)(topRegions, order.size());
+        std::partial_sort(order.begin(), order.begin() + count, order.end(),
+            [&](uint32_t a, uint32_t b) { return app.cells[a] > app.cells[b]; });
+        for (size_t i = 0; i < count; ++i)
+        {
+            AppRegion region;
+            region.x = (order[i] % m_cellsX) * m_regionSize;
+            region.y = (order[i] / m_cellsX) * m_regionSize;
+            region.width = (std::min)(m_regionSize, m_width - region.x);
+            region.height = (std::min)(m_regionSize, m_height - region.y);
+            region.stressSeconds = app.cells[order[i]];
+            entry.regions.push_back(region);
+        }
+        ledger.push_back(std::move(entry));
+    }
+    std::stable_sort(ledger.begin(), ledger.end(),
+        [](const AppLedgerEntry& a, const AppLedgerEntry& b) { return a.stressSeconds > b.stressSeconds; });
+    return ledger;
+}
+
+std::string FormatAttributionLedger(const std::vector<AppLedgerEntry>& ledger)
+{
+    std::string text;
+    char buf[160];
+    for (const AppLedgerEntry& entry : ledger)
+    {
+        std::snprintf(buf, sizeof(buf), "%s stress_s=%.1f share=%.3f visible_s=%.1f foreground_s=%.1f",
+            entry.app.c_str(), entry.stressSeconds, entry.share, entry.visibleSeconds, entry.foregroundSeconds);
+        text += buf;
+        for (const AppRegion& region : entry.regions)
+        {
+            std::snprintf(buf, sizeof(buf), " %u,%u,%u,%u:%.1f", region.x, region.y, region.width, region.height,
+                region.stressSeconds);
+            text += buf;
+        }
+        text += "\n";
+    }
+    return text;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "WearMap.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Which application caused the wear. Windows are sampled at a low rate; between two
+// layout changes every visible window rectangle (clipped by the ones in front of it) is
+// cut at a grid of regionSize cells, and each piece is charged the growth of the wear
+// map's planes over it: the sum over the piece when the layout ends minus the sum when it
+// began. The sums are SIMD reductions over plane rows, run only on layout changes, so
+// attribution costs nothing per frame, needs no per-pixel label map, and charges
+// whatever the map integrated meanwhile (HDR levels, the pointer) to the window under it.
+// Uncovered screen goes to DESKTOP.
+
+// A top-level window as sampled, in wear map columns and rows (the capture's frame layout)
+struct AppWindow
+{
+    std::string app;             // process name, e.g. "devenv.exe"
+    int32_t x = 0, y = 0;
+    int32_t width = 0, height = 0;
+    bool foreground = false;
+
+    bool operator==(const AppWindow& other) const
+    {
+        return app == other.app && x == other.x && y == other.y && width == other.width &&
+            height == other.height && foreground == other.foreground;
+    }
+};
+
+struct AppRegion
+{
+    uint32_t x = 0, y = 0, width = 0, height = 0;
+    double stressSeconds = 0.0;  // R + G + B, WearMap units times UnitSeconds()
+};
+
+struct AppLedgerEntry
+{
+    std::string app;
+    double stressSeconds = 0.0;
+    double share = 0.0;          // of all attributed stress
+    double visibleSeconds = 0.0;
+    double foregroundSeconds = 0.0;
+    std::vector<AppRegion> regions; // most damaged cells first
+};
+
+class AppAttribution
+{
+public:
+    static constexpr const char* DESKTOP = "(desktop)";
+
+    explicit AppAttribution(uint32_t regionSize = 64) : m_regionSize(regionSize ? regionSize : 64) {}
+
+    // windows front to back. Closes the interval of the previous layout at the wear
+    // accumulated so far and opens one for this layout.
+    void SetLayout(const WearMap& wear, const std::vector<AppWindow>& windows);
+    // Close the current interval without changing the layout, e.g. before reading the ledger
+    void Settle(const WearMap& wear);
+    void Clear();
+
+    // Most damage first, with the topRegions most damaged cells of every application
+    std::vector<AppLedgerEntry> Ledger(size_t topRegions = 5) const;
+    size_t Pieces() const { return m_pieces.size(); }
+
+private:
+    // A visible rectangle of one application inside one cell
+    struct Piece
+    {
+        uint32_t app, cell;
+        uint32_t x0, y0, x1, y1;
+        double start;            // plane sum when the layout began
+    };
+    struct App
+    {
+        std::string name;
+        double stressSeconds = 0.0;
+        double visibleSeconds = 0.0;
+        double foregroundSeconds = 0.0;
+        std::vector<double> cells;
+    };
+
+    uint32_t AppId(const std::string& name);
+    void Resize(const WearMap& wear);
+    void AddPieces(uint32_t app, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1);
+
+    uint32_t m_regionSize;
+    uint32_t m_width = 0, m_height = 0;
+    uint32_t m_cellsX = 0, m_cellsY = 0;
+    std::vector<App> m_apps;
+    std::unordered_map<std::string, uint32_t> m_appIds;
+
+    std::vector<Piece> m_pieces;
+    std::vector<uint32_t> m_visible; // apps with pieces in the current layout
+    uint32_t m_foreground = UINT32_MAX;
+    double m_layoutStart = 0.0;      // WearMap::TotalSeconds when the layout began
+    bool m_active = false;
+};
+
+// Sum of the R, G and B planes over [x0, x1) x [y0, y1), in stress-seconds
+double SumWearRect(const WearMap& wear, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, bool allowSimd = true);
+
+// "app stress_s share visible_s foreground_s" lines, regions as x,y,w,h:stress_s
+std::string FormatAttributionLedger(const std::vector<AppLedgerEntry>& ledger);
@@ -0,0 +1,255 @@
+#include "ArchiveSinks.h"
+#include "TileHash.h"
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+static const char RAW_MAGIC[8] = { 'O', 'L', 'B', 'G', 'R', 'A', '0', '1' };
+static const char TILE_MAGIC[8] = { 'O', 'L', 'T', 'I', 'L', 'E', '0', '1' };
+
+static void PutU32(uint8_t* dst, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i)
+        dst[i] = uint8_t(v >> (8 * i));
+}
+
+static uint32_t GetU32(const uint8_t* src)
+{
+    return uint32_t(src[0]) | uint32_t(src[1]) << 8 | uint32_t(src[2]) << 16 | uint32_t(src[3]) << 24;
+}
+
+static bool OpenIndex(std::ofstream& index, const std::string& path)
+{
+    index.open(path + ".idx");
+    index << "frame,timestamp_hns,offset\n";
+    return bool(index);
+}
+
+static void RemoveArchive(const std::string& path)
+{
+    std::remove(path.c_str());
+    std::remove((path + ".idx").c_str());
+}
+
+static void WriteIndexEntry(std::ofstream& index, uint64_t frame, int64_t timestampHns, uint64_t offset)
+{
+    char line[80];
+    std::snprintf(line, sizeof(line), "%llu,%lld,%llu\n",
+        (unsigned long long)frame, (long long)timestampHns, (unsigned long long)offset);
+    index << line;
+}
+
+bool RawBgraSink::Open(const std::string& path)
+{
+    m_bytes = 0;
+    m_frames = 0;
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file || !OpenIndex(m_index, path))
+        return false;
+
+    uint8_t header[HEADER_BYTES];
+    std::memcpy(header, RAW_MAGIC, sizeof(RAW_MAGIC));
+    PutU32(header + 8, m_width);
+    PutU32(header + 12, m_height);
+    m_file.write((const char*)header, sizeof(header));
+    m_bytes = sizeof(header);
+    return bool(m_file);
+}
+
+bool RawBgraSink::WriteFrame(const uint8_t* bgra, int64_t timestampHns)
+{
+    const uint64_t frameBytes = uint64_t(m_width) * m_height * 4;
+    WriteIndexEntry(m_index, m_frames++, timestampHns, m_bytes);
+    m_file.write((const char*)bgra, std::streamsize(frameBytes));
+    m_bytes += frameBytes;
+    return bool(m_file) && bool(m_index);
+}
+
+bool RawBgraSink::Close()
+{
+    m_file.close();
+    m_index.close();
+    return !m_file.fail() && !m_index.fail();
+}
+
+void RawBgraSink::Remove(const std::string& path)
+{
+    RemoveArchive(path);
+}
+
+// Calls entry(timestamp, offset) for every row of "<path>.idx"
+template <typename F>
+static bool ReadIndex(const std::string& path, F&& entry)
+{
+    std::ifstream index(path + ".idx");
+    std::string line;
+    if (!std::getline(index, line)) // header
+        return false;
+    while (std::getline(index, line))
+    {
+        unsigned long long frame = 0, offset = 0;
+        long long ts = 0;
+        char c1 = 0, c2 = 0;
+        std::istringstream row(line);
+        if (row >> frame >> c1 >> ts >> c2 >> offset)
+            entry(int64_t(ts), uint64_t(offset));
+    }
+    return true;
+}
+
+bool ReadArchiveTimestamps(const std::string& path, std::vector<int64_t>& timestampsHns)
+{
+    timestampsHns.clear();
+    return ReadIndex(path, [&](int64_t ts, uint64_t) { timestampsHns.push_back(ts); });
+}
+
+bool RawBgraReader::Open(const std::string& path)
+{
+    m_entries.clear();
+    m_file.open(path, std::ios::binary);
+    uint8_t header[RawBgraSink::HEADER_BYTES];
+    if (!m_file.read((char*)header, sizeof(header)) || std::memcmp(header, RAW_MAGIC, sizeof(RAW_MAGIC)) != 0)
+        return false;
+    m_width = GetU32(header + 8);
+    m_height = GetU32(header + 12);
+
+    return ReadIndex(path, [&](int64_t ts, uint64_t offset) { m_entries.push_back({ ts, offset }); });
+}
+
+bool RawBgraReader::ReadFrame(size_t frame, uint8_t* bgra)
+{
+    if (frame >= m_entries.size())
+        return false;
+    m_file.clear();
+    m_file.seekg(std::streamoff(m_entries[frame].offset));
+    return bool(m_file.read((char*)bgra, std::streamsize(uint64_t(m_width) * m_height * 4)));
+}
+
+bool Y4mSink::Open(const std::string& path)
+{
+    m_bytes = 0;
+    m_frames = 0;
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file || !OpenIndex(m_index, path))
+        return false;
+
+    char header[128];
+    int len = std::snprintf(header, sizeof(header),
+        "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C444 XCOLORRANGE=FULL XOLEPPY=GBR\n", m_width, m_height, m_fps);
+    m_file.write(header, len);
+    m_bytes = uint64_t(len);
+    m_planes.resize(size_t(m_width) * m_height * 3);
+    return bool(m_file);
+}
+
+bool Y4mSink::WriteFrame(const uint8_t* bgra, int64_t timestampHns)
+{
+    static const char FRAME_TAG[] = "FRAME\n";
+    const size_t count = size_t(m_width) * m_height;
+
+    // Deinterleave into G, B, R planes
+    uint8_t* g = m_planes.data();
+    uint8_t* b = g + count;
+    uint8_t* r = b + count;
+    for (size_t i = 0; i < count; ++i)
+    {
+        b[i] = bgra[i * 4 + 0];
+        g[i] = bgra[i * 4 + 1];
+        r[i] = bgra[i * 4 + 2];
+    }
+
+    WriteIndexEntry(m_index, m_frames++, timestampHns, m_bytes);
+    m_file.write(FRAME_TAG, sizeof(FRAME_TAG) - 1);
+    m_file.write((const char*)m_planes.data(), std::streamsize(m_planes.size()));
+    m_bytes += sizeof(FRAME_TAG) - 1 + m_planes.size();
+    return bool(m_file) && bool(m_index);
+}
+
+bool Y4mSink::Close()
+{
+    m_file.close();
+    m_index.close();
+    return !m_file.fail() && !m_index.fail();
+}
+
+void Y4mSink::Remove(const std::string& path)
+{
+    RemoveArchive(path);
+}
+
+bool TileArchiveSink::Open(const std::string& path)
+{
+    m_bytes = 0;
+    m_frames = 0;
+    m_encoder.ForceKeyframe();
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file || !OpenIndex(m_index, path))
+        return false;
+
+    uint8_t header[HEADER_BYTES];
+    std::memcpy(header, TILE_MAGIC, sizeof(TILE_MAGIC));
+    PutU32(header + 8, m_width);
+    PutU32(header + 12, m_height);
+    m_file.write((const char*)header, sizeof(header));
+    m_bytes = sizeof(header);
+    return bool(m_file);
+}
+
+bool TileArchiveSink::WriteFrame(const uint8_t* bgra, int64_t timestampHns)
+{
+    return WriteFrameWithTiles(bgra, timestampHns, nullptr);
+}
+
+// The hasher's tiles are the codec's
+static_assert(TileHasher::TILE == TileCodec::TILE_SIZE, "TileHasher and TileCodec tiles differ");
+
+bool TileArchiveSink::WriteFrameWithTiles(const uint8_t* bgra, int64_t timestampHns, const uint8_t* changedTiles)
+{
+    if (m_keyframeInterval > 0 && m_frames % m_keyframeInterval == 0)
+        m_encoder.ForceKeyframe();
+    m_encoder.EncodeFrame(bgra, m_encoded, changedTiles);
+
+    uint8_t length[4];
+    PutU32(length, uint32_t(m_encoded.size()));
+    WriteIndexEntry(m_index, m_frames++, timestampHns, m_bytes);
+    m_file.write((const char*)length, sizeof(length));
+    m_file.write((const char*)m_encoded.data(), std::streamsize(m_encoded.size()));
+    m_bytes += sizeof(length) + m_encoded.size();
+    return bool(m_file) && bool(m_index);
+}
+
+bool TileArchiveSink::Close()
+{
+    m_file.close();
+    m_index.close();
+    return !m_file.fail() && !m_index.fail();
+}
+
+void TileArchiveSink::Remove(const std::string& path)
+{
+    RemoveArchive(path);
+}
+
+bool TileArchiveReader::Open(const std::string& path, unsigned threads)
+{
+    m_file.open(path, std::ios::binary);
+    uint8_t header[TileArchiveSink::HEADER_BYTES];
+    if (!m_file.read((char*)header, sizeof(header)) || std::memcmp(header, TILE_MAGIC, sizeof(TILE_MAGIC)) != 0)
+        return false;
+    m_width = GetU32(header + 8);
+    m_height = GetU32(header + 12);
+    m_decoder = std::make_unique<TileDecoder>(m_width, m_height, threads);
+    return true;
+}
+
+bool TileArchiveReader::ReadNextFrame(uint8_t* bgra)
+{
+    uint8_t length[4];
+    if (!m_decoder || !m_file.read((char*)length, sizeof(length)))
+        return false;
+    m_encoded.resize(GetU32(length));
+    if (!m_file.read((char*)m_encoded.data(), std::streamsize(m_encoded.size())))
+        return false;
+    return m_decoder->DecodeFrame(m_encoded.data(), m_encoded.size(), bgra);
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "FrameSink.h"
+#include "TileCodec.h"
+
+#include <fstream>
+
+// Lossless archive sinks. Unlike the H.264 path they keep every subpixel value exactly,
+// which is what the wear model consumes. Both write a "<file>.idx" CSV next to the file
+// (frame,timestamp_hns,offset) because capture runs at a variable rate. Rows are stored
+// in the order given, top-down as every capture source delivers them (CaptureSource.h):
+// row 0 of an archive is the top of the screen whichever backend recorded it.
+
+// Raw top-down BGRA frames after a 16 byte header: "OLBGRA01", width, height (uint32 LE).
+// ~8 MB per 1080p frame; mainly a reference format and for short analysis runs.
+class RawBgraSink : public IFrameSink
+{
+public:
+    static constexpr uint32_t HEADER_BYTES = 16;
+
+    RawBgraSink(uint32_t width, uint32_t height) : m_width(width), m_height(height) {}
+
+    bool Open(const std::string& path) override;
+    bool WriteFrame(const uint8_t* bgra, int64_t timestampHns) override;
+    bool Close() override;
+    uint64_t BytesWritten() const override { return m_bytes; }
+    void Remove(const std::string& path) override; // the file and its index
+
+private:
+    uint32_t m_width, m_height;
+    std::ofstream m_file;
+    std::ofstream m_index;
+    uint64_t m_bytes = 0;
+    uint64_t m_frames = 0;
+};
+
+// Timestamps of every frame in the "<file>.idx" of an archive, in frame order
+bool ReadArchiveTimestamps(const std::string& path, std::vector<int64_t>& timestampsHns);
+
+// Random access to a RawBgraSink file through its index.
+class RawBgraReader
+{
+public:
+    bool Open(const std::string& path);
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    size_t FrameCount() const { return m_entries.size(); }
+    int64_t Timestamp(size_t frame) const { return m_entries[frame].timestampHns; }
+    bool ReadFrame(size_t frame, uint8_t* bgra);
+
+private:
+    struct Entry
+    {
+        int64_t timestampHns;
+        uint64_t offset;
+    };
+    uint32_t m_width = 0, m_height = 0;
+    std::ifstream m_file;
+    std::vector<Entry> m_entries;
+};
+
+// YUV4MPEG2, 4:4:4, 8 bit. There is no RGB colour space in Y4M, so the planes carry
+// G, B, R unchanged in the Y, Cb, Cr slots (tagged XOLEPPY=GBR, as ffmpeg's gbrp order):
+// lossless and streamable into any y4m tool, but a plain player shows false colours.
+// The fps in the header is nominal; real timing is in the index.
+class Y4mSink : public IFrameSink
+{
+public:
+    Y4mSink(uint32_t width, uint32_t height, uint32_t fps) : m_width(width), m_height(height), m_fps(fps) {}
+
+    bool Open(const std::string& path) override;
+    bool WriteFrame(const uint8_t* bgra, int64_t timestampHns) override;
+    bool Close() override;
+    uint64_t BytesWritten() const override { return m_bytes; }
+    void Remove(const std::string& path) override; // the file and its index
+
+private:
+    uint32_t m_width, m_height, m_fps;
+    std::ofstream m_file;
+    std::ofstream m_index;
+    std::vector<uint8_t> m_planes;
+    uint64_t m_bytes = 0;
+    uint64_t m_frames = 0;
+};
+
+// TileCodec stream after a 16 byte header "OLTILE01", width, height; every frame is a
+// u32 LE length plus the encoded frame. Lossless and usually well under 10% of raw on
+// desktop content. Each file starts with a keyframe, so any segment decodes on its own.
+class TileArchiveSink : public IFrameSink
+{
+public:
+    static constexpr uint32_t HEADER_BYTES = 16;
+
+    // keyframeInterval = 0: only the first frame of every file is a keyframe
+    TileArchiveSink(uint32_t width, uint32_t height, unsigned threads = 0, uint32_t keyframeInterval = 0)
+        : m_encoder(width, height, threads), m_width(width), m_height(height), m_keyframeInterval(keyframeInterval) {}
+
+    bool Open(const std::string& path) override;
+    bool WriteFrame(const uint8_t* bgra, int64_t timestampHns) override;
+    bool WriteFrameWithTiles(const uint8_t* bgra, int64_t timestampHns, const uint8_t* changedTiles) override;
+    bool Close() override;
+    uint64_t BytesWritten() const override { return m_bytes; }
+    void Remove(const std::string& path) override; // the file and its index
+
+private:
+    TileEncoder m_encoder;
+    uint32_t m_width, m_height, m_keyframeInterval;
+    std::ofstream m_file;
+    std::ofstream m_index;
+    std::vector<uint8_t> m_encoded;
+    uint64_t m_bytes = 0;
+    uint64_t m_frames = 0;
+};
+
+// Sequential decode of a TileArchiveSink file.
+class TileArchiveReader
+{
+public:
+    bool Open(const std::string& path, unsigned threads = 0);
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    // False at the end of the file or on a corrupt frame
+    bool ReadNextFrame(uint8_t* bgra);
+
+private:
+    uint32_t m_width = 0, m_height = 0;
+    std::ifstream m_file;
+    std::unique_ptr<TileDecoder> m_decoder;
+    std::vector<uint8_t> m_encoded;
+};
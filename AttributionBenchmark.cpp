@@ -0,0 +1,140 @@
+#include "BenchmarkModes.h"
+
+#include "WearMap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+// Four applications drifting across the screen; the front one changes every layout
+static std::vector<AppWindow> SyntheticLayout(uint64_t layout, uint32_t width, uint32_t height)
+{
+    static const char* const apps[] = { "ide.exe", "browser.exe", "game.exe", "terminal.exe" };
+    std::vector<AppWindow> windows;
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        const uint32_t slot = uint32_t((i + layout) % 4); // stacking order
+        AppWindow window;
+        window.app = apps[i];
+        window.width = int32_t(width / 2 + (i * width) / 16);
+        window.height = int32_t(height / 2 + (i * height) / 16);
+        window.x = int32_t((layout * 37 + i * width / 5) % width) - int32_t(width / 8);
+        window.y = int32_t((layout * 23 + i * height / 5) % height) - int32_t(height / 8);
+        window.foreground = slot == 0;
+        windows.push_back(window);
+    }
+    std::sort(windows.begin(), windows.end(),
+        [&](const AppWindow& a, const AppWindow& b) { return a.foreground > b.foreground || (a.foreground == b.foreground && a.app < b.app); });
+    return windows;
+}
+
+AttributionBenchmark MeasureAttribution(const BenchmarkConfig& config, uint32_t layoutFrames)
+{
+    AttributionBenchmark bench;
+    const uint32_t width = config.width, height = config.height;
+    const double dt = 1.0 / (config.fps > 0.0 ? config.fps : 60.0);
+    const SyntheticDesktop desktop(config.workload, width, height);
+    std::vector<uint8_t> frame(size_t(width) * height * 4);
+
+    WearMap wear;
+    wear.Reset(width, height);
+    AppAttribution attribution;
+
+    // Reference: the owner of every pixel and the planes when the layout began
+    std::vector<std::string> names = { AppAttribution::DESKTOP };
+    std::vector<uint8_t> labels(size_t(width) * height);
+    std::vector<double> snapshot[3];
+    std::vector<double> reference(5, 0.0);
+    auto settleReference = [&] {
+        for (int c = 0; c < 3; ++c)
+        {
+            const double* plane = wear.Plane(c);
+            if (snapshot[c].empty())
+                snapshot[c].assign(plane, plane + labels.size());
+            for (size_t i = 0; i < labels.size(); ++i)
+            {
+                reference[labels[i]] += (plane[i] - snapshot[c][i]) * WearMap::UnitSeconds();
+                snapshot[c][i] = plane[i];
+            }
+        }
+    };
+
+    double setLayoutNs = 0.0, labelNs = 0.0;
+    for (uint64_t i = 0; i < config.frames; ++i)
+    {
+        if (i % layoutFrames == 0)
+        {
+            const std::vector<AppWindow> windows = SyntheticLayout(i / layoutFrames, width, height);
+            auto start = Clock::now();
+            attribution.SetLayout(wear, windows);
+            auto set = Clock::now();
+
+            settleReference();
+            std::fill(labels.begin(), labels.end(), uint8_t(0));
+            for (auto w = windows.rbegin(); w != windows.rend(); ++w) // back to front
+            {
+                const uint8_t id = uint8_t(1 + (std::find(names.begin() + 1, names.end(), w->app) - (names.begin() + 1)));
+                if (id == names.size())
+                    names.push_back(w->app);
+                const int64_t x0 = (std::max)(int64_t(w->x), int64_t(0)), x1 = (std::min)(int64_t(w->x) + w->width, int64_t(width));
+                const int64_t y0 = (std::max)(int64_t(w->y), int64_t(0)), y1 = (std::min)(int64_t(w->y) + w->height, int64_t(height));
+                for (int64_t y = y0; y < y1; ++y)
+                    for (int64_t x = x0; x < x1; ++x)
+                        labels[size_t(y) * width + size_t(x)] = id;
+            }
+            auto labelled = Clock::now();
+            setLayoutNs += std::chrono::duration<double, std::nano>(set - start).count();
+            labelNs += std::chrono::duration<double, std::nano>(labelled - set).count();
+            bench.layouts++;
+        }
+        desktop.Render(i, frame.data());
+        wear.Accumulate(frame.data(), dt);
+        bench.frames++;
+    }
+    attribution.Settle(wear);
+    settleReference();
+
+    bench.setLayoutMs = bench.layouts ? setLayoutNs / 1e6 / double(bench.layouts) : 0.0;
+    bench.labelMapMs = bench.layouts ? labelNs / 1e6 / double(bench.layouts) : 0.0;
+    bench.ledger = attribution.Ledger(3);
+    for (const AppLedgerEntry& entry : bench.ledger)
+    {
+        const size_t id = size_t(std::find(names.begin(), names.end(), entry.app) - names.begin());
+        const double expected = id < names.size() ? reference[id] : 0.0;
+        const double error = std::fabs(entry.stressSeconds - expected) / (std::max)(std::fabs(expected), 1e-12);
+        bench.maxRelativeError = (std::max)(bench.maxRelativeError, error);
+    }
+    return bench;
+}
+
+std::string FormatAttributionJson(const AttributionBenchmark& bench)
+{
+    char buf[256];
+    std::snprintf(buf, sizeof(buf),
+        "{\"benchmark\":\"attribution\",\"frames\":%llu,\"layouts\":%llu,\"set_layout_ms\":%.3f,"
+        "\"label_map_ms\":%.3f,\"max_relative_error\":%.3g,\"apps\":[",
+        (unsigned long long)bench.frames, (unsigned long long)bench.layouts, bench.setLayoutMs, bench.labelMapMs,
+        bench.maxRelativeError);
+    std::string json = buf;
+    for (size_t i = 0; i < bench.ledger.size(); ++i)
+    {
+        const AppLedgerEntry& e = bench.ledger[i];
+        std::snprintf(buf, sizeof(buf),
+            "%s\n  {\"app\":\"%s\",\"stress_s\":%.3f,\"share\":%.4f,\"visible_s\":%.2f,\"foreground_s\":%.2f,\"top_region\":[%u,%u,%u,%u]}",
+            i ? "," : "", e.app.c_str(), e.stressSeconds, e.share, e.visibleSeconds, e.foregroundSeconds,
+            e.regions.empty() ? 0 : e.regions[0].x, e.regions.empty() ? 0 : e.regions[0].y,
+            e.regions.empty() ? 0 : e.regions[0].width, e.regions.empty() ? 0 : e.regions[0].height);
+        json += buf;
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+bool RunAttributionMode(const BenchmarkOptions& options, std::string& json)
+{
+    BenchmarkConfig config = options.config;
+    config.workload = options.workloads.front();
+    AttributionBenchmark bench = MeasureAttribution(config);
+    json = FormatAttributionJson(bench);
+    return bench.maxRelativeError < 1e-9;
+}
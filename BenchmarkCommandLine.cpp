@@ -0,0 +1,239 @@
+#include "BenchmarkModes.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+struct BenchmarkMode
+{
+    const char* name;
+    BenchmarkModeFunction run;
+    const char* help;
+};
+
+// --NAME or --mode=NAME; without one the pipeline runs
+const BenchmarkMode MODES[] = {
+    { "pipeline", RunPipelineMode,
+        "CapturePipeline per --workload into --sink (the default mode)" },
+    { "trace-overhead", RunTraceOverheadMode,
+        "TRACE_SCOPE cost disabled / enabled and ring allocation per thread" },
+    { "hdr-kernels", RunHdrKernelMode,
+        "HDR decode / luminance / wear kernels on the first workload" },
+    { "wear-accuracy", RunWearAccuracyMode,
+        "WearMap error against a long double reference, and its per-frame cost\n"
+        "against float32 planes on the first workload at --size" },
+    { "level-histogram", RunLevelHistogramMode,
+        "LevelHistogram against the exact WearMap for 8-64 bins and exponents\n"
+        "1, 1.54, 2.2 per workload at --size over --frames, counter rounding on\n"
+        "a long session, and 4K Evaluate on --threads=N" },
+    { "lifetime", RunLifetimeMode,
+        "LifetimeProjection percentiles against nth_element and ProjectMap /\n"
+        "Summarize time on a 4K map, HoursToThreshold against per-frame sums" },
+    { "offline-analysis", RunOfflineScalingMode,
+        "OfflineAnalysis scaling on a raw archive of the first workload,\n"
+        "--threads=N caps the thread count" },
+    { "media-ranking", RunRankingMode,
+        "rank --clips=5000 synthetic signatures against a wear map of --size" },
+    { "attribution", RunAttributionMode,
+        "per-application attribution of the first workload vs a label map" },
+    { "integral", RunIntegralMode,
+        "WearIntegral update cost per workload, with frame compares and with\n"
+        "hashed tiles, and query latency vs scans" },
+    { "heatmap", RunHeatmapMode,
+        "heatmap PNG / TIFF export of a --size map on --threads=N threads,\n"
+        "--golden=path compares the PNG with path instead of the built-in hash" },
+    { "proxy", RunProxyMode,
+        "FrameDownscaler SSE2 / scalar / fused with the readback copy for\n"
+        "factors 2, 4, 8, 16 on the first workload at --size" },
+    { "cold-start", RunColdStartMode,
+        "refcounted platform init over segment rotations, session start and\n"
+        "time to first frame at --size" },
+    { "x11", RunX11CaptureMode,
+        "X11CaptureSource throughput on --display=NAME (default $DISPLAY),\n"
+        "in builds with PIPELINE_BENCH_X11" },
+    { "tile-hash", RunTileHashMode,
+        "TileHasher cost against the readback copy and the tile compare it\n"
+        "replaces, and the tiles / frames it finds unchanged per workload at\n"
+        "--size over --frames" },
+    { "tile-codec", RunTileCodecMode,
+        "TileEncoder / TileDecoder round trip per workload at --size over\n"
+        "--frames, with and without Huffman and with hashed tiles: ratio, MB/s,\n"
+        "byte mismatches" },
+    { "session-stress", RunSessionStressMode,
+        "CaptureSession lost access / resize / restart self-check on\n"
+        "--threads=N concurrent sessions (default 4) and a CapturePipeline\n"
+        "following the mode changes" },
+    { "segments", RunSegmentMode,
+        "SegmentedRecorder rotation, ordering and open retries on a stub\n"
+        "encoder; writes bench_segment_*.stub here and deletes them" },
+    { "control", RunControlMode,
+        "daemon control protocol script against a pipeline on the first\n"
+        "workload at --size" },
+    { "gop-parallel", RunGopParallelMode,
+        "GopParallelSink chunk order and reorder / queue bounds against a\n"
+        "sequential encode; writes bench_gop.264 here and deletes it" },
+    { "pointer-wear", RunPointerWearMode,
+        "PointerWear against composited frames over a 3000-step pointer track\n"
+        "on the first workload at --size" },
+    { "frame-arena", RunFrameArenaMode,
+        "the pipeline unpaced on the first workload with FrameArena frame buffers\n"
+        "and with std::vector: throughput, stage times and dTLB misses" },
+    { "rate-controller", RunRateControllerMode,
+        "CPU / GPU time CaptureRateController saves against a fixed-rate capture\n"
+        "on synthetic rate traces and the one in --rate-trace=path (SaveRateTrace)" },
+};
+
+const char USAGE[] =
+    "usage: pipeline_bench [--MODE | --mode=MODE] [options]\n"
+    "options:\n"
+    "  --workload=all|static_desktop|scrolling_text|video|game_hud  --size=1920x1080\n"
+    "  --fps=60 (0 = unpaced)  --frames=300  --warmup=30  --sink=null|raw|y4m|tile\n"
+    "  --level-bins=0  --arena=1 (0 = std::vector frame buffers)  --threads=N  --clips=N\n"
+    "  --out=path (- = stdout)\n"
+    "  --trace=path      record trace points during the pipeline runs (Chrome trace)\n"
+    "  --golden=path     --display=NAME  --rate-trace=path\n"
+    "modes:\n";
+
+void PrintUsage(FILE* out)
+{
+    std::fputs(USAGE, out);
+    for (const BenchmarkMode& mode : MODES)
+    {
+        std::fprintf(out, "  %-18s", mode.name);
+        for (const char* line = mode.help; *line;)
+        {
+            const char* end = line;
+            while (*end && *end != '\n')
+                ++end;
+            std::fprintf(out, "%.*s\n", int(end - line), line);
+            line = *end ? end + 1 : end;
+            if (*line)
+                std::fprintf(out, "  %-18s", "");
+        }
+    }
+}
+
+const BenchmarkMode* FindMode(const std::string& name)
+{
+    for (const BenchmarkMode& mode : MODES)
+        if (name == mode.name)
+            return &mode;
+    return nullptr;
+}
+
+bool ParseWorkload(const std::string& name, std::vector<SyntheticWorkload>& workloads)
+{
+    const SyntheticWorkload all[] = { SyntheticWorkload::StaticDesktop, SyntheticWorkload::ScrollingText,
+        SyntheticWorkload::Video, SyntheticWorkload::GameHud };
+    workloads.clear();
+    for (SyntheticWorkload workload : all)
+        if (name == "all" || name == SyntheticWorkloadName(workload))
+            workloads.push_back(workload);
+    return !workloads.empty();
+}
+
+bool ParseSink(const std::string& name, BenchmarkSink& sink)
+{
+    const BenchmarkSink all[] = { BenchmarkSink::Null, BenchmarkSink::Raw, BenchmarkSink::Y4m, BenchmarkSink::Tile };
+    for (BenchmarkSink candidate : all)
+        if (name == BenchmarkSinkName(candidate))
+        {
+            sink = candidate;
+            return true;
+        }
+    return false;
+}
+}
+
+int RunBenchmarkCommandLine(const std::vector<std::string>& args, const std::string& defaultOut)
+{
+    BenchmarkOptions options;
+    BenchmarkConfig& config = options.config;
+    ParseWorkload("all", options.workloads);
+    std::string out = defaultOut;
+    const BenchmarkMode* mode = nullptr;
+
+    for (const std::string& arg : args)
+    {
+        if (arg == "--help" || arg == "-h")
+        {
+            PrintUsage(stdout);
+            return 0;
+        }
+        if (arg == "--bench") // the Windows switch that got us here
+            continue;
+
+        const size_t eq = arg.find('=');
+        const std::string key = arg.compare(0, 2, "--") == 0 ? arg.substr(2, eq == std::string::npos ? eq : eq - 2) : "";
+        const std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        const BenchmarkMode* named = eq == std::string::npos ? FindMode(key) : key == "mode" ? FindMode(value) : nullptr;
+        bool known = true, valid = true;
+        if (named)
+        {
+            valid = !mode || mode == named;
+            mode = named;
+        }
+        else if (key.empty() || eq == std::string::npos || key == "mode")
+            known = false;
+        else if (key == "workload")
+            valid = ParseWorkload(value, options.workloads);
+        else if (key == "size")
+            valid = std::sscanf(value.c_str(), "%ux%u", &config.width, &config.height) == 2 && config.width && config.height;
+        else if (key == "fps")
+            config.fps = std::atof(value.c_str());
+        else if (key == "frames")
+            config.frames = uint32_t(std::strtoul(value.c_str(), nullptr, 10));
+        else if (key == "warmup")
+            config.warmupFrames = uint32_t(std::strtoul(value.c_str(), nullptr, 10));
+        else if (key == "sink")
+            valid = ParseSink(value, config.sink);
+        else if (key == "level-bins")
+            config.levelBins = uint32_t(std::strtoul(value.c_str(), nullptr, 10));
+        else if (key == "arena")
+        {
+            valid = value == "0" || value == "1";
+            config.frameArena = value != "0";
+        }
+        else if (key == "threads")
+            options.maxThreads = unsigned(std::strtoul(value.c_str(), nullptr, 10));
+        else if (key == "clips")
+            options.clips = uint32_t(std::strtoul(value.c_str(), nullptr, 10));
+        else if (key == "out")
+            out = value;
+        else if (key == "trace")
+            options.tracePath = value;
+        else if (key == "golden")
+            options.goldenPath = value;
+        else if (key == "display")
+            options.display = value;
+        else if (key == "rate-trace")
+            options.rateTracePath = value;
+        else
+            known = false;
+
+        if (!known || !valid)
+        {
+            std::fprintf(stderr, "bench: %s %s\n", known ? "bad value in" : "unknown argument", arg.c_str());
+            PrintUsage(stderr);
+            return 2;
+        }
+    }
+
+    std::string json;
+    bool ok = (mode ? mode->run : RunPipelineMode)(options, json);
+
+    if (out == "-")
+    {
+        std::cout << json;
+    }
+    else
+    {
+        std::ofstream file(out, std::ios::trunc);
+        file << json;
+        ok = ok && bool(file);
+    }
+    return ok ? 0 : 1;
+}
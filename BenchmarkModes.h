@@ -0,0 +1,77 @@
+#pragma once
+
+#include "PipelineBenchmark.h"
+#include "WearMap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Internal to the benchmark: every mode of RunBenchmarkCommandLine lives in its own
+// <Name>Benchmark.cpp with its Measure* / Format*Json (declared in PipelineBenchmark.h)
+// and a Run*Mode that runs it with the command-line options and applies its self-check.
+// BenchmarkCommandLine.cpp lists the modes by name.
+
+using Clock = std::chrono::steady_clock;
+
+// Everything the command line sets; each mode reads what it needs
+struct BenchmarkOptions
+{
+    BenchmarkConfig config;
+    std::vector<SyntheticWorkload> workloads; // never empty
+    unsigned maxThreads = 0;                  // --threads
+    uint32_t clips = 5000;                    // --clips
+    std::string display;                      // --display, X11
+    std::string goldenPath;                   // --golden, heatmap
+    std::string tracePath;                    // --trace, pipeline
+    std::string rateTracePath;                // --rate-trace, rate controller
+};
+
+// Runs a mode into json; false when its self-check failed
+using BenchmarkModeFunction = bool (*)(const BenchmarkOptions& options, std::string& json);
+
+bool RunPipelineMode(const BenchmarkOptions& options, std::string& json);
+bool RunTraceOverheadMode(const BenchmarkOptions& options, std::string& json);
+bool RunHdrKernelMode(const BenchmarkOptions& options, std::string& json);
+bool RunWearAccuracyMode(const BenchmarkOptions& options, std::string& json);
+bool RunLevelHistogramMode(const BenchmarkOptions& options, std::string& json);
+bool RunLifetimeMode(const BenchmarkOptions& options, std::string& json);
+bool RunOfflineScalingMode(const BenchmarkOptions& options, std::string& json);
+bool RunRankingMode(const BenchmarkOptions& options, std::string& json);
+bool RunAttributionMode(const BenchmarkOptions& options, std::string& json);
+bool RunIntegralMode(const BenchmarkOptions& options, std::string& json);
+bool RunHeatmapMode(const BenchmarkOptions& options, std::string& json);
+bool RunProxyMode(const BenchmarkOptions& options, std::string& json);
+bool RunColdStartMode(const BenchmarkOptions& options, std::string& json);
+bool RunTileHashMode(const BenchmarkOptions& options, std::string& json);
+bool RunTileCodecMode(const BenchmarkOptions& options, std::string& json);
+bool RunSessionStressMode(const BenchmarkOptions& options, std::string& json);
+bool RunSegmentMode(const BenchmarkOptions& options, std::string& json);
+bool RunControlMode(const BenchmarkOptions& options, std::string& json);
+bool RunGopParallelMode(const BenchmarkOptions& options, std::string& json);
+bool RunPointerWearMode(const BenchmarkOptions& options, std::string& json);
+bool RunFrameArenaMode(const BenchmarkOptions& options, std::string& json);
+bool RunRateControllerMode(const BenchmarkOptions& options, std::string& json);
+bool RunX11CaptureMode(const BenchmarkOptions& options, std::string& json);
+
+// Best of repetitions, in nanoseconds per call
+template <typename F>
+double BestOf(uint32_t repetitions, F&& f)
+{
+    double best = 1e30;
+    for (uint32_t i = 0; i < repetitions; ++i)
+    {
+        auto start = Clock::now();
+        f();
+        best = (std::min)(best, std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+// Mean, p50, p99 and max of nanosecond samples; reorders them
+StageTiming Summarize(std::vector<int64_t>& samples);
+
+// Same size, total time and bit-identical planes
+bool SamePlanes(const WearMap& a, const WearMap& b);
@@ -0,0 +1,589 @@
+#include "CapturePipeline.h"
+
+#include "FrameArena.h"
+#include "FrameProxy.h"
+#include "TileHash.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+using Seconds = std::chrono::duration<double>;
+
+static bool SamePointer(const PointerState& a, const PointerState& b)
+{
+    return a.visible == b.visible && a.x == b.x && a.y == b.y && a.shape == b.shape;
+}
+
+// Window rectangles in proxy pixels: every proxy pixel the window touches
+static void ScaleWindows(std::vector<AppWindow>& windows, uint32_t factor)
+{
+    for (AppWindow& window : windows)
+    {
+        const int32_t x0 = int32_t(std::floor(double(window.x) / factor));
+        const int32_t y0 = int32_t(std::floor(double(window.y) / factor));
+        const int32_t x1 = int32_t(std::ceil((double(window.x) + window.width) / factor));
+        const int32_t y1 = int32_t(std::ceil((double(window.y) + window.height) / factor));
+        window.x = x0;
+        window.y = y0;
+        window.width = x1 - x0;
+        window.height = y1 - y0;
+    }
+}
+
+CapturePipeline::CapturePipeline(CaptureSession& session, PipelineConfig config)
+    : m_session(session), m_config(std::move(config))
+{
+    if (m_config.sinkFactory)
+        m_recorder = std::make_unique<SegmentedRecorder>(m_config.sinkFactory, m_config.segments);
+    if (IsProxyFactor(m_config.proxyFactor))
+        m_proxyFactor = m_config.proxyFactor;
+}
+
+CapturePipeline::~CapturePipeline()
+{
+    Stop();
+}
+
+bool CapturePipeline::Start()
+{
+    if (m_running)
+        return true;
+    if (m_thread.joinable())
+        m_thread.join(); // the previous run ended on its own (session fault)
+
+    if (!m_session.Start())
+        return false;
+
+    // The sinks the factory makes are for one frame size, the first one recorded
+    const bool record = m_recorder && !m_recordingEnded;
+    if (record)
+    {
+        if (!m_recordWidth)
+        {
+            m_recordWidth = m_session.Width();
+            m_recordHeight = m_session.Height();
+        }
+        if (m_session.Width() != m_recordWidth || m_session.Height() != m_recordHeight)
+        {
+            m_session.Stop(); // do not hold the duplication without a capture thread
+            return false;
+        }
+    }
+
+    ResizeAnalysis();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_rate = std::make_unique<CaptureRateController>(m_config.rate);
+        m_startTime = std::chrono::steady_clock::now();
+    }
+
+    if (record && !m_recorder->Begin())
+    {
+        m_session.Stop();
+        return false;
+    }
+    m_recording = record;
+
+    m_stopRequested = false;
+    m_running = true;
+    m_thread = std::thread(&CapturePipeline::Run, this);
+    return true;
+}
+
+// Everything but the recording is at the proxy's size of the session's current mode
+void CapturePipeline::ResizeAnalysis()
+{
+    const uint32_t width = ProxyDimension(m_session.Width(), m_proxyFactor);
+    const uint32_t height = ProxyDimension(m_session.Height(), m_proxyFactor);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_wear.Width() != width || m_wear.Height() != height)
+    {
+        m_wear.Reset(width, height, m_config.wearExponent);
+        // The open interval refers to cells of the old map
+        if (m_attribution)
+            m_attribution->Clear();
+    }
+    // Kept in step across Start/Stop like the map; taken over from it when new or resized
+    if (m_config.wearIntegral &&
+        (!m_integral || m_integral->Width() != m_wear.Width() || m_integral->Height() != m_wear.Height()))
+    {
+        m_integral = std::make_unique<WearIntegral>();
+        m_integral->Reset(m_wear);
+    }
+    if (m_config.levelBins && (!m_levels || m_levels->Width() != width || m_levels->Height() != height))
+    {
+        m_levels = std::make_unique<LevelHistogram>();
+        if (!m_levels->Reset(width, height, m_config.levelBins))
+            m_levels.reset();
+    }
+    if (m_config.windowSampler && !m_attribution)
+        m_attribution = std::make_unique<AppAttribution>();
+}
+
+void CapturePipeline::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopRequested = true;
+    }
+    m_cv.notify_all();
+
+    if (m_thread.joinable())
+        m_thread.join();
+    if (m_recorder)
+        m_recorder->End();
+}
+
+void CapturePipeline::Flush()
+{
+    m_flushRequested = true;
+}
+
+void CapturePipeline::EndRecording()
+{
+    if (m_running)
+        return;
+    if (m_recorder)
+        m_recorder->End();
+    m_recordingEnded = true;
+}
+
+bool CapturePipeline::WaitUntil(std::chrono::steady_clock::time_point deadline)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait_until(lock, deadline, [&] { return m_stopRequested.load(); });
+    return !m_stopRequested;
+}
+
+void CapturePipeline::Run()
+{
+    Trace::SetThreadName("capture");
+    while (RunMode())
+    {
+        // The session reopened at another size: new maps (like a Start at that size) and
+        // new buffers. The recording's sinks are for the old size, so it ends here.
+        if (m_recording)
+        {
+            m_recording = false;
+            m_recorder->End();
+        }
+        ResizeAnalysis();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_modeChanges++;
+    }
+    m_running = false;
+}
+
+// Captures at the session's current size until Stop, a fault (false) or a mode change (true)
+bool CapturePipeline::RunMode()
+{
+    // The frames analysed: full frames, or their proxies
+    const uint32_t factor = m_proxyFactor;
+    const uint32_t fullWidth = m_session.Width(), fullHeight = m_session.Height();
+    const uint32_t width = ProxyDimension(fullWidth, factor), height = ProxyDimension(fullHeight, factor);
+
+    // Both frame buffers on this thread's NUMA node, in large pages where allowed
+    const size_t frameBytes = size_t(width) * height * 4;
+    FrameArena frames;
+    std::vector<uint8_t> frameVectors[2];
+    uint8_t* frame;
+    uint8_t* lastFrame;
+    if (m_config.frameArena)
+    {
+        if (!frames.Reset(frameBytes, 2, { true, true }))
+            return false;
+        frame = frames.Slot(0);
+        lastFrame = frames.Slot(1);
+    }
+    else
+    {
+        frameVectors[0].resize(frameBytes);
+        frameVectors[1].resize(frameBytes);
+        frame = frameVectors[0].data();
+        lastFrame = frameVectors[1].data();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_frameBuffers = frames.Backing();
+    }
+    bool haveLastFrame = false;
+
+    // With a proxy, full frames are only read back for the recording
+    FrameArena archiveArena;
+    uint8_t* fullFrame = nullptr;
+    if (factor > 1 && m_recording)
+    {
+        if (!archiveArena.Reset(size_t(fullWidth) * fullHeight * 4, 1, { true, true }))
+            return false;
+        fullFrame = archiveArena.Slot(0);
+    }
+
+    // HDR sources also hand out level codes, paired with the frame buffers
+    FrameArena levelArena;
+    uint16_t* levels = nullptr;
+    uint16_t* lastLevels = nullptr;
+    bool lastHasLevels = false;
+    if (factor == 1 && m_session.Format() != CapturePixelFormat::Bgra8 &&
+        levelArena.Reset(size_t(width) * height * 4 * sizeof(uint16_t), 2, { true, true }))
+    {
+        levels = reinterpret_cast<uint16_t*>(levelArena.Slot(0));
+        lastLevels = reinterpret_cast<uint16_t*>(levelArena.Slot(1));
+    }
+    PointerState pointer; // on screen over lastFrame since lastFrameTime
+    // The pointer as it covers a proxy; the shape is averaged once per shape
+    std::shared_ptr<const PointerShape> proxyShape;
+    auto analysedPointer = [&](const PointerState& reported) -> PointerState {
+        if (factor == 1)
+            return reported;
+        if (reported.shape && (!proxyShape || proxyShape->id != reported.shape->id))
+            proxyShape = DownscalePointerShape(*reported.shape, factor);
+        PointerState scaled;
+        ScalePointer(reported, factor, reported.shape ? proxyShape : nullptr, scaled);
+        return scaled;
+    };
+
+    // Changed tiles of the full frames as they are read back, against lastFrame when it
+    // was hashed too. They go to the tile archive with the frame, and add up to the tiles
+    // changed since the frame the wear integral last took while every frame in between
+    // was hashed (at full size only: the integral is at proxy size), so neither compares
+    // frames nor keeps a copy of the previous one.
+    TileHasher tiles;
+    bool lastHashed = false;
+    bool recordedHashed = false;
+    std::vector<uint8_t> integralChanged;
+    bool integralChangedKnown = false;
+    static_assert(TileHasher::TILE == WearIntegral::TILE, "TileHasher and WearIntegral tiles differ");
+
+    auto integrateLast = [&](double seconds) {
+        if (Integrate(lastFrame, lastHasLevels ? lastLevels : nullptr, pointer, seconds,
+                integralChangedKnown ? integralChanged.data() : nullptr))
+        {
+            std::fill(integralChanged.begin(), integralChanged.end(), uint8_t(0));
+            integralChangedKnown = true;
+        }
+    };
+    auto record = [&](const CaptureFrameInfo& info, int64_t ts) {
+        if (!m_recording)
+            return;
+        m_recorder->WriteFrame(factor > 1 ? fullFrame : frame, ts,
+            recordedHashed && info.tilesHashed ? tiles.Changed().data() : nullptr);
+        recordedHashed = info.tilesHashed;
+    };
+
+    const auto start = m_startTime;
+    auto lastFrameTime = start;
+    auto nextCapture = start;
+    auto nextWindowSample = start;
+    std::vector<AppWindow> windows, sampledWindows; // layout attributed since the last change
+    bool resized = false;
+
+    while (WaitUntil(nextCapture))
+    {
+        auto captureStart = std::chrono::steady_clock::now();
+        int64_t ts =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(captureStart - start).count() / 100;
+
+        CaptureFrameInfo info;
+        info.levels = levels;
+        if (factor > 1)
+        {
+            info.proxy = frame;
+            info.proxyFactor = factor;
+        }
+        if (m_config.tileHash)
+            info.tiles = &tiles;
+        CaptureResult result = m_session.CaptureNext(factor > 1 ? fullFrame : frame, &info);
+
+        // Not a pixel changed: lastFrame is still what is on screen, so its interval goes
+        // on and nothing is analysed, unless the pointer moved. Level codes are not hashed.
+        const bool unchanged = result == CaptureResult::Frame && haveLastFrame && lastHashed &&
+            info.tilesHashed && tiles.ChangedCount() == 0 && !info.hdrLevels && !lastHasLevels;
+        if (unchanged)
+        {
+            auto captured = std::chrono::steady_clock::now();
+            const PointerState moved = analysedPointer(info.pointer);
+            if (!SamePointer(moved, pointer))
+            {
+                integrateLast(Seconds(captured - lastFrameTime).count());
+                lastFrameTime = captured;
+                pointer = moved;
+            }
+
+            record(info, ts);
+
+            auto analysed = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_unchangedFrames++;
+            m_rate->OnFrame(Seconds(captured - start).count(), info.dirtyFraction, 0.0,
+                Seconds(captured - captureStart).count(), Seconds(analysed - captured).count());
+        }
+        else if (result == CaptureResult::Frame)
+        {
+            auto captured = std::chrono::steady_clock::now();
+            double difference = 255.0;
+            if (haveLastFrame)
+            {
+                TRACE_SCOPE("FrameDifference");
+                difference = SampledFrameDifference(frame, lastFrame, width, height);
+            }
+
+            // The previous frame was on screen from lastFrameTime until now
+            if (haveLastFrame)
+                integrateLast(Seconds(captured - lastFrameTime).count());
+            pointer = analysedPointer(info.pointer);
+
+            record(info, ts);
+
+            if (factor == 1 && lastHashed && info.tilesHashed && !info.hdrLevels)
+            {
+                const std::vector<uint8_t>& changed = tiles.Changed();
+                integralChanged.resize(changed.size());
+                for (size_t i = 0; i < changed.size(); ++i)
+                    integralChanged[i] |= changed[i];
+            }
+            else
+            {
+                integralChangedKnown = false;
+            }
+            std::swap(frame, lastFrame);
+            std::swap(levels, lastLevels);
+            lastHasLevels = info.hdrLevels;
+            lastHashed = info.tilesHashed;
+            haveLastFrame = true;
+            lastFrameTime = captured;
+
+            auto analysed = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_peakNits = info.peakNits;
+            m_rate->OnFrame(Seconds(captured - start).count(), info.dirtyFraction, difference,
+                Seconds(captured - captureStart).count(), Seconds(analysed - captured).count());
+        }
+        else if (result == CaptureResult::PointerMoved)
+        {
+            // The desktop is unchanged and was not read back; only the pointer interval ends
+            auto now = std::chrono::steady_clock::now();
+            if (haveLastFrame)
+            {
+                integrateLast(Seconds(now - lastFrameTime).count());
+                lastFrameTime = now;
+            }
+            pointer = analysedPointer(info.pointer);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_rate->OnIdle(Seconds(now - start).count(), 0.0);
+        }
+        else if (result == CaptureResult::Resized)
+        {
+            // Nothing was written; the frame on screen until the mode change ends now
+            resized = true;
+            break;
+        }
+        else if (result == CaptureResult::Timeout || result == CaptureResult::Dropped)
+        {
+            // Nothing new within the acquire timeout: the desktop is static
+            auto now = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_rate->OnIdle(Seconds(now - start).count(), 0.0);
+        }
+        else if (m_session.State() == CaptureSessionState::Faulted)
+        {
+            break;
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+
+        if (m_attribution && std::chrono::steady_clock::now() >= nextWindowSample)
+        {
+            TRACE_SCOPE("WindowSample");
+            auto now = std::chrono::steady_clock::now();
+            nextWindowSample = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                Seconds(m_config.windowSampleSeconds));
+            bool sampled = m_config.windowSampler(sampledWindows);
+            if (sampled && factor > 1)
+                ScaleWindows(sampledWindows, factor);
+            if (sampled && sampledWindows != windows)
+            {
+                // The frame on screen until now still counts for the old layout
+                if (haveLastFrame)
+                {
+                    integrateLast(Seconds(now - lastFrameTime).count());
+                    lastFrameTime = now;
+                }
+                windows.swap(sampledWindows);
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_attribution->SetLayout(m_wear, windows);
+            }
+        }
+
+        if (m_flushRequested.exchange(false))
+        {
+            if (haveLastFrame)
+            {
+                auto now = std::chrono::steady_clock::now();
+                integrateLast(Seconds(now - lastFrameTime).count());
+                lastFrameTime = now;
+            }
+            if (m_recording)
+                m_recorder->RequestRotation();
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        nextCapture = captureStart + m_rate->Interval();
+    }
+
+    if (haveLastFrame)
+        integrateLast(Seconds(std::chrono::steady_clock::now() - lastFrameTime).count());
+    return resized;
+}
+
+// The previous frame was on screen for seconds: add it to every accumulator. The level
+// histogram, the pointer and the recording stay on the 8-bit view of HDR frames. True
+// when the wear integral took bgra (with changedTiles, when given).
+bool CapturePipeline::Integrate(const uint8_t* bgra, const uint16_t* levels, const PointerState& pointer,
+    double seconds, const uint8_t* changedTiles)
+{
+    TRACE_SCOPE("Integrate");
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t ticks = levels ? m_wear.AccumulateLevels(levels, seconds) : m_wear.Accumulate(bgra, seconds);
+    if (m_integral)
+    {
+        if (levels)
+            m_integral->AccumulateLevels(levels, ticks);
+        else
+            m_integral->Accumulate(bgra, ticks, changedTiles);
+    }
+    if (m_config.pointerWear)
+        m_pointerWear.Accumulate(m_wear, bgra, pointer, ticks, m_integral.get());
+    if (m_levels)
+        m_levels->Accumulate(bgra, seconds);
+    return m_integral && ticks > 0;
+}
+
+PipelineStats CapturePipeline::Stats() const
+{
+    PipelineStats stats;
+    stats.capture = m_session.Stats();
+    if (m_recorder)
+    {
+        stats.recording = m_recorder->Stats();
+        stats.segmentsClosed = m_recorder->Segments().size();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stats.running = m_running;
+    stats.wearSeconds = m_wear.TotalSeconds();
+    stats.peakNits = m_peakNits;
+    stats.unchangedFrames = m_unchangedFrames;
+    stats.modeChanges = m_modeChanges;
+    stats.frameBuffers = m_frameBuffers;
+    if (m_rate)
+    {
+        stats.currentFps = m_rate->CurrentFps();
+        stats.rate = m_rate->Report();
+        stats.uptimeSeconds = m_running ? Seconds(std::chrono::steady_clock::now() - m_startTime).count()
+                                        : stats.rate.elapsedSeconds;
+    }
+    return stats;
+}
+
+WearMap CapturePipeline::WearSnapshot() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_wear;
+}
+
+float CapturePipeline::WearOverview(uint32_t factor, std::vector<float>& out, uint32_t& width, uint32_t& height) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_wear.Downsample(factor, out, width, height);
+}
+
+bool CapturePipeline::SaveLevelHistogram(const std::string& path) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_levels && m_levels->Save(path);
+}
+
+std::vector<AppLedgerEntry> CapturePipeline::AttributionLedger(size_t topRegions) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_attribution)
+        return std::vector<AppLedgerEntry>();
+    m_attribution->Settle(m_wear);
+    return m_attribution->Ledger(topRegions);
+}
+
+void CapturePipeline::QueryWear(const std::vector<WearRect>& rects, std::vector<WearRegion>& out) const
+{
+    // Frame pixels to map pixels: every proxy pixel the rectangle touches
+    const uint32_t factor = m_proxyFactor;
+    std::vector<WearRect> scaled;
+    if (factor > 1)
+    {
+        scaled.resize(rects.size());
+        for (size_t i = 0; i < rects.size(); ++i)
+        {
+            scaled[i].x = rects[i].x / factor;
+            scaled[i].y = rects[i].y / factor;
+            scaled[i].width = uint32_t((uint64_t(rects[i].x) + rects[i].width + factor - 1) / factor - scaled[i].x);
+            scaled[i].height = uint32_t((uint64_t(rects[i].y) + rects[i].height + factor - 1) / factor - scaled[i].y);
+        }
+    }
+    const std::vector<WearRect>& mapRects = factor > 1 ? scaled : rects;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    out.resize(rects.size());
+    if (m_integral)
+    {
+        m_integral->QueryBatch(mapRects.data(), mapRects.size(), out.data());
+    }
+    else
+    {
+        for (size_t i = 0; i < mapRects.size(); ++i)
+        {
+            const WearRect& rect = mapRects[i];
+            const uint32_t x1 = uint32_t((std::min)(uint64_t(rect.x) + rect.width, uint64_t(m_wear.Width())));
+            const uint32_t y1 = uint32_t((std::min)(uint64_t(rect.y) + rect.height, uint64_t(m_wear.Height())));
+            out[i] = WearRegion();
+            if (rect.x >= x1 || rect.y >= y1)
+                continue;
+            out[i].sum = SumWearRect(m_wear, rect.x, rect.y, x1, y1);
+            out[i].mean = out[i].sum / (double(x1 - rect.x) * (y1 - rect.y));
+        }
+    }
+    // A proxy pixel carries the mean of factor^2 frame pixels
+    for (WearRegion& region : out)
+        region.sum *= double(factor) * factor;
+}
+
+bool CapturePipeline::HottestTile(WearTile& tile) const
+{
+    const uint32_t fullWidth = m_session.Width(), fullHeight = m_session.Height();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_integral || !m_integral->Width())
+        return false;
+    tile = m_integral->MaxTile();
+    if (m_proxyFactor > 1)
+    {
+        const uint32_t factor = m_proxyFactor;
+        const uint32_t x1 = (std::min)((tile.rect.x + tile.rect.width) * factor, fullWidth);
+        const uint32_t y1 = (std::min)((tile.rect.y + tile.rect.height) * factor, fullHeight);
+        tile.rect.x *= factor;
+        tile.rect.y *= factor;
+        tile.rect.width = x1 - tile.rect.x;
+        tile.rect.height = y1 - tile.rect.y;
+        tile.wear.sum *= double(factor) * factor;
+    }
+    return true;
+}
+
+std::vector<RateTraceSample> CapturePipeline::RateTrace() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_rate ? m_rate->Trace() : std::vector<RateTraceSample>();
+}
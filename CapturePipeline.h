@@ -0,0 +1,159 @@
+#pragma once
+
+#include "AppAttribution.h"
+#include "CaptureRateController.h"
+#include "CaptureSession.h"
+#include "FrameArena.h"
+#include "LevelHistogram.h"
+#include "PointerWear.h"
+#include "SegmentedRecorder.h"
+#include "WearIntegral.h"
+#include "WearMap.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+struct PipelineConfig
+{
+    RateControllerConfig rate;
+    float wearExponent = 1.54f;
+    // Time-at-level histogram bins per subpixel for re-running other wear models later;
+    // 0 = off. Costs 2 * bins + 5 bytes per subpixel, 230 MB at 1080p with 16 bins
+    // (see LevelHistogram.h).
+    uint32_t levelBins = 0;
+    // Add the wear of the mouse pointer the source reports outside the frame. The level
+    // histogram and the recording never contain it.
+    bool pointerWear = true;
+    // Top-level windows front to back in frame coordinates, for per-application wear (see
+    // AppAttribution); called on the capture thread every windowSampleSeconds. Empty = off.
+    std::function<bool(std::vector<AppWindow>&)> windowSampler;
+    double windowSampleSeconds = 0.5;
+    // Keep a WearIntegral beside the map for O(1) region queries (QueryWear, HottestTile);
+    // 2 doubles per pixel, a copy of the previous frame (4 bytes per pixel, 8 with HDR
+    // levels, none while tileHash covers every frame at full resolution) and band
+    // prefixes of about 1/16 double per pixel, so ~21 B per pixel (~170 MB at 4K); a few
+    // tile rewrites per changed frame.
+    bool wearIntegral = false;
+    // Analyse an area-averaged proxy of every frame (FrameProxy.h) instead of the frame:
+    // 2, 4, 8 or 16, anything else = full resolution. Wear, the level histogram, change
+    // detection and the integral run at 1 / proxyFactor in each direction; only the
+    // recording gets full frames, and without a sinkFactory no full frame is copied out of
+    // the readback at all. HDR level codes are full resolution only, so a proxy wears by
+    // the 8-bit view.
+    uint32_t proxyFactor = 1;
+    // Hash the 64x64 tiles of every frame in its readback copy (TileHash.h). The changed
+    // area bounds the dirty fraction the rate controller sees, a frame without a changed
+    // tile is not analysed again (the one before simply stays on screen longer), and the
+    // changed tiles replace the frame compares of the wear integral and the tile archive.
+    // The hash adds less to the copy than one such compare costs (--tile-hash).
+    bool tileHash = true;
+    // The two analysis frame buffers from a FrameArena (large pages where allowed, on the
+    // capture thread's NUMA node); false = plain std::vector, to compare the two.
+    bool frameArena = true;
+    SegmentConfig segments;
+    FrameSinkFactory sinkFactory; // empty = analysis only, nothing archived
+};
+
+struct PipelineStats
+{
+    bool running = false;
+    double uptimeSeconds = 0.0;
+    double currentFps = 0.0;
+    double wearSeconds = 0.0;
+    double peakNits = 0.0; // brightest subpixel of the last HDR frame, 0 for SDR capture
+    uint64_t unchangedFrames = 0; // frames without a changed tile, recorded but not analysed
+    uint32_t modeChanges = 0;     // the source came back at another size (CaptureResult::Resized)
+    FrameArenaBacking frameBuffers = FrameArenaBacking::None; // of the current or last run; None = std::vector
+    CaptureSessionStats capture;
+    RateControllerReport rate;
+    SegmentStats recording;
+    uint64_t segmentsClosed = 0;
+};
+
+// capture -> wear -> encode on a dedicated thread. Shared by the windowed build and the
+// headless daemon; nothing here touches a window, swapchain or shader.
+class CapturePipeline
+{
+public:
+    CapturePipeline(CaptureSession& session, PipelineConfig config);
+    ~CapturePipeline();
+
+    CapturePipeline(const CapturePipeline&) = delete;
+    CapturePipeline& operator=(const CapturePipeline&) = delete;
+
+    // Start also starts the session if needed. The wear map keeps accumulating across
+    // Start/Stop cycles; rate statistics restart with every Start. When the session comes
+    // back at another size (CaptureResult::Resized) the run goes on at that size with new
+    // maps, as a Start would, and the recording ends: its sinks are made for one size, so
+    // a Start with a recording at any other size than the first fails. A failed Start
+    // leaves the session stopped.
+    bool Start();
+    void Stop();
+    // Integrate the frame on screen up to now and close the current segment at the next
+    // keyframe, so everything captured so far is on disk.
+    void Flush();
+    // While stopped: the recording is over, every later Start captures and analyses
+    // without one (and with a proxy reads no full frames back). Its stats stay readable.
+    void EndRecording();
+
+    bool IsRunning() const { return m_running; }
+    PipelineStats Stats() const;
+    // Copy of the wear accumulated so far, safe while running.
+    WearMap WearSnapshot() const;
+    // WearMap::Downsample of the live map without copying it; for the preview overlay.
+    float WearOverview(uint32_t factor, std::vector<float>& out, uint32_t& width, uint32_t& height) const;
+    std::vector<RateTraceSample> RateTrace() const;
+    // LevelHistogram::Save of the live histogram; false when levelBins is 0.
+    bool SaveLevelHistogram(const std::string& path) const;
+    // Wear per application so far; empty without a windowSampler.
+    std::vector<AppLedgerEntry> AttributionLedger(size_t topRegions = 5) const;
+    // Wear over each rectangle of frame pixels: O(1) each with wearIntegral, a scan of the
+    // planes without. With a proxy the rectangles are widened to whole proxy pixels and
+    // the sums scaled by proxyFactor^2 to estimate the frame's.
+    void QueryWear(const std::vector<WearRect>& rects, std::vector<WearRegion>& out) const;
+    // The most worn WearIntegral::TILE square of the map, in frame pixels; false without
+    // wearIntegral or before Start.
+    bool HottestTile(WearTile& tile) const;
+
+private:
+    void Run();
+    bool RunMode();
+    void ResizeAnalysis();
+    // levels: the frame's HDR level codes, nullptr to wear by the BGRA values;
+    // changedTiles: see WearIntegral::Accumulate
+    bool Integrate(const uint8_t* bgra, const uint16_t* levels, const PointerState& pointer, double seconds,
+        const uint8_t* changedTiles = nullptr);
+    bool WaitUntil(std::chrono::steady_clock::time_point deadline);
+
+    CaptureSession& m_session;
+    PipelineConfig m_config;
+    uint32_t m_proxyFactor = 1; // 1 = no proxy
+    std::unique_ptr<SegmentedRecorder> m_recorder;
+    bool m_recording = false; // m_recorder began and takes frames; capture thread while running
+    bool m_recordingEnded = false;
+    uint32_t m_recordWidth = 0, m_recordHeight = 0;
+
+    mutable std::mutex m_mutex; // guards wear, rate and the timestamps below
+    std::condition_variable m_cv;
+    WearMap m_wear;
+    std::unique_ptr<LevelHistogram> m_levels;
+    std::unique_ptr<WearIntegral> m_integral;
+    PointerWear m_pointerWear;
+    std::unique_ptr<AppAttribution> m_attribution;
+    std::unique_ptr<CaptureRateController> m_rate;
+    std::chrono::steady_clock::time_point m_startTime;
+    double m_peakNits = 0.0;
+    uint64_t m_unchangedFrames = 0;
+    uint32_t m_modeChanges = 0;
+    FrameArenaBacking m_frameBuffers = FrameArenaBacking::None;
+
+    std::atomic<bool> m_running{ false };
+    std::atomic<bool> m_stopRequested{ false };
+    std::atomic<bool> m_flushRequested{ false };
+    std::thread m_thread;
+};
@@ -0,0 +1,215 @@
+#include "CaptureRateController.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <string>
+
+CaptureRateController::CaptureRateController(const RateControllerConfig& config)
+    : m_config(config), m_fps(config.maxFps)
+{
+}
+
+void CaptureRateController::Observe(double timeSeconds, bool isStatic)
+{
+    if (m_startTime < 0.0)
+        m_startTime = timeSeconds;
+    m_lastTime = timeSeconds;
+
+    if (!isStatic)
+    {
+        // Any change snaps straight back to the ceiling so motion is never undersampled
+        m_staticFrames = 0;
+        m_fps = m_config.maxFps;
+        return;
+    }
+
+    if (++m_staticFrames >= m_config.staticFramesBeforeBackoff)
+        m_fps = std::max(m_config.minFps, m_fps * m_config.backoffFactor);
+}
+
+void CaptureRateController::OnFrame(double timeSeconds, double dirtyFraction, double difference,
+    double captureSeconds, double analysisSeconds)
+{
+    const bool isStatic = dirtyFraction < m_config.staticDirtyFraction
+        && difference < m_config.staticDifference;
+    Observe(timeSeconds, isStatic);
+
+    const double a = m_framesProcessed == 0 ? 1.0 : m_config.costSmoothing;
+    m_avgCapture += a * (captureSeconds - m_avgCapture);
+    m_avgAnalysis += a * (analysisSeconds - m_avgAnalysis);
+    m_captureSpent += captureSeconds;
+    m_analysisSpent += analysisSeconds;
+    m_framesProcessed++;
+
+    if (m_config.recordTrace)
+        m_trace.push_back({ timeSeconds, dirtyFraction, difference, captureSeconds, analysisSeconds });
+}
+
+void CaptureRateController::OnIdle(double timeSeconds, double captureSeconds)
+{
+    Observe(timeSeconds, true);
+    m_captureSpent += captureSeconds;
+
+    if (m_config.recordTrace)
+        m_trace.push_back({ timeSeconds, 0.0, 0.0, captureSeconds, 0.0 });
+}
+
+std::chrono::microseconds CaptureRateController::Interval() const
+{
+    return std::chrono::microseconds((long long)(1000000.0 / m_fps));
+}
+
+RateControllerReport CaptureRateController::Report() const
+{
+    RateControllerReport report;
+    if (m_startTime < 0.0)
+        return report;
+
+    report.elapsedSeconds = m_lastTime - m_startTime;
+    report.framesProcessed = m_framesProcessed;
+    report.baselineFrames = (uint64_t)(report.elapsedSeconds * m_config.maxFps) + 1;
+    report.captureSecondsSpent = m_captureSpent;
+    report.analysisSecondsSpent = m_analysisSpent;
+
+    const uint64_t skipped = report.baselineFrames > m_framesProcessed
+        ? report.baselineFrames - m_framesProcessed : 0;
+    report.captureSecondsSaved = skipped * m_avgCapture;
+    report.analysisSecondsSaved = skipped * m_avgAnalysis;
+    return report;
+}
+
+double SampledFrameDifference(const uint8_t* a, const uint8_t* b,
+    uint32_t width, uint32_t height, uint32_t step)
+{
+    if (step == 0)
+        step = 1;
+
+    uint64_t sum = 0, count = 0;
+    for (uint32_t y = 0; y < height; y += step)
+    {
+        const uint8_t* rowA = a + size_t(y) * width * 4;
+        const uint8_t* rowB = b + size_t(y) * width * 4;
+        for (uint32_t x = 0; x < width; x += step)
+        {
+            const uint8_t* pa = rowA + x * 4;
+            const uint8_t* pb = rowB + x * 4;
+            sum += std::abs(pa[0] - pb[0]) + std::abs(pa[1] - pb[1]) + std::abs(pa[2] - pb[2]);
+            count += 3;
+        }
+    }
+    return count ? double(sum) / double(count) : 0.0;
+}
+
+bool SaveRateTrace(const char* filename, const std::vector<RateTraceSample>& trace)
+{
+    std::ofstream f(filename);
+    if (!f)
+        return false;
+
+    f << "time,dirty,difference,capture,analysis\n";
+    f.precision(std::numeric_limits<double>::max_digits10); // replays like the trace it came from
+    for (const auto& s : trace)
+        f << s.timeSeconds << ',' << s.dirtyFraction << ',' << s.difference << ','
+          << s.captureSeconds << ',' << s.analysisSeconds << '\n';
+
+    return bool(f);
+}
+
+bool LoadRateTrace(const char* filename, std::vector<RateTraceSample>& trace)
+{
+    std::ifstream f(filename);
+    std::string line;
+    if (!f || !std::getline(f, line)) // header
+        return false;
+
+    trace.clear();
+    RateTraceSample s;
+    char comma;
+    while (f >> s.timeSeconds >> comma >> s.dirtyFraction >> comma >> s.difference
+        >> comma >> s.captureSeconds >> comma >> s.analysisSeconds)
+    {
+        trace.push_back(s);
+    }
+    return true;
+}
+
+RateControllerReport ReplayRateTrace(const std::vector<RateTraceSample>& trace,
+    const RateControllerConfig& config)
+{
+    RateControllerConfig replayConfig = config;
+    replayConfig.recordTrace = false;
+    CaptureRateController controller(replayConfig);
+
+    RateControllerReport report;
+    if (trace.empty())
+        return report;
+
+    // Like DXGI, changes that happen while we sleep are not lost: dirty area and
+    // difference accumulate until the next sample the controller actually takes.
+    double pendingDirty = 0.0, pendingDifference = 0.0;
+    double nextTime = trace.front().timeSeconds;
+
+    for (const auto& s : trace)
+    {
+        pendingDirty = std::min(1.0, pendingDirty + s.dirtyFraction);
+        pendingDifference = std::max(pendingDifference, s.difference);
+
+        // A sample a rounding error before its time is due: at the trace's own rate every
+        // sample is taken
+        if (s.timeSeconds < nextTime - 1e-6)
+        {
+            report.captureSecondsSaved += s.captureSeconds;
+            report.analysisSecondsSaved += s.analysisSeconds;
+            continue;
+        }
+
+        controller.OnFrame(s.timeSeconds, pendingDirty, pendingDifference, s.captureSeconds, s.analysisSeconds);
+        report.framesProcessed++;
+        report.captureSecondsSpent += s.captureSeconds;
+        report.analysisSecondsSpent += s.analysisSeconds;
+        pendingDirty = pendingDifference = 0.0;
+        nextTime = s.timeSeconds + 1.0 / controller.CurrentFps();
+    }
+
+    report.elapsedSeconds = trace.back().timeSeconds - trace.front().timeSeconds;
+    report.baselineFrames = trace.size();
+    return report;
+}
+
+std::vector<RateTraceSample> BuildSyntheticRateTrace(double seconds, double fps,
+    double activeRatio, double captureSeconds, double analysisSeconds, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    std::vector<RateTraceSample> trace;
+    trace.reserve(size_t(seconds * fps) + 1);
+
+    // Alternate idle and active phases of 0.5-10 s, active with probability activeRatio
+    double phaseEnd = 0.0;
+    bool active = false;
+    for (double t = 0.0; t < seconds; t += 1.0 / fps)
+    {
+        if (t >= phaseEnd)
+        {
+            active = uniform(rng) < activeRatio;
+            phaseEnd = t + 0.5 + 9.5 * uniform(rng);
+        }
+
+        RateTraceSample s;
+        s.timeSeconds = t;
+        s.captureSeconds = captureSeconds;
+        s.analysisSeconds = analysisSeconds;
+        if (active)
+        {
+            s.dirtyFraction = 0.02 + 0.5 * uniform(rng);
+            s.difference = 1.0 + 20.0 * uniform(rng);
+        }
+        trace.push_back(s);
+    }
+    return trace;
+}
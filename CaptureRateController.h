@@ -0,0 +1,96 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Adaptive capture rate: run at the ceiling while the desktop changes and back off
+// towards the floor while it is static. Static time is not lost for wear purposes,
+// the caller integrates the last frame over the whole gap (WearMap::Accumulate).
+
+struct RateControllerConfig
+{
+    double minFps = 2.0;                    // floor while static
+    double maxFps = 80.0;                   // ceiling while content changes
+    double staticDirtyFraction = 0.002;     // dirty-rect area / screen area below this counts as static
+    double staticDifference = 0.5;          // mean abs difference (0-255 scale) below this counts as static
+    uint32_t staticFramesBeforeBackoff = 4; // consecutive static frames before lowering the rate
+    double backoffFactor = 0.5;             // rate multiplier per further static frame
+    double costSmoothing = 0.1;             // EWMA weight for per-frame cost samples
+    bool recordTrace = false;
+};
+
+// One observation. Costs are wall-clock seconds: captureSeconds covers
+// AcquireNextFrame/CopyResource/Map (GPU bound), analysisSeconds the CPU work after readback.
+struct RateTraceSample
+{
+    double timeSeconds = 0.0;
+    double dirtyFraction = 0.0;
+    double difference = 0.0;
+    double captureSeconds = 0.0;
+    double analysisSeconds = 0.0;
+};
+
+struct RateControllerReport
+{
+    double elapsedSeconds = 0.0;
+    uint64_t framesProcessed = 0;
+    uint64_t baselineFrames = 0;   // frames a fixed maxFps capture would have processed
+    double captureSecondsSpent = 0.0;
+    double analysisSecondsSpent = 0.0;
+    double captureSecondsSaved = 0.0;
+    double analysisSecondsSaved = 0.0;
+};
+
+class CaptureRateController
+{
+public:
+    explicit CaptureRateController(const RateControllerConfig& config = RateControllerConfig());
+
+    // Call after a frame was captured and analysed.
+    void OnFrame(double timeSeconds, double dirtyFraction, double difference,
+        double captureSeconds, double analysisSeconds);
+    // Call when the source reported no new frame (e.g. DXGI_ERROR_WAIT_TIMEOUT).
+    void OnIdle(double timeSeconds, double captureSeconds);
+
+    double CurrentFps() const { return m_fps; }
+    std::chrono::microseconds Interval() const;
+    bool IsStatic() const { return m_staticFrames >= m_config.staticFramesBeforeBackoff; }
+
+    // Savings against a fixed maxFps capture over the same wall time, using the
+    // smoothed per-frame costs for the frames that were skipped.
+    RateControllerReport Report() const;
+
+    const std::vector<RateTraceSample>& Trace() const { return m_trace; }
+
+private:
+    void Observe(double timeSeconds, bool isStatic);
+
+    RateControllerConfig m_config;
+    double m_fps;
+    uint32_t m_staticFrames = 0;
+    double m_startTime = -1.0;
+    double m_lastTime = 0.0;
+    uint64_t m_framesProcessed = 0;
+    double m_captureSpent = 0.0;
+    double m_analysisSpent = 0.0;
+    double m_avgCapture = 0.0;
+    double m_avgAnalysis = 0.0;
+    std::vector<RateTraceSample> m_trace;
+};
+
+// Mean absolute per-subpixel difference between two BGRA frames, sampling every
+// step-th pixel in both directions (the README analysis uses step = 10 as well).
+double SampledFrameDifference(const uint8_t* a, const uint8_t* b,
+    uint32_t width, uint32_t height, uint32_t step = 8);
+
+// Trace I/O. A trace recorded at the fixed ceiling rate can be replayed through the
+// controller to compare the adaptive rate with the fixed-rate baseline offline.
+bool SaveRateTrace(const char* filename, const std::vector<RateTraceSample>& trace);
+bool LoadRateTrace(const char* filename, std::vector<RateTraceSample>& trace);
+RateControllerReport ReplayRateTrace(const std::vector<RateTraceSample>& trace,
+    const RateControllerConfig& config);
+
+// Idle desktop with bursts of activity, sampled at config.maxFps.
+std::vector<RateTraceSample> BuildSyntheticRateTrace(double seconds, double fps,
+    double activeRatio, double captureSeconds, double analysisSeconds, uint32_t seed = 1);
@@ -0,0 +1,193 @@
+#include "CaptureSession.h"
+
+#include "TileHash.h"
+#include "Trace.h"
+
+#include <algorithm>
+
+CaptureSession::CaptureSession(std::unique_ptr<ICaptureSource> source)
+    : m_source(std::move(source))
+{
+}
+
+CaptureSession::~CaptureSession()
+{
+    Stop();
+}
+
+bool CaptureSession::Start()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_state == CaptureSessionState::Running)
+        return true;
+
+    m_startTime = std::chrono::steady_clock::now();
+    const bool opened = m_source->Open();
+    auto warmStart = std::chrono::steady_clock::now();
+    const bool warmed = opened && m_source->Warm();
+    auto warmEnd = std::chrono::steady_clock::now();
+    m_stats.openSeconds = std::chrono::duration<double>(warmStart - m_startTime).count();
+    m_stats.warmSeconds = std::chrono::duration<double>(warmEnd - warmStart).count();
+    m_stats.firstFrameSeconds = 0.0;
+    if (!warmed)
+    {
+        m_source->Close();
+        m_state = CaptureSessionState::Faulted;
+        return false;
+    }
+
+    m_state = CaptureSessionState::Running;
+    m_awaitingFirstFrame = true;
+    return true;
+}
+
+void CaptureSession::Stop()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_state != CaptureSessionState::Running)
+        return;
+
+    m_source->Close();
+    m_state = CaptureSessionState::Stopped;
+}
+
+void CaptureSession::Reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_state == CaptureSessionState::Running || m_state == CaptureSessionState::Faulted)
+        m_source->Close();
+
+    m_state = CaptureSessionState::Idle;
+    m_stats = CaptureSessionStats();
+    m_nextFrameId = 0;
+}
+
+CaptureResult CaptureSession::CaptureNext(uint8_t* dst, CaptureFrameInfo* info)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_state != CaptureSessionState::Running)
+        return CaptureResult::Error;
+
+    // Trace points in the source and every later stage on this thread carry the id the
+    // frame gets if one arrives
+    Trace::SetFrame(m_nextFrameId);
+    TRACE_SCOPE("CaptureNext");
+    CaptureFrameInfo frameInfo;
+    frameInfo.levels = info ? info->levels : nullptr;
+    frameInfo.tiles = info ? info->tiles : nullptr;
+    if (info && info->proxy && IsProxyFactor(info->proxyFactor))
+    {
+        frameInfo.proxy = info->proxy;
+        frameInfo.proxyFactor = info->proxyFactor;
+        if (!m_source->WritesProxy() && !dst)
+        {
+            m_proxySource.resize(size_t(m_source->Width()) * m_source->Height() * 4);
+            dst = m_proxySource.data();
+        }
+    }
+    // The mode the caller's buffers were sized for
+    const uint32_t width = m_source->Width(), height = m_source->Height();
+    const CapturePixelFormat format = m_source->Format();
+    CaptureResult result = m_source->AcquireFrame(dst, &frameInfo);
+
+    if (result == CaptureResult::AccessLost)
+    {
+        m_source->Close();
+        if (!m_source->Open() || !m_source->Warm())
+        {
+            m_source->Close();
+            m_state = CaptureSessionState::Faulted;
+            m_stats.errors++;
+            return CaptureResult::Error;
+        }
+        m_stats.restarts++;
+        // The caller's buffers are for the old mode: never acquire into them at a new one
+        if (m_source->Width() != width || m_source->Height() != height || m_source->Format() != format)
+        {
+            if (info)
+                *info = CaptureFrameInfo();
+            return CaptureResult::Resized;
+        }
+        result = m_source->AcquireFrame(dst, &frameInfo);
+    }
+
+    if (result == CaptureResult::Frame && frameInfo.proxy && !frameInfo.proxyWritten)
+    {
+        TRACE_SCOPE("Downscale");
+        const uint32_t width = m_source->Width(), height = m_source->Height();
+        bool ready = m_downscaler.Width() == width && m_downscaler.Height() == height &&
+            m_downscaler.Factor() == frameInfo.proxyFactor;
+        if (!ready)
+            ready = m_downscaler.Reset(width, height, frameInfo.proxyFactor);
+        if (ready)
+        {
+            m_downscaler.Downscale(dst, frameInfo.proxy);
+            frameInfo.proxyWritten = true;
+        }
+    }
+
+    if (result == CaptureResult::Frame && frameInfo.tiles)
+    {
+        if (!frameInfo.tilesHashed && dst && frameInfo.tiles->Resize(m_source->Width(), m_source->Height()))
+        {
+            TRACE_SCOPE("TileHash");
+            frameInfo.tiles->Hash(dst);
+            frameInfo.tilesHashed = true;
+        }
+        // Dirty rects and changed tiles both cover every change, the smaller bound wins
+        if (frameInfo.tilesHashed)
+            frameInfo.dirtyFraction = (std::min)(frameInfo.dirtyFraction, frameInfo.tiles->ChangedFraction());
+    }
+
+    switch (result)
+    {
+    case CaptureResult::Frame:
+        frameInfo.frameId = m_nextFrameId++;
+        m_stats.frames++;
+        if (m_awaitingFirstFrame)
+        {
+            m_stats.firstFrameSeconds =
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+            m_awaitingFirstFrame = false;
+        }
+        break;
+    case CaptureResult::PointerMoved: m_stats.pointerUpdates++; break;
+    case CaptureResult::Timeout: m_stats.timeouts++; break;
+    case CaptureResult::Dropped: m_stats.dropped++; break;
+    default:                     m_stats.errors++; break;
+    }
+
+    if (info)
+        *info = frameInfo;
+    return result;
+}
+
+CaptureSessionState CaptureSession::State() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_state;
+}
+
+CaptureSessionStats CaptureSession::Stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+uint32_t CaptureSession::Width() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_source->Width();
+}
+
+uint32_t CaptureSession::Height() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_source->Height();
+}
+
+CapturePixelFormat CaptureSession::Format() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_source->Format();
+}
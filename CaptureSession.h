@@ -0,0 +1,81 @@
+#pragma once
+
+#include "CaptureSource.h"
+#include "FrameProxy.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+enum class CaptureSessionState
+{
+    Idle,    // constructed or Reset, source closed
+    Running, // source open, CaptureNext allowed
+    Stopped, // source closed, Start reopens it
+    Faulted  // the source could not be reopened after losing access
+};
+
+struct CaptureSessionStats
+{
+    uint64_t frames = 0;
+    uint64_t timeouts = 0;
+    uint64_t pointerUpdates = 0; // PointerMoved: no desktop change, no readback
+    uint64_t dropped = 0;
+    uint64_t errors = 0;
+    uint64_t restarts = 0; // reopen after AccessLost
+    // Cold start of the last Start: Open + Warm, and Start to the first Frame (0 until one
+    // arrived)
+    double openSeconds = 0.0;
+    double warmSeconds = 0.0;
+    double firstFrameSeconds = 0.0;
+};
+
+// Owns one capture source (device, duplication and readback pool) and its lifecycle.
+// Sessions share no mutable state, so one per monitor can run on separate threads.
+// All methods are safe to call from any thread; CaptureNext is serialized with Stop/Reset.
+class CaptureSession
+{
+public:
+    explicit CaptureSession(std::unique_ptr<ICaptureSource> source);
+    ~CaptureSession();
+
+    CaptureSession(const CaptureSession&) = delete;
+    CaptureSession& operator=(const CaptureSession&) = delete;
+
+    bool Start();
+    void Stop();
+    // Close the source and forget stats and frame ids, back to Idle.
+    void Reset();
+
+    // Transparently reopens (and warms) the source once on AccessLost. When it comes back
+    // at the same size and format the frame is acquired again; otherwise CaptureNext
+    // returns Resized without writing anything, and dst, info->proxy, info->levels and
+    // everything else sized from Width() / Height() / Format() must be reallocated before
+    // the next call. A failed reopen returns Error and faults the session; the Start
+    // after that may open the source at another size too. With info->proxy set, dst may
+    // be nullptr: only the proxy is delivered. Sources that cannot write the proxy get a
+    // full frame into dst (or a buffer of the session's) and the session downscales it;
+    // info->tiles is hashed the same way.
+    CaptureResult CaptureNext(uint8_t* dst, CaptureFrameInfo* info = nullptr);
+
+    CaptureSessionState State() const;
+    CaptureSessionStats Stats() const;
+    uint32_t Width() const;
+    uint32_t Height() const;
+    // Valid while Running; an HDR source may have fallen back to Bgra8 on Open.
+    CapturePixelFormat Format() const;
+    ICaptureSource& Source() { return *m_source; }
+
+private:
+    mutable std::mutex m_mutex;
+    std::unique_ptr<ICaptureSource> m_source;
+    CaptureSessionState m_state = CaptureSessionState::Idle;
+    CaptureSessionStats m_stats;
+    uint64_t m_nextFrameId = 0;
+    std::chrono::steady_clock::time_point m_startTime;
+    bool m_awaitingFirstFrame = false;
+    FrameDownscaler m_downscaler;      // proxies of sources that do not write them
+    std::vector<uint8_t> m_proxySource; // their full frame when the caller passed no dst
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class TileHasher;
+
+// Platform-independent view of a screen capture backend. Everything above this
+// interface (session lifecycle, rate control, wear, encoding) builds without D3D.
+
+enum class CaptureResult
+{
+    Frame,        // dst was written
+    PointerMoved, // only the pointer moved or changed shape: dst was not written
+    Timeout,      // nothing changed within the acquire timeout
+    Dropped,      // a frame arrived but could not be read back in time
+    AccessLost,   // the source must be closed and reopened (mode change, UAC desktop, ...)
+    Resized,      // CaptureSession reopened the source at another size or format: nothing
+                  // was written, buffers sized for the old mode must be reallocated first
+    Error
+};
+
+// What the backend reads back. dst is always 8-bit BGRA; the HDR formats additionally
+// deliver extended-range level codes for wear (see HdrFormats.h).
+enum class CapturePixelFormat
+{
+    Bgra8,   // SDR, or HDR tone-mapped to SDR by the OS
+    Rgb10A2, // HDR10: PQ-encoded BT.2020, 10 bits per channel
+    Rgba16F  // scRGB: linear BT.709 half floats, 1.0 = 80 nits
+};
+
+// Mouse pointer image, normalized from what the backend delivers (see DecodePointerShape).
+// Drawn pixel by pixel: where xorMask is set the desktop is XORed with bgr, elsewhere bgra
+// is alpha blended over it.
+struct PointerShape
+{
+    uint64_t id = 0; // new for every shape the source receives
+    uint32_t width = 0, height = 0;
+    std::vector<uint8_t> bgra;    // width * height, straight alpha
+    std::vector<uint8_t> xorMask; // width * height, 0 or 1
+};
+
+// Backends that deliver the pointer outside the frame (DXGI duplication) report it here;
+// shapes are shared and only replaced when the shape changes.
+struct PointerState
+{
+    bool visible = false;
+    int32_t x = 0, y = 0; // top-left of the shape, in dst columns and (top-down) rows
+    std::shared_ptr<const PointerShape> shape;
+};
+
+struct CaptureFrameInfo
+{
+    uint64_t frameId = 0;       // assigned by CaptureSession, monotonic per session
+    double dirtyFraction = 1.0; // changed area / output area
+    PointerState pointer;       // with Frame and PointerMoved; hidden when not reported
+
+    // In: Width() * Height() * 4 level codes to fill (WearMap::AccumulateLevels), or
+    // nullptr. Sources with an HDR Format() write them and set hdrLevels.
+    uint16_t* levels = nullptr;
+    bool hdrLevels = false;
+    double peakNits = 0.0;      // brightest subpixel of the frame (sampled), HDR formats only
+
+    // In: ProxyDimension(Width(), proxyFactor) x ProxyDimension(Height(), proxyFactor)
+    // BGRA to fill with the area-averaged frame (FrameProxy.h), or nullptr. Sources that
+    // WritesProxy() fill it while copying the frame and set proxyWritten; CaptureSession
+    // does it for the others.
+    uint8_t* proxy = nullptr;
+    uint32_t proxyFactor = 1;
+    bool proxyWritten = false;
+
+    // In: a TileHasher for the full-resolution frame (TileHash.h), or nullptr; it compares
+    // each frame with the last one it hashed. Sources that HashesTiles() resize it and feed
+    // it the rows as they copy them, and set tilesHashed; CaptureSession hashes dst for the
+    // others and bounds dirtyFraction by the changed tiles' area.
+    TileHasher* tiles = nullptr;
+    bool tilesHashed = false;
+};
+
+class ICaptureSource
+{
+public:
+    virtual ~ICaptureSource() = default;
+
+    // Open acquires every device resource the source needs, Close releases all of them.
+    // A closed source can be opened again.
+    virtual bool Open() = 0;
+    virtual void Close() = 0;
+    // After Open: touch every buffer and device resource the first frame will use, so it
+    // does not pay for first-use allocation or residency. False fails the Start.
+    virtual bool Warm() { return true; }
+
+    // Valid after a successful Open.
+    virtual uint32_t Width() const = 0;
+    virtual uint32_t Height() const = 0;
+    virtual CapturePixelFormat Format() const { return CapturePixelFormat::Bgra8; }
+
+    // dst is Width() * Height() BGRA in top-down rows: row 0 is the top of the screen, as
+    // in desktop coordinates. Every backend delivers this orientation (the DXGI source
+    // reads its readback in that order), so frames, proxies, level codes, pointer
+    // positions, window rectangles, tile grids, wear maps and archives are all top-down
+    // and none of them needs to know which backend produced it.
+    virtual CaptureResult AcquireFrame(uint8_t* dst, CaptureFrameInfo* info) = 0;
+
+    // True when AcquireFrame fills info->proxy itself, and then also takes dst = nullptr:
+    // only the proxy is wanted and the full-resolution copy is skipped.
+    virtual bool WritesProxy() const { return false; }
+    // True when AcquireFrame feeds info->tiles itself, also when dst = nullptr
+    virtual bool HashesTiles() const { return false; }
+};
@@ -0,0 +1,130 @@
+#include "ColdStart.h"
+
+#include <cstdio>
+#include <utility>
+
+RefCountedInit::RefCountedInit(std::function<bool()> startup, std::function<void()> shutdown)
+    : m_startup(std::move(startup)), m_shutdown(std::move(shutdown))
+{
+}
+
+RefCountedInit::~RefCountedInit()
+{
+    // Leases outliving the object are a bug; shut down anyway rather than leak the platform
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_references && m_shutdown)
+    {
+        m_shutdown();
+        m_shutdowns++;
+    }
+}
+
+bool RefCountedInit::Acquire()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_references == 0 && m_startup)
+    {
+        auto start = std::chrono::steady_clock::now();
+        const bool ok = m_startup();
+        m_startupSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!ok)
+            return false;
+        m_startups++;
+    }
+    m_references++;
+    return true;
+}
+
+void RefCountedInit::Release()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_references == 0)
+        return;
+    if (--m_references == 0 && m_shutdown)
+    {
+        m_shutdown();
+        m_shutdowns++;
+    }
+}
+
+uint32_t RefCountedInit::References() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_references;
+}
+
+uint64_t RefCountedInit::Startups() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_startups;
+}
+
+uint64_t RefCountedInit::Shutdowns() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_shutdowns;
+}
+
+double RefCountedInit::StartupSeconds() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_startupSeconds;
+}
+
+bool InitLease::Acquire(RefCountedInit& init)
+{
+    Release();
+    if (!init.Acquire())
+        return false;
+    m_init = &init;
+    return true;
+}
+
+void InitLease::Release()
+{
+    if (m_init)
+        m_init->Release();
+    m_init = nullptr;
+}
+
+StartupTimeline::StartupTimeline()
+    : m_origin(std::chrono::steady_clock::now())
+{
+}
+
+void StartupTimeline::Mark(const std::string& name)
+{
+    Mark(name, std::chrono::duration<double>(std::chrono::steady_clock::now() - m_origin).count());
+}
+
+void StartupTimeline::Mark(const std::string& name, double seconds)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& mark : m_marks)
+        if (mark.first == name)
+            return;
+    m_marks.emplace_back(name, seconds);
+}
+
+double StartupTimeline::Seconds(const std::string& name) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& mark : m_marks)
+        if (mark.first == name)
+            return mark.second;
+    return -1.0;
+}
+
+std::string StartupTimeline::Format() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string out;
+    char buf[96];
+    for (const auto& mark : m_marks)
+    {
+        std::snprintf(buf, sizeof(buf), "%s%s=%.1fms", out.empty() ? "" : " ", mark.first.c_str(),
+            mark.second * 1000.0);
+        out += buf;
+    }
+    return out;
+}
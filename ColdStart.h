@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Pieces of a fast launch that do not depend on the platform.
+//
+// RefCountedInit wraps a process-wide startup / shutdown pair (MFStartup / MFShutdown):
+// the first Acquire starts it, the last Release shuts it down. Holding one lease for the
+// life of the process makes every other Acquire a counter increment, so an encoder per
+// segment no longer pays for platform init on every rotation.
+class RefCountedInit
+{
+public:
+    RefCountedInit(std::function<bool()> startup, std::function<void()> shutdown);
+    ~RefCountedInit();
+
+    RefCountedInit(const RefCountedInit&) = delete;
+    RefCountedInit& operator=(const RefCountedInit&) = delete;
+
+    // False, without taking a reference, when startup fails; the next Acquire retries.
+    // Callers wait while another thread runs startup.
+    bool Acquire();
+    void Release();
+
+    uint32_t References() const;
+    uint64_t Startups() const;
+    uint64_t Shutdowns() const;
+    double StartupSeconds() const; // all startups together
+
+private:
+    mutable std::mutex m_mutex;
+    std::function<bool()> m_startup;
+    std::function<void()> m_shutdown;
+    uint32_t m_references = 0;
+    uint64_t m_startups = 0, m_shutdowns = 0;
+    double m_startupSeconds = 0.0;
+};
+
+// One reference, released with the lease
+class InitLease
+{
+public:
+    InitLease() = default;
+    explicit InitLease(RefCountedInit& init) { Acquire(init); }
+    ~InitLease() { Release(); }
+
+    InitLease(const InitLease&) = delete;
+    InitLease& operator=(const InitLease&) = delete;
+
+    // Releases a reference held before
+    bool Acquire(RefCountedInit& init);
+    void Release();
+    bool Held() const { return m_init != nullptr; }
+
+private:
+    RefCountedInit* m_init = nullptr;
+};
+
+// Milestones of a launch in seconds since the timeline was constructed (a static one
+// comes close to process start): "device", "capture", "first_frame", ... Thread-safe.
+class StartupTimeline
+{
+public:
+    StartupTimeline();
+
+    // Only the first mark of a name counts
+    void Mark(const std::string& name);
+    // A milestone measured elsewhere, in seconds since construction
+    void Mark(const std::string& name, double seconds);
+    // -1 when not marked
+    double Seconds(const std::string& name) const;
+    // "name=12.3ms name=45.6ms" in the order marked
+    std::string Format() const;
+
+private:
+    mutable std::mutex m_mutex;
+    std::chrono::steady_clock::time_point m_origin;
+    std::vector<std::pair<std::string, double>> m_marks;
+};
@@ -0,0 +1,92 @@
+#include "BenchmarkModes.h"
+
+#include "CaptureSession.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+ColdStartBenchmark MeasureColdStart(const BenchmarkConfig& config, uint32_t rotations)
+{
+    ColdStartBenchmark bench;
+    bench.rotations = rotations;
+    bench.startupMs = 2.0;
+    auto startup = [&] {
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(bench.startupMs));
+        return true;
+    };
+
+    // Every segment's encoder takes its own reference, as CpuMp4Encoder::Begin / End do
+    RefCountedInit perSegment(startup, [] {});
+    for (uint32_t i = 0; i < rotations; ++i)
+    {
+        InitLease encoder(perSegment);
+    }
+    RefCountedInit leased(startup, [] {});
+    {
+        InitLease process(leased);
+        for (uint32_t i = 0; i < rotations; ++i)
+        {
+            InitLease encoder(leased);
+        }
+    }
+    bench.startupsPerSegment = perSegment.Startups();
+    bench.startupsLeased = leased.Startups();
+    bench.perSegmentInitMs = perSegment.StartupSeconds() * 1000.0;
+    bench.leasedInitMs = leased.StartupSeconds() * 1000.0;
+    bench.balanced = perSegment.References() == 0 && leased.References() == 0 &&
+        perSegment.Shutdowns() == perSegment.Startups() && leased.Shutdowns() == leased.Startups();
+
+    // Start to first frame, unpaced so the first frame is due at once
+    const size_t frameBytes = size_t(config.width) * config.height * 4;
+    CaptureSession session(std::make_unique<SyntheticCaptureSource>(config.workload, config.width, config.height,
+        0.0, config.loopFrames));
+    if (!session.Start())
+        return bench;
+
+    std::unique_ptr<uint8_t[]> cold(new uint8_t[frameBytes]);
+    auto start = Clock::now();
+    CaptureResult result = session.CaptureNext(cold.get());
+    bench.firstCopyColdMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    FrameArena arena;
+    if (arena.Reset(frameBytes, 1))
+    {
+        start = Clock::now();
+        session.CaptureNext(arena.Slot(0));
+        bench.firstCopyArenaMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    const CaptureSessionStats stats = session.Stats();
+    bench.openMs = stats.openSeconds * 1000.0;
+    bench.warmMs = stats.warmSeconds * 1000.0;
+    bench.firstFrameMs = result == CaptureResult::Frame ? stats.firstFrameSeconds * 1000.0 : 0.0;
+    session.Stop();
+    return bench;
+}
+
+std::string FormatColdStartJson(const ColdStartBenchmark& bench)
+{
+    char buf[640];
+    std::snprintf(buf, sizeof(buf),
+        "{\"benchmark\":\"cold_start\",\"rotations\":%u,\"startup_ms\":%.1f,\"startups_per_segment\":%llu,"
+        "\"startups_leased\":%llu,\"per_segment_init_ms\":%.2f,\"leased_init_ms\":%.2f,\"balanced\":%s,"
+        "\"open_ms\":%.2f,\"warm_ms\":%.3f,\"first_frame_ms\":%.2f,\"first_copy_cold_ms\":%.3f,"
+        "\"first_copy_arena_ms\":%.3f}\n",
+        bench.rotations, bench.startupMs, (unsigned long long)bench.startupsPerSegment,
+        (unsigned long long)bench.startupsLeased, bench.perSegmentInitMs, bench.leasedInitMs,
+        bench.balanced ? "true" : "false", bench.openMs, bench.warmMs, bench.firstFrameMs, bench.firstCopyColdMs,
+        bench.firstCopyArenaMs);
+    return buf;
+}
+
+bool RunColdStartMode(const BenchmarkOptions& options, std::string& json)
+{
+    BenchmarkConfig config = options.config;
+    config.workload = options.workloads.front();
+    ColdStartBenchmark bench = MeasureColdStart(config);
+    json = FormatColdStartJson(bench);
+    return bench.balanced && bench.startupsLeased == 1 && bench.startupsPerSegment == bench.rotations &&
+        bench.firstFrameMs > 0.0;
+}
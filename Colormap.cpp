@@ -0,0 +1,51 @@
+#include "Colormap.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Coefficients c0..c6 per channel; same values as INFERNO_C / VIRIDIS_C in the preview shader
+static const float INFERNO_C[7][3] = {
+    {  0.0002189403691192265f,  0.001651004631001012f, -0.01948089843709184f },
+    {  0.1065134194856116f,     0.5639564367884091f,    3.932712388889277f   },
+    { 11.60249308247187f,      -3.972853965665698f,   -15.9423941062914f     },
+    {-41.70399613139459f,      17.43639888205313f,     44.35414519872813f    },
+    { 77.162935699427f,       -33.40235894210092f,    -81.80730925738993f    },
+    {-71.31942824499214f,      32.62606426397723f,     73.20951985803202f    },
+    { 25.13112622477341f,     -12.24266895238567f,    -23.07032500287172f    },
+};
+
+static const float VIRIDIS_C[7][3] = {
+    {  0.2777273272234177f,  0.005407344544966578f,  0.3340998053353061f  },
+    {  0.1050930431085774f,  1.404613529898575f,     1.384590162594685f   },
+    { -0.3308618287255563f,  0.214847559468213f,     0.09509516302823659f },
+    { -4.634230498983486f,  -5.799100973351585f,   -19.33244095627987f    },
+    {  6.228269936347081f,  14.17993336680509f,     56.69055260068105f    },
+    {  4.776384997670288f, -13.74514537774601f,    -65.35303263337234f    },
+    { -5.435455855934631f,   4.645852612178535f,    26.3124352495832f     },
+};
+
+void EvaluateColormap(Colormap map, float t, float rgb[3])
+{
+    const float (*c)[3] = map == Colormap::Inferno ? INFERNO_C : VIRIDIS_C;
+    t = std::min(1.0f, std::max(0.0f, t));
+
+    // Horner, in the same order as the HLSL version so both round alike
+    for (int i = 0; i < 3; ++i)
+    {
+        float v = c[6][i];
+        for (int k = 5; k >= 0; --k)
+            v = c[k][i] + t * v;
+        rgb[i] = std::min(1.0f, std::max(0.0f, v));
+    }
+}
+
+void BuildColormapLut(Colormap map, uint8_t lut[256][3])
+{
+    for (int i = 0; i < 256; ++i)
+    {
+        float rgb[3];
+        EvaluateColormap(map, i / 255.0f, rgb);
+        for (int c = 0; c < 3; ++c)
+            lut[i][c] = uint8_t(std::lround(rgb[c] * 255.0f));
+    }
+}
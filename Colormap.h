@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+// Perceptual colour maps as 6th order polynomial fits of matplotlib's inferno and viridis
+// (max error ~1/255 per channel). The preview pixel shader evaluates the same polynomials;
+// this is the CPU reference for it and for image export. Keep both in sync.
+
+enum class Colormap
+{
+    Inferno,
+    Viridis
+};
+
+// t is clamped to [0, 1]; rgb receives linear 0-1 values, clamped.
+void EvaluateColormap(Colormap map, float t, float rgb[3]);
+
+// 256-entry RGB8 table, index = round(t * 255).
+void BuildColormapLut(Colormap map, uint8_t lut[256][3]);
@@ -0,0 +1,150 @@
+#include "BenchmarkModes.h"
+
+#include "CapturePipeline.h"
+#include "CaptureSession.h"
+#include "ControlProtocol.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <thread>
+
+ControlBenchmark MeasureControlProtocol(const BenchmarkConfig& config)
+{
+    struct Step
+    {
+        const char* line;
+        const char* prefix;   // the reply starts with this
+        const char* contains; // and contains this, or nullptr
+    };
+    static const Step SCRIPT[] = {
+        { "help", "ok commands=", "trace dump" },
+        { "stats", "ok running=0", nullptr },
+        { "flush", "error not running", nullptr },
+        { "lifetime", "error no wear", nullptr },
+        { "start", "ok", nullptr },
+        { "  Start \r", "ok", nullptr },
+        { "STATS\r", "ok running=1", " mode_changes=0" },
+        { "flush", "ok", nullptr },
+        { "region 0 0 64 64", "ok sum_s=", " mean_s=" },
+        { "region 0 0 0 64", "error usage", nullptr },
+        { "region 1 2", "error usage", nullptr },
+        { "hotspot", "ok x=", " sum_s=" },
+        { "lifetime", "ok session_seconds=", " l90_worst_hours=" },
+        { "trace on", "ok", nullptr },
+        { "trace off", "ok", nullptr },
+        { "start now", "error unknown command", nullptr },
+        { "", "error unknown command", nullptr },
+        { "stop", "ok", nullptr },
+        { "stats", "ok running=0", nullptr },
+        { "quit", "ok", nullptr },
+    };
+
+    ControlBenchmark bench;
+    CaptureSession session(std::make_unique<SyntheticCaptureSource>(config.workload, config.width, config.height,
+        60.0, config.loopFrames));
+    PipelineConfig pipelineConfig;
+    pipelineConfig.wearIntegral = true;
+    CapturePipeline pipeline(session, pipelineConfig);
+
+    bool quit = false;
+    for (const Step& step : SCRIPT)
+    {
+        const std::string reply = HandleControlCommand(pipeline, step.line, quit);
+        bench.commands++;
+        if (reply.compare(0, std::strlen(step.prefix), step.prefix) != 0 ||
+            (step.contains && reply.find(step.contains) == std::string::npos))
+            bench.failed.push_back(step.line);
+
+        // Let some wear accumulate before anything that reads it
+        if (std::strcmp(step.line, "  Start \r") == 0)
+        {
+            for (int wait = 0; wait < 500 && pipeline.Stats().wearSeconds <= 0.0; ++wait)
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            const uint32_t rounds = 1000;
+            auto start = Clock::now();
+            for (uint32_t i = 0; i < rounds; ++i)
+                HandleControlCommand(pipeline, "stats", quit);
+            bench.statsUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / rounds;
+        }
+    }
+    if (!quit || pipeline.IsRunning())
+        bench.failed.push_back("quit");
+    Trace::Clear();
+
+    // The region answers come from the wear integral, fed the hashed tiles: they must be
+    // what a scan of the map gives
+    const WearMap wear = pipeline.WearSnapshot();
+    const uint32_t w = wear.Width(), h = wear.Height();
+    const std::vector<WearRect> rects = { { 0, 0, w, h }, { 0, 0, w / 2, h / 2 }, { w / 3, h / 3, w / 3, h / 3 },
+        { w - (std::min)(w, 100u), h - (std::min)(h, 77u), 100, 77 } };
+    std::vector<WearRegion> regions;
+    pipeline.QueryWear(rects, regions);
+    const double total = (std::max)(SumWearRect(wear, 0, 0, w, h), 1e-12);
+    bench.regionsMatch = w > 0 && regions.size() == rects.size();
+    for (size_t i = 0; bench.regionsMatch && i < rects.size(); ++i)
+    {
+        const WearRect& r = rects[i];
+        const double sum = SumWearRect(wear, r.x, r.y, (std::min)(r.x + r.width, w), (std::min)(r.y + r.height, h));
+        bench.regionsMatch = std::fabs(regions[i].sum - sum) <= 1e-9 * total;
+    }
+
+    // The script as one stream, handed over in pieces of 1 to 7 bytes
+    std::string stream;
+    for (const Step& step : SCRIPT)
+        stream += std::string(step.line) + "\n";
+    ControlLineBuffer lines;
+    std::vector<std::string> received;
+    std::string line;
+    bool appended = true;
+    for (size_t i = 0, piece = 1; i < stream.size(); i += piece, piece = piece % 7 + 1)
+    {
+        appended = appended && lines.Append(stream.data() + i, (std::min)(piece, stream.size() - i));
+        while (lines.NextLine(line))
+            received.push_back(line);
+    }
+    bench.linesSplit = appended && received.size() == std::size(SCRIPT);
+    for (size_t i = 0; bench.linesSplit && i < received.size(); ++i)
+        bench.linesSplit = received[i] == SCRIPT[i].line;
+
+    const std::string longest(ControlLineBuffer::MAX_LINE - 1, 'x');
+    ControlLineBuffer fits, overflows;
+    bench.overlongRefused = fits.Append(longest.data(), longest.size()) && fits.Append("\nstats", 6) &&
+        fits.NextLine(line) && line == longest && !fits.NextLine(line) &&
+        overflows.Append(longest.data(), longest.size()) && !overflows.Append("x", 1);
+    return bench;
+}
+
+std::string FormatControlJson(const ControlBenchmark& bench)
+{
+    std::string failed;
+    for (const std::string& command : bench.failed)
+    {
+        std::string escaped;
+        for (char c : command)
+            if (c >= 0x20 && c != '"' && c != '\\')
+                escaped += c;
+        failed += (failed.empty() ? "\"" : ",\"") + escaped + "\"";
+    }
+    char buf[256];
+    std::snprintf(buf, sizeof(buf),
+        "{\"benchmark\":\"control\",\"commands\":%u,\"stats_us\":%.2f,\"lines_split\":%s,\"overlong_refused\":%s,"
+        "\"regions_match\":%s,\"failed\":[",
+        bench.commands, bench.statsUs, bench.linesSplit ? "true" : "false", bench.overlongRefused ? "true" : "false",
+        bench.regionsMatch ? "true" : "false");
+    return buf + failed + "]}\n";
+}
+
+bool RunControlMode(const BenchmarkOptions& options, std::string& json)
+{
+    BenchmarkConfig config = options.config;
+    config.workload = options.workloads.front();
+    ControlBenchmark bench = MeasureControlProtocol(config);
+    json = FormatControlJson(bench);
+    return bench.failed.empty() && bench.linesSplit && bench.overlongRefused && bench.regionsMatch;
+}
@@ -0,0 +1,101 @@
+#include "ControlPipeServer.h"
+
+#include "CapturePipeline.h"
+#include "ControlProtocol.h"
+
+#include <sddl.h>
+
+#include <memory>
+#include <string>
+
+#pragma comment(lib, "advapi32.lib")
+
+// Security descriptor that grants the pipe to the user this process runs as and nobody
+// else; LocalFree it when done.
+static HRESULT CreateCurrentUserDescriptor(PSECURITY_DESCRIPTOR* descriptor)
+{
+    HANDLE token = nullptr;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &token))
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    DWORD size = 0;
+    GetTokenInformation(token, TokenUser, nullptr, 0, &size);
+    std::unique_ptr<BYTE[]> buffer(new BYTE[size ? size : 1]);
+    BOOL ok = size && GetTokenInformation(token, TokenUser, buffer.get(), size, &size);
+    DWORD error = GetLastError();
+    CloseHandle(token);
+    if (!ok)
+        return HRESULT_FROM_WIN32(error);
+
+    LPWSTR sid = nullptr;
+    if (!ConvertSidToStringSidW(reinterpret_cast<TOKEN_USER*>(buffer.get())->User.Sid, &sid))
+        return HRESULT_FROM_WIN32(GetLastError());
+    // Protected DACL with a single full-access entry: no inherited or default entries
+    std::wstring sddl = std::wstring(L"D:P(A;;GA;;;") + sid + L")";
+    LocalFree(sid);
+
+    if (!ConvertStringSecurityDescriptorToSecurityDescriptorW(sddl.c_str(), SDDL_REVISION_1, descriptor, nullptr))
+        return HRESULT_FROM_WIN32(GetLastError());
+    return S_OK;
+}
+
+HRESULT RunControlPipeServer(const wchar_t* pipeName, CapturePipeline& pipeline)
+{
+    PSECURITY_DESCRIPTOR descriptor = nullptr;
+    HRESULT hr = CreateCurrentUserDescriptor(&descriptor);
+    if (FAILED(hr))
+        return hr;
+    SECURITY_ATTRIBUTES security = { sizeof(security), descriptor, FALSE };
+
+    bool quit = false;
+    DWORD firstInstance = FILE_FLAG_FIRST_PIPE_INSTANCE; // fail if another process owns the name
+    while (!quit)
+    {
+        HANDLE pipe = CreateNamedPipeW(pipeName, PIPE_ACCESS_DUPLEX | firstInstance,
+            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+            1, 4096, 4096, 0, &security);
+        if (pipe == INVALID_HANDLE_VALUE)
+        {
+            hr = HRESULT_FROM_WIN32(GetLastError());
+            break;
+        }
+        firstInstance = 0;
+
+        if (!ConnectNamedPipe(pipe, nullptr) && GetLastError() != ERROR_PIPE_CONNECTED)
+        {
+            CloseHandle(pipe);
+            continue;
+        }
+
+        // Read until the client disconnects, answering every complete line
+        ControlLineBuffer lines;
+        std::string line;
+        char buf[512];
+        DWORD read = 0;
+        while (!quit && ReadFile(pipe, buf, sizeof(buf), &read, nullptr) && read > 0)
+        {
+            const bool fits = lines.Append(buf, read);
+            while (!quit && lines.NextLine(line))
+            {
+                std::string reply = HandleControlCommand(pipeline, line, quit) + "\n";
+                DWORD written = 0;
+                WriteFile(pipe, reply.data(), DWORD(reply.size()), &written, nullptr);
+            }
+            if (!fits)
+            {
+                // Not a protocol client: drop it rather than buffer without bound
+                static const char TOO_LONG[] = "error line too long\n";
+                DWORD written = 0;
+                WriteFile(pipe, TOO_LONG, DWORD(sizeof(TOO_LONG) - 1), &written, nullptr);
+                break;
+            }
+        }
+
+        FlushFileBuffers(pipe);
+        DisconnectNamedPipe(pipe);
+        CloseHandle(pipe);
+    }
+
+    LocalFree(descriptor);
+    return hr;
+}
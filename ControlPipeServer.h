@@ -0,0 +1,11 @@
+#pragma once
+
+#include <windows.h>
+
+class CapturePipeline;
+
+// Serves the control protocol (ControlProtocol.h) on a local named pipe, one client at a
+// time, until a client sends quit. Only the user the daemon runs as can open the pipe,
+// remote clients are rejected, and a client sending an overlong line is disconnected.
+// Fails when another process already serves the name.
+HRESULT RunControlPipeServer(const wchar_t* pipeName, CapturePipeline& pipeline);
@@ -0,0 +1,170 @@
+#include "ControlProtocol.h"
+
+#include "CapturePipeline.h"
+#include "LifetimeProjection.h"
+#include "Trace.h"
+
+#include <cctype>
+#include <cstdio>
+#include <vector>
+
+ControlCommand ParseControlCommand(const std::string& line)
+{
+    // Trim whitespace (including a trailing \r from telnet-style clients) and lower-case
+    size_t begin = 0, end = line.size();
+    while (begin < end && std::isspace((unsigned char)line[begin])) ++begin;
+    while (end > begin && std::isspace((unsigned char)line[end - 1])) --end;
+
+    std::string word;
+    for (size_t i = begin; i < end; ++i)
+        word += char(std::tolower((unsigned char)line[i]));
+
+    if (word == "start") return ControlCommand::Start;
+    if (word == "stop")  return ControlCommand::Stop;
+    if (word == "flush") return ControlCommand::Flush;
+    if (word == "stats") return ControlCommand::Stats;
+    if (word == "lifetime") return ControlCommand::Lifetime;
+    if (word.compare(0, 7, "region ") == 0) return ControlCommand::Region;
+    if (word == "hotspot") return ControlCommand::Hotspot;
+    if (word == "trace on") return ControlCommand::TraceOn;
+    if (word == "trace off") return ControlCommand::TraceOff;
+    if (word == "trace dump") return ControlCommand::TraceDump;
+    if (word == "quit")  return ControlCommand::Quit;
+    if (word == "help")  return ControlCommand::Help;
+    return ControlCommand::Unknown;
+}
+
+std::string FormatPipelineStats(const PipelineStats& stats)
+{
+    char buf[512];
+    std::snprintf(buf, sizeof(buf),
+        "ok running=%d uptime=%.1f fps=%.1f wear_seconds=%.1f frames=%llu timeouts=%llu dropped=%llu "
+        "pointer_updates=%llu errors=%llu restarts=%llu baseline_frames=%llu capture_saved=%.3f analysis_saved=%.3f "
+        "segments=%llu rotations=%u max_switch_ms=%.3f peak_nits=%.0f unchanged_frames=%llu mode_changes=%u",
+        stats.running ? 1 : 0, stats.uptimeSeconds, stats.currentFps, stats.wearSeconds,
+        (unsigned long long)stats.capture.frames, (unsigned long long)stats.capture.timeouts,
+        (unsigned long long)stats.capture.dropped, (unsigned long long)stats.capture.pointerUpdates,
+        (unsigned long long)stats.capture.errors,
+        (unsigned long long)stats.capture.restarts, (unsigned long long)stats.rate.baselineFrames,
+        stats.rate.captureSecondsSaved, stats.rate.analysisSecondsSaved,
+        (unsigned long long)stats.segmentsClosed, stats.recording.rotations,
+        stats.recording.maxSwitchSeconds * 1000.0, stats.peakNits,
+        (unsigned long long)stats.unchangedFrames, stats.modeChanges);
+    return buf;
+}
+
+std::string FormatLifetimeSummary(const LifetimeSummary& summary)
+{
+    static const char* FRACTION_NAMES[] = { "worst", "p1", "median" };
+
+    std::string reply = "ok";
+    char buf[160];
+    std::snprintf(buf, sizeof(buf), " session_seconds=%.1f", summary.sessionSeconds);
+    reply += buf;
+    for (const auto& t : summary.thresholds)
+    {
+        for (size_t f = 0; f < summary.fractions.size() && f < 3; ++f)
+        {
+            std::snprintf(buf, sizeof(buf), " l%.0f_%s_hours=%.0f,%.0f,%.0f", t.threshold * 100.0, FRACTION_NAMES[f],
+                t.hours[0][f], t.hours[1][f], t.hours[2][f]);
+            reply += buf;
+        }
+    }
+    return reply;
+}
+
+std::string HandleControlCommand(CapturePipeline& pipeline, const std::string& line, bool& quit)
+{
+    switch (ParseControlCommand(line))
+    {
+    case ControlCommand::Start:
+        return pipeline.Start() ? "ok" : "error start failed";
+    case ControlCommand::Stop:
+        pipeline.Stop();
+        return "ok";
+    case ControlCommand::Flush:
+        if (!pipeline.IsRunning())
+            return "error not running";
+        pipeline.Flush();
+        return "ok";
+    case ControlCommand::Stats:
+        return FormatPipelineStats(pipeline.Stats());
+    case ControlCommand::Lifetime:
+    {
+        WearMap wear = pipeline.WearSnapshot();
+        if (wear.TotalSeconds() <= 0.0)
+            return "error no wear accumulated";
+        return FormatLifetimeSummary(LifetimeProjection().Summarize(wear, { 0.9, 0.8, 0.5 }, { 0.0, 0.01, 0.5 }));
+    }
+    case ControlCommand::Region:
+    {
+        unsigned x = 0, y = 0, w = 0, h = 0;
+        if (std::sscanf(line.c_str(), " %*s %u %u %u %u", &x, &y, &w, &h) != 4 || !w || !h)
+            return "error usage: region x y w h";
+        std::vector<WearRegion> regions;
+        pipeline.QueryWear({ { x, y, w, h } }, regions);
+        char buf[160];
+        std::snprintf(buf, sizeof(buf), "ok sum_s=%.3f mean_s=%.6f", regions[0].sum, regions[0].mean);
+        return buf;
+    }
+    case ControlCommand::Hotspot:
+    {
+        WearTile tile;
+        if (!pipeline.HottestTile(tile))
+            return "error wear integral off";
+        char buf[160];
+        std::snprintf(buf, sizeof(buf), "ok x=%u y=%u w=%u h=%u sum_s=%.3f mean_s=%.6f", tile.rect.x, tile.rect.y,
+            tile.rect.width, tile.rect.height, tile.wear.sum, tile.wear.mean);
+        return buf;
+    }
+    case ControlCommand::TraceOn:
+    case ControlCommand::TraceOff:
+        Trace::Enable(ParseControlCommand(line) == ControlCommand::TraceOn);
+        return "ok";
+    case ControlCommand::TraceDump:
+    {
+        if (!Trace::SaveChromeJson("trace.json"))
+            return "error cannot write trace.json";
+        std::string reply = "ok path=trace.json";
+        char buf[160];
+        for (const Trace::StageSummary& stage : Trace::Summarize())
+        {
+            std::snprintf(buf, sizeof(buf), " stage=%s:%llu:%.1f:%.1f:%.1f", stage.name.c_str(),
+                (unsigned long long)stage.count, stage.p50Us, stage.p99Us, stage.maxUs);
+            reply += buf;
+        }
+        return reply;
+    }
+    case ControlCommand::Quit:
+        pipeline.Stop();
+        quit = true;
+        return "ok";
+    case ControlCommand::Help:
+        return "ok commands=start,stop,flush,stats,lifetime,region,hotspot,trace on,trace off,trace dump,quit,help";
+    default:
+        return "error unknown command";
+    }
+}
+
+bool ControlLineBuffer::Append(const char* data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (data[i] == '\n')
+            m_lineLength = 0;
+        else if (++m_lineLength >= MAX_LINE)
+            return false;
+    }
+    m_pending.append(data, size);
+    return true;
+}
+
+bool ControlLineBuffer::NextLine(std::string& line)
+{
+    size_t newline = m_pending.find('\n');
+    if (newline == std::string::npos)
+        return false;
+    line.assign(m_pending, 0, newline);
+    m_pending.erase(0, newline + 1);
+    return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+
+class CapturePipeline;
+struct PipelineStats;
+struct LifetimeSummary;
+
+// Line-based control protocol of the headless daemon. One command per line, one reply
+// line per command: "ok[ key=value ...]" or "error <reason>".
+//
+//   start   start capturing (no-op when running)
+//   stop    stop capturing and finalize the current segment
+//   flush   integrate wear up to now and cut the current segment
+//   stats   counters as key=value pairs
+//   lifetime  projected hours to L90/L80/L50 if the session so far is repeated
+//             (worst, 1% and median subpixel per channel, R,G,B)
+//   region x y w h  wear over a rectangle of frame pixels: sum_s (R + G + B stress-seconds)
+//                   and mean_s per pixel; O(1) with the pipeline's wearIntegral
+//   hotspot  the most worn 64x64 tile of the map (64 * proxyFactor frame pixels with a
+//            proxy): x, y, w, h, sum_s, mean_s (needs wearIntegral)
+//   trace on / trace off   start / stop hot-path tracing (Trace.h)
+//   trace dump             write trace.json (Chrome trace) and reply with per-stage
+//                          latencies: stage=name:count:p50_us:p99_us:max_us
+//   quit    stop and shut the daemon down
+//   help    list the commands
+
+enum class ControlCommand
+{
+    Start,
+    Stop,
+    Flush,
+    Stats,
+    Lifetime,
+    Region,
+    Hotspot,
+    TraceOn,
+    TraceOff,
+    TraceDump,
+    Quit,
+    Help,
+    Unknown
+};
+
+ControlCommand ParseControlCommand(const std::string& line);
+std::string FormatPipelineStats(const PipelineStats& stats);
+std::string FormatLifetimeSummary(const LifetimeSummary& summary);
+
+// Execute one command line against the pipeline and return the reply (without newline).
+// quit is set when the daemon should exit.
+std::string HandleControlCommand(CapturePipeline& pipeline, const std::string& line, bool& quit);
+
+// Splits what a client sends into command lines. A client that sends MAX_LINE bytes
+// without a newline is not speaking the protocol: Append fails and the transport should
+// drop it instead of buffering without bound.
+class ControlLineBuffer
+{
+public:
+    static const size_t MAX_LINE = 4096;
+
+    bool Append(const char* data, size_t size);
+    // The next complete line without its newline; false when none is buffered
+    bool NextLine(std::string& line);
+
+private:
+    std::string m_pending;
+    size_t m_lineLength = 0; // of the line being received
+};
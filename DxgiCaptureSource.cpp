@@ -0,0 +1,400 @@
+#include "DxgiCaptureSource.h"
+
+#include "PointerWear.h"
+#include "TileHash.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstring>
+
+using Microsoft::WRL::ComPtr;
+
+static CaptureResult ToCaptureResult(HRESULT hr)
+{
+    if (hr == DXGI_ERROR_WAIT_TIMEOUT) return CaptureResult::Timeout;
+    if (hr == DXGI_ERROR_ACCESS_LOST)  return CaptureResult::AccessLost;
+    return CaptureResult::Error;
+}
+
+static DXGI_FORMAT ToDxgiFormat(CapturePixelFormat format)
+{
+    switch (format)
+    {
+    case CapturePixelFormat::Rgb10A2: return DXGI_FORMAT_R10G10B10A2_UNORM;
+    case CapturePixelFormat::Rgba16F: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+    default:                          return DXGI_FORMAT_B8G8R8A8_UNORM;
+    }
+}
+
+DxgiCaptureSource::DxgiCaptureSource(UINT outputIndex, ID3D11Device* device)
+    : m_outputIndex(outputIndex), m_sharedDevice(device)
+{
+}
+
+DxgiCaptureSource::~DxgiCaptureSource()
+{
+    Close();
+}
+
+void DxgiCaptureSource::RequestFormat(CapturePixelFormat format, float sdrWhiteNits)
+{
+    m_requestedFormat = format;
+    m_decoder = HdrDecoder(sdrWhiteNits);
+}
+
+bool DxgiCaptureSource::CreateDeviceForOutput(ComPtr<IDXGIOutput>& output)
+{
+    if (m_sharedDevice)
+    {
+        m_device = m_sharedDevice;
+        m_device->GetImmediateContext(&m_context);
+
+        ComPtr<IDXGIDevice> dxgiDevice;
+        ComPtr<IDXGIAdapter> adapter;
+        if (FAILED(m_device.As(&dxgiDevice)) || FAILED(dxgiDevice->GetAdapter(&adapter)))
+            return false;
+        return SUCCEEDED(adapter->EnumOutputs(m_outputIndex, &output));
+    }
+
+    ComPtr<IDXGIFactory1> factory;
+    if (FAILED(CreateDXGIFactory1(__uuidof(IDXGIFactory1), (void**)&factory)))
+        return false;
+
+    // Walk outputs across adapters until we reach the requested global index
+    UINT remaining = m_outputIndex;
+    ComPtr<IDXGIAdapter1> adapter;
+    for (UINT a = 0; factory->EnumAdapters1(a, &adapter) != DXGI_ERROR_NOT_FOUND; ++a)
+    {
+        for (UINT o = 0; adapter->EnumOutputs(o, &output) != DXGI_ERROR_NOT_FOUND; ++o)
+        {
+            if (remaining-- == 0)
+            {
+                HRESULT hr = D3D11CreateDevice(
+                    adapter.Get(), D3D_DRIVER_TYPE_UNKNOWN, nullptr, D3D11_CREATE_DEVICE_BGRA_SUPPORT,
+                    nullptr, 0, D3D11_SDK_VERSION, &m_device, nullptr, &m_context);
+                return SUCCEEDED(hr);
+            }
+            output.Reset();
+        }
+        adapter.Reset();
+    }
+    return false;
+}
+
+bool DxgiCaptureSource::Open()
+{
+    ComPtr<IDXGIOutput> output;
+    if (!CreateDeviceForOutput(output))
+        return false;
+
+    ComPtr<IDXGIOutput1> output1;
+    if (FAILED(output.As(&output1)))
+        return false;
+
+    // DuplicateOutput1 hands out the desktop in the first supported format of the list;
+    // with only the HDR one listed it fails rather than tone-mapping
+    m_format = CapturePixelFormat::Bgra8;
+    if (m_requestedFormat != CapturePixelFormat::Bgra8)
+    {
+        ComPtr<IDXGIOutput5> output5;
+        const DXGI_FORMAT formats[] = { ToDxgiFormat(m_requestedFormat) };
+        if (SUCCEEDED(output.As(&output5)) &&
+            SUCCEEDED(output5->DuplicateOutput1(m_device.Get(), 0, 1, formats, &m_duplication)))
+            m_format = m_requestedFormat;
+    }
+    if (!m_duplication && FAILED(output1->DuplicateOutput(m_device.Get(), &m_duplication)))
+        return false;
+
+    DXGI_OUTDUPL_DESC duplDesc;
+    m_duplication->GetDesc(&duplDesc);
+    m_width = duplDesc.ModeDesc.Width;
+    m_height = duplDesc.ModeDesc.Height;
+    DXGI_OUTPUT_DESC outputDesc;
+    if (SUCCEEDED(output->GetDesc(&outputDesc)))
+        m_desktopRect = outputDesc.DesktopCoordinates;
+
+    D3D11_TEXTURE2D_DESC desc_staging = {};
+    desc_staging.Width = m_width;
+    desc_staging.Height = m_height;
+    desc_staging.MipLevels = 1;
+    desc_staging.ArraySize = 1;
+    desc_staging.Format = ToDxgiFormat(m_format); // matches the duplication
+    desc_staging.SampleDesc.Count = 1;
+    desc_staging.Usage = D3D11_USAGE_STAGING;
+    desc_staging.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    desc_staging.BindFlags = 0;
+    desc_staging.MiscFlags = 0;
+
+    for (UINT i = 0; i < READBACK_COUNT; ++i)
+    {
+        if (FAILED(m_device->CreateTexture2D(&desc_staging, nullptr, &m_readbacks[i])))
+            return false;
+    }
+
+    m_readbackIndex = 0;
+    m_pointer = {};
+    m_pointerPosition = {};
+    return m_previewInterval > 0.0 ? CreatePreviewRing() : true;
+}
+
+bool DxgiCaptureSource::Warm()
+{
+    TRACE_SCOPE("WarmReadbacks");
+    volatile uint8_t sink = 0;
+    for (UINT i = 0; i < READBACK_COUNT; ++i)
+    {
+        D3D11_MAPPED_SUBRESOURCE mapped = {};
+        if (FAILED(m_context->Map(m_readbacks[i].Get(), 0, D3D11_MAP_READ, 0, &mapped)))
+            return false;
+        const uint8_t* data = (const uint8_t*)mapped.pData;
+        const size_t bytes = size_t(mapped.RowPitch) * m_height;
+        for (size_t offset = 0; offset < bytes; offset += 4096)
+            sink = uint8_t(sink + data[offset]);
+        m_context->Unmap(m_readbacks[i].Get(), 0);
+    }
+
+    // Metadata and pointer shapes reuse these; most frames fit without a reallocation
+    m_dirtyRects.reserve(256);
+    m_pointerBuffer.reserve(256 * 256 * 4);
+    return true;
+}
+
+bool DxgiCaptureSource::CreatePreviewRing()
+{
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Width = m_width;
+    desc.Height = m_height;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = ToDxgiFormat(m_format); // CopyResource needs the duplication's format
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    desc.MiscFlags = D3D11_RESOURCE_MISC_SHARED; // openable from the preview device
+
+    for (UINT i = 0; i < PREVIEW_COUNT; ++i)
+    {
+        ComPtr<IDXGIResource> resource;
+        if (FAILED(m_device->CreateTexture2D(&desc, nullptr, &m_previews[i])) ||
+            FAILED(m_previews[i].As(&resource)) ||
+            FAILED(resource->GetSharedHandle(&m_previewHandles[i])))
+            return false;
+    }
+
+    m_previewIndex = 0;
+    m_lastPreview = {};
+    return true;
+}
+
+void DxgiCaptureSource::PublishPreview(ID3D11Texture2D* frameTex)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - m_lastPreview).count() < m_previewInterval)
+        return;
+    m_lastPreview = now;
+
+    // Write the slot after the latest so the one the preview is sampling stays untouched
+    UINT idx = ++m_previewIndex % PREVIEW_COUNT;
+    m_context->CopyResource(m_previews[idx].Get(), frameTex);
+    // Shared resources without a keyed mutex are only coherent across devices after a flush
+    m_context->Flush();
+    m_previewLatest = m_previewHandles[idx];
+}
+
+void DxgiCaptureSource::Close()
+{
+    m_previewLatest = nullptr;
+    for (UINT i = 0; i < PREVIEW_COUNT; ++i)
+    {
+        m_previews[i].Reset();
+        m_previewHandles[i] = nullptr;
+    }
+    for (auto& readback : m_readbacks)
+        readback.Reset();
+    m_duplication.Reset();
+    m_context.Reset();
+    m_device.Reset();
+    m_width = m_height = 0;
+}
+
+double DxgiCaptureSource::DirtyFraction(const DXGI_OUTDUPL_FRAME_INFO& frameInfo)
+{
+    if (frameInfo.TotalMetadataBufferSize == 0)
+        return 1.0;
+
+    m_dirtyRects.resize(frameInfo.TotalMetadataBufferSize / sizeof(RECT) + 1);
+    UINT bytes = 0;
+    if (FAILED(m_duplication->GetFrameDirtyRects(
+        UINT(m_dirtyRects.size() * sizeof(RECT)), m_dirtyRects.data(), &bytes)))
+        return 1.0;
+
+    double area = 0.0;
+    for (UINT i = 0; i < bytes / sizeof(RECT); ++i)
+        area += double(m_dirtyRects[i].right - m_dirtyRects[i].left) * (m_dirtyRects[i].bottom - m_dirtyRects[i].top);
+    return (std::min)(1.0, area / (double(m_width) * m_height));
+}
+
+void DxgiCaptureSource::UpdatePointer(const DXGI_OUTDUPL_FRAME_INFO& frameInfo)
+{
+    if (frameInfo.LastMouseUpdateTime.QuadPart == 0)
+        return; // neither position nor shape changed
+
+    m_pointer.visible = frameInfo.PointerPosition.Visible != FALSE;
+    m_pointerPosition = frameInfo.PointerPosition.Position;
+
+    if (frameInfo.PointerShapeBufferSize > 0)
+    {
+        m_pointerBuffer.resize(frameInfo.PointerShapeBufferSize);
+        UINT required = 0;
+        DXGI_OUTDUPL_POINTER_SHAPE_INFO shapeInfo = {};
+        auto shape = std::make_shared<PointerShape>();
+        if (SUCCEEDED(m_duplication->GetFramePointerShape(UINT(m_pointerBuffer.size()), m_pointerBuffer.data(),
+                &required, &shapeInfo)) &&
+            DecodePointerShape(PointerShapeType(shapeInfo.Type), shapeInfo.Width, shapeInfo.Height, shapeInfo.Pitch,
+                m_pointerBuffer.data(), false, *shape))
+        {
+            shape->id = ++m_pointerShapes;
+            m_pointer.shape = std::move(shape);
+        }
+    }
+
+    // Frames are top-down like the desktop, so the position is already in frame rows
+    m_pointer.x = m_pointerPosition.x;
+    m_pointer.y = m_pointerPosition.y;
+}
+
+CaptureResult DxgiCaptureSource::AcquireFrame(uint8_t* dst, CaptureFrameInfo* info)
+{
+    DXGI_OUTDUPL_FRAME_INFO frameInfo = {};
+    ComPtr<IDXGIResource> desktopResource;
+
+    HRESULT hr;
+    {
+        TRACE_SCOPE("AcquireNextFrame");
+        hr = m_duplication->AcquireNextFrame(16, &frameInfo, &desktopResource);
+    }
+    if (FAILED(hr))
+        return ToCaptureResult(hr);
+
+    UpdatePointer(frameInfo);
+    if (info)
+        info->pointer = m_pointer;
+
+    // Only the pointer moved or changed shape: the desktop image is unchanged, so skip
+    // the full-frame copy and readback
+    if (frameInfo.LastPresentTime.QuadPart == 0)
+    {
+        m_duplication->ReleaseFrame();
+        return CaptureResult::PointerMoved;
+    }
+
+    if (info)
+        info->dirtyFraction = DirtyFraction(frameInfo);
+
+    ComPtr<ID3D11Texture2D> frameTex;
+    desktopResource.As(&frameTex);
+
+    if (m_previews[0])
+        PublishPreview(frameTex.Get());
+
+    UINT idx = m_readbackIndex % READBACK_COUNT;
+    {
+        TRACE_SCOPE("CopyResource");
+        m_context->CopyResource(m_readbacks[idx].Get(), frameTex.Get());
+    }
+
+    // Map the copy issued on the previous call so the GPU has had a frame to finish it
+    UINT mapIdx = (m_readbackIndex + READBACK_COUNT - 1) % READBACK_COUNT;
+
+    D3D11_MAPPED_SUBRESOURCE mapped = {};
+    {
+        TRACE_SCOPE("Map");
+        hr = m_context->Map(m_readbacks[mapIdx].Get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+    }
+    if (SUCCEEDED(hr))
+    {
+        TRACE_SCOPE("RowCopy");
+        // Top-down like the desktop (ICaptureSource); HDR formats also fill the level codes
+        // when the caller asked for them
+        uint16_t* levels = info ? info->levels : nullptr;
+        const uint8_t* src = (const uint8_t*)mapped.pData;
+        uint8_t* proxy = info ? info->proxy : nullptr;
+        if (proxy && (m_downscaler.Width() != m_width || m_downscaler.Height() != m_height ||
+                         m_downscaler.Factor() != info->proxyFactor) &&
+            !m_downscaler.Reset(m_width, m_height, info->proxyFactor))
+        {
+            proxy = nullptr; // left unwritten, proxyWritten stays false
+        }
+
+        TileHasher* tiles = info ? info->tiles : nullptr;
+        if (tiles && !tiles->Resize(m_width, m_height))
+            tiles = nullptr;
+
+        if ((proxy || tiles) && m_format == CapturePixelFormat::Bgra8)
+        {
+            // Each row is hashed in the pass that copies it, and averaged into the proxy
+            // while it is still in cache; without a dst both read it straight from the
+            // readback and it is never copied
+            if (proxy)
+                m_downscaler.Begin(proxy);
+            if (tiles)
+                tiles->Begin();
+            const size_t rowBytes = size_t(m_width) * 4;
+            for (UINT y = 0; y < m_height; ++y)
+            {
+                const uint8_t* row = src + size_t(y) * mapped.RowPitch;
+                if (dst)
+                {
+                    uint8_t* copy = dst + size_t(y) * rowBytes;
+                    if (tiles)
+                        tiles->AddRow(row, copy);
+                    else
+                        std::memcpy(copy, row, rowBytes);
+                    row = copy;
+                }
+                else if (tiles)
+                {
+                    tiles->AddRow(row);
+                }
+                if (proxy)
+                    m_downscaler.AddRow(row);
+            }
+            if (proxy)
+                info->proxyWritten = true;
+            if (tiles)
+                info->tilesHashed = true;
+        }
+        else if (proxy)
+        {
+            uint8_t* decoded = dst;
+            if (!decoded)
+            {
+                m_decoded.resize(size_t(m_width) * m_height * 4);
+                decoded = m_decoded.data();
+            }
+            DecodeFrame(m_format, m_decoder, src, mapped.RowPitch, m_width, m_height, false, levels, decoded);
+            m_downscaler.Downscale(decoded, proxy);
+            info->proxyWritten = true;
+            if (tiles)
+            {
+                tiles->Hash(decoded);
+                info->tilesHashed = true;
+            }
+        }
+        else
+        {
+            DecodeFrame(m_format, m_decoder, src, mapped.RowPitch, m_width, m_height, false, levels, dst);
+        }
+        if (info && m_format != CapturePixelFormat::Bgra8)
+        {
+            info->hdrLevels = levels != nullptr;
+            info->peakNits = MeasureLuminance(m_format, m_decoder, src, mapped.RowPitch, m_width, m_height).peakNits;
+        }
+
+        m_context->Unmap(m_readbacks[mapIdx].Get(), 0);
+    }
+
+    m_readbackIndex++;
+    m_duplication->ReleaseFrame();
+    return SUCCEEDED(hr) ? CaptureResult::Frame : CaptureResult::Dropped;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d11.h>
+#include <dxgi1_2.h>
+#include <dxgi1_5.h>
+#include <wrl/client.h>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "CaptureSource.h"
+#include "FrameProxy.h"
+#include "HdrFormats.h"
+
+// DXGI Desktop Duplication backend. Owns the duplication and the readback ring for one
+// output; the only Windows-specific piece of the capture path.
+class DxgiCaptureSource : public ICaptureSource
+{
+public:
+    static constexpr UINT READBACK_COUNT = 3;
+    static constexpr UINT PREVIEW_COUNT = 3;
+
+    // outputIndex counts outputs across all adapters. With device == nullptr the source
+    // creates a private device on the adapter that owns the output, otherwise it shares
+    // the given device (and its immediate context) and outputIndex is local to its adapter.
+    explicit DxgiCaptureSource(UINT outputIndex = 0, ID3D11Device* device = nullptr);
+    ~DxgiCaptureSource() override;
+
+    bool Open() override;
+    void Close() override;
+    // Maps every readback once and touches its pages, so the first frame's Map neither
+    // commits driver memory nor page faults through 8-33 MB
+    bool Warm() override;
+    uint32_t Width() const override { return m_width; }
+    uint32_t Height() const override { return m_height; }
+    CapturePixelFormat Format() const override { return m_format; }
+    CaptureResult AcquireFrame(uint8_t* dst, CaptureFrameInfo* info) override;
+    // Bgra8 rows are downscaled straight after their copy, or straight from the mapped
+    // readback without one; HDR frames are decoded first
+    bool WritesProxy() const override { return true; }
+    // Bgra8 rows are hashed in the pass that copies them; HDR frames once decoded (the
+    // session hashes dst when only that is written)
+    bool HashesTiles() const override { return true; }
+
+    // Publish every acquired frame, at most fps times a second, into a ring of shared
+    // textures so a preview on another device can show it without acquiring frames of its
+    // own. Call before Open; 0 (the default) disables publishing.
+    void SetPreviewRate(double fps) { m_previewInterval = fps > 0.0 ? 1.0 / fps : 0.0; }
+    // Duplicate in an HDR format through IDXGIOutput5::DuplicateOutput1, so highlights
+    // reach the wear map instead of the OS tone-mapping them to SDR. Call before Open;
+    // Open falls back to Bgra8 where DuplicateOutput1 is missing or refuses the format.
+    void RequestFormat(CapturePixelFormat format, float sdrWhiteNits = 203.0f);
+    // Shared handle (IDXGIResource::GetSharedHandle) of the most recently published frame,
+    // nullptr before the first one. Open it with ID3D11Device::OpenSharedResource; the
+    // handle stays valid until Close. A slot is rewritten two publishes later.
+    HANDLE LatestPreviewHandle() const { return m_previewLatest; }
+
+    // The duplicated output in desktop coordinates, valid after Open
+    RECT DesktopRect() const { return m_desktopRect; }
+
+    ID3D11Device* Device() const { return m_device.Get(); }
+
+private:
+    bool CreateDeviceForOutput(Microsoft::WRL::ComPtr<IDXGIOutput>& output);
+    double DirtyFraction(const DXGI_OUTDUPL_FRAME_INFO& frameInfo);
+    void UpdatePointer(const DXGI_OUTDUPL_FRAME_INFO& frameInfo);
+    bool CreatePreviewRing();
+    void PublishPreview(ID3D11Texture2D* frameTex);
+
+    UINT m_outputIndex;
+    Microsoft::WRL::ComPtr<ID3D11Device> m_sharedDevice;
+    Microsoft::WRL::ComPtr<ID3D11Device> m_device;
+    Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_context;
+    Microsoft::WRL::ComPtr<IDXGIOutputDuplication> m_duplication;
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> m_readbacks[READBACK_COUNT];
+    UINT m_readbackIndex = 0;
+    UINT m_width = 0, m_height = 0;
+    RECT m_desktopRect = {};
+    std::vector<RECT> m_dirtyRects;
+
+    CapturePixelFormat m_requestedFormat = CapturePixelFormat::Bgra8;
+    CapturePixelFormat m_format = CapturePixelFormat::Bgra8;
+    HdrDecoder m_decoder;
+
+    FrameDownscaler m_downscaler;
+    std::vector<uint8_t> m_decoded; // HDR frame decoded for the proxy when there is no dst
+
+    // Pointer as last reported; the shape is only fetched when duplication says it changed
+    PointerState m_pointer;
+    POINT m_pointerPosition = {}; // top-left, desktop rows (top-down)
+    std::vector<uint8_t> m_pointerBuffer;
+    uint64_t m_pointerShapes = 0;
+
+    double m_previewInterval = 0.0;
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> m_previews[PREVIEW_COUNT];
+    HANDLE m_previewHandles[PREVIEW_COUNT] = {};
+    UINT m_previewIndex = 0;
+    std::chrono::steady_clock::time_point m_lastPreview;
+    std::atomic<HANDLE> m_previewLatest{ nullptr };
+};
@@ -0,0 +1,248 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const size_t SMALL_PAGE = 4096;
+static const size_t LARGE_PAGE = 2u << 20;
+
+static size_t RoundUp(size_t value, size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+const char* FrameArenaBackingName(FrameArenaBacking backing)
+{
+    switch (backing)
+    {
+    case FrameArenaBacking::SmallPages:      return "small_pages";
+    case FrameArenaBacking::TransparentHuge: return "transparent_huge";
+    case FrameArenaBacking::LargePages:      return "large_pages";
+    default:                                 return "none";
+    }
+}
+
+#ifdef _WIN32
+
+// MEM_LARGE_PAGES fails unless the token holds SeLockMemoryPrivilege, which is granted by
+// policy and only has to be enabled here
+static bool EnableLockMemoryPrivilege()
+{
+    HANDLE token = nullptr;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+        return false;
+
+    TOKEN_PRIVILEGES privileges = {};
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    bool ok = LookupPrivilegeValueW(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)
+        && AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr)
+        && GetLastError() == ERROR_SUCCESS; // ERROR_NOT_ALL_ASSIGNED: not granted
+    CloseHandle(token);
+    return ok;
+}
+
+static int CurrentNumaNode()
+{
+    PROCESSOR_NUMBER processor;
+    GetCurrentProcessorNumberEx(&processor);
+    USHORT node = 0;
+    return GetNumaProcessorNodeEx(&processor, &node) ? int(node) : -1;
+}
+
+static void* Map(size_t& bytes, const FrameArenaOptions& options, FrameArenaBacking& backing, int& node)
+{
+    node = options.numaLocal ? CurrentNumaNode() : -1;
+    auto alloc = [&](size_t size, DWORD flags) -> void*
+    {
+        return node >= 0 ? VirtualAllocExNuma(GetCurrentProcess(), nullptr, size, flags, PAGE_READWRITE, DWORD(node))
+                         : VirtualAlloc(nullptr, size, flags, PAGE_READWRITE);
+    };
+
+    const size_t largePage = GetLargePageMinimum();
+    if (options.largePages && largePage && EnableLockMemoryPrivilege())
+    {
+        size_t size = RoundUp(bytes, largePage);
+        if (void* p = alloc(size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES))
+        {
+            bytes = size;
+            backing = FrameArenaBacking::LargePages;
+            return p;
+        }
+    }
+
+    size_t size = RoundUp(bytes, SMALL_PAGE);
+    void* p = alloc(size, MEM_RESERVE | MEM_COMMIT);
+    if (p)
+    {
+        bytes = size;
+        backing = FrameArenaBacking::SmallPages;
+    }
+    return p;
+}
+
+static void Unmap(void* mapping, size_t)
+{
+    VirtualFree(mapping, 0, MEM_RELEASE);
+}
+
+#elif defined(__linux__)
+
+static int CurrentNumaNode()
+{
+    unsigned cpu = 0, node = 0;
+    return syscall(SYS_getcpu, &cpu, &node, nullptr) == 0 ? int(node) : -1;
+}
+
+static void* Map(size_t& bytes, const FrameArenaOptions& options, FrameArenaBacking& backing, int& node)
+{
+    void* p = MAP_FAILED;
+    if (options.largePages)
+    {
+        // Needs pages reserved in /proc/sys/vm/nr_hugepages
+        size_t size = RoundUp(bytes, LARGE_PAGE);
+        p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED)
+        {
+            bytes = size;
+            backing = FrameArenaBacking::LargePages;
+        }
+    }
+    if (p == MAP_FAILED)
+    {
+        size_t size = RoundUp(bytes, options.largePages ? LARGE_PAGE : SMALL_PAGE);
+        p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            return nullptr;
+        bytes = size;
+        backing = FrameArenaBacking::SmallPages;
+        // Huge pages only fill 2 MB aligned ranges; mmap of this size usually is one
+        if (options.largePages && madvise(p, size, MADV_HUGEPAGE) == 0)
+            backing = FrameArenaBacking::TransparentHuge;
+    }
+
+    // Preferred, not bound: a full node falls back to another instead of failing. Must
+    // happen before the pages are first touched.
+    node = -1;
+    if (options.numaLocal)
+    {
+        int current = CurrentNumaNode();
+        unsigned long mask = current >= 0 && current < int(8 * sizeof(unsigned long)) ? 1ul << current : 0;
+        const int MPOL_PREFERRED_MODE = 1;
+        if (mask && syscall(SYS_mbind, p, bytes, MPOL_PREFERRED_MODE, &mask, 8 * sizeof(mask), 0) == 0)
+            node = current;
+    }
+    return p;
+}
+
+static void Unmap(void* mapping, size_t bytes)
+{
+    munmap(mapping, bytes);
+}
+
+#else
+
+static void* Map(size_t& bytes, const FrameArenaOptions&, FrameArenaBacking& backing, int& node)
+{
+    bytes = RoundUp(bytes, SMALL_PAGE);
+    node = -1;
+    void* p = ::operator new(bytes, std::align_val_t(SMALL_PAGE), std::nothrow);
+    if (p)
+        backing = FrameArenaBacking::SmallPages;
+    return p;
+}
+
+static void Unmap(void* mapping, size_t)
+{
+    ::operator delete(mapping, std::align_val_t(SMALL_PAGE));
+}
+
+#endif
+
+FrameArena::~FrameArena()
+{
+    Unmap();
+}
+
+void FrameArena::Unmap()
+{
+    if (m_mapping)
+        ::Unmap(m_mapping, m_mappedBytes);
+    m_mapping = nullptr;
+    m_base = nullptr;
+    m_mappedBytes = 0;
+    m_slotBytes = m_slotStride = 0;
+    m_slotCount = 0;
+    m_backing = FrameArenaBacking::None;
+    m_numaNode = -1;
+}
+
+bool FrameArena::Reset(size_t slotBytes, uint32_t slotCount, FrameArenaOptions options)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Unmap();
+    m_free.clear();
+    if (slotBytes == 0 || slotCount == 0)
+        return true;
+
+    // Page-granular slots: aligned, and no page is shared by two frames that different
+    // threads write
+    const size_t stride = RoundUp(slotBytes, SMALL_PAGE);
+    size_t bytes = stride * slotCount;
+    FrameArenaBacking backing = FrameArenaBacking::None;
+    int node = -1;
+    void* mapping = ::Map(bytes, options, backing, node);
+    if (!mapping)
+        return false;
+
+    // Fault everything in now, on this thread (and node)
+    std::memset(mapping, 0, bytes);
+
+    m_mapping = mapping;
+    m_base = static_cast<uint8_t*>(mapping);
+    m_mappedBytes = bytes;
+    m_slotBytes = slotBytes;
+    m_slotStride = stride;
+    m_slotCount = slotCount;
+    m_backing = backing;
+    m_numaNode = node;
+
+    // Lowest index on top, so a lightly used arena keeps reusing the same few slots
+    m_free.reserve(slotCount);
+    for (uint32_t i = slotCount; i > 0; --i)
+        m_free.push_back(i - 1);
+    return true;
+}
+
+uint8_t* FrameArena::Acquire()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_free.empty())
+        return nullptr;
+    uint32_t index = m_free.back();
+    m_free.pop_back();
+    return Slot(index);
+}
+
+void FrameArena::Release(const uint8_t* slot)
+{
+    if (!slot)
+        return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.push_back(uint32_t(size_t(slot - m_base) / m_slotStride));
+}
+
+uint32_t FrameArena::FreeSlots() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return uint32_t(m_free.size());
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Fixed-size frame buffers allocated once, up front, instead of a vector or media buffer
+// per frame. All slots come from one mapping:
+//
+//  - backed by 2 MB pages where the OS allows it: MAP_HUGETLB, then transparent huge
+//    pages (madvise) on Linux; MEM_LARGE_PAGES on Windows, which needs the "Lock pages in
+//    memory" privilege. Otherwise normal pages. A 1080p BGRA frame spans 4 large pages
+//    instead of ~2000 small ones.
+//  - every slot starts on a page boundary, so it is 64-byte aligned for SIMD and rows of
+//    a BGRA frame are too whenever the width is a multiple of 16 (1280, 1920, 2560, 3840)
+//  - optionally placed on the NUMA node of the thread calling Reset, which should be the
+//    thread that will touch the frames most
+//  - every page is touched in Reset, so no page fault or allocation lands mid-capture
+//
+// Acquire and Release are O(1) and thread-safe (a free list under a mutex); a slot may be
+// released on another thread than the one that acquired it.
+enum class FrameArenaBacking
+{
+    None,           // not allocated
+    SmallPages,
+    TransparentHuge, // small pages the kernel was asked to collapse into 2 MB ones
+    LargePages       // explicit 2 MB pages
+};
+
+const char* FrameArenaBackingName(FrameArenaBacking backing);
+
+struct FrameArenaOptions
+{
+    bool largePages = true;
+    bool numaLocal = false;
+};
+
+class FrameArena
+{
+public:
+    static constexpr size_t ALIGNMENT = 64;
+
+    FrameArena() = default;
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Frees the previous mapping (every slot must be released) and maps slotCount slots
+    // of at least slotBytes. Reset(0, 0) just frees. False if nothing could be mapped.
+    bool Reset(size_t slotBytes, uint32_t slotCount, FrameArenaOptions options = {});
+
+    // nullptr when every slot is in use
+    uint8_t* Acquire();
+    void Release(const uint8_t* slot);
+
+    uint8_t* Slot(uint32_t index) const { return m_base + size_t(index) * m_slotStride; }
+    uint32_t SlotCount() const { return m_slotCount; }
+    uint32_t FreeSlots() const;
+    size_t SlotBytes() const { return m_slotBytes; }
+    size_t SlotStride() const { return m_slotStride; }
+    size_t MappedBytes() const { return m_mappedBytes; }
+    FrameArenaBacking Backing() const { return m_backing; }
+    int NumaNode() const { return m_numaNode; } // -1 = not placed
+
+private:
+    void Unmap();
+
+    uint8_t* m_base = nullptr;
+    void* m_mapping = nullptr;
+    size_t m_mappedBytes = 0;
+    size_t m_slotBytes = 0, m_slotStride = 0;
+    uint32_t m_slotCount = 0;
+    FrameArenaBacking m_backing = FrameArenaBacking::None;
+    int m_numaNode = -1;
+
+    mutable std::mutex m_mutex;
+    std::vector<uint32_t> m_free; // stack of free slot indices
+};
@@ -0,0 +1,69 @@
+#include "BenchmarkModes.h"
+
+#include <cstdio>
+
+static double GainPercent(double slower, double faster)
+{
+    return faster > 0.0 ? (slower / faster - 1.0) * 100.0 : 0.0;
+}
+
+FrameArenaComparison MeasureFrameArena(const BenchmarkConfig& config)
+{
+    FrameArenaComparison comparison;
+    BenchmarkConfig run = config;
+    run.fps = 0.0;
+    for (int round = 0; round < 2; ++round)
+    {
+        for (bool arena : { true, false })
+        {
+            run.frameArena = arena;
+            BenchmarkResult result = RunPipelineBenchmark(run);
+            BenchmarkResult& best = arena ? comparison.arena : comparison.vectors;
+            if (round == 0 || !result.ok || (best.ok && result.sustainedFps > best.sustainedFps))
+                best = result;
+        }
+    }
+
+    const BenchmarkResult& a = comparison.arena;
+    const BenchmarkResult& v = comparison.vectors;
+    comparison.fpsGainPercent = GainPercent(a.sustainedFps, v.sustainedFps);
+    comparison.captureGainPercent = GainPercent(v.stages[STAGE_CAPTURE].meanNs, a.stages[STAGE_CAPTURE].meanNs);
+    comparison.wearGainPercent = GainPercent(v.stages[STAGE_WEAR].meanNs, a.stages[STAGE_WEAR].meanNs);
+    if (a.dtlbMisses >= 0 && v.dtlbMisses >= 0)
+        comparison.dtlbMissesSaved = v.dtlbMisses - a.dtlbMisses;
+    return comparison;
+}
+
+std::string FormatFrameArenaJson(const FrameArenaComparison& comparison)
+{
+    const BenchmarkResult& a = comparison.arena;
+    const BenchmarkResult& v = comparison.vectors;
+    char buf[1024];
+    std::snprintf(buf, sizeof(buf),
+        "{\"benchmark\":\"frame_arena\",\"workload\":\"%s\",\"width\":%u,\"height\":%u,\"frames\":%u,"
+        "\"backing\":\"%s\",\"ok\":%s,\n"
+        " \"arena\":{\"sustained_fps\":%.2f,\"capture_ns\":%.0f,\"stats_ns\":%.0f,\"wear_ns\":%.0f,\"dtlb_misses\":%lld},\n"
+        " \"vector\":{\"sustained_fps\":%.2f,\"capture_ns\":%.0f,\"stats_ns\":%.0f,\"wear_ns\":%.0f,\"dtlb_misses\":%lld},\n"
+        " \"fps_gain_percent\":%.1f,\"capture_gain_percent\":%.1f,\"wear_gain_percent\":%.1f,"
+        "\"dtlb_misses_saved\":%lld%s}\n",
+        SyntheticWorkloadName(a.config.workload), a.config.width, a.config.height, a.config.frames,
+        FrameArenaBackingName(a.arenaBacking), a.ok && v.ok ? "true" : "false",
+        a.sustainedFps, a.stages[STAGE_CAPTURE].meanNs, a.stages[STAGE_STATS].meanNs, a.stages[STAGE_WEAR].meanNs,
+        (long long)a.dtlbMisses,
+        v.sustainedFps, v.stages[STAGE_CAPTURE].meanNs, v.stages[STAGE_STATS].meanNs, v.stages[STAGE_WEAR].meanNs,
+        (long long)v.dtlbMisses,
+        comparison.fpsGainPercent, comparison.captureGainPercent, comparison.wearGainPercent,
+        (long long)comparison.dtlbMissesSaved,
+        comparison.dtlbMissesSaved < 0 ? ",\"note\":\"dTLB counters unavailable\"" : "");
+    return buf;
+}
+
+bool RunFrameArenaMode(const BenchmarkOptions& options, std::string& json)
+{
+    BenchmarkConfig config = options.config;
+    config.workload = options.workloads.front();
+    FrameArenaComparison comparison = MeasureFrameArena(config);
+    json = FormatFrameArenaJson(comparison);
+    return comparison.arena.ok && comparison.vectors.ok && comparison.arena.arenaBacking != FrameArenaBacking::None &&
+        comparison.vectors.arenaBacking == FrameArenaBacking::None;
+}
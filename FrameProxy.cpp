@@ -0,0 +1,261 @@
+#include "FrameProxy.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PROXY_SSE 1
+#else
+#define PROXY_SSE 0
+#endif
+
+#if PROXY_SSE
+// Column sums of one block, two pixels per register: the block's pixel sum in both halves'
+// sum (low half + high half)
+static inline __m128i BlockSums(const uint16_t* block, uint32_t pairs)
+{
+    __m128i sum = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    for (uint32_t k = 1; k < pairs; ++k)
+        sum = _mm_add_epi16(sum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + k * 8)));
+    return sum;
+}
+
+// Two blocks' pixel sums side by side
+static inline __m128i FoldPair(__m128i a, __m128i b)
+{
+    return _mm_add_epi16(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+}
+#endif
+
+bool IsProxyFactor(uint32_t factor)
+{
+    return factor == 2 || factor == 4 || factor == 8 || factor == 16;
+}
+
+uint32_t ProxyDimension(uint32_t size, uint32_t factor)
+{
+    return factor ? uint32_t((uint64_t(size) + factor - 1) / factor) : 0;
+}
+
+bool FrameDownscaler::Reset(uint32_t width, uint32_t height, uint32_t factor, bool allowSimd)
+{
+    if (!IsProxyFactor(factor) || width == 0 || height == 0)
+        return false;
+
+    m_width = width;
+    m_height = height;
+    m_factor = factor;
+    m_shift = 0;
+    while ((1u << m_shift) < factor * factor)
+        m_shift++;
+    m_proxyWidth = ProxyDimension(width, factor);
+    m_proxyHeight = ProxyDimension(height, factor);
+#if PROXY_SSE
+    m_simd = allowSimd;
+#else
+    (void)allowSimd;
+    m_simd = false;
+#endif
+    // Rounded up to whole blocks so the column fold never reads past the end
+    m_sums.assign(size_t(m_proxyWidth) * factor * 4, 0);
+    m_proxy = nullptr;
+    m_row = m_rowInBlock = m_blockRow = 0;
+    return true;
+}
+
+void FrameDownscaler::Begin(uint8_t* proxy)
+{
+    m_proxy = proxy;
+    m_row = m_rowInBlock = m_blockRow = 0;
+}
+
+void FrameDownscaler::AddRow(const uint8_t* row)
+{
+    const size_t count = size_t(m_width) * 4;
+    uint16_t* sums = m_sums.data();
+    size_t i = 0;
+    // The first row of a block row overwrites the sums, the others add to them
+    const bool first = m_rowInBlock == 0;
+#if PROXY_SSE
+    if (m_simd)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        if (first)
+        {
+            for (; i + 16 <= count; i += 16)
+            {
+                const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + i), _mm_unpacklo_epi8(px, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + i + 8), _mm_unpackhi_epi8(px, zero));
+            }
+        }
+        else
+        {
+            for (; i + 16 <= count; i += 16)
+            {
+                const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+                __m128i* lo = reinterpret_cast<__m128i*>(sums + i);
+                __m128i* hi = reinterpret_cast<__m128i*>(sums + i + 8);
+                _mm_storeu_si128(lo, _mm_add_epi16(_mm_loadu_si128(lo), _mm_unpacklo_epi8(px, zero)));
+                _mm_storeu_si128(hi, _mm_add_epi16(_mm_loadu_si128(hi), _mm_unpackhi_epi8(px, zero)));
+            }
+        }
+    }
+#endif
+    if (first)
+    {
+        for (; i < count; ++i)
+            sums[i] = row[i];
+    }
+    else
+    {
+        for (; i < count; ++i)
+            sums[i] = uint16_t(sums[i] + row[i]);
+    }
+
+    m_row++;
+    if (++m_rowInBlock == m_factor || m_row == m_height)
+        EmitBlockRow();
+}
+
+void FrameDownscaler::EmitBlockRow()
+{
+    const uint32_t rows = m_rowInBlock;
+    const uint32_t factor = m_factor;
+    const uint16_t* sums = m_sums.data();
+    uint8_t* out = m_proxy + size_t(m_blockRow) * m_proxyWidth * 4;
+    m_rowInBlock = 0;
+    m_blockRow++;
+
+    // Whole blocks divide by a shift, edge blocks by their pixel count; both round to
+    // nearest, so (sum + d / 2) / d gives the same bytes as the shift
+    uint32_t x = 0;
+    const uint32_t wholeBlocks = rows == factor ? m_width / factor : 0;
+#if PROXY_SSE
+    if (m_simd)
+    {
+        const __m128i round = _mm_set1_epi16(int16_t(1 << (m_shift - 1)));
+        const __m128i shift = _mm_cvtsi32_si128(int(m_shift));
+        const uint32_t pairs = factor / 2; // two pixels per register
+        const size_t stride = size_t(factor) * 4;
+        // Four output pixels per store; 16 x 16 x 255 + 128 still fits an unsigned 16-bit lane
+        for (; x + 4 <= wholeBlocks; x += 4)
+        {
+            const uint16_t* block = sums + size_t(x) * stride;
+            __m128i lo = FoldPair(BlockSums(block, pairs), BlockSums(block + stride, pairs));
+            __m128i hi = FoldPair(BlockSums(block + 2 * stride, pairs), BlockSums(block + 3 * stride, pairs));
+            lo = _mm_srl_epi16(_mm_add_epi16(lo, round), shift);
+            hi = _mm_srl_epi16(_mm_add_epi16(hi, round), shift);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + size_t(x) * 4), _mm_packus_epi16(lo, hi));
+        }
+        for (; x < wholeBlocks; ++x)
+        {
+            __m128i sum = BlockSums(sums + size_t(x) * stride, pairs);
+            sum = _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+            sum = _mm_srl_epi16(_mm_add_epi16(sum, round), shift);
+            const int packed = _mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+            std::memcpy(out + size_t(x) * 4, &packed, 4);
+        }
+    }
+#endif
+    for (; x < m_proxyWidth; ++x)
+    {
+        const uint32_t x0 = x * factor;
+        const uint32_t x1 = (std::min)(x0 + factor, m_width);
+        const uint32_t count = (x1 - x0) * rows;
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            uint32_t sum = 0;
+            for (uint32_t sx = x0; sx < x1; ++sx)
+                sum += sums[size_t(sx) * 4 + c];
+            out[size_t(x) * 4 + c] = uint8_t((sum + count / 2) / count);
+        }
+    }
+}
+
+void FrameDownscaler::Downscale(const uint8_t* bgra, size_t pitch, uint8_t* proxy)
+{
+    Begin(proxy);
+    for (uint32_t y = 0; y < m_height; ++y)
+        AddRow(bgra + size_t(y) * pitch);
+}
+
+std::shared_ptr<const PointerShape> DownscalePointerShape(const PointerShape& shape, uint32_t factor)
+{
+    auto out = std::make_shared<PointerShape>();
+    out->id = shape.id;
+    if (factor <= 1 || shape.width == 0 || shape.height == 0)
+    {
+        *out = shape;
+        return out;
+    }
+
+    out->width = ProxyDimension(shape.width, factor);
+    out->height = ProxyDimension(shape.height, factor);
+    out->bgra.assign(size_t(out->width) * out->height * 4, 0);
+    out->xorMask.assign(size_t(out->width) * out->height, 0);
+
+    for (uint32_t y = 0; y < out->height; ++y)
+    {
+        for (uint32_t x = 0; x < out->width; ++x)
+        {
+            uint32_t pixels = 0, xors = 0, alpha = 0;
+            uint32_t blend[3] = {}, xorSum[3] = {};
+            const uint32_t y1 = (std::min)((y + 1) * factor, shape.height);
+            const uint32_t x1 = (std::min)((x + 1) * factor, shape.width);
+            for (uint32_t sy = y * factor; sy < y1; ++sy)
+            {
+                for (uint32_t sx = x * factor; sx < x1; ++sx)
+                {
+                    const size_t i = size_t(sy) * shape.width + sx;
+                    const uint8_t* px = shape.bgra.data() + i * 4;
+                    pixels++;
+                    if (shape.xorMask[i])
+                    {
+                        xors++;
+                        for (int c = 0; c < 3; ++c)
+                            xorSum[c] += px[c];
+                    }
+                    else
+                    {
+                        alpha += px[3];
+                        for (int c = 0; c < 3; ++c)
+                            blend[c] += px[c] * px[3];
+                    }
+                }
+            }
+
+            const size_t o = size_t(y) * out->width + x;
+            uint8_t* px = out->bgra.data() + o * 4;
+            if (xors * 2 > pixels)
+            {
+                out->xorMask[o] = 1;
+                for (int c = 0; c < 3; ++c)
+                    px[c] = uint8_t((xorSum[c] + xors / 2) / xors);
+            }
+            else if (alpha)
+            {
+                for (int c = 0; c < 3; ++c)
+                    px[c] = uint8_t((blend[c] + alpha / 2) / alpha);
+                px[3] = uint8_t((alpha + pixels / 2) / pixels);
+            }
+        }
+    }
+    return out;
+}
+
+static int32_t FloorDiv(int32_t value, uint32_t factor)
+{
+    const int32_t f = int32_t(factor);
+    return value >= 0 ? value / f : -((-value + f - 1) / f);
+}
+
+void ScalePointer(const PointerState& pointer, uint32_t factor, std::shared_ptr<const PointerShape> scaledShape,
+    PointerState& out)
+{
+    out.visible = pointer.visible;
+    out.x = factor > 1 ? FloorDiv(pointer.x, factor) : pointer.x;
+    out.y = factor > 1 ? FloorDiv(pointer.y, factor) : pointer.y;
+    out.shape = factor > 1 ? std::move(scaledShape) : pointer.shape;
+}
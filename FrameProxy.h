@@ -0,0 +1,66 @@
+#pragma once
+
+#include "CaptureSource.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Low-resolution analysis proxies of capture frames. Wear, level statistics and change
+// detection do not need every pixel of a 4K desktop (the README's analysis samples every
+// 10th one); a factor x factor area average keeps the mean of every block at 1/16 or
+// 1/64 of the work downstream.
+//
+//  - factors are 2, 4, 8 and 16; the proxy is ceil(width / factor) x ceil(height /
+//    factor), edge blocks average the pixels they have
+//  - rows are fed one at a time, so a source can downscale each row while it is still in
+//    cache from the readback copy, or without copying the full frame at all
+//  - SSE2 sums every row into 16-bit column sums (16 x 255 fits), then folds factor
+//    columns at the end of each block row; the scalar path gives the same bytes
+//  - rows are kept in the order they are fed: a bottom-up frame gives a bottom-up proxy
+
+bool IsProxyFactor(uint32_t factor);
+// ceil(size / factor)
+uint32_t ProxyDimension(uint32_t size, uint32_t factor);
+
+class FrameDownscaler
+{
+public:
+    // False for a factor IsProxyFactor rejects or an empty frame
+    bool Reset(uint32_t width, uint32_t height, uint32_t factor, bool allowSimd = true);
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    uint32_t Factor() const { return m_factor; }
+    uint32_t ProxyWidth() const { return m_proxyWidth; }
+    uint32_t ProxyHeight() const { return m_proxyHeight; }
+
+    // Start a frame: ProxyWidth() * ProxyHeight() BGRA. Then Height() rows of Width()
+    // BGRA pixels, in frame order; the last one completes the proxy.
+    void Begin(uint8_t* proxy);
+    void AddRow(const uint8_t* row);
+
+    // Begin + every row of a frame with rows pitch bytes apart
+    void Downscale(const uint8_t* bgra, size_t pitch, uint8_t* proxy);
+    void Downscale(const uint8_t* bgra, uint8_t* proxy) { Downscale(bgra, size_t(m_width) * 4, proxy); }
+
+private:
+    void EmitBlockRow();
+
+    uint32_t m_width = 0, m_height = 0;
+    uint32_t m_factor = 0, m_shift = 0; // shift = log2(factor * factor)
+    uint32_t m_proxyWidth = 0, m_proxyHeight = 0;
+    bool m_simd = false;
+
+    std::vector<uint16_t> m_sums; // per subpixel of a row, over the block row so far
+    uint8_t* m_proxy = nullptr;
+    uint32_t m_row = 0, m_rowInBlock = 0, m_blockRow = 0;
+};
+
+// The pointer as it covers the proxy: position divided by the factor (rounded down), the
+// shape area-averaged like the frame. Alpha-blended pixels average by alpha; an output
+// pixel XORs when most of its block does. The shape keeps the source id, so callers can
+// cache it by id.
+std::shared_ptr<const PointerShape> DownscalePointerShape(const PointerShape& shape, uint32_t factor);
+void ScalePointer(const PointerState& pointer, uint32_t factor, std::shared_ptr<const PointerShape> scaledShape,
+    PointerState& out);
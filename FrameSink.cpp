@@ -0,0 +1,69 @@
+#include "FrameSink.h"
+
+void FanOutSink::Add(std::unique_ptr<IFrameSink> sink, std::string extension)
+{
+    m_children.push_back({ std::move(sink), std::move(extension) });
+}
+
+// Strip the extension of the file name only, never of a directory component
+static std::string PathStem(const std::string& path)
+{
+    size_t slash = path.find_last_of("/\\");
+    size_t dot = path.find_last_of('.');
+    return (dot != std::string::npos && (slash == std::string::npos || dot > slash)) ? path.substr(0, dot) : path;
+}
+
+bool FanOutSink::Open(const std::string& path)
+{
+    const std::string stem = PathStem(path);
+    for (size_t i = 0; i < m_children.size(); ++i)
+    {
+        if (!m_children[i].sink->Open(stem + m_children[i].extension))
+        {
+            // Leave nothing half open
+            while (i-- > 0)
+                m_children[i].sink->Close();
+            return false;
+        }
+    }
+    return !m_children.empty();
+}
+
+bool FanOutSink::WriteFrame(const uint8_t* bgra, int64_t timestampHns)
+{
+    bool ok = true;
+    for (auto& child : m_children)
+        ok &= child.sink->WriteFrame(bgra, timestampHns);
+    return ok;
+}
+
+bool FanOutSink::Close()
+{
+    bool ok = true;
+    for (auto& child : m_children)
+        ok &= child.sink->Close();
+    return ok;
+}
+
+uint64_t FanOutSink::BytesWritten() const
+{
+    uint64_t bytes = 0;
+    for (auto& child : m_children)
+        bytes += child.sink->BytesWritten();
+    return bytes;
+}
+
+bool FanOutSink::IsKeyframeBoundary() const
+{
+    for (auto& child : m_children)
+        if (!child.sink->IsKeyframeBoundary())
+            return false;
+    return true;
+}
+
+void FanOutSink::Remove(const std::string& path)
+{
+    const std::string stem = PathStem(path);
+    for (auto& child : m_children)
+        child.sink->Remove(stem + child.extension);
+}
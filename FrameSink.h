@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Destination for captured frames: one output file per Open/Close. CpuMp4Encoder is the
+// Windows implementation; ArchiveSinks.h has the portable lossless ones. Frames are
+// top-down BGRA of the size the sink was constructed with.
+class IFrameSink
+{
+public:
+    virtual ~IFrameSink() = default;
+
+    // Everything up to the first frame (file creation, codec setup). Runs on the worker thread.
+    virtual bool Open(const std::string& path) = 0;
+    virtual bool WriteFrame(const uint8_t* bgra, int64_t timestampHns) = 0;
+    // WriteFrame with, per 64x64 tile in row-major order, nonzero where bgra differs from
+    // the frame written before it (TileHasher::Changed()): a sink that compares frames may
+    // trust it instead. Never for the first frame of a file.
+    virtual bool WriteFrameWithTiles(const uint8_t* bgra, int64_t timestampHns, const uint8_t* /*changedTiles*/)
+    {
+        return WriteFrame(bgra, timestampHns);
+    }
+    // Finalize; the file is complete and playable once this returns. Runs on the worker thread.
+    virtual bool Close() = 0;
+    virtual uint64_t BytesWritten() const = 0;
+    // True when the next frame starts a new GOP, i.e. cutting here loses no references.
+    virtual bool IsKeyframeBoundary() const { return true; }
+    // After Close: delete every file Open(path) created, e.g. for a segment without frames.
+    virtual void Remove(const std::string& path) { std::remove(path.c_str()); }
+};
+
+using FrameSinkFactory = std::function<std::unique_ptr<IFrameSink>()>;
+
+// Accepts and drops everything; measures the capture path without any encode or I/O.
+class NullSink : public IFrameSink
+{
+public:
+    explicit NullSink(uint32_t width = 0, uint32_t height = 0) : m_frameBytes(uint64_t(width) * height * 4) {}
+
+    bool Open(const std::string&) override { return true; }
+    bool WriteFrame(const uint8_t*, int64_t) override { m_bytes += m_frameBytes; ++m_frames; return true; }
+    bool Close() override { return true; }
+    // Bytes that were handed in, so size-based rotation still behaves like a raw archive
+    uint64_t BytesWritten() const override { return m_bytes; }
+    uint64_t Frames() const { return m_frames; }
+
+private:
+    uint64_t m_frameBytes;
+    uint64_t m_bytes = 0;
+    uint64_t m_frames = 0;
+};
+
+// Writes every frame to several sinks, e.g. an MP4 for viewing plus a lossless archive
+// for the wear model. Each child gets the segment path with its own extension.
+class FanOutSink : public IFrameSink
+{
+public:
+    // extension replaces the one of the path given to Open, e.g. ".y4m"
+    void Add(std::unique_ptr<IFrameSink> sink, std::string extension);
+
+    bool Open(const std::string& path) override;
+    // Every child sees every frame; fails if any child failed.
+    bool WriteFrame(const uint8_t* bgra, int64_t timestampHns) override;
+    bool Close() override;
+    uint64_t BytesWritten() const override;
+    bool IsKeyframeBoundary() const override;
+    void Remove(const std::string& path) override;
+
+private:
+    struct Child
+    {
+        std::unique_ptr<IFrameSink> sink;
+        std::string extension;
+    };
+    std::vector<Child> m_children;
+};
@@ -0,0 +1,124 @@
+#include "BenchmarkModes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <thread>
+
+// StubChunkEncoder that finishes every twelfth chunk late, long enough for the other
+// encoders to run into the reorder bound behind it
+class LateChunkEncoder : public StubChunkEncoder
+{
+public:
+    using StubChunkEncoder::StubChunkEncoder;
+
+    bool Begin(uint64_t chunkIndex) override
+    {
+        m_late = chunkIndex % 12 == 1;
+        return StubChunkEncoder::Begin(chunkIndex);
+    }
+    bool End(std::vector<uint8_t>& bitstream) override
+    {
+        if (m_late)
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        return StubChunkEncoder::End(bitstream);
+    }
+
+private:
+    bool m_late = false;
+};
+
+GopParallelBenchmark MeasureGopParallel(const std::string& directory, uint32_t frames, uint32_t gopFrames)
+{
+    static const int64_t FRAME_HNS = 10000000 / 60;
+    GopParallelBenchmark bench;
+    bench.width = 64;
+    bench.height = 36;
+    bench.frames = frames;
+    bench.gopFrames = gopFrames;
+    const size_t frameBytes = size_t(bench.width) * bench.height * 4;
+
+    std::vector<std::vector<uint8_t>> input(frames, std::vector<uint8_t>(frameBytes));
+    std::mt19937 rng(33);
+    for (auto& frame : input)
+        for (uint8_t& byte : frame)
+            byte = uint8_t(rng());
+
+    // Reference: one encoder, chunk after chunk
+    std::vector<uint8_t> expected, chunk;
+    {
+        StubChunkEncoder encoder(bench.width, bench.height);
+        for (uint32_t first = 0; first < frames; first += gopFrames)
+        {
+            encoder.Begin(first / gopFrames);
+            for (uint32_t f = first; f < (std::min)(frames, first + gopFrames); ++f)
+                encoder.EncodeFrame(input[f].data(), int64_t(f) * FRAME_HNS);
+            encoder.End(chunk);
+            expected.insert(expected.end(), chunk.begin(), chunk.end());
+        }
+    }
+
+    const std::string path = directory + "/bench_gop.264";
+    for (unsigned encoders : { 1u, 2u, 4u })
+    {
+        GopParallelRun run;
+        run.encoders = encoders;
+        run.maxQueuedFrames = encoders * gopFrames;
+
+        GopParallelConfig config;
+        config.gopFrames = gopFrames;
+        config.encoders = encoders;
+        GopParallelSink sink(bench.width, bench.height,
+            [&] { return std::unique_ptr<IChunkEncoder>(new LateChunkEncoder(bench.width, bench.height)); }, config);
+        bool ok = sink.Open(path);
+        auto start = Clock::now();
+        for (uint32_t f = 0; f < frames && ok; ++f)
+            ok = sink.WriteFrame(input[f].data(), int64_t(f) * FRAME_HNS);
+        ok = sink.Close() && ok;
+        run.ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        run.stats = sink.Stats();
+        run.chunks = run.stats.chunks;
+
+        std::ifstream file(path, std::ios::binary);
+        std::vector<uint8_t> written((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        file.close();
+        run.matches = ok && written == expected;
+        std::remove(path.c_str());
+        bench.runs.push_back(run);
+    }
+    return bench;
+}
+
+std::string FormatGopParallelJson(const GopParallelBenchmark& bench)
+{
+    std::string runs;
+    for (const GopParallelRun& run : bench.runs)
+    {
+        char buf[320];
+        std::snprintf(buf, sizeof(buf),
+            "%s{\"encoders\":%u,\"chunks\":%llu,\"ms\":%.2f,\"peak_pending_chunks\":%u,\"peak_queued_frames\":%u,"
+            "\"max_queued_frames\":%u,\"stall_ms\":%.2f,\"encoder_failures\":%u,\"matches\":%s}",
+            runs.empty() ? "" : ",", run.encoders, (unsigned long long)run.chunks, run.ms, run.stats.peakPendingChunks,
+            run.stats.peakQueuedFrames, run.maxQueuedFrames, run.stats.stallSeconds * 1000.0, run.stats.encoderFailures,
+            run.matches ? "true" : "false");
+        runs += buf;
+    }
+    char buf[160];
+    std::snprintf(buf, sizeof(buf), "{\"benchmark\":\"gop_parallel\",\"width\":%u,\"height\":%u,\"frames\":%u,"
+        "\"gop_frames\":%u,\"runs\":[", bench.width, bench.height, bench.frames, bench.gopFrames);
+    return buf + runs + "]}\n";
+}
+
+bool RunGopParallelMode(const BenchmarkOptions&, std::string& json)
+{
+    GopParallelBenchmark bench = MeasureGopParallel(".");
+    bool ok = bench.runs.size() == 3;
+    for (const GopParallelRun& run : bench.runs)
+        ok = ok && run.matches && run.chunks == (bench.frames + bench.gopFrames - 1) / bench.gopFrames &&
+            run.stats.peakPendingChunks < 2 * run.encoders && run.stats.peakQueuedFrames <= run.maxQueuedFrames;
+    json = FormatGopParallelJson(bench);
+    return ok;
+}
@@ -0,0 +1,302 @@
+#include "GopParallelSink.h"
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using Seconds = std::chrono::duration<double>;
+
+GopParallelSink::GopParallelSink(uint32_t width, uint32_t height, ChunkEncoderFactory factory, GopParallelConfig config)
+    : m_width(width), m_height(height), m_factory(std::move(factory)), m_config(config)
+{
+    if (m_config.gopFrames == 0) m_config.gopFrames = 1;
+    if (m_config.encoders == 0) m_config.encoders = 1;
+    m_config.maxQueuedFrames = (std::max)(m_config.maxQueuedFrames, m_config.encoders * m_config.gopFrames);
+}
+
+GopParallelSink::~GopParallelSink()
+{
+    if (!m_threads.empty())
+        Close();
+}
+
+bool GopParallelSink::Open(const std::string& path)
+{
+    if (!m_threads.empty())
+        return false;
+
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file)
+        return false;
+
+    m_bytes = 0;
+    m_framesInChunk = 0;
+    m_nextChunk = 0;
+    m_stop = false;
+    m_failed = false;
+    m_chunks.clear();
+    m_stats = {};
+
+    // All frame copies up front: nothing is allocated per frame
+    if (m_framePool.empty())
+    {
+        if (!m_arena.Reset(size_t(m_width) * m_height * 4, m_config.maxQueuedFrames))
+        {
+            m_file.close();
+            return false;
+        }
+        for (uint32_t i = 0; i < m_config.maxQueuedFrames; ++i)
+        {
+            m_framePool.push_back(std::make_unique<Frame>());
+            m_framePool.back()->pixels = m_arena.Slot(i);
+        }
+    }
+    m_freeFrames.clear();
+    for (auto& frame : m_framePool)
+        m_freeFrames.push_back(frame.get());
+
+    for (unsigned i = 0; i < m_config.encoders; ++i)
+    {
+        auto encoder = m_factory();
+        if (!encoder)
+        {
+            StopEncoders();
+            return false;
+        }
+        m_threads.emplace_back(&GopParallelSink::EncoderLoop, this, encoder.get());
+        m_encoders.push_back(std::move(encoder));
+    }
+    return true;
+}
+
+bool GopParallelSink::WriteFrame(const uint8_t* bgra, int64_t timestampHns)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_failed || m_threads.empty())
+        return false;
+
+    if (m_freeFrames.empty())
+    {
+        TRACE_SCOPE("GopQueueStall");
+        auto start = std::chrono::steady_clock::now();
+        m_cv.wait(lock, [&] { return !m_freeFrames.empty() || m_failed; });
+        m_stats.stallSeconds += Seconds(std::chrono::steady_clock::now() - start).count();
+        if (m_failed)
+            return false;
+    }
+    Frame* frame = m_freeFrames.back();
+    m_freeFrames.pop_back();
+
+    lock.unlock();
+    std::memcpy(frame->pixels, bgra, m_arena.SlotBytes());
+    frame->timestampHns = timestampHns;
+    frame->traceFrame = Trace::CurrentFrame();
+    lock.lock();
+
+    if (m_framesInChunk == 0)
+    {
+        m_chunks.push_back(std::make_unique<Chunk>());
+        m_chunks.back()->index = m_nextChunk++;
+    }
+    m_chunks.back()->frames.push_back(frame);
+    if (++m_framesInChunk == m_config.gopFrames)
+    {
+        m_chunks.back()->closed = true;
+        m_framesInChunk = 0;
+    }
+
+    uint32_t queued = uint32_t(m_framePool.size() - m_freeFrames.size());
+    m_stats.peakQueuedFrames = std::max(m_stats.peakQueuedFrames, queued);
+    m_cv.notify_all();
+    return true;
+}
+
+void GopParallelSink::EncoderLoop(IChunkEncoder* encoder)
+{
+    // Finished chunks wait for earlier ones; cap how far encoders may run ahead
+    const size_t reorderWindow = size_t(m_config.encoders) * 2;
+    Trace::SetThreadName("gop-encoder");
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        Chunk* chunk = nullptr;
+        m_cv.wait(lock, [&] {
+            for (size_t i = 0; i < m_chunks.size() && i < reorderWindow; ++i)
+            {
+                if (!m_chunks[i]->taken)
+                {
+                    chunk = m_chunks[i].get();
+                    return true;
+                }
+            }
+            return m_stop && m_chunks.size() <= reorderWindow;
+        });
+        if (!chunk)
+            return; // stopping and every chunk is taken
+
+        chunk->taken = true;
+        lock.unlock();
+        bool ok = encoder->Begin(chunk->index);
+        lock.lock();
+
+        for (;;)
+        {
+            m_cv.wait(lock, [&] { return !chunk->frames.empty() || chunk->closed; });
+            if (chunk->frames.empty())
+                break;
+            Frame* frame = chunk->frames.front();
+            chunk->frames.pop_front();
+
+            lock.unlock();
+            if (ok)
+            {
+                TRACE_SCOPE_FRAME("EncodeFrame", frame->traceFrame);
+                ok = encoder->EncodeFrame(frame->pixels, frame->timestampHns);
+            }
+            lock.lock();
+
+            m_freeFrames.push_back(frame);
+            m_cv.notify_all();
+        }
+
+        lock.unlock();
+        if (ok)
+        {
+            TRACE_SCOPE("EndChunk");
+            ok = encoder->End(chunk->bitstream);
+        }
+        lock.lock();
+
+        chunk->done = true;
+        chunk->failed = !ok;
+        if (!ok)
+            m_stats.encoderFailures++;
+
+        uint32_t pending = 0;
+        for (auto& c : m_chunks)
+            pending += c->done ? 1 : 0;
+        m_stats.peakPendingChunks = std::max(m_stats.peakPendingChunks, pending - 1);
+
+        WriteFinishedChunks(lock);
+        m_cv.notify_all();
+    }
+}
+
+void GopParallelSink::WriteFinishedChunks(std::unique_lock<std::mutex>& lock)
+{
+    // One writer at a time; it keeps going while the front chunk is done, so chunks
+    // finished by others meanwhile are written too, always in stream order
+    if (m_writing)
+        return;
+    m_writing = true;
+
+    while (!m_chunks.empty() && m_chunks.front()->done)
+    {
+        std::unique_ptr<Chunk> chunk = std::move(m_chunks.front());
+        m_chunks.pop_front();
+
+        lock.unlock();
+        if (!chunk->failed)
+            m_file.write((const char*)chunk->bitstream.data(), std::streamsize(chunk->bitstream.size()));
+        bool ok = !chunk->failed && bool(m_file);
+        lock.lock();
+
+        m_bytes += chunk->failed ? 0 : chunk->bitstream.size();
+        m_stats.chunks++;
+        if (!ok)
+            m_failed = true;
+    }
+
+    m_writing = false;
+    m_cv.notify_all();
+}
+
+void GopParallelSink::StopEncoders()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_chunks.empty())
+            m_chunks.back()->closed = true;
+        m_framesInChunk = 0;
+        m_stop = true;
+    }
+    m_cv.notify_all();
+
+    for (auto& thread : m_threads)
+        thread.join();
+    m_threads.clear();
+    m_encoders.clear();
+}
+
+bool GopParallelSink::Close()
+{
+    if (m_threads.empty())
+        return false;
+
+    StopEncoders();
+    m_file.close();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_failed && m_chunks.empty() && !m_file.fail();
+}
+
+uint64_t GopParallelSink::BytesWritten() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bytes;
+}
+
+GopParallelStats GopParallelSink::Stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+bool StubChunkEncoder::Begin(uint64_t chunkIndex)
+{
+    m_chunkIndex = chunkIndex;
+    m_frameInChunk = 0;
+    m_bitstream.clear();
+    return true;
+}
+
+bool StubChunkEncoder::EncodeFrame(const uint8_t* bgra, int64_t timestampHns)
+{
+    // FNV-1a over a sparse sample of the frame
+    uint64_t hash = 1469598103934665603ULL ^ m_chunkIndex;
+    const size_t bytes = size_t(m_width) * m_height * 4;
+    for (size_t i = 0; i < bytes; i += 251)
+        hash = (hash ^ bgra[i]) * 1099511628211ULL;
+    hash = (hash ^ uint64_t(timestampHns)) * 1099511628211ULL;
+
+    const bool key = m_frameInChunk++ == 0;
+    const size_t payload = (key ? 4096 : 256) + size_t(hash % 2048);
+
+    static const uint8_t START_CODE[4] = { 0, 0, 0, 1 };
+    m_bitstream.insert(m_bitstream.end(), START_CODE, START_CODE + 4);
+    m_bitstream.push_back(uint8_t(0x60 | (key ? 5 : 1))); // nal_ref_idc 3, IDR or non-IDR slice
+
+    // Simulated work; the bytes have their low bit set so no start code can appear
+    uint64_t state = hash | 1;
+    for (size_t i = 0; i < payload; ++i)
+    {
+        for (uint32_t w = 0; w <= m_workPerByte; ++w)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+        }
+        m_bitstream.push_back(uint8_t(state) | 1);
+    }
+    return true;
+}
+
+bool StubChunkEncoder::End(std::vector<uint8_t>& bitstream)
+{
+    bitstream.swap(m_bitstream);
+    m_bitstream.clear();
+    return true;
+}
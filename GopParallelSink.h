@@ -0,0 +1,136 @@
+#pragma once
+
+#include "FrameArena.h"
+#include "FrameSink.h"
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+// Encodes one closed GOP: the first frame is a keyframe and nothing references frames
+// outside the chunk, so chunk bitstreams can simply be concatenated in order (Annex-B
+// H.264, MPEG-2 TS, ...).
+class IChunkEncoder
+{
+public:
+    virtual ~IChunkEncoder() = default;
+
+    virtual bool Begin(uint64_t chunkIndex) = 0;
+    virtual bool EncodeFrame(const uint8_t* bgra, int64_t timestampHns) = 0;
+    // Flush and hand out the complete chunk
+    virtual bool End(std::vector<uint8_t>& bitstream) = 0;
+};
+
+using ChunkEncoderFactory = std::function<std::unique_ptr<IChunkEncoder>()>;
+
+struct GopParallelConfig
+{
+    uint32_t gopFrames = 80;      // frames per chunk
+    unsigned encoders = 4;        // parallel encoder instances, each on its own thread
+    // Frame copies waiting for an encoder; WriteFrame blocks beyond. Raised to at least
+    // encoders * gopFrames: every encoder takes a whole chunk and may still be on its first
+    // frames when the last one arrives, so with fewer the capture thread stalls down to one
+    // encoder's speed. That many frames must fit in memory; shorten gopFrames if not.
+    uint32_t maxQueuedFrames = 0;
+};
+
+struct GopParallelStats
+{
+    uint64_t chunks = 0;
+    uint32_t peakQueuedFrames = 0;
+    uint32_t peakPendingChunks = 0; // finished chunks held back waiting for an earlier one
+    double stallSeconds = 0.0;      // WriteFrame blocked on a full frame queue
+    uint32_t encoderFailures = 0;
+};
+
+// Software encoders are single-GOP sequential; one instance cannot keep up with 4K or
+// high fps on CPU. This sink cuts the stream into closed-GOP chunks, encodes up to
+// `encoders` chunks at once and writes the chunk bitstreams to the file in order.
+// Memory is bounded: at most maxQueuedFrames frame copies, and at most 2 * encoders
+// chunks between being started and being written (finished ones wait as bitstreams for
+// an earlier chunk, so a slow chunk does not idle the other encoders at once).
+class GopParallelSink : public IFrameSink
+{
+public:
+    GopParallelSink(uint32_t width, uint32_t height, ChunkEncoderFactory factory, GopParallelConfig config = {});
+    ~GopParallelSink() override;
+
+    bool Open(const std::string& path) override;
+    bool WriteFrame(const uint8_t* bgra, int64_t timestampHns) override;
+    bool Close() override;
+    uint64_t BytesWritten() const override;
+    // Only between chunks, so a segment cut never splits a GOP
+    bool IsKeyframeBoundary() const override { return m_framesInChunk == 0; }
+
+    GopParallelStats Stats() const;
+
+private:
+    struct Frame
+    {
+        uint8_t* pixels = nullptr; // slot of m_arena
+        int64_t timestampHns = 0;
+        uint64_t traceFrame = 0; // capture frame id, for trace points on the encoder threads
+    };
+
+    struct Chunk
+    {
+        uint64_t index = 0;
+        std::deque<Frame*> frames;
+        bool closed = false;  // no more frames will be added
+        bool taken = false;   // an encoder is working on it
+        bool done = false;
+        bool failed = false;
+        std::vector<uint8_t> bitstream;
+    };
+
+    void EncoderLoop(IChunkEncoder* encoder);
+    void WriteFinishedChunks(std::unique_lock<std::mutex>& lock);
+    void StopEncoders();
+
+    uint32_t m_width, m_height;
+    ChunkEncoderFactory m_factory;
+    GopParallelConfig m_config;
+
+    // Capture thread only
+    uint32_t m_framesInChunk = 0;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    FrameArena m_arena;
+    std::vector<std::unique_ptr<Frame>> m_framePool;
+    std::vector<Frame*> m_freeFrames;
+    std::deque<std::unique_ptr<Chunk>> m_chunks; // in stream order, front = next to write
+    uint64_t m_nextChunk = 0;
+    bool m_writing = false;
+    bool m_stop = false;
+    bool m_failed = false;
+    std::ofstream m_file;
+    uint64_t m_bytes = 0;
+    GopParallelStats m_stats;
+
+    std::vector<std::unique_ptr<IChunkEncoder>> m_encoders;
+    std::vector<std::thread> m_threads;
+};
+
+// Deterministic stand-in for a real encoder: emits Annex-B framed fake NAL units whose
+// size and encode time depend on frame content (a keyframe costs more, like an IDR).
+// Used to check ordering and scheduling without Media Foundation.
+class StubChunkEncoder : public IChunkEncoder
+{
+public:
+    // workPerByte scales the busy loop that simulates encode cost
+    explicit StubChunkEncoder(uint32_t width, uint32_t height, uint32_t workPerByte = 1)
+        : m_width(width), m_height(height), m_workPerByte(workPerByte) {}
+
+    bool Begin(uint64_t chunkIndex) override;
+    bool EncodeFrame(const uint8_t* bgra, int64_t timestampHns) override;
+    bool End(std::vector<uint8_t>& bitstream) override;
+
+private:
+    uint32_t m_width, m_height, m_workPerByte;
+    uint64_t m_chunkIndex = 0;
+    uint32_t m_frameInChunk = 0;
+    std::vector<uint8_t> m_bitstream;
+};
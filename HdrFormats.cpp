@@ -0,0 +1,422 @@
+#include "HdrFormats.h"
+
+#include "WearMap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#include <immintrin.h>
+#define HDR_X86 1
+#define HDR_TARGET_F16C
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HDR_X86 1
+#define HDR_TARGET_F16C __attribute__((target("avx,f16c")))
+#else
+#define HDR_X86 0
+#endif
+
+size_t BytesPerPixel(CapturePixelFormat format)
+{
+    return format == CapturePixelFormat::Rgba16F ? 8 : 4;
+}
+
+const char* CapturePixelFormatName(CapturePixelFormat format)
+{
+    switch (format)
+    {
+    case CapturePixelFormat::Bgra8:   return "bgra8";
+    case CapturePixelFormat::Rgb10A2: return "hdr10";
+    case CapturePixelFormat::Rgba16F: return "scrgb";
+    }
+    return "unknown";
+}
+
+float HalfToFloat(uint16_t half)
+{
+    const uint32_t sign = uint32_t(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1F;
+    const uint32_t mantissa = half & 0x3FF;
+    uint32_t bits;
+    if (exponent == 0)
+    {
+        // Zero or subnormal: mantissa * 2^-24
+        float value = std::ldexp(float(mantissa), -24);
+        return sign ? -value : value;
+    }
+    if (exponent == 31)
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    else
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = uint16_t((bits >> 16) & 0x8000);
+    const uint32_t magnitude = bits & 0x7FFFFFFF;
+
+    if (magnitude > 0x7F800000)
+        return uint16_t(sign | 0x7E00); // NaN
+    if (magnitude >= 0x477FF000)
+        return uint16_t(sign | 0x7C00); // rounds past 65504: infinity
+    if (magnitude < 0x38800000)
+    {
+        // Subnormal half: round value * 2^24 to the nearest integer, ties to even
+        float absolute;
+        std::memcpy(&absolute, &magnitude, sizeof(absolute));
+        return uint16_t(sign | uint16_t(std::nearbyint(absolute * 16777216.0f)));
+    }
+    // Round the mantissa to 10 bits, ties to even, and rebias the exponent 127 -> 15
+    const uint32_t rounded = magnitude + 0xFFF + ((magnitude >> 13) & 1);
+    return uint16_t(sign | uint16_t((rounded - 0x38000000) >> 13));
+}
+
+static const double PQ_M1 = 2610.0 / 16384.0;
+static const double PQ_M2 = 2523.0 / 4096.0 * 128.0;
+static const double PQ_C1 = 3424.0 / 4096.0;
+static const double PQ_C2 = 2413.0 / 4096.0 * 32.0;
+static const double PQ_C3 = 2392.0 / 4096.0 * 32.0;
+
+double PqToNits(double signal)
+{
+    const double e = std::pow(std::clamp(signal, 0.0, 1.0), 1.0 / PQ_M2);
+    return 10000.0 * std::pow((std::max)(e - PQ_C1, 0.0) / (PQ_C2 - PQ_C3 * e), 1.0 / PQ_M1);
+}
+
+double NitsToPq(double nits)
+{
+    const double y = std::pow(std::clamp(nits / 10000.0, 0.0, 1.0), PQ_M1);
+    return std::pow((PQ_C1 + PQ_C2 * y) / (1.0 + PQ_C3 * y), PQ_M2);
+}
+
+HdrDecoder::HdrDecoder(float sdrWhiteNits)
+    : m_sdrWhiteNits(sdrWhiteNits > 0.0f ? sdrWhiteNits : 203.0f)
+{
+    m_pqLevels.resize(1024);
+    m_pqNits.resize(1024);
+    for (uint32_t code = 0; code < 1024; ++code)
+    {
+        const double nits = PqToNits(code / 1023.0);
+        m_pqNits[code] = float(nits);
+        m_pqLevels[code] = LevelFromNits(nits);
+    }
+
+    m_sdrNits.resize(256);
+    for (uint32_t value = 0; value < 256; ++value)
+        m_sdrNits[value] = NitsFromLevel(uint16_t(value << 2));
+
+    m_halfLevels.resize(65536);
+    for (uint32_t bits = 0; bits < 65536; ++bits)
+    {
+        const float value = HalfToFloat(uint16_t(bits));
+        m_halfLevels[bits] = value > 0.0f ? LevelFromNits(double(value) * SCRGB_NITS) : 0; // also NaN
+    }
+}
+
+uint16_t HdrDecoder::LevelFromNits(double nits) const
+{
+    if (!(nits > 0.0))
+        return 0;
+    const double code = WearMap::LEVEL_CODE_WHITE * std::pow(nits / m_sdrWhiteNits, 1.0 / 2.2);
+    return uint16_t((std::min)(std::lround(code), long(WearMap::LEVEL_CODES - 1)));
+}
+
+float HdrDecoder::NitsFromLevel(uint16_t level) const
+{
+    return float(m_sdrWhiteNits * std::pow(level / double(WearMap::LEVEL_CODE_WHITE), 2.2));
+}
+
+// ---- Per-format pixel access ----
+
+template <CapturePixelFormat F>
+struct PixelCodes;
+
+template <>
+struct PixelCodes<CapturePixelFormat::Bgra8>
+{
+    static constexpr size_t BYTES = 4;
+    // Level codes of B, G, R
+    static void Levels(const HdrDecoder&, const uint8_t* px, uint16_t out[3])
+    {
+        out[0] = uint16_t(px[0] << 2);
+        out[1] = uint16_t(px[1] << 2);
+        out[2] = uint16_t(px[2] << 2);
+    }
+};
+
+template <>
+struct PixelCodes<CapturePixelFormat::Rgb10A2>
+{
+    static constexpr size_t BYTES = 4;
+    static void Levels(const HdrDecoder& decoder, const uint8_t* px, uint16_t out[3])
+    {
+        uint32_t packed;
+        std::memcpy(&packed, px, sizeof(packed));
+        out[0] = decoder.PqLevel(packed >> 20);
+        out[1] = decoder.PqLevel(packed >> 10);
+        out[2] = decoder.PqLevel(packed);
+    }
+};
+
+template <>
+struct PixelCodes<CapturePixelFormat::Rgba16F>
+{
+    static constexpr size_t BYTES = 8;
+    static void Levels(const HdrDecoder& decoder, const uint8_t* px, uint16_t out[3])
+    {
+        uint16_t half[3];
+        std::memcpy(half, px, sizeof(half));
+        out[0] = decoder.HalfLevel(half[2]);
+        out[1] = decoder.HalfLevel(half[1]);
+        out[2] = decoder.HalfLevel(half[0]);
+    }
+};
+
+static inline uint8_t SdrValue(uint16_t level)
+{
+    return uint8_t((std::min)(level, uint16_t(WearMap::LEVEL_CODE_WHITE)) >> 2);
+}
+
+template <CapturePixelFormat F, bool WithLevels>
+static void DecodeRow(const HdrDecoder& decoder, const uint8_t* src, uint32_t width, uint16_t* levels, uint8_t* bgra)
+{
+    if (F == CapturePixelFormat::Bgra8 && !WithLevels)
+    {
+        std::memcpy(bgra, src, size_t(width) * 4);
+        return;
+    }
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        uint16_t codes[3];
+        PixelCodes<F>::Levels(decoder, src + x * PixelCodes<F>::BYTES, codes);
+        if (WithLevels)
+        {
+            levels[x * 4 + 0] = codes[0];
+            levels[x * 4 + 1] = codes[1];
+            levels[x * 4 + 2] = codes[2];
+            levels[x * 4 + 3] = 0;
+        }
+        bgra[x * 4 + 0] = SdrValue(codes[0]);
+        bgra[x * 4 + 1] = SdrValue(codes[1]);
+        bgra[x * 4 + 2] = SdrValue(codes[2]);
+        bgra[x * 4 + 3] = 0xFF;
+    }
+}
+
+template <CapturePixelFormat F, bool WithLevels>
+static void DecodeRows(const HdrDecoder& decoder, const uint8_t* src, size_t pitch, uint32_t width, uint32_t height,
+    bool bottomUp, uint16_t* levels, uint8_t* bgra)
+{
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* row = src + size_t(bottomUp ? height - 1 - y : y) * pitch;
+        DecodeRow<F, WithLevels>(decoder, row, width,
+            WithLevels ? levels + size_t(y) * width * 4 : nullptr, bgra + size_t(y) * width * 4);
+    }
+}
+
+template <CapturePixelFormat F>
+static void DecodeFrameT(const HdrDecoder& decoder, const uint8_t* src, size_t pitch, uint32_t width, uint32_t height,
+    bool bottomUp, uint16_t* levels, uint8_t* bgra)
+{
+    if (levels)
+        DecodeRows<F, true>(decoder, src, pitch, width, height, bottomUp, levels, bgra);
+    else
+        DecodeRows<F, false>(decoder, src, pitch, width, height, bottomUp, nullptr, bgra);
+}
+
+void DecodeFrame(CapturePixelFormat format, const HdrDecoder& decoder, const uint8_t* src, size_t pitch,
+    uint32_t width, uint32_t height, bool bottomUp, uint16_t* levels, uint8_t* bgra)
+{
+    switch (format)
+    {
+    case CapturePixelFormat::Bgra8:
+        DecodeFrameT<CapturePixelFormat::Bgra8>(decoder, src, pitch, width, height, bottomUp, levels, bgra);
+        break;
+    case CapturePixelFormat::Rgb10A2:
+        DecodeFrameT<CapturePixelFormat::Rgb10A2>(decoder, src, pitch, width, height, bottomUp, levels, bgra);
+        break;
+    case CapturePixelFormat::Rgba16F:
+        DecodeFrameT<CapturePixelFormat::Rgba16F>(decoder, src, pitch, width, height, bottomUp, levels, bgra);
+        break;
+    }
+}
+
+// ---- Luminance ----
+
+bool CpuHasF16c()
+{
+#if HDR_X86 && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    const bool f16c = (info[2] & (1 << 29)) != 0;
+    return osxsave && avx && f16c && (_xgetbv(0) & 6) == 6; // OS saves the YMM state
+#elif HDR_X86
+    return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+#else
+    return false;
+#endif
+}
+
+// Sum and max of one row's R, G, B in the format's own units
+struct RowLuminance
+{
+    double sum = 0.0;
+    float peak = 0.0f;
+};
+
+template <CapturePixelFormat F>
+static RowLuminance RowLuminanceScalar(const HdrDecoder& decoder, const uint8_t* row, uint32_t width);
+
+template <>
+RowLuminance RowLuminanceScalar<CapturePixelFormat::Bgra8>(const HdrDecoder& decoder, const uint8_t* row, uint32_t width)
+{
+    RowLuminance out;
+    uint8_t peak = 0;
+    for (uint32_t i = 0; i < width * 4; ++i)
+    {
+        if ((i & 3) == 3)
+            continue;
+        peak = (std::max)(peak, row[i]);
+        out.sum += decoder.SdrNits(row[i]);
+    }
+    out.peak = decoder.SdrNits(peak);
+    return out;
+}
+
+template <>
+RowLuminance RowLuminanceScalar<CapturePixelFormat::Rgb10A2>(const HdrDecoder& decoder, const uint8_t* row, uint32_t width)
+{
+    // PQ is monotonic: the largest code is the brightest subpixel
+    RowLuminance out;
+    uint32_t peak = 0;
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        uint32_t packed;
+        std::memcpy(&packed, row + x * 4, sizeof(packed));
+        for (int shift = 0; shift < 30; shift += 10)
+        {
+            const uint32_t code = (packed >> shift) & 1023;
+            peak = (std::max)(peak, code);
+            out.sum += decoder.PqNits(code);
+        }
+    }
+    out.peak = decoder.PqNits(peak);
+    return out;
+}
+
+template <>
+RowLuminance RowLuminanceScalar<CapturePixelFormat::Rgba16F>(const HdrDecoder&, const uint8_t* row, uint32_t width)
+{
+    RowLuminance out;
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        uint16_t half[3];
+        std::memcpy(half, row + x * 8, sizeof(half));
+        for (int c = 0; c < 3; ++c)
+        {
+            const float value = (std::max)(HalfToFloat(half[c]), 0.0f);
+            out.peak = (std::max)(out.peak, value);
+            out.sum += value;
+        }
+    }
+    out.peak *= HdrDecoder::SCRGB_NITS;
+    out.sum *= HdrDecoder::SCRGB_NITS;
+    return out;
+}
+
+#if HDR_X86
+// Two pixels per conversion: 8 halves -> 8 floats, alpha lanes zeroed, negatives clamped
+HDR_TARGET_F16C static RowLuminance RowLuminanceF16c(const uint8_t* row, uint32_t width)
+{
+    const __m256 rgbMask = _mm256_castsi256_ps(_mm256_setr_epi32(-1, -1, -1, 0, -1, -1, -1, 0));
+    __m256 sum = _mm256_setzero_ps();
+    __m256 peak = _mm256_setzero_ps();
+    uint32_t x = 0;
+    for (; x + 2 <= width; x += 2)
+    {
+        __m256 v = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 8)));
+        v = _mm256_and_ps(_mm256_max_ps(v, _mm256_setzero_ps()), rgbMask);
+        sum = _mm256_add_ps(sum, v);
+        peak = _mm256_max_ps(peak, v);
+    }
+
+    alignas(32) float sums[8], peaks[8];
+    _mm256_store_ps(sums, sum);
+    _mm256_store_ps(peaks, peak);
+    RowLuminance out;
+    for (int i = 0; i < 8; ++i)
+    {
+        out.sum += sums[i];
+        out.peak = (std::max)(out.peak, peaks[i]);
+    }
+    for (; x < width; ++x)
+    {
+        uint16_t half[3];
+        std::memcpy(half, row + x * 8, sizeof(half));
+        for (int c = 0; c < 3; ++c)
+        {
+            const float value = (std::max)(HalfToFloat(half[c]), 0.0f);
+            out.peak = (std::max)(out.peak, value);
+            out.sum += value;
+        }
+    }
+    out.peak *= HdrDecoder::SCRGB_NITS;
+    out.sum *= HdrDecoder::SCRGB_NITS;
+    return out;
+}
+#endif
+
+template <CapturePixelFormat F>
+static HdrLuminance MeasureLuminanceT(const HdrDecoder& decoder, const uint8_t* src, size_t pitch, uint32_t width,
+    uint32_t height, uint32_t rowStep, bool simd)
+{
+    HdrLuminance luminance;
+    double sum = 0.0;
+    uint64_t subpixels = 0;
+    for (uint32_t y = 0; y < height; y += rowStep)
+    {
+        const uint8_t* row = src + size_t(y) * pitch;
+        RowLuminance r;
+#if HDR_X86
+        if (F == CapturePixelFormat::Rgba16F && simd)
+            r = RowLuminanceF16c(row, width);
+        else
+#endif
+            r = RowLuminanceScalar<F>(decoder, row, width);
+        (void)simd;
+        sum += r.sum;
+        luminance.peakNits = (std::max)(luminance.peakNits, r.peak);
+        subpixels += uint64_t(width) * 3;
+    }
+    luminance.meanNits = subpixels ? float(sum / double(subpixels)) : 0.0f;
+    return luminance;
+}
+
+HdrLuminance MeasureLuminance(CapturePixelFormat format, const HdrDecoder& decoder, const uint8_t* src, size_t pitch,
+    uint32_t width, uint32_t height, uint32_t rowStep, bool allowSimd)
+{
+    static const bool f16c = CpuHasF16c();
+    rowStep = (std::max)(rowStep, 1u);
+    switch (format)
+    {
+    case CapturePixelFormat::Bgra8:
+        return MeasureLuminanceT<CapturePixelFormat::Bgra8>(decoder, src, pitch, width, height, rowStep, false);
+    case CapturePixelFormat::Rgb10A2:
+        return MeasureLuminanceT<CapturePixelFormat::Rgb10A2>(decoder, src, pitch, width, height, rowStep, false);
+    case CapturePixelFormat::Rgba16F:
+        return MeasureLuminanceT<CapturePixelFormat::Rgba16F>(decoder, src, pitch, width, height, rowStep,
+            allowSimd && f16c);
+    }
+    return {};
+}
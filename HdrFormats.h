@@ -0,0 +1,76 @@
+#pragma once
+
+#include "CaptureSource.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// HDR readback formats turned into what the rest of the pipeline consumes:
+//
+//  - level codes for WearMap::AccumulateLevels, the 8-bit drive scale (times 4) extended
+//    past SDR white: code = LEVEL_CODE_WHITE * (nits / sdrWhiteNits)^(1 / 2.2). Highlights
+//    above SDR white wear more instead of clipping at 255 as the tone-mapped SDR capture
+//    does.
+//  - the 8-bit BGRA view (codes clipped at SDR white) for frame differencing, the level
+//    histogram, the pointer and the recording
+//
+// Decoding is a table lookup per subpixel: a PQ channel has 1024 codes and a half float
+// 65536 bit patterns, so the PQ EOTF and the scRGB power curve are evaluated once per
+// code instead of once per pixel. Primaries are not converted: each channel is taken as
+// the drive of its subpixel.
+//
+// Kernels are templated on the format; the ones exported here dispatch at run time.
+
+size_t BytesPerPixel(CapturePixelFormat format);
+const char* CapturePixelFormatName(CapturePixelFormat format);
+
+float HalfToFloat(uint16_t half);
+uint16_t FloatToHalf(float value);
+// SMPTE ST 2084, signal in [0, 1]
+double PqToNits(double signal);
+double NitsToPq(double nits);
+
+class HdrDecoder
+{
+public:
+    static constexpr float SCRGB_NITS = 80.0f; // scRGB 1.0
+
+    // BT.2408 reference white; the OS "SDR content brightness" slider moves it
+    explicit HdrDecoder(float sdrWhiteNits = 203.0f);
+
+    float SdrWhiteNits() const { return m_sdrWhiteNits; }
+    uint16_t LevelFromNits(double nits) const;
+    float NitsFromLevel(uint16_t level) const;
+
+    uint16_t PqLevel(uint32_t code) const { return m_pqLevels[code & 1023]; }
+    float PqNits(uint32_t code) const { return m_pqNits[code & 1023]; }
+    uint16_t HalfLevel(uint16_t half) const { return m_halfLevels[half]; }
+    float SdrNits(uint8_t value) const { return m_sdrNits[value]; }
+
+private:
+    float m_sdrWhiteNits;
+    std::vector<uint16_t> m_pqLevels;   // 10-bit PQ code -> level code
+    std::vector<float> m_pqNits;        // 10-bit PQ code -> nits
+    std::vector<uint16_t> m_halfLevels; // half float bits -> level code (negative, NaN -> 0)
+    std::vector<float> m_sdrNits;       // 8-bit value -> nits
+};
+
+// Copy a mapped frame (rows pitch bytes apart; bottomUp = write them last row first) into
+// level codes (optional, 4 per pixel BGRX) and the BGRA view. Capture sources pass false:
+// frames are top-down (ICaptureSource::AcquireFrame).
+void DecodeFrame(CapturePixelFormat format, const HdrDecoder& decoder, const uint8_t* src, size_t pitch,
+    uint32_t width, uint32_t height, bool bottomUp, uint16_t* levels, uint8_t* bgra);
+
+struct HdrLuminance
+{
+    float peakNits = 0.0f; // brightest subpixel
+    float meanNits = 0.0f; // mean over R, G and B subpixels
+};
+
+// Over every rowStep-th row. Rgba16F converts with F16C (8 halves per instruction) when
+// the CPU has it and allowSimd is set; the other formats are integer max / table sums.
+HdrLuminance MeasureLuminance(CapturePixelFormat format, const HdrDecoder& decoder, const uint8_t* src,
+    size_t pitch, uint32_t width, uint32_t height, uint32_t rowStep = 4, bool allowSimd = true);
+
+bool CpuHasF16c();
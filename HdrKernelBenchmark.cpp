@@ -0,0 +1,130 @@
+#include "BenchmarkModes.h"
+
+#include "HdrFormats.h"
+#include "WearMap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// The desktop at its SDR brightness (value v is level code 4 v) with a 1000 nit patch in
+// the middle, encoded as a top-down readback of the given format
+static std::vector<uint8_t> EncodeHdrFrame(CapturePixelFormat format, const HdrDecoder& decoder,
+    const std::vector<uint8_t>& bgra, uint32_t width, uint32_t height)
+{
+    const size_t bpp = BytesPerPixel(format);
+    std::vector<uint8_t> out(size_t(width) * height * bpp);
+    const uint32_t x0 = width * 3 / 8, x1 = width * 5 / 8, y0 = height * 3 / 8, y1 = height * 5 / 8;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            const size_t i = size_t(y) * width + x;
+            const bool highlight = x >= x0 && x < x1 && y >= y0 && y < y1;
+            double nits[3]; // R, G, B
+            for (int c = 0; c < 3; ++c)
+                nits[c] = highlight ? 1000.0 : decoder.NitsFromLevel(uint16_t(bgra[i * 4 + 2 - c] << 2));
+
+            uint8_t* px = &out[i * bpp];
+            if (format == CapturePixelFormat::Rgba16F)
+            {
+                const uint16_t half[4] = { FloatToHalf(float(nits[0] / HdrDecoder::SCRGB_NITS)),
+                    FloatToHalf(float(nits[1] / HdrDecoder::SCRGB_NITS)),
+                    FloatToHalf(float(nits[2] / HdrDecoder::SCRGB_NITS)), FloatToHalf(1.0f) };
+                std::memcpy(px, half, sizeof(half));
+            }
+            else if (format == CapturePixelFormat::Rgb10A2)
+            {
+                uint32_t packed = 3u << 30;
+                for (int c = 0; c < 3; ++c)
+                    packed |= uint32_t(std::lround(NitsToPq(nits[c]) * 1023.0)) << (10 * c);
+                std::memcpy(px, &packed, sizeof(packed));
+            }
+            else
+            {
+                std::memcpy(px, &bgra[i * 4], 4);
+            }
+        }
+    }
+    return out;
+}
+
+HdrKernelBenchmark MeasureHdrKernels(SyntheticWorkload workload, uint32_t width, uint32_t height, uint32_t repetitions)
+{
+    HdrKernelBenchmark bench;
+    bench.width = width;
+    bench.height = height;
+    bench.f16c = CpuHasF16c();
+
+    const SyntheticDesktop desktop(workload, width, height);
+    std::vector<uint8_t> sdr(size_t(width) * height * 4);
+    desktop.Render(0, sdr.data());
+
+    const HdrDecoder decoder;
+    std::vector<uint16_t> levels(size_t(width) * height * 4);
+    std::vector<uint8_t> bgra(size_t(width) * height * 4);
+    const CapturePixelFormat formats[] = { CapturePixelFormat::Bgra8, CapturePixelFormat::Rgb10A2,
+        CapturePixelFormat::Rgba16F };
+    for (CapturePixelFormat format : formats)
+    {
+        const std::vector<uint8_t> src = EncodeHdrFrame(format, decoder, sdr, width, height);
+        const size_t pitch = size_t(width) * BytesPerPixel(format);
+
+        HdrKernelTiming timing;
+        timing.format = format;
+        timing.decodeNs = BestOf(repetitions, [&] {
+            DecodeFrame(format, decoder, src.data(), pitch, width, height, true, levels.data(), bgra.data());
+        });
+        HdrLuminance simd, scalar;
+        timing.luminanceNs = BestOf(repetitions, [&] {
+            simd = MeasureLuminance(format, decoder, src.data(), pitch, width, height);
+        });
+        timing.luminanceScalarNs = BestOf(repetitions, [&] {
+            scalar = MeasureLuminance(format, decoder, src.data(), pitch, width, height, 4, false);
+        });
+        timing.peakNits = simd.peakNits;
+        // F16C rounds like the table conversion; only the summation order differs
+        timing.simdMatches = simd.peakNits == scalar.peakNits &&
+            std::fabs(simd.meanNits - scalar.meanNits) <= 1e-3f * (std::max)(1.0f, scalar.meanNits);
+        bench.formats.push_back(timing);
+    }
+
+    // levels and bgra hold the last format's decode; both accumulate the same frame
+    WearMap wear;
+    wear.Reset(width, height);
+    bench.accumulateNs = BestOf(repetitions, [&] { wear.Accumulate(bgra.data(), 1.0 / 60.0); });
+    bench.accumulateLevelsNs = BestOf(repetitions, [&] { wear.AccumulateLevels(levels.data(), 1.0 / 60.0); });
+    return bench;
+}
+
+std::string FormatHdrKernelJson(const HdrKernelBenchmark& bench)
+{
+    char buf[512];
+    std::snprintf(buf, sizeof(buf), "{\"benchmark\":\"hdr_kernels\",\"width\":%u,\"height\":%u,\"f16c\":%s,"
+        "\"accumulate_ns\":%.0f,\"accumulate_levels_ns\":%.0f,\"formats\":[",
+        bench.width, bench.height, bench.f16c ? "true" : "false", bench.accumulateNs, bench.accumulateLevelsNs);
+    std::string json = buf;
+    for (size_t i = 0; i < bench.formats.size(); ++i)
+    {
+        const HdrKernelTiming& t = bench.formats[i];
+        std::snprintf(buf, sizeof(buf),
+            "%s\n  {\"format\":\"%s\",\"decode_ns\":%.0f,\"luminance_ns\":%.0f,\"luminance_scalar_ns\":%.0f,"
+            "\"peak_nits\":%.1f,\"simd_matches\":%s}",
+            i ? "," : "", CapturePixelFormatName(t.format), t.decodeNs, t.luminanceNs, t.luminanceScalarNs,
+            t.peakNits, t.simdMatches ? "true" : "false");
+        json += buf;
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+bool RunHdrKernelMode(const BenchmarkOptions& options, std::string& json)
+{
+    HdrKernelBenchmark bench = MeasureHdrKernels(options.workloads.front(), options.config.width, options.config.height);
+    bool ok = true;
+    for (const HdrKernelTiming& timing : bench.formats)
+        ok = ok && timing.simdMatches;
+    json = FormatHdrKernelJson(bench);
+    return ok;
+}
@@ -0,0 +1,103 @@
+#include "BenchmarkModes.h"
+
+#include "WearMap.h"
+#include "WorkerPool.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+// Every workload on screen for a while, 8 h down to 1 h
+static void HeatmapBenchWear(uint32_t width, uint32_t height, WearMap& wear)
+{
+    const SyntheticWorkload workloads[] = { SyntheticWorkload::StaticDesktop, SyntheticWorkload::ScrollingText,
+        SyntheticWorkload::Video, SyntheticWorkload::GameHud };
+    wear.Reset(width, height);
+    std::vector<uint8_t> frame(size_t(width) * height * 4);
+    double hours = 8.0;
+    for (SyntheticWorkload workload : workloads)
+    {
+        SyntheticDesktop(workload, width, height).Render(0, frame.data());
+        wear.Accumulate(frame.data(), hours * 3600.0);
+        hours /= 2.0;
+    }
+}
+
+// FNV-1a of the PNG the 320x180 map gives with 8 contour levels. Update it together with
+// any intended change to the colormap, contours or PNG encoder.
+static const uint64_t HEATMAP_GOLDEN_FNV1A = 0xa4f038b6b50c260bULL;
+
+HeatmapBenchmark MeasureHeatmapExport(const BenchmarkConfig& config, unsigned threads, const std::string& goldenPath)
+{
+    HeatmapBenchmark bench;
+    WearMap wear;
+    HeatmapBenchWear(config.width, config.height, wear);
+
+    WorkerPool pool(threads);
+    bench.threads = pool.Threads();
+    HeatmapOptions options;
+    HeatmapImage simd, scalar, contoured;
+    bench.renderMs = BestOf(3, [&] { RenderHeatmap(wear, options, simd, &pool); }) / 1e6;
+    options.allowSimd = false;
+    bench.renderScalarMs = BestOf(3, [&] { RenderHeatmap(wear, options, scalar, &pool); }) / 1e6;
+    bench.simdMatches = simd.rgb == scalar.rgb;
+    options.allowSimd = true;
+    options.contourLevels = 8;
+    bench.contoursMs = BestOf(3, [&] { RenderHeatmap(wear, options, contoured, &pool); }) / 1e6 - bench.renderMs;
+    bench.contourSegments = contoured.contourSegments;
+
+    std::vector<uint8_t> serial, parallel, tiff;
+    bench.pngSerialMs = BestOf(2, [&] {
+        EncodePng(contoured.rgb.data(), contoured.width, contoured.height, serial);
+    }) / 1e6;
+    bench.pngParallelMs = BestOf(3, [&] {
+        EncodePng(contoured.rgb.data(), contoured.width, contoured.height, parallel, &pool);
+    }) / 1e6;
+    bench.deterministic = serial == parallel;
+    bench.pngBytes = parallel.size();
+    bench.tiffMs = BestOf(2, [&] { EncodeWearTiff(wear, TiffSample::Float32, false, tiff); }) / 1e6;
+
+    WearMap small;
+    HeatmapBenchWear(320, 180, small);
+    HeatmapImage image;
+    std::vector<uint8_t> png;
+    RenderHeatmap(small, options, image, &pool);
+    EncodePng(image.rgb.data(), image.width, image.height, png, &pool);
+    bench.goldenHash = 1469598103934665603ULL;
+    for (uint8_t byte : png)
+        bench.goldenHash = (bench.goldenHash ^ byte) * 1099511628211ULL;
+
+    if (goldenPath.empty())
+    {
+        bench.golden = bench.goldenHash == HEATMAP_GOLDEN_FNV1A ? "match" : "mismatch";
+    }
+    else
+    {
+        std::ifstream file(goldenPath, std::ios::binary);
+        const std::vector<uint8_t> golden((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        bench.golden = !file.is_open() ? "missing" : golden == parallel ? "match" : "mismatch";
+    }
+    return bench;
+}
+
+std::string FormatHeatmapJson(const HeatmapBenchmark& bench)
+{
+    char buf[512];
+    std::snprintf(buf, sizeof(buf),
+        "{\"benchmark\":\"heatmap_export\",\"threads\":%u,\"render_ms\":%.3f,\"render_scalar_ms\":%.3f,"
+        "\"contours_ms\":%.3f,\"contour_segments\":%llu,\"png_serial_ms\":%.3f,\"png_parallel_ms\":%.3f,"
+        "\"tiff_ms\":%.3f,\"png_bytes\":%llu,\"simd_matches\":%s,\"deterministic\":%s,"
+        "\"golden_hash\":\"%016llx\",\"golden\":\"%s\"}\n",
+        bench.threads, bench.renderMs, bench.renderScalarMs, bench.contoursMs,
+        (unsigned long long)bench.contourSegments, bench.pngSerialMs, bench.pngParallelMs, bench.tiffMs,
+        (unsigned long long)bench.pngBytes, bench.simdMatches ? "true" : "false",
+        bench.deterministic ? "true" : "false", (unsigned long long)bench.goldenHash, bench.golden.c_str());
+    return buf;
+}
+
+bool RunHeatmapMode(const BenchmarkOptions& options, std::string& json)
+{
+    HeatmapBenchmark bench = MeasureHeatmapExport(options.config, options.maxThreads, options.goldenPath);
+    json = FormatHeatmapJson(bench);
+    return bench.simdMatches && bench.deterministic && bench.golden == "match";
+}
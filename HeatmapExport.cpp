@@ -0,0 +1,827 @@
+#include "HeatmapExport.h"
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define HEATMAP_SSE 1
+#else
+#define HEATMAP_SSE 0
+#endif
+
+static void ForEach(WorkerPool* pool, size_t count, const std::function<void(size_t)>& fn)
+{
+    if (pool)
+    {
+        pool->ParallelFor(count, fn);
+        return;
+    }
+    for (size_t i = 0; i < count; ++i)
+        fn(i);
+}
+
+// ---- Colouring ----
+
+// Largest R + G + B (SUM) or single plane value of a row
+template <bool SUM>
+static double MaxRow(const double* p0, const double* p1, const double* p2, uint32_t width, bool allowSimd)
+{
+    double best = 0.0;
+    uint32_t x = 0;
+#if HEATMAP_SSE
+    if (allowSimd)
+    {
+        __m128d m = _mm_setzero_pd();
+        for (; x + 2 <= width; x += 2)
+        {
+            __m128d v = _mm_loadu_pd(p0 + x);
+            if (SUM)
+                v = _mm_add_pd(_mm_add_pd(v, _mm_loadu_pd(p1 + x)), _mm_loadu_pd(p2 + x));
+            m = _mm_max_pd(m, v);
+        }
+        alignas(16) double lanes[2];
+        _mm_store_pd(lanes, m);
+        best = (std::max)(lanes[0], lanes[1]);
+    }
+#endif
+    (void)allowSimd;
+    for (; x < width; ++x)
+        best = (std::max)(best, SUM ? (p0[x] + p1[x]) + p2[x] : p0[x]);
+    return best;
+}
+
+// Colour index min(value * scale + 0.5, 255), truncated; the SSE2 path rounds the same way
+template <bool SUM>
+static void IndexRow(const double* p0, const double* p1, const double* p2, uint32_t width, double scale,
+    bool allowSimd, uint8_t* out)
+{
+    uint32_t x = 0;
+#if HEATMAP_SSE
+    if (allowSimd)
+    {
+        const __m128d s = _mm_set1_pd(scale), half = _mm_set1_pd(0.5), top = _mm_set1_pd(255.0);
+        for (; x + 4 <= width; x += 4)
+        {
+            __m128d a = _mm_loadu_pd(p0 + x), b = _mm_loadu_pd(p0 + x + 2);
+            if (SUM)
+            {
+                a = _mm_add_pd(_mm_add_pd(a, _mm_loadu_pd(p1 + x)), _mm_loadu_pd(p2 + x));
+                b = _mm_add_pd(_mm_add_pd(b, _mm_loadu_pd(p1 + x + 2)), _mm_loadu_pd(p2 + x + 2));
+            }
+            a = _mm_min_pd(_mm_add_pd(_mm_mul_pd(a, s), half), top);
+            b = _mm_min_pd(_mm_add_pd(_mm_mul_pd(b, s), half), top);
+            const __m128i i = _mm_unpacklo_epi64(_mm_cvttpd_epi32(a), _mm_cvttpd_epi32(b));
+            const __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(i, i), _mm_setzero_si128());
+            const int packed = _mm_cvtsi128_si32(bytes);
+            std::memcpy(out + x, &packed, 4);
+        }
+    }
+#endif
+    (void)allowSimd;
+    for (; x < width; ++x)
+    {
+        const double v = SUM ? (p0[x] + p1[x]) + p2[x] : p0[x];
+        out[x] = uint8_t(int32_t((std::min)(v * scale + 0.5, 255.0)));
+    }
+}
+
+// ---- Contours ----
+
+void TraceContours(const float* field, uint32_t width, uint32_t height, const std::vector<float>& levels,
+    std::vector<ContourSegment>& out)
+{
+    enum { TOP, RIGHT, BOTTOM, LEFT };
+    // Edge pairs per case (corners top-left = 8, top-right = 4, bottom-right = 2,
+    // bottom-left = 1 when at or above the level); 5 and 10 are the saddles
+    static const int8_t EDGES[16][2] = {
+        { -1, -1 }, { LEFT, BOTTOM }, { BOTTOM, RIGHT }, { LEFT, RIGHT }, { TOP, RIGHT }, { -1, -1 },
+        { TOP, BOTTOM }, { LEFT, TOP }, { LEFT, TOP }, { TOP, BOTTOM }, { -1, -1 }, { TOP, RIGHT },
+        { LEFT, RIGHT }, { BOTTOM, RIGHT }, { LEFT, BOTTOM }, { -1, -1 } };
+
+    if (width < 2 || height < 2)
+        return;
+    for (uint32_t level = 0; level < levels.size(); ++level)
+    {
+        const float l = levels[level];
+        for (uint32_t y = 0; y + 1 < height; ++y)
+        {
+            const float* row = field + size_t(y) * width;
+            const float* next = row + width;
+            for (uint32_t x = 0; x + 1 < width; ++x)
+            {
+                const float a = row[x], b = row[x + 1], c = next[x + 1], d = next[x];
+                const int index = (a >= l ? 8 : 0) | (b >= l ? 4 : 0) | (c >= l ? 2 : 0) | (d >= l ? 1 : 0);
+                if (index == 0 || index == 15)
+                    continue;
+
+                auto point = [&](int edge, float& px, float& py) {
+                    auto t = [l](float v0, float v1) { return (l - v0) / (v1 - v0); };
+                    switch (edge)
+                    {
+                    case TOP:    px = x + t(a, b); py = float(y); break;
+                    case RIGHT:  px = float(x + 1); py = y + t(b, c); break;
+                    case BOTTOM: px = x + t(d, c); py = float(y + 1); break;
+                    default:     px = float(x); py = y + t(a, d); break;
+                    }
+                };
+                auto emit = [&](int e0, int e1) {
+                    ContourSegment segment;
+                    point(e0, segment.x0, segment.y0);
+                    point(e1, segment.x1, segment.y1);
+                    segment.level = level;
+                    out.push_back(segment);
+                };
+
+                if (index == 5 || index == 10)
+                {
+                    // The high corners are joined through the middle when the mean is high
+                    const bool centerHigh = (a + b + c + d) * 0.25f >= l;
+                    if ((index == 5) == centerHigh)
+                    {
+                        emit(LEFT, TOP);
+                        emit(RIGHT, BOTTOM);
+                    }
+                    else
+                    {
+                        emit(TOP, RIGHT);
+                        emit(LEFT, BOTTOM);
+                    }
+                    continue;
+                }
+                emit(EDGES[index][0], EDGES[index][1]);
+            }
+        }
+    }
+}
+
+static void DrawSegment(HeatmapImage& image, float x0, float y0, float x1, float y1, const uint8_t rgb[3])
+{
+    const float dx = x1 - x0, dy = y1 - y0;
+    const int steps = (std::max)(1, int(std::ceil((std::max)(std::fabs(dx), std::fabs(dy)))));
+    for (int i = 0; i <= steps; ++i)
+    {
+        const float t = float(i) / float(steps);
+        const int x = int(x0 + dx * t), y = int(y0 + dy * t);
+        if (x < 0 || y < 0 || uint32_t(x) >= image.width || uint32_t(y) >= image.height)
+            continue;
+        uint8_t* px = image.rgb.data() + (size_t(y) * image.width + size_t(x)) * 3;
+        px[0] = rgb[0];
+        px[1] = rgb[1];
+        px[2] = rgb[2];
+    }
+}
+
+bool RenderHeatmap(const WearMap& wear, const HeatmapOptions& options, HeatmapImage& out, WorkerPool* pool)
+{
+    const uint32_t width = wear.Width(), height = wear.Height();
+    if (!width || !height || options.channel > 2)
+        return false;
+
+    const bool sum = options.channel < 0;
+    const double* p0 = wear.Plane(sum ? 0 : options.channel);
+    const double* p1 = wear.Plane(1);
+    const double* p2 = wear.Plane(2);
+    const size_t bands = (height + PNG_BAND - 1) / PNG_BAND;
+    // Rows of the image band, and the map row each comes from
+    auto source = [&](uint32_t y) { return size_t(options.flipRows ? height - 1 - y : y) * width; };
+
+    double maxUnits = options.maxSeconds / WearMap::UnitSeconds();
+    if (options.maxSeconds <= 0.0)
+    {
+        std::vector<double> bandMax(bands, 0.0);
+        ForEach(pool, bands, [&](size_t band) {
+            double best = 0.0;
+            for (uint32_t y = uint32_t(band) * PNG_BAND; y < (std::min)(uint32_t(band + 1) * PNG_BAND, height); ++y)
+            {
+                const size_t i = size_t(y) * width;
+                best = (std::max)(best, sum ? MaxRow<true>(p0 + i, p1 + i, p2 + i, width, options.allowSimd)
+                                            : MaxRow<false>(p0 + i, p1 + i, p2 + i, width, options.allowSimd));
+            }
+            bandMax[band] = best;
+        });
+        maxUnits = *std::max_element(bandMax.begin(), bandMax.end());
+    }
+
+    uint8_t lut[256][3];
+    BuildColormapLut(options.colormap, lut);
+    const double scale = maxUnits > 0.0 ? 255.0 / maxUnits : 0.0;
+    out.width = width;
+    out.height = height;
+    out.maxSeconds = maxUnits * WearMap::UnitSeconds();
+    out.contourSegments = 0;
+    out.rgb.resize(size_t(width) * height * 3);
+    ForEach(pool, bands, [&](size_t band) {
+        std::vector<uint8_t> index(width);
+        for (uint32_t y = uint32_t(band) * PNG_BAND; y < (std::min)(uint32_t(band + 1) * PNG_BAND, height); ++y)
+        {
+            const size_t i = source(y);
+            if (sum)
+                IndexRow<true>(p0 + i, p1 + i, p2 + i, width, scale, options.allowSimd, index.data());
+            else
+                IndexRow<false>(p0 + i, p1 + i, p2 + i, width, scale, options.allowSimd, index.data());
+            uint8_t* dst = out.rgb.data() + size_t(y) * width * 3;
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                dst[x * 3 + 0] = lut[index[x]][0];
+                dst[x * 3 + 1] = lut[index[x]][1];
+                dst[x * 3 + 2] = lut[index[x]][2];
+            }
+        }
+    });
+
+    if (!options.contourLevels || maxUnits <= 0.0)
+        return true;
+
+    // Block means in seconds, in image rows
+    const uint32_t step = (std::max)(options.contourStep, 1u);
+    const uint32_t gridWidth = (width + step - 1) / step, gridHeight = (height + step - 1) / step;
+    std::vector<float> grid(size_t(gridWidth) * gridHeight);
+    ForEach(pool, gridHeight, [&](size_t gy) {
+        const uint32_t y0 = uint32_t(gy) * step, y1 = (std::min)(y0 + step, height);
+        std::vector<double> sums(gridWidth, 0.0);
+        for (uint32_t y = y0; y < y1; ++y)
+        {
+            const size_t i = source(y);
+            for (uint32_t x = 0; x < width; ++x)
+                sums[x / step] += sum ? (p0[i + x] + p1[i + x]) + p2[i + x] : p0[i + x];
+        }
+        for (uint32_t gx = 0; gx < gridWidth; ++gx)
+        {
+            const uint32_t columns = (std::min)(step, width - gx * step);
+            grid[gy * gridWidth + gx] = float(sums[gx] * WearMap::UnitSeconds() / (double(columns) * (y1 - y0)));
+        }
+    });
+
+    std::vector<float> levels(options.contourLevels);
+    for (uint32_t k = 0; k < options.contourLevels; ++k)
+        levels[k] = float(out.maxSeconds * (k + 1) / (options.contourLevels + 1));
+    std::vector<ContourSegment> segments;
+    TraceContours(grid.data(), gridWidth, gridHeight, levels, segments);
+
+    // Grid point g is the centre of block g
+    const float half = 0.5f * float(step);
+    for (const ContourSegment& s : segments)
+        DrawSegment(out, s.x0 * step + half, s.y0 * step + half, s.x1 * step + half, s.y1 * step + half,
+            options.contourRgb);
+    out.contourSegments = segments.size();
+    return true;
+}
+
+// ---- Deflate (fixed Huffman codes) ----
+
+namespace
+{
+// LSB-first bit packing into a buffer reserved up front, flushed 32 bits at a time
+struct BitWriter
+{
+    std::vector<uint8_t>& out;
+    uint64_t bits = 0;
+    int count = 0;
+
+    explicit BitWriter(std::vector<uint8_t>& o) : out(o) {}
+
+    void Put(uint32_t value, int n)
+    {
+        bits |= uint64_t(value) << count;
+        count += n;
+        if (count >= 32)
+        {
+            const uint8_t bytes[4] = { uint8_t(bits), uint8_t(bits >> 8), uint8_t(bits >> 16), uint8_t(bits >> 24) };
+            out.insert(out.end(), bytes, bytes + 4);
+            bits >>= 32;
+            count -= 32;
+        }
+    }
+    void Align()
+    {
+        while (count > 0)
+        {
+            out.push_back(uint8_t(bits));
+            bits >>= 8;
+            count -= 8;
+        }
+        bits = 0;
+        count = 0;
+    }
+};
+
+struct FixedCodes
+{
+    uint16_t literal[288];       // bit-reversed, ready to Put
+    uint8_t literalBits[288];
+    uint16_t lengthSymbol[259];  // by match length 3..258
+    uint8_t distanceCode[512];   // zlib's trick: d - 1 < 256 direct, else 256 + ((d - 1) >> 7)
+};
+}
+
+static const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51,
+    59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4,
+    5, 5, 5, 5, 0 };
+static const uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+    513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10,
+    10, 11, 11, 12, 12, 13, 13 };
+
+static uint32_t ReverseBits(uint32_t code, int bits)
+{
+    uint32_t reversed = 0;
+    for (int i = 0; i < bits; ++i)
+        reversed |= ((code >> i) & 1u) << (bits - 1 - i);
+    return reversed;
+}
+
+static const FixedCodes& Codes()
+{
+    static const FixedCodes codes = [] {
+        FixedCodes c;
+        for (uint32_t v = 0; v < 288; ++v)
+        {
+            uint32_t code, bits;
+            if (v < 144)      { code = 0x30 + v;         bits = 8; }
+            else if (v < 256) { code = 0x190 + v - 144;  bits = 9; }
+            else if (v < 280) { code = v - 256;          bits = 7; }
+            else              { code = 0xC0 + v - 280;   bits = 8; }
+            c.literal[v] = uint16_t(ReverseBits(code, int(bits)));
+            c.literalBits[v] = uint8_t(bits);
+        }
+        for (uint32_t symbol = 0; symbol < 29; ++symbol)
+        {
+            const uint32_t end = symbol == 28 ? 259 : LENGTH_BASE[symbol + 1];
+            for (uint32_t length = LENGTH_BASE[symbol]; length < end; ++length)
+                c.lengthSymbol[length] = uint16_t(symbol);
+        }
+        for (uint32_t code = 0; code < 30; ++code)
+        {
+            const uint32_t end = code == 29 ? 32769 : DISTANCE_BASE[code + 1];
+            for (uint32_t d = DISTANCE_BASE[code]; d < end; ++d)
+                c.distanceCode[d - 1 < 256 ? d - 1 : 256 + ((d - 1) >> 7)] = uint8_t(code);
+        }
+        return c;
+    }();
+    return codes;
+}
+
+// One deflate block of in (fixed codes, greedy LZ77 over a 32 KB window with short hash
+// chains), byte-aligned at the end: the final block is padded, any other is followed by
+// an empty stored block so the next band can start on a byte
+static void DeflateBand(const uint8_t* in, size_t size, bool final, std::vector<uint8_t>& out)
+{
+    constexpr int HASH_BITS = 15;
+    // Short chains, and only the start of long matches hashed, like zlib's fast levels
+    constexpr size_t WINDOW = 32768, MAX_MATCH = 258, MAX_CHAIN = 8, GOOD_MATCH = 32, MAX_INSERT = 16;
+    const FixedCodes& codes = Codes();
+    std::vector<int32_t> head(size_t(1) << HASH_BITS, -1);
+    std::unique_ptr<int32_t[]> previous(new int32_t[size]); // read only where written
+    auto hash = [&](size_t i) {
+        const uint32_t v = uint32_t(in[i]) | uint32_t(in[i + 1]) << 8 | uint32_t(in[i + 2]) << 16;
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    };
+    auto insert = [&](size_t i) {
+        if (i + 3 > size)
+            return;
+        const uint32_t h = hash(i);
+        previous[i] = head[h];
+        head[h] = int32_t(i);
+    };
+
+    // Fixed codes spend at most 9 bits on a literal
+    out.reserve(out.size() + size + size / 8 + 16);
+    BitWriter writer(out);
+    writer.Put(final ? 1 : 0, 1);
+    writer.Put(1, 2);
+    auto literal = [&](uint32_t v) { writer.Put(codes.literal[v], codes.literalBits[v]); };
+
+    size_t i = 0;
+    while (i < size)
+    {
+        size_t bestLength = 0, bestDistance = 0;
+        if (i + 3 <= size)
+        {
+            const size_t limit = (std::min)(MAX_MATCH, size - i);
+            int32_t candidate = head[hash(i)];
+            for (size_t chain = 0; chain < MAX_CHAIN && candidate >= 0 && i - size_t(candidate) <= WINDOW; ++chain)
+            {
+                const uint8_t* a = in + candidate;
+                const uint8_t* b = in + i;
+                if (a[bestLength < limit ? bestLength : 0] != b[bestLength < limit ? bestLength : 0])
+                {
+                    candidate = previous[candidate];
+                    continue;
+                }
+                size_t length = 0;
+                while (length + 8 <= limit)
+                {
+                    uint64_t x, y;
+                    std::memcpy(&x, a + length, 8);
+                    std::memcpy(&y, b + length, 8);
+                    if (x != y)
+                        break;
+                    length += 8;
+                }
+                while (length < limit && a[length] == b[length])
+                    ++length;
+                if (length > bestLength)
+                {
+                    bestLength = length;
+                    bestDistance = i - size_t(candidate);
+                    if (length >= GOOD_MATCH)
+                        break;
+                }
+                candidate = previous[candidate];
+            }
+        }
+
+        if (bestLength >= 3)
+        {
+            const uint32_t symbol = codes.lengthSymbol[bestLength];
+            literal(257 + symbol);
+            if (LENGTH_EXTRA[symbol])
+                writer.Put(uint32_t(bestLength - LENGTH_BASE[symbol]), LENGTH_EXTRA[symbol]);
+            const size_t d = bestDistance - 1;
+            const uint32_t code = codes.distanceCode[d < 256 ? d : 256 + (d >> 7)];
+            writer.Put(ReverseBits(code, 5), 5);
+            if (DISTANCE_EXTRA[code])
+                writer.Put(uint32_t(bestDistance - DISTANCE_BASE[code]), DISTANCE_EXTRA[code]);
+            for (size_t k = 0; k < (std::min)(bestLength, MAX_INSERT); ++k)
+                insert(i + k);
+            i += bestLength;
+        }
+        else
+        {
+            literal(in[i]);
+            insert(i);
+            ++i;
+        }
+    }
+    literal(256);
+
+    if (final)
+    {
+        writer.Align();
+        return;
+    }
+    writer.Put(0, 3); // stored, not final
+    writer.Align();
+    const uint8_t sync[4] = { 0x00, 0x00, 0xFF, 0xFF };
+    out.insert(out.end(), sync, sync + 4);
+}
+
+// ---- PNG ----
+
+static uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+{
+    static const auto table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static uint32_t Adler32(const uint8_t* data, size_t size)
+{
+    constexpr uint32_t BASE = 65521, NMAX = 5552;
+    uint32_t a = 1, b = 0;
+    while (size)
+    {
+        const size_t n = (std::min)(size, size_t(NMAX));
+        for (size_t i = 0; i < n; ++i)
+        {
+            a += data[i];
+            b += a;
+        }
+        a %= BASE;
+        b %= BASE;
+        data += n;
+        size -= n;
+    }
+    return b << 16 | a;
+}
+
+// Adler-32 of A followed by B from both checksums and B's length (zlib's adler32_combine)
+static uint32_t Adler32Combine(uint32_t adlerA, uint32_t adlerB, size_t sizeB)
+{
+    constexpr uint64_t BASE = 65521;
+    const uint64_t remainder = sizeB % BASE;
+    uint64_t sum1 = adlerA & 0xFFFF;
+    uint64_t sum2 = (remainder * sum1) % BASE;
+    sum1 += (adlerB & 0xFFFF) + BASE - 1;
+    sum2 += ((adlerA >> 16) & 0xFFFF) + ((adlerB >> 16) & 0xFFFF) + BASE - remainder;
+    sum1 %= BASE;
+    sum2 %= BASE;
+    return uint32_t(sum2 << 16 | sum1);
+}
+
+static void PutBigEndian(std::vector<uint8_t>& out, uint32_t v)
+{
+    const uint8_t bytes[4] = { uint8_t(v >> 24), uint8_t(v >> 16), uint8_t(v >> 8), uint8_t(v) };
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+static void PutChunk(std::vector<uint8_t>& out, const char type[4], const uint8_t* data, size_t size)
+{
+    PutBigEndian(out, uint32_t(size));
+    const size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    if (size)
+        out.insert(out.end(), data, data + size);
+    PutBigEndian(out, Crc32(out.data() + start, size + 4));
+}
+
+static uint8_t Paeth(int a, int b, int c)
+{
+    const int p = a + b - c;
+    const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    return uint8_t(pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+}
+
+// Sum of |signed byte|, the filter heuristic's cost
+static uint64_t FilterCost(const uint8_t* v, size_t bytes)
+{
+    uint64_t cost = 0;
+    size_t i = 0;
+#if HEATMAP_SSE
+    __m128i sums = _mm_setzero_si128();
+    for (; i + 16 <= bytes; i += 16)
+    {
+        // |v| as unsigned bytes is min(u, 256 - u)
+        const __m128i u = _mm_loadu_si128((const __m128i*)(v + i));
+        const __m128i magnitude = _mm_min_epu8(u, _mm_sub_epi8(_mm_setzero_si128(), u));
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(magnitude, _mm_setzero_si128()));
+    }
+    alignas(16) uint64_t lanes[2];
+    _mm_store_si128((__m128i*)lanes, sums);
+    cost = lanes[0] + lanes[1];
+#endif
+    for (; i < bytes; ++i)
+        cost += uint64_t(std::abs(int(int8_t(v[i]))));
+    return cost;
+}
+
+// row - Paeth(left, above, above-left) from byte `from` on; encoding has no dependency on
+// earlier outputs, so eight bytes go at a time in 16-bit lanes
+static void PaethRow(const uint8_t* row, const uint8_t* above, size_t from, size_t bytes, uint8_t* out)
+{
+    constexpr size_t BPP = 3;
+    size_t i = from;
+#if HEATMAP_SSE
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= bytes; i += 8)
+    {
+        auto load = [&](const uint8_t* p) { return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)p), zero); };
+        const __m128i a = load(row + i - BPP), b = load(above + i), c = load(above + i - BPP);
+        auto abs16 = [&](__m128i x) { return _mm_max_epi16(x, _mm_sub_epi16(zero, x)); };
+        const __m128i pa = abs16(_mm_sub_epi16(b, c));
+        const __m128i pb = abs16(_mm_sub_epi16(a, c));
+        const __m128i pc = abs16(_mm_sub_epi16(_mm_add_epi16(a, b), _mm_add_epi16(c, c)));
+        // a when pa <= pb and pa <= pc, else b when pb <= pc, else c
+        const __m128i useA = _mm_andnot_si128(_mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc)),
+            _mm_set1_epi16(-1));
+        const __m128i useB = _mm_andnot_si128(_mm_cmpgt_epi16(pb, pc), _mm_set1_epi16(-1));
+        const __m128i bc = _mm_or_si128(_mm_and_si128(useB, b), _mm_andnot_si128(useB, c));
+        const __m128i predictor = _mm_or_si128(_mm_and_si128(useA, a), _mm_andnot_si128(useA, bc));
+        const __m128i value = _mm_and_si128(_mm_sub_epi16(load(row + i), predictor), _mm_set1_epi16(0xFF));
+        _mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(value, zero));
+    }
+#endif
+    for (; i < bytes; ++i)
+        out[i] = uint8_t(row[i] - Paeth(row[i - BPP], above[i], above[i - BPP]));
+}
+
+// Filter one row (None, Sub, Up or Paeth, whichever has the smallest sum of signed
+// bytes, the usual heuristic) into out: filter byte + row
+static void FilterRow(const uint8_t* row, const uint8_t* above, size_t bytes, uint8_t* out,
+    std::vector<uint8_t>& scratch)
+{
+    constexpr size_t BPP = 3;
+    scratch.resize(bytes * 3);
+    uint8_t* sub = scratch.data();
+    uint8_t* up = sub + bytes;
+    uint8_t* paeth = up + bytes;
+    const size_t head = (std::min)(BPP, bytes);
+    for (size_t i = 0; i < head; ++i)
+        sub[i] = row[i];
+    for (size_t i = BPP; i < bytes; ++i)
+        sub[i] = uint8_t(row[i] - row[i - BPP]);
+    if (above)
+    {
+        for (size_t i = 0; i < bytes; ++i)
+            up[i] = uint8_t(row[i] - above[i]);
+        for (size_t i = 0; i < head; ++i)
+            paeth[i] = uint8_t(row[i] - above[i]); // Paeth(0, b, 0) = b
+        PaethRow(row, above, head, bytes, paeth);
+    }
+    else
+    {
+        // First row: Up is None and Paeth is Sub
+        std::memcpy(up, row, bytes);
+        std::memcpy(paeth, sub, bytes);
+    }
+
+    const uint8_t* candidates[4] = { row, sub, up, paeth };
+    static const uint8_t TYPES[4] = { 0, 1, 2, 4 };
+    uint64_t bestCost = UINT64_MAX;
+    int best = 0;
+    for (int f = 0; f < 4; ++f)
+    {
+        const uint64_t cost = FilterCost(candidates[f], bytes);
+        if (cost < bestCost)
+        {
+            bestCost = cost;
+            best = f;
+        }
+    }
+    out[0] = TYPES[best];
+    std::memcpy(out + 1, candidates[best], bytes);
+}
+
+bool EncodePng(const uint8_t* rgb, uint32_t width, uint32_t height, std::vector<uint8_t>& out, WorkerPool* pool)
+{
+    out.clear();
+    if (!rgb || !width || !height)
+        return false;
+
+    static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+    out.insert(out.end(), SIGNATURE, SIGNATURE + 8);
+    std::vector<uint8_t> header;
+    PutBigEndian(header, width);
+    PutBigEndian(header, height);
+    const uint8_t format[5] = { 8, 2, 0, 0, 0 }; // 8-bit RGB, deflate, adaptive filters, no interlace
+    header.insert(header.end(), format, format + 5);
+    PutChunk(out, "IHDR", header.data(), header.size());
+
+    // Every band becomes a complete IDAT chunk; the first carries the zlib header
+    const size_t rowBytes = size_t(width) * 3;
+    const size_t bands = (height + PNG_BAND - 1) / PNG_BAND;
+    std::vector<std::vector<uint8_t>> chunks(bands);
+    std::vector<uint32_t> adlers(bands);
+    std::vector<size_t> sizes(bands);
+    ForEach(pool, bands, [&](size_t band) {
+        const uint32_t y0 = uint32_t(band) * PNG_BAND, y1 = (std::min)(y0 + PNG_BAND, height);
+        std::vector<uint8_t> filtered((rowBytes + 1) * (y1 - y0));
+        std::vector<uint8_t> scratch;
+        for (uint32_t y = y0; y < y1; ++y)
+            FilterRow(rgb + y * rowBytes, y ? rgb + (y - 1) * rowBytes : nullptr, rowBytes,
+                filtered.data() + (y - y0) * (rowBytes + 1), scratch);
+        adlers[band] = Adler32(filtered.data(), filtered.size());
+        sizes[band] = filtered.size();
+
+        std::vector<uint8_t> data;
+        if (band == 0)
+        {
+            data.push_back(0x78); // deflate, 32 KB window
+            data.push_back(0x01); // fastest level, no dictionary
+        }
+        DeflateBand(filtered.data(), filtered.size(), band + 1 == bands, data);
+        PutChunk(chunks[band], "IDAT", data.data(), data.size());
+    });
+    uint32_t adler = adlers[0];
+    for (size_t band = 0; band < bands; ++band)
+    {
+        out.insert(out.end(), chunks[band].begin(), chunks[band].end());
+        if (band)
+            adler = Adler32Combine(adler, adlers[band], sizes[band]);
+    }
+
+    std::vector<uint8_t> trailer;
+    PutBigEndian(trailer, adler);
+    PutChunk(out, "IDAT", trailer.data(), trailer.size());
+    PutChunk(out, "IEND", nullptr, 0);
+    return true;
+}
+
+// ---- TIFF ----
+
+bool EncodeWearTiff(const WearMap& wear, TiffSample sample, bool flipRows, std::vector<uint8_t>& out)
+{
+    const uint32_t width = wear.Width(), height = wear.Height();
+    out.clear();
+    if (!width || !height)
+        return false;
+
+    const uint16_t bits = sample == TiffSample::Float32 ? 32 : 16;
+    const uint32_t rowBytes = width * 3 * (bits / 8);
+    const uint64_t imageBytes = uint64_t(rowBytes) * height;
+    if (imageBytes > 0xFFFFFFF0ull)
+        return false;
+
+    // Header, one IFD of 11 entries, the two 3-value arrays, then the pixels in one strip
+    constexpr uint32_t ENTRIES = 11, IFD = 8;
+    constexpr uint32_t BITS_OFFSET = IFD + 2 + ENTRIES * 12 + 4;
+    constexpr uint32_t FORMAT_OFFSET = BITS_OFFSET + 6;
+    constexpr uint32_t PIXELS = FORMAT_OFFSET + 8; // 4-byte aligned
+    out.resize(PIXELS + size_t(imageBytes), 0);
+    uint8_t* p = out.data();
+    auto put16 = [&](uint32_t at, uint32_t v) { p[at] = uint8_t(v); p[at + 1] = uint8_t(v >> 8); };
+    auto put32 = [&](uint32_t at, uint32_t v) { put16(at, v & 0xFFFF); put16(at + 2, v >> 16); };
+
+    p[0] = 'I';
+    p[1] = 'I';
+    put16(2, 42);
+    put32(4, IFD);
+    put16(IFD, ENTRIES);
+    uint32_t at = IFD + 2;
+    auto entry = [&](uint16_t tag, uint16_t type, uint32_t count, uint32_t value) {
+        put16(at, tag);
+        put16(at + 2, type);
+        put32(at + 4, count);
+        if (type == 3 && count == 1)
+            put16(at + 8, value);
+        else
+            put32(at + 8, value);
+        at += 12;
+    };
+    const uint16_t SHORT = 3, LONG = 4;
+    entry(256, LONG, 1, width);                                  // ImageWidth
+    entry(257, LONG, 1, height);                                 // ImageLength
+    entry(258, SHORT, 3, BITS_OFFSET);                           // BitsPerSample
+    entry(259, SHORT, 1, 1);                                     // Compression: none
+    entry(262, SHORT, 1, 2);                                     // Photometric: RGB
+    entry(273, LONG, 1, PIXELS);                                 // StripOffsets
+    entry(277, SHORT, 1, 3);                                     // SamplesPerPixel
+    entry(278, LONG, 1, height);                                 // RowsPerStrip
+    entry(279, LONG, 1, uint32_t(imageBytes));                   // StripByteCounts
+    entry(284, SHORT, 1, 1);                                     // PlanarConfiguration: chunky
+    entry(339, SHORT, 3, FORMAT_OFFSET);                         // SampleFormat
+    put32(at, 0);                                                // no next IFD
+    for (int c = 0; c < 3; ++c)
+    {
+        put16(BITS_OFFSET + c * 2, bits);
+        put16(FORMAT_OFFSET + c * 2, sample == TiffSample::Float32 ? 3 : 1);
+    }
+
+    const double* planes[3] = { wear.Plane(0), wear.Plane(1), wear.Plane(2) };
+    double maxUnits = 0.0;
+    if (sample == TiffSample::Uint16)
+        for (int c = 0; c < 3; ++c)
+            maxUnits = (std::max)(maxUnits, *std::max_element(planes[c], planes[c] + size_t(width) * height));
+    const double scale = maxUnits > 0.0 ? 65535.0 / maxUnits : 0.0;
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const size_t src = size_t(flipRows ? height - 1 - y : y) * width;
+        uint8_t* dst = p + PIXELS + size_t(y) * rowBytes;
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                const double v = planes[c][src + x];
+                if (sample == TiffSample::Float32)
+                {
+                    const float seconds = float(v * WearMap::UnitSeconds());
+                    std::memcpy(dst, &seconds, 4); // little-endian hosts only, like the rest of the formats
+                    dst += 4;
+                }
+                else
+                {
+                    const uint16_t level = uint16_t(v * scale + 0.5);
+                    dst[0] = uint8_t(level);
+                    dst[1] = uint8_t(level >> 8);
+                    dst += 2;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static bool WriteFile(const std::string& path, const std::vector<uint8_t>& data)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write((const char*)data.data(), std::streamsize(data.size()));
+    file.close();
+    return !file.fail();
+}
+
+bool ExportHeatmapPng(const WearMap& wear, const HeatmapOptions& options, const std::string& path, unsigned threads)
+{
+    WorkerPool pool(threads);
+    HeatmapImage image;
+    std::vector<uint8_t> png;
+    return RenderHeatmap(wear, options, image, &pool) && EncodePng(image.rgb.data(), image.width, image.height, png, &pool) &&
+        WriteFile(path, png);
+}
+
+bool ExportWearTiff(const WearMap& wear, TiffSample sample, bool flipRows, const std::string& path)
+{
+    std::vector<uint8_t> tiff;
+    return EncodeWearTiff(wear, sample, flipRows, tiff) && WriteFile(path, tiff);
+}
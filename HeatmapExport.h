@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Colormap.h"
+#include "WearMap.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class WorkerPool;
+
+// Wear map images without a Python round trip: a colour-mapped heatmap with optional
+// iso-contour lines as PNG (the README's contour plots), and the raw stress-seconds as a
+// 16-bit or float TIFF for tools that want the numbers.
+//
+//  - colouring: R + G + B (or one plane) scaled to 0-255 with SSE2, then the 256-entry
+//    BuildColormapLut table, row bands on a WorkerPool
+//  - contours: marching squares on contourStep x contourStep block means, drawn over the
+//    colours
+//  - PNG: every band of PNG_BAND rows is filtered and deflated on its own (fixed Huffman
+//    codes, LZ77 within the band) into its own IDAT chunk; bands end on a byte boundary
+//    with an empty stored block, so the chunks concatenate into one zlib stream. The
+//    output does not depend on the thread count, so files can be compared byte for byte.
+
+struct HeatmapOptions
+{
+    Colormap colormap = Colormap::Inferno;
+    int channel = -1;             // -1 = R + G + B, 0 / 1 / 2 = one plane
+    double maxSeconds = 0.0;      // top of the colour scale; 0 = the map's maximum
+    bool flipRows = false;        // the map is bottom-up (rows last first); capture maps are not
+    uint32_t contourLevels = 0;   // iso lines at maxSeconds * k / (contourLevels + 1)
+    uint32_t contourStep = 4;     // contour grid spacing in pixels
+    uint8_t contourRgb[3] = { 255, 255, 255 };
+    bool allowSimd = true;
+};
+
+// Top-down RGB8
+struct HeatmapImage
+{
+    uint32_t width = 0, height = 0;
+    double maxSeconds = 0.0;      // the colour scale used
+    size_t contourSegments = 0;
+    std::vector<uint8_t> rgb;
+};
+
+// One piece of an iso line, in map pixels
+struct ContourSegment
+{
+    float x0, y0, x1, y1;
+    uint32_t level;
+};
+
+// Marching squares over a width x height grid (row-major), one pass per level. Saddle
+// cells are resolved by the cell mean.
+void TraceContours(const float* field, uint32_t width, uint32_t height, const std::vector<float>& levels,
+    std::vector<ContourSegment>& out);
+
+// False for an empty map. pool = nullptr runs on the calling thread.
+bool RenderHeatmap(const WearMap& wear, const HeatmapOptions& options, HeatmapImage& out, WorkerPool* pool = nullptr);
+
+constexpr uint32_t PNG_BAND = 64;
+
+// 8-bit RGB PNG of top-down rows
+bool EncodePng(const uint8_t* rgb, uint32_t width, uint32_t height, std::vector<uint8_t>& out,
+    WorkerPool* pool = nullptr);
+
+enum class TiffSample
+{
+    Uint16,   // stress-seconds scaled so the most worn subpixel is 65535
+    Float32   // stress-seconds
+};
+
+// Uncompressed little-endian RGB TIFF of the three planes, top-down
+bool EncodeWearTiff(const WearMap& wear, TiffSample sample, bool flipRows, std::vector<uint8_t>& out);
+
+// Render + encode + write; threads = 0: hardware concurrency
+bool ExportHeatmapPng(const WearMap& wear, const HeatmapOptions& options, const std::string& path, unsigned threads = 0);
+bool ExportWearTiff(const WearMap& wear, TiffSample sample, bool flipRows, const std::string& path);
@@ -0,0 +1,158 @@
+#include "BenchmarkModes.h"
+
+#include "TileHash.h"
+#include "WearMap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+IntegralBenchmark MeasureWearIntegral(const BenchmarkConfig& config, const std::vector<SyntheticWorkload>& workloads,
+    uint32_t queries)
+{
+    IntegralBenchmark bench;
+    const uint32_t width = config.width, height = config.height;
+    const double dt = 1.0 / (config.fps > 0.0 ? config.fps : 60.0);
+    std::vector<uint8_t> frame(size_t(width) * height * 4);
+
+    // Some wear to take over: a minute of the first workload
+    WearMap wear;
+    wear.Reset(width, height);
+    const SyntheticDesktop first(workloads.front(), width, height);
+    first.Render(0, frame.data());
+    wear.Accumulate(frame.data(), 60.0);
+
+    WearIntegral integral;
+    bench.resetMs = BestOf(3, [&] { integral.Reset(wear); }) / 1e6;
+    bench.tiles = integral.TilesX() * integral.TilesY();
+
+    // The same frames with the changed tiles from their hashes, as the pipeline passes them
+    WearIntegral hinted;
+    hinted.Reset(wear);
+    TileHasher hasher;
+    hasher.Reset(width, height);
+
+    for (SyntheticWorkload workload : workloads)
+    {
+        const SyntheticDesktop desktop(workload, width, height);
+        IntegralRun run;
+        run.workload = workload;
+        double accumulateNs = 0.0, updateNs = 0.0, hintedNs = 0.0, tiles = 0.0;
+        for (uint64_t i = 0; i < config.frames; ++i)
+        {
+            desktop.Render(i, frame.data());
+            hasher.Hash(frame.data());
+            auto start = Clock::now();
+            const uint64_t ticks = wear.Accumulate(frame.data(), dt);
+            auto accumulated = Clock::now();
+            tiles += integral.Accumulate(frame.data(), ticks);
+            auto updated = Clock::now();
+            hinted.Accumulate(frame.data(), ticks, hasher.Changed().data());
+            auto hintedUpdated = Clock::now();
+            accumulateNs += std::chrono::duration<double, std::nano>(accumulated - start).count();
+            updateNs += std::chrono::duration<double, std::nano>(updated - accumulated).count();
+            hintedNs += std::chrono::duration<double, std::nano>(hintedUpdated - updated).count();
+            run.frames++;
+        }
+        if (run.frames)
+        {
+            run.tilesPerFrame = tiles / double(run.frames);
+            run.accumulateMs = accumulateNs / 1e6 / double(run.frames);
+            run.updateMs = updateNs / 1e6 / double(run.frames);
+            run.hintedUpdateMs = hintedNs / 1e6 / double(run.frames);
+        }
+        bench.runs.push_back(run);
+    }
+
+    // Rectangles of every size, from a few pixels to most of the screen
+    std::mt19937 rng(45);
+    std::vector<WearRect> rects(queries);
+    for (WearRect& rect : rects)
+    {
+        rect.width = 1 + rng() % width;
+        rect.height = 1 + rng() % height;
+        rect.x = rng() % (width - rect.width + 1);
+        rect.y = rng() % (height - rect.height + 1);
+    }
+    std::vector<WearRegion> regions(queries);
+    bench.queries = queries;
+    if (queries)
+    {
+        double sink = 0.0;
+        bench.queryNs = BestOf(3, [&] {
+            for (const WearRect& rect : rects)
+                sink += integral.Query(rect).sum;
+        }) / double(queries);
+        bench.batchNs = BestOf(3, [&] { integral.QueryBatch(rects.data(), rects.size(), regions.data()); }) /
+            double(queries);
+
+        // Scans are slow: a few hundred rectangles are enough for the latency and the check
+        const size_t scanned = (std::min)(rects.size(), size_t(200));
+        std::vector<double> sums(scanned);
+        bench.scanNs = BestOf(1, [&] {
+            for (size_t i = 0; i < scanned; ++i)
+                sums[i] = SumWearRect(wear, rects[i].x, rects[i].y, rects[i].x + rects[i].width,
+                    rects[i].y + rects[i].height);
+        }) / double(scanned);
+        const double total = (std::max)(SumWearRect(wear, 0, 0, width, height), 1e-12);
+        for (size_t i = 0; i < scanned; ++i)
+            bench.maxRelativeError = (std::max)(bench.maxRelativeError, std::fabs(regions[i].sum - sums[i]) / total);
+
+        std::vector<WearRegion> hintedRegions(queries);
+        hinted.QueryBatch(rects.data(), rects.size(), hintedRegions.data());
+        bench.hintedMatches = true;
+        for (size_t i = 0; i < rects.size(); ++i)
+            bench.hintedMatches = bench.hintedMatches && hintedRegions[i].sum == regions[i].sum;
+        if (sink < 0.0)
+            std::printf("%f", sink);
+    }
+
+    const WearTile hottest = integral.MaxTile();
+    double best = -1.0;
+    WearRect bestRect;
+    for (uint32_t y = 0; y < height; y += WearIntegral::TILE)
+        for (uint32_t x = 0; x < width; x += WearIntegral::TILE)
+        {
+            const double sum = SumWearRect(wear, x, y, x + WearIntegral::TILE, y + WearIntegral::TILE);
+            if (sum > best)
+            {
+                best = sum;
+                bestRect = { x, y, 0, 0 };
+            }
+        }
+    bench.hottestMatches = hottest.rect.x == bestRect.x && hottest.rect.y == bestRect.y &&
+        std::fabs(hottest.wear.sum - best) <= 1e-9 * best;
+    return bench;
+}
+
+std::string FormatIntegralJson(const IntegralBenchmark& bench)
+{
+    char buf[384];
+    std::snprintf(buf, sizeof(buf),
+        "{\"benchmark\":\"wear_integral\",\"tiles\":%u,\"reset_ms\":%.3f,\"queries\":%u,\"query_ns\":%.1f,"
+        "\"batch_ns\":%.1f,\"scan_ns\":%.0f,\"max_relative_error\":%.3g,\"hottest_matches\":%s,"
+        "\"hinted_matches\":%s,\"runs\":[",
+        bench.tiles, bench.resetMs, bench.queries, bench.queryNs, bench.batchNs, bench.scanNs, bench.maxRelativeError,
+        bench.hottestMatches ? "true" : "false", bench.hintedMatches ? "true" : "false");
+    std::string json = buf;
+    for (size_t i = 0; i < bench.runs.size(); ++i)
+    {
+        const IntegralRun& run = bench.runs[i];
+        std::snprintf(buf, sizeof(buf),
+            "%s\n  {\"workload\":\"%s\",\"frames\":%llu,\"tiles_per_frame\":%.1f,\"accumulate_ms\":%.3f,\"update_ms\":%.3f,"
+            "\"hinted_update_ms\":%.3f}",
+            i ? "," : "", SyntheticWorkloadName(run.workload), (unsigned long long)run.frames, run.tilesPerFrame,
+            run.accumulateMs, run.updateMs, run.hintedUpdateMs);
+        json += buf;
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+bool RunIntegralMode(const BenchmarkOptions& options, std::string& json)
+{
+    IntegralBenchmark bench = MeasureWearIntegral(options.config, options.workloads);
+    json = FormatIntegralJson(bench);
+    return bench.maxRelativeError < 1e-12 && bench.hottestMatches && bench.hintedMatches;
+}
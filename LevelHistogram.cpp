@@ -0,0 +1,339 @@
+#include "LevelHistogram.h"
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define LEVELS_SSE 1
+#else
+#define LEVELS_SSE 0
+#endif
+
+static const char HIST_MAGIC[8] = { 'O', 'L', 'H', 'I', 'S', 'T', '0', '2' };
+// uint32 counters in ticks, no unit field
+static const char HIST_MAGIC_V1[8] = { 'O', 'L', 'H', 'I', 'S', 'T', '0', '1' };
+
+// Uniform in [0, 2^32) per counter and clock: rounding ticks to units up or down with
+// the probability of the remainder keeps every counter unbiased
+static uint32_t Dither(size_t index, uint64_t clock)
+{
+    uint64_t h = (uint64_t(index) ^ (clock << 32 | clock >> 32)) * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 29;
+    return uint32_t((h * 0xBF58476D1CE4E5B9ull) >> 32);
+}
+
+void LevelHistogram::AddTicks(size_t index, uint64_t ticks) const
+{
+    uint64_t units;
+    for (;;)
+    {
+        const uint64_t mask = (uint64_t(1) << m_scale) - 1;
+        units = (ticks + (mask ? Dither(index, m_clockTicks) & mask : 0)) >> m_scale;
+        if (m_counts[index] + units <= UINT16_MAX || m_scale >= MAX_SCALE)
+            break;
+        Rescale();
+    }
+    const uint64_t sum = m_counts[index] + units;
+    m_counts[index] = sum > UINT16_MAX ? UINT16_MAX : uint16_t(sum);
+}
+
+// Doubles the unit: every counter halved, rounded like AddTicks
+void LevelHistogram::Rescale() const
+{
+    for (size_t i = 0; i < m_counts.size(); ++i)
+        m_counts[i] = uint16_t((m_counts[i] + (Dither(i, m_clockTicks) & 1)) >> 1);
+    ++m_scale;
+}
+
+bool LevelHistogram::Reset(uint32_t width, uint32_t height, uint32_t bins)
+{
+    if (bins < 2 || bins > 256 || (bins & (bins - 1)) != 0)
+        return false;
+
+    m_width = width;
+    m_height = height;
+    m_bins = bins;
+    m_shift = 0;
+    while ((256u >> m_shift) > bins)
+        ++m_shift;
+
+    m_totalTicks = 0;
+    m_tickRemainder = 0.0;
+    m_clockTicks = 0;
+    m_epochTicks = 0;
+    m_scale = 0;
+
+    const size_t subpixels = Subpixels() * 3;
+    m_counts.assign(subpixels * bins, 0);
+    m_level.assign(subpixels, 0);
+    m_since.assign(subpixels, 0);
+    return true;
+}
+
+// Close every open interval at the current clock; the subpixels stay in their bins
+void LevelHistogram::Flush() const
+{
+    const uint64_t now = m_clockTicks - m_epochTicks;
+    if (now == 0)
+        return;
+
+    const size_t subpixels = Subpixels() * 3;
+    for (size_t s = 0; s < subpixels; ++s)
+    {
+        AddTicks(s * m_bins + m_level[s], now - m_since[s]);
+        m_since[s] = 0;
+    }
+    m_epochTicks = m_clockTicks;
+}
+
+void LevelHistogram::Accumulate(const uint8_t* bgra, double dtSeconds)
+{
+    if (dtSeconds <= 0.0)
+        return;
+
+    double exactTicks = dtSeconds / TICK_SECONDS + m_tickRemainder;
+    uint64_t ticks = uint64_t(exactTicks);
+    m_tickRemainder = exactTicks - double(ticks);
+    AccumulateTicks(bgra, ticks);
+}
+
+void LevelHistogram::AccumulateTicks(const uint8_t* bgra, uint64_t ticks)
+{
+    if (ticks == 0)
+        return;
+
+    // Interval starts are stored as 32-bit offsets from the epoch
+    if (m_clockTicks - m_epochTicks > UINT32_MAX)
+        Flush();
+    const uint32_t now = uint32_t(m_clockTicks - m_epochTicks);
+
+    const size_t count = Subpixels();
+    const int shift = m_shift;
+    const uint32_t bins = m_bins;
+    uint8_t* level[3];
+    uint32_t* since[3];
+    for (int c = 0; c < 3; ++c)
+    {
+        level[c] = m_level.data() + size_t(c) * count;
+        since[c] = m_since.data() + size_t(c) * count;
+    }
+
+    // One pass over the frame. The common case is a run of pixels whose subpixels all stay
+    // in their bins: checked branch-free (vectorizable) per block, then skipped.
+    const size_t BLOCK = 32;
+    for (size_t begin = 0; begin < count; begin += BLOCK)
+    {
+        const size_t end = std::min(count, begin + BLOCK);
+        unsigned changed = 0;
+        for (size_t i = begin; i < end; ++i)
+        {
+            const uint8_t* px = bgra + i * 4;
+            changed |= unsigned(px[2] >> shift ^ level[0][i]) | unsigned(px[1] >> shift ^ level[1][i])
+                | unsigned(px[0] >> shift ^ level[2][i]);
+        }
+        if (changed == 0)
+            continue;
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            const uint8_t* px = bgra + i * 4;
+            for (int c = 0; c < 3; ++c)
+            {
+                const uint8_t bin = uint8_t(px[2 - c] >> shift);
+                if (bin == level[c][i])
+                    continue;
+                AddTicks((size_t(c) * count + i) * bins + level[c][i], now - since[c][i]);
+                level[c][i] = bin;
+                since[c][i] = now;
+            }
+        }
+    }
+
+    m_clockTicks += ticks;
+    m_totalTicks += ticks;
+}
+
+bool LevelHistogram::Merge(const LevelHistogram& other)
+{
+    if (other.m_width != m_width || other.m_height != m_height || other.m_bins != m_bins)
+        return false;
+
+    // Only closed time is merged; this histogram's open intervals carry on unchanged
+    other.Flush();
+    while (m_scale < other.m_scale)
+        Rescale();
+    for (size_t i = 0; i < m_counts.size(); ++i)
+        AddTicks(i, uint64_t(other.m_counts[i]) << other.m_scale);
+    m_totalTicks += other.m_totalTicks;
+    return true;
+}
+
+std::vector<double> LevelHistogram::BinWeights(const std::function<double(double)>& f) const
+{
+    std::vector<double> weights(m_bins, 0.0);
+    const uint32_t perBin = 1u << m_shift;
+    for (uint32_t v = 0; v < 256; ++v)
+        weights[v >> m_shift] += f(v / 255.0) / perBin;
+    return weights;
+}
+
+void LevelHistogram::Evaluate(const std::vector<double> weights[3], WearMap& out, WorkerPool* pool) const
+{
+    Flush();
+    const size_t count = Subpixels();
+    const uint32_t bins = m_bins;
+
+    // One 16-bit factor per bin: count * factor fits 32 bits and the sum 64. Scaled to
+    // WearMap units after the sum, which converts to double exactly while the session is
+    // shorter than ~99 days (< 2^53).
+    std::vector<uint32_t> factors[3];
+    for (int c = 0; c < 3; ++c)
+        for (uint32_t b = 0; b < bins; ++b)
+        {
+            double w = b < weights[c].size() ? std::clamp(weights[c][b], 0.0, 1.0) : 0.0;
+            factors[c].push_back(uint32_t(std::llround(w * WearMap::LUT_SCALE)));
+        }
+    const uint64_t unit = uint64_t(WEAR_TICKS_PER_TICK) << m_scale;
+
+    // Written into the planes out already has: a 4K map is 600 MB to allocate
+    if (out.Width() != m_width || out.Height() != m_height)
+        out.Reset(m_width, m_height, out.Exponent());
+    std::vector<double> planes[3];
+    out.SwapPlanes(planes);
+    for (int c = 0; c < 3; ++c)
+        planes[c].resize(count);
+
+    // Rows of 4096 subpixels per work item: memory bound, so coarse items are enough
+    const size_t ROWS = 4096;
+    const size_t items = (count + ROWS - 1) / ROWS * 3;
+    auto work = [&](size_t item)
+    {
+        const int c = int(item % 3);
+        const size_t begin = item / 3 * ROWS, end = std::min(count, begin + ROWS);
+        const uint16_t* counts = m_counts.data() + size_t(c) * count * bins;
+        const uint32_t* factor = factors[c].data();
+        double* dst = planes[c].data();
+#if LEVELS_SSE
+        // Eight bins per step: counts widened to 32 bits, even and odd lanes multiplied
+        // into 64-bit sums. Twice the scalar speed, close to the counter read bandwidth.
+        if (bins % 8 == 0)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            for (size_t i = begin; i < end; ++i)
+            {
+                const uint16_t* row = counts + i * bins;
+                __m128i sum = zero;
+                for (uint32_t b = 0; b < bins; b += 8)
+                {
+                    const __m128i v = _mm_loadu_si128((const __m128i*)(row + b));
+                    const __m128i lo = _mm_unpacklo_epi16(v, zero), hi = _mm_unpackhi_epi16(v, zero);
+                    const __m128i flo = _mm_loadu_si128((const __m128i*)(factor + b));
+                    const __m128i fhi = _mm_loadu_si128((const __m128i*)(factor + b + 4));
+                    sum = _mm_add_epi64(sum, _mm_mul_epu32(lo, flo));
+                    sum = _mm_add_epi64(sum, _mm_mul_epu32(_mm_srli_epi64(lo, 32), _mm_srli_epi64(flo, 32)));
+                    sum = _mm_add_epi64(sum, _mm_mul_epu32(hi, fhi));
+                    sum = _mm_add_epi64(sum, _mm_mul_epu32(_mm_srli_epi64(hi, 32), _mm_srli_epi64(fhi, 32)));
+                }
+                alignas(16) uint64_t lanes[2];
+                _mm_store_si128((__m128i*)lanes, sum);
+                dst[i] = double((lanes[0] + lanes[1]) * unit);
+            }
+            return;
+        }
+#endif
+        for (size_t i = begin; i < end; ++i)
+        {
+            const uint16_t* row = counts + i * bins;
+            uint64_t sum = 0;
+            for (uint32_t b = 0; b < bins; ++b)
+                sum += uint64_t(row[b]) * factor[b];
+            dst[i] = double(sum * unit);
+        }
+    };
+    if (pool)
+        pool->ParallelFor(items, work);
+    else
+        for (size_t item = 0; item < items; ++item)
+            work(item);
+
+    out.Assign(planes, m_totalTicks * WEAR_TICKS_PER_TICK);
+}
+
+void LevelHistogram::Evaluate(float exponent, WearMap& out, WorkerPool* pool) const
+{
+    std::vector<double> weights = BinWeights([=](double level) { return std::pow(level, double(exponent)); });
+    const std::vector<double> perChannel[3] = { weights, weights, weights };
+    if (out.Exponent() != exponent)
+        out.Reset(m_width, m_height, exponent);
+    Evaluate(perChannel, out, pool);
+}
+
+bool LevelHistogram::Save(const std::string& path) const
+{
+    Flush();
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    uint8_t header[32];
+    std::memcpy(header, HIST_MAGIC, sizeof(HIST_MAGIC));
+    const uint32_t fields[3] = { m_width, m_height, m_bins };
+    for (int f = 0; f < 3; ++f)
+        for (int i = 0; i < 4; ++i)
+            header[8 + f * 4 + i] = uint8_t(fields[f] >> (8 * i));
+    for (int i = 0; i < 8; ++i)
+        header[20 + i] = uint8_t(m_totalTicks >> (8 * i));
+    for (int i = 0; i < 4; ++i)
+        header[28 + i] = uint8_t(uint32_t(m_scale) >> (8 * i));
+
+    // Counters are written as in memory (little endian, like the raw frame archives)
+    file.write((const char*)header, sizeof(header));
+    file.write((const char*)m_counts.data(), std::streamsize(m_counts.size() * sizeof(uint16_t)));
+    file.close();
+    return !file.fail();
+}
+
+bool LevelHistogram::Load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    uint8_t header[32];
+    if (!file.read((char*)header, 28))
+        return false;
+    const bool v1 = std::memcmp(header, HIST_MAGIC_V1, sizeof(HIST_MAGIC_V1)) == 0;
+    if (!v1 && (std::memcmp(header, HIST_MAGIC, sizeof(HIST_MAGIC)) != 0 || !file.read((char*)header + 28, 4)))
+        return false;
+
+    uint32_t fields[3] = {};
+    for (int f = 0; f < 3; ++f)
+        for (int i = 0; i < 4; ++i)
+            fields[f] |= uint32_t(header[8 + f * 4 + i]) << (8 * i);
+    uint64_t ticks = 0;
+    for (int i = 0; i < 8; ++i)
+        ticks |= uint64_t(header[20 + i]) << (8 * i);
+
+    if (!Reset(fields[0], fields[1], fields[2]))
+        return false;
+    if (v1)
+    {
+        // Tick counters: added one by one, which picks the unit they need
+        std::vector<uint32_t> ticksPerBin(m_counts.size());
+        if (!file.read((char*)ticksPerBin.data(), std::streamsize(ticksPerBin.size() * sizeof(uint32_t))))
+            return false;
+        for (size_t i = 0; i < ticksPerBin.size(); ++i)
+            AddTicks(i, ticksPerBin[i]);
+    }
+    else
+    {
+        uint32_t scale = 0;
+        for (int i = 0; i < 4; ++i)
+            scale |= uint32_t(header[28 + i]) << (8 * i);
+        if (scale > uint32_t(MAX_SCALE) ||
+            !file.read((char*)m_counts.data(), std::streamsize(m_counts.size() * sizeof(uint16_t))))
+            return false;
+        m_scale = int(scale);
+    }
+    m_totalTicks = ticks;
+    return true;
+}
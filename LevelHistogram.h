@@ -0,0 +1,112 @@
+#pragma once
+
+#include "WearMap.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class WorkerPool;
+
+// Per-subpixel time spent at each quantized drive level.
+// Every damage model of the README is sum(f(level) * dt), so with the time per level kept
+// any f (exponent, per-channel curves, thresholds) becomes a dot product over the bins and
+// an old session can be re-evaluated without decoding its recording.
+//
+//  - bins split the code values 0-255 evenly (power of two, 2-256)
+//  - time is counted in TICK_SECONDS ticks, one uint16 per bin in units of 2^Scale()
+//    ticks shared by the whole histogram. A counter that would overflow halves every
+//    counter and doubles the unit, so a counter resolves 1/65536 of the longest time
+//    any subpixel spent in one bin (exact for the first ~65 s). Ticks are rounded to
+//    units up or down with the probability of the remainder: unbiased, not exact.
+//  - a subpixel's counter is only written when it changes bin: a static frame costs one
+//    byte compare per subpixel. Open intervals are closed lazily before any read.
+//
+// Memory is 2 * bins + 5 bytes per subpixel. Error against the exact WearMap, worst of
+// the SyntheticDesktop workloads at 1080p, 240 frames each at 60 fps (pipeline_bench
+// --level-histogram; max = worst subpixel with more than 5% of full-drive stress,
+// total = whole panel), max / total in % per exponent:
+//
+//   bins  bytes/pixel  1080p    4K        ^1.0        ^1.54       ^2.2
+//     8        63      131 MB   0.52 GB   50 / 5.3    36 / 3.7    19 / 2.6
+//    16       111      230 MB   0.92 GB   47 / 0.35   25 / 2.5   8.9 / 5.4
+//    32       207      429 MB   1.72 GB   22 / 0.52   12 / 0.33  8.6 / 1.4
+//    64       399      827 MB   3.31 GB  9.4 / 0.24  5.3 / 0.22  3.7 / 0.73
+//
+// The counter unit adds 0.004% (worst subpixel) over 2 hours at 256 bins.
+//
+// Bins assume the time inside a bin is spread evenly over its code values, so content
+// sitting on a few values (pure white text) is where the error is. Accumulating is a
+// byte compare per subpixel on static content and one counter update per subpixel that
+// changes bin; full-screen motion is bound by those updates. Evaluate reads every
+// counter once (SSE2) and scales with the WorkerPool up to the memory bandwidth.
+// Known miss: a 4K, 16-bin re-evaluation reads 800 MB and takes ~250 ms on one core
+// here, not milliseconds; only cores and bandwidth bring it down further.
+class LevelHistogram
+{
+public:
+    static constexpr uint32_t WEAR_TICKS_PER_TICK = 10;
+    static constexpr double TICK_SECONDS = WearMap::TICK_SECONDS * WEAR_TICKS_PER_TICK;
+
+    // False for a bin count that is not a power of two in [2, 256]
+    bool Reset(uint32_t width, uint32_t height, uint32_t bins = 16);
+
+    // Same contract as WearMap::Accumulate / AccumulateTicks (ticks of TICK_SECONDS here)
+    void Accumulate(const uint8_t* bgra, double dtSeconds);
+    void AccumulateTicks(const uint8_t* bgra, uint64_t ticks);
+
+    // Add another histogram of the same size and bin count
+    bool Merge(const LevelHistogram& other);
+
+    // Per-bin weights of a model f(level), level = code value / 255 in [0, 1]: the mean of
+    // f over the code values of each bin
+    std::vector<double> BinWeights(const std::function<double(double)>& f) const;
+
+    // Stress-time under per-bin weights (R, G, B), written as a WearMap so that
+    // LifetimeProjection, Downsample and the exports work unchanged. Weights are rounded
+    // to WearMap::LUT_SCALE steps; with 256 bins and power-law weights the result equals
+    // the live WearMap up to the coarser tick and the counter unit. out keeps its
+    // Exponent() as a label; a map of the right size is refilled without allocating.
+    void Evaluate(const std::vector<double> weights[3], WearMap& out, WorkerPool* pool = nullptr) const;
+    // Power law level^exponent on every channel
+    void Evaluate(float exponent, WearMap& out, WorkerPool* pool = nullptr) const;
+
+    // "OLHIST02" width:u32 height:u32 bins:u32 ticks:u64 scale:u32, then the uint16
+    // counters. Load also reads "OLHIST01" files (no scale, uint32 tick counters).
+    bool Save(const std::string& path) const;
+    bool Load(const std::string& path);
+
+    // Counters in units of 2^Scale() ticks for every subpixel of a channel (0 = R), bins
+    // consecutive per subpixel
+    const uint16_t* Counts(int channel) const { Flush(); return m_counts.data() + size_t(channel) * Subpixels() * m_bins; }
+    int Scale() const { Flush(); return m_scale; }
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    uint32_t Bins() const { return m_bins; }
+    double TotalSeconds() const { return double(m_totalTicks) * TICK_SECONDS; }
+    size_t MemoryBytes() const { return m_counts.size() * 2 + m_level.size() + m_since.size() * 4; }
+
+private:
+    // Units of 2^32 ticks (~50 days) per counter at most; counters then saturate
+    static constexpr int MAX_SCALE = 16;
+
+    size_t Subpixels() const { return size_t(m_width) * m_height; }
+    void Flush() const;
+    void AddTicks(size_t index, uint64_t ticks) const;
+    void Rescale() const;
+
+    uint32_t m_width = 0, m_height = 0, m_bins = 0;
+    int m_shift = 0;                  // code value >> m_shift = bin
+    uint64_t m_totalTicks = 0;
+    double m_tickRemainder = 0.0;
+
+    // Channel-major, subpixel, then bin
+    mutable std::vector<uint16_t> m_counts;
+    mutable int m_scale = 0;          // counter unit = 2^m_scale ticks
+    // The open interval of every subpixel: its bin and the clock when it entered it
+    mutable std::vector<uint8_t> m_level;
+    mutable std::vector<uint32_t> m_since; // relative to m_epochTicks
+    uint64_t m_clockTicks = 0;
+    mutable uint64_t m_epochTicks = 0;
+};
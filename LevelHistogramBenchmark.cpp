@@ -0,0 +1,162 @@
+#include "BenchmarkModes.h"
+
+#include "LevelHistogram.h"
+#include "WorkerPool.h"
+
+#include <cmath>
+#include <cstdio>
+#include <memory>
+
+// Relative errors in percent of evaluated against exact: the worst subpixel with more
+// than 5% of full-drive stress, and the panel total
+static void CompareMaps(const WearMap& evaluated, const WearMap& exact, double& maxPercent, double& totalPercent)
+{
+    const size_t count = size_t(exact.Width()) * exact.Height();
+    const double significant = 0.05 * exact.TotalSeconds() / WearMap::UnitSeconds();
+    double worst = 0.0, sumEvaluated = 0.0, sumExact = 0.0;
+    for (int c = 0; c < 3; ++c)
+    {
+        const double* a = evaluated.Plane(c);
+        const double* b = exact.Plane(c);
+        for (size_t i = 0; i < count; ++i)
+        {
+            sumEvaluated += a[i];
+            sumExact += b[i];
+            if (b[i] > significant)
+                worst = (std::max)(worst, std::fabs(a[i] - b[i]) / b[i]);
+        }
+    }
+    maxPercent = worst * 100.0;
+    totalPercent = sumExact > 0.0 ? std::fabs(sumEvaluated - sumExact) / sumExact * 100.0 : 0.0;
+}
+
+LevelHistogramBenchmark MeasureLevelHistogram(const BenchmarkConfig& config,
+    const std::vector<SyntheticWorkload>& workloads, unsigned maxThreads)
+{
+    LevelHistogramBenchmark bench;
+    const uint32_t width = config.width, height = config.height;
+    bench.width = width;
+    bench.height = height;
+    bench.frames = config.frames;
+    const double dt = 1.0 / (config.fps > 0.0 ? config.fps : 60.0);
+    const float exponents[] = { 1.0f, 1.54f, 2.2f };
+    WorkerPool pool(maxThreads);
+
+    std::vector<uint8_t> frame(size_t(width) * height * 4);
+    for (uint32_t bins : { 8u, 16u, 32u, 64u })
+    {
+        for (SyntheticWorkload workload : workloads)
+        {
+            const SyntheticDesktop desktop(workload, width, height);
+            LevelHistogram levels;
+            levels.Reset(width, height, bins);
+            WearMap exact[3];
+            for (int e = 0; e < 3; ++e)
+                exact[e].Reset(width, height, exponents[e]);
+            for (uint32_t i = 0; i < config.frames; ++i)
+            {
+                desktop.Render(i, frame.data());
+                levels.Accumulate(frame.data(), dt);
+                for (WearMap& map : exact)
+                    map.Accumulate(frame.data(), dt);
+            }
+            for (int e = 0; e < 3; ++e)
+            {
+                LevelHistogramRun run;
+                run.bins = bins;
+                run.workload = workload;
+                run.exponent = exponents[e];
+                WearMap evaluated;
+                levels.Evaluate(exponents[e], evaluated, &pool);
+                CompareMaps(evaluated, exact[e], run.maxErrorPercent, run.totalErrorPercent);
+                bench.runs.push_back(run);
+            }
+        }
+    }
+
+    // 256 bins evaluate to the WearMap up to the tick: what is left is the counter unit
+    {
+        const uint32_t longWidth = 320, longHeight = 180;
+        const double longDt = 30.0;
+        const SyntheticDesktop desktop(workloads.front(), longWidth, longHeight);
+        std::vector<uint8_t> small(size_t(longWidth) * longHeight * 4);
+        LevelHistogram levels;
+        levels.Reset(longWidth, longHeight, 256);
+        WearMap exact;
+        exact.Reset(longWidth, longHeight, 1.54f);
+        for (uint32_t i = 0; i < 240; ++i)
+        {
+            desktop.Render(i, small.data());
+            levels.Accumulate(small.data(), longDt);
+            exact.Accumulate(small.data(), longDt);
+        }
+        WearMap evaluated, reloaded;
+        levels.Evaluate(1.54f, evaluated, &pool);
+        CompareMaps(evaluated, exact, bench.longMaxErrorPercent, bench.longTotalErrorPercent);
+        bench.longSeconds = levels.TotalSeconds();
+        bench.longScale = levels.Scale();
+
+        const std::string path = "bench_levels.olh";
+        LevelHistogram loaded;
+        if (levels.Save(path) && loaded.Load(path))
+        {
+            loaded.Evaluate(1.54f, reloaded, &pool);
+            bench.reloaded = SamePlanes(evaluated, reloaded) && loaded.Scale() == levels.Scale();
+        }
+        std::remove(path.c_str());
+    }
+
+    // Re-evaluating a 4K session: one frame of each workload so that counters are spread
+    {
+        const uint32_t w4k = 3840, h4k = 2160;
+        std::vector<uint8_t> big(size_t(w4k) * h4k * 4);
+        auto levels = std::make_unique<LevelHistogram>();
+        levels->Reset(w4k, h4k, 16);
+        for (SyntheticWorkload workload : workloads)
+        {
+            SyntheticDesktop(workload, w4k, h4k).Render(3, big.data());
+            levels->Accumulate(big.data(), 1.0);
+        }
+        big = std::vector<uint8_t>();
+        WearMap out;
+        bench.evaluateThreads = pool.Threads();
+        bench.evaluate4kMs = BestOf(3, [&] { levels->Evaluate(1.54f, out, &pool); }) / 1e6;
+        const double counterBytes = double(w4k) * h4k * 3 * 16 * 2;
+        bench.evaluate4kGBps = bench.evaluate4kMs > 0.0 ? counterBytes / 1e6 / bench.evaluate4kMs : 0.0;
+    }
+    return bench;
+}
+
+std::string FormatLevelHistogramJson(const LevelHistogramBenchmark& bench)
+{
+    char buf[512];
+    std::snprintf(buf, sizeof(buf),
+        "{\"benchmark\":\"level_histogram\",\"width\":%u,\"height\":%u,\"frames\":%llu,"
+        "\"long_seconds\":%.0f,\"long_scale\":%d,\"long_max_error_percent\":%.3f,\"long_total_error_percent\":%.4f,"
+        "\"reloaded\":%s,\"evaluate_threads\":%u,\"evaluate_4k_ms\":%.1f,\"evaluate_4k_gb_s\":%.2f,\"runs\":[",
+        bench.width, bench.height, (unsigned long long)bench.frames, bench.longSeconds, bench.longScale,
+        bench.longMaxErrorPercent, bench.longTotalErrorPercent, bench.reloaded ? "true" : "false",
+        bench.evaluateThreads, bench.evaluate4kMs, bench.evaluate4kGBps);
+    std::string json = buf;
+    for (size_t i = 0; i < bench.runs.size(); ++i)
+    {
+        const LevelHistogramRun& run = bench.runs[i];
+        std::snprintf(buf, sizeof(buf),
+            "%s\n  {\"bins\":%u,\"workload\":\"%s\",\"exponent\":%.2f,\"max_error_percent\":%.2f,"
+            "\"total_error_percent\":%.2f}",
+            i ? "," : "", run.bins, SyntheticWorkloadName(run.workload), run.exponent, run.maxErrorPercent,
+            run.totalErrorPercent);
+        json += buf;
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+bool RunLevelHistogramMode(const BenchmarkOptions& options, std::string& json)
+{
+    LevelHistogramBenchmark bench = MeasureLevelHistogram(options.config, options.workloads, options.maxThreads);
+    json = FormatLevelHistogramJson(bench);
+    // Rounding to the counter unit must stay far below the binning error
+    return !bench.runs.empty() && bench.reloaded && bench.longScale > 0 && bench.longMaxErrorPercent < 1.0 &&
+        bench.longTotalErrorPercent < 0.1;
+}
@@ -0,0 +1,125 @@
+#include "BenchmarkModes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+
+LifetimeBenchmark MeasureLifetime(uint64_t frames)
+{
+    LifetimeBenchmark bench;
+    const uint32_t width = 3840, height = 2160;
+    bench.width = width;
+    bench.height = height;
+    const size_t count = size_t(width) * height;
+
+    // Integers below 2^53 like a real plane; repeats make ties inside a select bucket
+    WearMap wear;
+    wear.Reset(width, height);
+    {
+        std::mt19937_64 rng(34);
+        std::vector<double> planes[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            planes[c].resize(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                const uint64_t r = rng();
+                planes[c][i] = r % 10 == 0 ? 0.0 : r % 10 == 1 ? 123456789.0 : double(r >> 24);
+            }
+        }
+        wear.Assign(planes, 36000000); // an hour of ticks
+    }
+
+    const LifetimeProjection projection;
+    const std::vector<double> thresholds = { 0.9, 0.8, 0.5 };
+    const std::vector<double> fractions = { 0.0, 0.001, 0.01, 0.5, 1.0 };
+    bench.summarizeMs = BestOf(3, [&] { projection.Summarize(wear); }) / 1e6;
+    const LifetimeSummary summary = projection.Summarize(wear, thresholds, fractions);
+    std::vector<float> hours[3];
+    bench.projectMapMs = BestOf(3, [&] { projection.ProjectMap(wear, 0.8, hours); }) / 1e6;
+
+    std::vector<double> sorted;
+    for (int c = 0; c < 3; ++c)
+    {
+        sorted.assign(wear.Plane(c), wear.Plane(c) + count);
+        for (size_t f = 0; f < fractions.size(); ++f)
+        {
+            // The rank Summarize documents: fraction q of the subpixels, most worn first
+            const size_t rank = std::min(count - 1, size_t(fractions[f] * double(count - 1) + 0.5));
+            std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end(), std::greater<double>());
+            const double stress = sorted[rank] * WearMap::UnitSeconds();
+            for (size_t t = 0; t < thresholds.size(); ++t)
+            {
+                const double expected = projection.HoursToThreshold(stress, wear.TotalSeconds(), thresholds[t], c);
+                ++bench.percentiles;
+                bench.percentileMismatches += summary.thresholds[t].hours[c][f] == expected ? 0 : 1;
+            }
+        }
+    }
+
+    // beta = 1: damage adds per frame, so the per-frame sum is the reference
+    {
+        const uint32_t size = 8;
+        WearMap session;
+        session.Reset(size, size);
+        std::vector<uint8_t> frame(size_t(size) * size * 4);
+        std::vector<long double> stress(size_t(size) * size * 3, 0.0L); // sum of f * dt, seconds
+        long double sessionSeconds = 0.0L;
+        std::mt19937_64 rng(1);
+        for (uint64_t f = 0; f < frames; ++f)
+        {
+            for (uint8_t& v : frame)
+                v = uint8_t(rng());
+            const uint64_t ticks = 10 + rng() % 491;
+            session.AccumulateTicks(frame.data(), ticks);
+            const long double dt = (long double)ticks * WearMap::TICK_SECONDS;
+            sessionSeconds += dt;
+            for (size_t p = 0; p < size_t(size) * size; ++p)
+                for (int c = 0; c < 3; ++c)
+                    stress[c * size * size + p] += (long double)session.LutValue(frame[p * 4 + 2 - c]) / WearMap::LUT_SCALE * dt;
+        }
+
+        const LifetimeProjection betaOne(LifetimeModel{});
+        for (int c = 0; c < 3; ++c)
+        {
+            const long double tauSeconds = betaOne.Model().TauHours(c) * 3600.0L;
+            for (size_t p = 0; p < size_t(size) * size; ++p)
+            {
+                const long double perSession = stress[c * size * size + p] / tauSeconds;
+                for (double threshold : thresholds)
+                {
+                    // exp(-n * perSession) = threshold after n sessions
+                    const long double expected = -std::log((long double)threshold) / perSession * sessionSeconds / 3600.0L;
+                    const double got = betaOne.HoursToThreshold(session.Plane(c)[p] * WearMap::UnitSeconds(),
+                        session.TotalSeconds(), threshold, c);
+                    bench.betaOneMaxRelativeError = std::max(bench.betaOneMaxRelativeError,
+                        double(std::fabs((long double)got - expected) / expected));
+                }
+            }
+        }
+        bench.frames = frames;
+    }
+    return bench;
+}
+
+std::string FormatLifetimeJson(const LifetimeBenchmark& bench)
+{
+    char buf[512];
+    std::snprintf(buf, sizeof(buf),
+        "{\"benchmark\":\"lifetime\",\"width\":%u,\"height\":%u,\"percentiles\":%llu,\"percentile_mismatches\":%llu,"
+        "\"project_map_ms\":%.1f,\"summarize_ms\":%.1f,\"frames\":%llu,\"beta_one_max_relative_error\":%.3g}\n",
+        bench.width, bench.height, (unsigned long long)bench.percentiles, (unsigned long long)bench.percentileMismatches,
+        bench.projectMapMs, bench.summarizeMs, (unsigned long long)bench.frames, bench.betaOneMaxRelativeError);
+    return buf;
+}
+
+bool RunLifetimeMode(const BenchmarkOptions&, std::string& json)
+{
+    LifetimeBenchmark bench = MeasureLifetime();
+    json = FormatLifetimeJson(bench);
+    // Only double rounding may separate the closed form from the per-frame sum
+    return bench.percentiles > 0 && bench.percentileMismatches == 0 && bench.betaOneMaxRelativeError < 1e-9;
+}
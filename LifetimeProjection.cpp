@@ -0,0 +1,146 @@
+#include "LifetimeProjection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+static const double SECONDS_PER_HOUR = 3600.0;
+
+double LifetimeModel::TauHours(int channel) const
+{
+    // exp(-(t50 / tau)^beta) = 0.5
+    return halfLifeHours[channel] / std::pow(std::log(2.0), 1.0 / beta);
+}
+
+// Reference-drive hours to threshold: tau * (-ln p)^(1/beta)
+static double ReferenceHours(const LifetimeModel& model, double threshold, int channel)
+{
+    return model.TauHours(channel) * std::pow(-std::log(threshold), 1.0 / model.beta);
+}
+
+double LifetimeProjection::HoursToThreshold(double stressSeconds, double sessionSeconds, double threshold, int channel) const
+{
+    if (stressSeconds <= 0.0)
+        return std::numeric_limits<double>::infinity();
+    return sessionSeconds * ReferenceHours(m_model, threshold, channel) / stressSeconds;
+}
+
+void LifetimeProjection::ProjectMap(const WearMap& wear, double threshold, std::vector<float> out[3]) const
+{
+    const size_t count = size_t(wear.Width()) * wear.Height();
+    for (int c = 0; c < 3; ++c)
+    {
+        // t_p = K / W with one K per channel (plane units folded in): a single division
+        // per subpixel. W = 0 gives +inf, the right answer for a never-lit subpixel.
+        const double k = wear.TotalSeconds() * ReferenceHours(m_model, threshold, c) / WearMap::UnitSeconds();
+        const double* w = wear.Plane(c);
+        out[c].resize(count);
+        float* dst = out[c].data();
+        for (size_t i = 0; i < count; ++i)
+            dst[i] = float(k / w[i]);
+    }
+}
+
+// Exact order statistics (rank 0 = largest) of non-negative doubles in two linear passes:
+// a histogram over the top 20 bits of the IEEE representation, which orders like the
+// values, then one pass that gathers the buckets holding the ranks and a selection inside
+// each. Much cheaper than nth_element over a full 4K plane.
+static const int KEY_SHIFT = 44;
+static const uint32_t KEY_COUNT = 1u << 20;
+
+static void SelectDescending(const double* data, size_t count, const std::vector<size_t>& ranks, std::vector<double>& out)
+{
+    std::vector<uint32_t> histogram(KEY_COUNT, 0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &data[i], sizeof(bits));
+        histogram[bits >> KEY_SHIFT]++;
+    }
+
+    // Walk buckets from the largest values down to the one containing each rank
+    std::vector<uint32_t> keys;
+    std::vector<size_t> above;
+    for (size_t rank : ranks)
+    {
+        size_t before = 0;
+        uint32_t key = KEY_COUNT;
+        while (key > 0 && before + histogram[key - 1] <= rank)
+            before += histogram[--key];
+        keys.push_back(key - 1);
+        above.push_back(before);
+    }
+
+    // Ranks often share a bucket: one pass fills the distinct ones. The histogram turns
+    // into a table of bucket numbers by key (0 = not wanted), so that the pass costs the
+    // same for any number of ranks.
+    std::vector<uint32_t> bucketKeys;
+    std::vector<std::vector<double>> buckets;
+    std::vector<size_t> bucketOf;
+    for (uint32_t key : keys)
+    {
+        size_t b = 0;
+        while (b < bucketKeys.size() && bucketKeys[b] != key)
+            ++b;
+        if (b == bucketKeys.size())
+        {
+            bucketKeys.push_back(key);
+            buckets.emplace_back();
+            buckets.back().reserve(histogram[key]);
+        }
+        bucketOf.push_back(b);
+    }
+    std::fill(histogram.begin(), histogram.end(), 0u);
+    for (size_t b = 0; b < bucketKeys.size(); ++b)
+        histogram[bucketKeys[b]] = uint32_t(b + 1);
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &data[i], sizeof(bits));
+        if (const uint32_t b = histogram[bits >> KEY_SHIFT])
+            buckets[b - 1].push_back(data[i]);
+    }
+
+    for (size_t r = 0; r < ranks.size(); ++r)
+    {
+        std::vector<double>& bucket = buckets[bucketOf[r]];
+        auto nth = bucket.begin() + (ranks[r] - above[r]);
+        std::nth_element(bucket.begin(), nth, bucket.end(), std::greater<double>());
+        out.push_back(*nth);
+    }
+}
+
+LifetimeSummary LifetimeProjection::Summarize(const WearMap& wear,
+    const std::vector<double>& thresholds, const std::vector<double>& fractions) const
+{
+    LifetimeSummary summary;
+    summary.sessionSeconds = wear.TotalSeconds();
+    summary.fractions = fractions;
+    for (double threshold : thresholds)
+    {
+        summary.thresholds.emplace_back();
+        summary.thresholds.back().threshold = threshold;
+    }
+
+    // t_p is monotone decreasing in W, so the fraction-q subpixel to cross any threshold
+    // is the (1 - q) quantile of W: select once per channel, transform per threshold.
+    const size_t count = size_t(wear.Width()) * wear.Height();
+    std::vector<size_t> ranks;
+    for (double q : fractions)
+        ranks.push_back(count ? std::min(count - 1, size_t(std::clamp(q, 0.0, 1.0) * double(count - 1) + 0.5)) : 0);
+
+    for (int c = 0; c < 3; ++c)
+    {
+        std::vector<double> stress;
+        if (count > 0)
+            SelectDescending(wear.Plane(c), count, ranks, stress);
+        for (double& w : stress)
+            w *= WearMap::UnitSeconds();
+
+        for (auto& t : summary.thresholds)
+            for (double w : stress)
+                t.hours[c].push_back(HoursToThreshold(w, summary.sessionSeconds, t.threshold, c));
+    }
+    return summary;
+}
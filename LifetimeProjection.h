@@ -0,0 +1,64 @@
+#pragma once
+
+#include "WearMap.h"
+
+#include <cstdint>
+#include <vector>
+
+// Stretched-exponential model of the README: L/L0 = exp(-(t_eq / tau)^beta), where the
+// equivalent reference-drive age t_eq grows with the stress-time a WearMap accumulates.
+// Repeating a session of T_s seconds that left W stress-seconds on a subpixel ages it at
+// W / T_s reference seconds per second, so the wall time to fall to threshold p is
+//
+//     t_p = T_s * tau * (-ln p)^(1/beta) / W
+//
+// This is exact for any beta. Summing per-frame (dt / tau)^beta, as the 5-frame formula
+// does, is only right for beta = 1 and otherwise depends on the frame rate.
+struct LifetimeModel
+{
+    double beta = 1.0;
+    // Hours to L50 at full drive (value 255) per channel, R G B; the README's T_50
+    double halfLifeHours[3] = { 20000.0, 20000.0, 20000.0 };
+
+    // tau of a channel in hours, from its half life
+    double TauHours(int channel) const;
+};
+
+struct LifetimeThresholdSummary
+{
+    double threshold = 0.0;               // relative luminance, e.g. 0.8 for L80
+    std::vector<double> hours[3];         // per channel, one entry per requested fraction
+};
+
+struct LifetimeSummary
+{
+    double sessionSeconds = 0.0;
+    std::vector<double> fractions;        // fraction of subpixels already past threshold
+    std::vector<LifetimeThresholdSummary> thresholds;
+};
+
+class LifetimeProjection
+{
+public:
+    explicit LifetimeProjection(LifetimeModel model = {}) : m_model(model) {}
+
+    const LifetimeModel& Model() const { return m_model; }
+
+    // Hours of repeated viewing until a subpixel with stressSeconds over a session of
+    // sessionSeconds reaches threshold; +inf when it is never driven.
+    double HoursToThreshold(double stressSeconds, double sessionSeconds, double threshold, int channel) const;
+
+    // Full-resolution map of hours to threshold, one plane per channel (0 = R). Memory
+    // bound: ~50 ms for a 4K map on one core (pipeline_bench --lifetime).
+    void ProjectMap(const WearMap& wear, double threshold, std::vector<float> out[3]) const;
+
+    // Panel percentiles: hours until the given fraction of a channel's subpixels is past
+    // each threshold. Fraction 0 is the first (most worn) subpixel. Two passes over
+    // every plane: ~110 ms for a 4K map with the default fractions.
+    LifetimeSummary Summarize(const WearMap& wear,
+        const std::vector<double>& thresholds = { 0.9, 0.8, 0.5 },
+        const std::vector<double>& fractions = { 0.0, 0.001, 0.01, 0.5 }) const;
+
+private:
+    LifetimeModel m_model;
+};
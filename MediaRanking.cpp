@@ -0,0 +1,288 @@
+#include "MediaRanking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RANKING_SSE 1
+#else
+#define RANKING_SSE 0
+#endif
+
+static const char SIG_MAGIC[8] = { 'O', 'L', 'S', 'I', 'G', '0', '0', '1' };
+
+void ResampleWear(const WearMap& wear, uint32_t gridWidth, uint32_t gridHeight, std::vector<float>& out)
+{
+    const uint32_t width = wear.Width(), height = wear.Height();
+    const size_t cells = size_t(gridWidth) * gridHeight;
+    out.assign(cells * 3, 0.0f);
+    if (!width || !height || !cells)
+        return;
+
+    std::vector<uint32_t> column(width);
+    std::vector<uint32_t> columns(gridWidth, 0);
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        column[x] = uint32_t(uint64_t(x) * gridWidth / width);
+        columns[column[x]]++;
+    }
+
+    // Sum every plane's rows into their cell row, then divide by the cell area
+    std::vector<double> sums(cells * 3, 0.0);
+    for (int c = 0; c < 3; ++c)
+    {
+        const double* plane = wear.Plane(c);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            double* dst = sums.data() + c * cells + size_t(uint64_t(y) * gridHeight / height) * gridWidth;
+            const double* src = plane + size_t(y) * width;
+            for (uint32_t x = 0; x < width; ++x)
+                dst[column[x]] += src[x];
+        }
+    }
+
+    for (uint32_t gy = 0; gy < gridHeight; ++gy)
+    {
+        // Rows of cell row gy: the y with y * gridHeight / height == gy
+        const uint32_t y0 = uint32_t((uint64_t(gy) * height + gridHeight - 1) / gridHeight);
+        const uint32_t y1 = uint32_t((uint64_t(gy + 1) * height + gridHeight - 1) / gridHeight);
+        for (uint32_t gx = 0; gx < gridWidth; ++gx)
+        {
+            const double area = double(y1 - y0) * columns[gx];
+            for (int c = 0; c < 3; ++c)
+            {
+                const size_t i = c * cells + size_t(gy) * gridWidth + gx;
+                out[i] = area > 0.0 ? float(sums[i] * WearMap::UnitSeconds() / area) : 0.0f;
+            }
+        }
+    }
+}
+
+bool MediaLibrary::Add(const std::string& name, const WearMap& clipWear)
+{
+    if (clipWear.TotalSeconds() <= 0.0)
+        return false;
+
+    MediaSignature clip;
+    clip.name = name;
+    clip.durationSeconds = clipWear.TotalSeconds();
+    clip.exponent = clipWear.Exponent();
+    ResampleWear(clipWear, gridWidth, gridHeight, clip.rates);
+    const float perSecond = float(1.0 / clip.durationSeconds);
+    for (float& rate : clip.rates)
+        rate *= perSecond;
+    clips.push_back(std::move(clip));
+    return true;
+}
+
+template <typename T>
+static void WriteValue(std::ofstream& file, const T& value)
+{
+    file.write((const char*)&value, sizeof(value));
+}
+
+template <typename T>
+static bool ReadValue(std::ifstream& file, T& value)
+{
+    return bool(file.read((char*)&value, sizeof(value)));
+}
+
+bool MediaLibrary::Save(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(SIG_MAGIC, sizeof(SIG_MAGIC));
+    WriteValue(file, gridWidth);
+    WriteValue(file, gridHeight);
+    WriteValue(file, uint32_t(clips.size()));
+    for (const MediaSignature& clip : clips)
+    {
+        WriteValue(file, uint32_t(clip.name.size()));
+        file.write(clip.name.data(), std::streamsize(clip.name.size()));
+        WriteValue(file, clip.durationSeconds);
+        WriteValue(file, clip.exponent);
+        file.write((const char*)clip.rates.data(), std::streamsize(clip.rates.size() * sizeof(float)));
+    }
+    file.close();
+    return !file.fail();
+}
+
+bool MediaLibrary::Load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(SIG_MAGIC)];
+    uint32_t count = 0;
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, SIG_MAGIC, sizeof(SIG_MAGIC)) != 0 ||
+        !ReadValue(file, gridWidth) || !ReadValue(file, gridHeight) || !ReadValue(file, count))
+        return false;
+
+    const size_t values = size_t(gridWidth) * gridHeight * 3;
+    clips.assign(count, MediaSignature());
+    for (MediaSignature& clip : clips)
+    {
+        uint32_t nameLength = 0;
+        if (!ReadValue(file, nameLength) || nameLength > 4096)
+            return false;
+        clip.name.resize(nameLength);
+        clip.rates.resize(values);
+        if (!file.read(&clip.name[0], std::streamsize(nameLength)) || !ReadValue(file, clip.durationSeconds) ||
+            !ReadValue(file, clip.exponent) ||
+            !file.read((char*)clip.rates.data(), std::streamsize(values * sizeof(float))))
+            return false;
+    }
+    return true;
+}
+
+// sum(a * s), sum(s), sum(s * s) in one pass over n values
+struct DotSums
+{
+    double as = 0.0, s = 0.0, ss = 0.0;
+};
+
+static DotSums DotSumsScalar(const float* a, const float* s, size_t n)
+{
+    float as = 0.0f, sum = 0.0f, ss = 0.0f;
+    for (size_t i = 0; i < n; ++i)
+    {
+        as += a[i] * s[i];
+        sum += s[i];
+        ss += s[i] * s[i];
+    }
+    return { as, sum, ss };
+}
+
+#if RANKING_SSE
+// Two accumulators per sum (8 values per iteration) to hide the add latency
+static DotSums DotSumsSse(const float* a, const float* s, size_t n)
+{
+    __m128 as0 = _mm_setzero_ps(), as1 = _mm_setzero_ps();
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    __m128 ss0 = _mm_setzero_ps(), ss1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128 a0 = _mm_loadu_ps(a + i), a1 = _mm_loadu_ps(a + i + 4);
+        const __m128 v0 = _mm_loadu_ps(s + i), v1 = _mm_loadu_ps(s + i + 4);
+        as0 = _mm_add_ps(as0, _mm_mul_ps(a0, v0));
+        as1 = _mm_add_ps(as1, _mm_mul_ps(a1, v1));
+        s0 = _mm_add_ps(s0, v0);
+        s1 = _mm_add_ps(s1, v1);
+        ss0 = _mm_add_ps(ss0, _mm_mul_ps(v0, v0));
+        ss1 = _mm_add_ps(ss1, _mm_mul_ps(v1, v1));
+    }
+
+    alignas(16) float lanes[3][4];
+    _mm_store_ps(lanes[0], _mm_add_ps(as0, as1));
+    _mm_store_ps(lanes[1], _mm_add_ps(s0, s1));
+    _mm_store_ps(lanes[2], _mm_add_ps(ss0, ss1));
+    DotSums sums = DotSumsScalar(a + i, s + i, n - i);
+    for (int l = 0; l < 4; ++l)
+    {
+        sums.as += lanes[0][l];
+        sums.s += lanes[1][l];
+        sums.ss += lanes[2][l];
+    }
+    return sums;
+}
+#endif
+
+static DotSums ComputeDotSums(const float* a, const float* s, size_t n, bool allowSimd)
+{
+#if RANKING_SSE
+    if (allowSimd)
+        return DotSumsSse(a, s, n);
+#endif
+    (void)allowSimd;
+    return DotSumsScalar(a, s, n);
+}
+
+void MediaRanker::SetWear(const WearMap& wear, uint32_t gridWidth, uint32_t gridHeight)
+{
+    m_gridWidth = gridWidth;
+    m_gridHeight = gridHeight;
+    m_exponent = wear.Exponent();
+    ResampleWear(wear, gridWidth, gridHeight, m_wear);
+
+    double sum = 0.0, squares = 0.0;
+    m_wearMax = 0.0f;
+    for (float w : m_wear)
+    {
+        sum += w;
+        squares += double(w) * w;
+        m_wearMax = (std::max)(m_wearMax, w);
+    }
+    const double n = double((std::max)(m_wear.size(), size_t(1)));
+    m_wearMean = sum / n;
+    m_wearVariance = (std::max)(0.0, squares / n - m_wearMean * m_wearMean);
+
+    // Centered once, so the covariance with a clip is a plain dot product without cancellation
+    m_centered.resize(m_wear.size());
+    for (size_t i = 0; i < m_wear.size(); ++i)
+        m_centered[i] = float(m_wear[i] - m_wearMean);
+}
+
+double MediaRanker::Hotspots(float power, std::vector<float>& weights) const
+{
+    weights.resize(m_wear.size());
+    double sum = 0.0;
+    const float scale = m_wearMax > 0.0f ? 1.0f / m_wearMax : 0.0f;
+    for (size_t i = 0; i < m_wear.size(); ++i)
+    {
+        // No wear yet: every cell counts alike
+        weights[i] = scale > 0.0f ? std::pow(m_wear[i] * scale, power) : 1.0f;
+        sum += weights[i];
+    }
+    return sum;
+}
+
+double MediaRanker::ScoreWith(const MediaSignature& clip, const RankingConfig& config,
+    const std::vector<float>& hotspots, double hotspotSum) const
+{
+    const size_t n = m_wear.size();
+    const double t = config.playSeconds;
+    if (config.objective == RankingObjective::WornRegions)
+    {
+        const DotSums sums = ComputeDotSums(hotspots.data(), clip.rates.data(), n, config.allowSimd);
+        return hotspotSum > 0.0 ? sums.as / hotspotSum * t : 0.0;
+    }
+
+    // Var(w + t s) = Var(w) + 2 t Cov(w, s) + t^2 Var(s)
+    const DotSums sums = ComputeDotSums(m_centered.data(), clip.rates.data(), n, config.allowSimd);
+    const double mean = sums.s / double(n);
+    const double covariance = sums.as / double(n);
+    const double clipVariance = (std::max)(0.0, sums.ss / double(n) - mean * mean);
+    const double variance = m_wearVariance + 2.0 * t * covariance + t * t * clipVariance;
+    return std::sqrt((std::max)(0.0, variance)) - std::sqrt(m_wearVariance);
+}
+
+double MediaRanker::Score(const MediaSignature& clip, const RankingConfig& config) const
+{
+    std::vector<float> hotspots;
+    const double hotspotSum =
+        config.objective == RankingObjective::WornRegions ? Hotspots(config.hotspotPower, hotspots) : 0.0;
+    return ScoreWith(clip, config, hotspots, hotspotSum);
+}
+
+std::vector<MediaScore> MediaRanker::Rank(const MediaLibrary& library, const RankingConfig& config) const
+{
+    std::vector<MediaScore> scores;
+    if (library.gridWidth != m_gridWidth || library.gridHeight != m_gridHeight)
+        return scores;
+
+    std::vector<float> hotspots;
+    const double hotspotSum =
+        config.objective == RankingObjective::WornRegions ? Hotspots(config.hotspotPower, hotspots) : 0.0;
+    scores.reserve(library.clips.size());
+    for (size_t i = 0; i < library.clips.size(); ++i)
+    {
+        const MediaSignature& clip = library.clips[i];
+        if (clip.exponent != m_exponent || clip.rates.size() != m_wear.size())
+            continue;
+        scores.push_back({ i, ScoreWith(clip, config, hotspots, hotspotSum) });
+    }
+    std::stable_sort(scores.begin(), scores.end(),
+        [](const MediaScore& a, const MediaScore& b) { return a.score < b.score; });
+    return scores;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "WearMap.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// "Which media to play to reduce the damage": rank a library of clips against the wear
+// the panel has already taken.
+//
+// A clip's signature is its wear rate played full screen: the mean stress-seconds per
+// second of every subpixel channel over a coarse grid of cells (R, G and B planes, row
+// major), taken from a WearMap of the clip (e.g. AnalyzeArchives of its recording). The
+// grid is the same for the whole library, so scoring is a few dot products per clip
+// against the current wear resampled once onto that grid, whatever the screen size.
+
+struct MediaSignature
+{
+    std::string name;
+    double durationSeconds = 0.0;
+    float exponent = 1.54f;        // of the WearMap it came from; must match the panel's
+    std::vector<float> rates;      // 3 * gridWidth * gridHeight
+};
+
+struct MediaLibrary
+{
+    uint32_t gridWidth = 64, gridHeight = 36;
+    std::vector<MediaSignature> clips;
+
+    // Signature of a clip's wear map, added to clips; false when it is empty
+    bool Add(const std::string& name, const WearMap& clipWear);
+    // "OLSIG001", grid size, count, then per clip its name, duration, exponent and rates
+    // (little endian, as in memory)
+    bool Save(const std::string& path) const;
+    bool Load(const std::string& path);
+};
+
+// Mean of every channel over each grid cell, in stress-seconds; 3 planes row major.
+void ResampleWear(const WearMap& wear, uint32_t gridWidth, uint32_t gridHeight, std::vector<float>& out);
+
+enum class RankingObjective
+{
+    // Playing the clip adds the least stress where the panel is already most worn:
+    // sum(weight * rate) / sum(weight) * playSeconds, weight = (wear / max wear)^hotspotPower
+    WornRegions,
+    // Playing the clip evens wear out the most: change of the standard deviation of the
+    // per-cell wear after playSeconds (negative = more even)
+    Evenness
+};
+
+struct RankingConfig
+{
+    RankingObjective objective = RankingObjective::WornRegions;
+    double playSeconds = 3600.0;
+    float hotspotPower = 2.0f;
+    bool allowSimd = true;
+};
+
+struct MediaScore
+{
+    size_t clip = 0;               // index into MediaLibrary::clips
+    double score = 0.0;            // lower is better, in stress-seconds
+};
+
+class MediaRanker
+{
+public:
+    // Resamples the current wear onto the library's grid; call again when it has grown.
+    void SetWear(const WearMap& wear, uint32_t gridWidth, uint32_t gridHeight);
+
+    // Every clip whose grid and exponent match, best first
+    std::vector<MediaScore> Rank(const MediaLibrary& library, const RankingConfig& config) const;
+    double Score(const MediaSignature& clip, const RankingConfig& config) const;
+
+private:
+    // (wear / max wear)^power per channel cell and their sum
+    double Hotspots(float power, std::vector<float>& weights) const;
+    double ScoreWith(const MediaSignature& clip, const RankingConfig& config, const std::vector<float>& hotspots,
+        double hotspotSum) const;
+
+    uint32_t m_gridWidth = 0, m_gridHeight = 0;
+    float m_exponent = 0.0f;
+    std::vector<float> m_wear;     // stress-seconds per channel cell
+    std::vector<float> m_centered; // m_wear minus its mean
+    double m_wearMean = 0.0, m_wearVariance = 0.0;
+    float m_wearMax = 0.0f;
+};
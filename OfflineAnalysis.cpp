@@ -0,0 +1,237 @@
+#include "OfflineAnalysis.h"
+
+#include "ArchiveSinks.h"
+#include "TileHash.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+struct ArchiveFile
+{
+    std::string path;
+    bool tile = false;
+    std::vector<int64_t> timestamps;
+};
+
+// Frames [first, end) of one file
+struct Span
+{
+    size_t file;
+    size_t first, end;
+};
+}
+
+static int64_t TickOf(int64_t hns)
+{
+    const int64_t hnsPerTick = int64_t(WearMap::TICK_SECONDS * 1e7 + 0.5);
+    return hns >= 0 ? hns / hnsPerTick : -((-hns + hnsPerTick - 1) / hnsPerTick);
+}
+
+// Ticks frame i of the file stayed on screen; a timestamp going backwards counts as none
+static uint64_t FrameTicks(const ArchiveFile& file, size_t i, int64_t lastFrameHns)
+{
+    const int64_t start = file.timestamps[i];
+    const int64_t end = i + 1 < file.timestamps.size() ? file.timestamps[i + 1] : start + lastFrameHns;
+    const int64_t ticks = TickOf(end) - TickOf(start);
+    return ticks > 0 ? uint64_t(ticks) : 0;
+}
+
+static bool OpenArchive(ArchiveFile& file, uint32_t& width, uint32_t& height)
+{
+    RawBgraReader raw;
+    if (raw.Open(file.path))
+    {
+        file.tile = false;
+        width = raw.Width();
+        height = raw.Height();
+        file.timestamps.resize(raw.FrameCount());
+        for (size_t i = 0; i < raw.FrameCount(); ++i)
+            file.timestamps[i] = raw.Timestamp(i);
+        return true;
+    }
+
+    TileArchiveReader tile;
+    if (!tile.Open(file.path, 1) || !ReadArchiveTimestamps(file.path, file.timestamps))
+        return false;
+    file.tile = true;
+    width = tile.Width();
+    height = tile.Height();
+    return true;
+}
+
+namespace
+{
+// Decode buffers of one slot. With a hasher, a frame is held back in pending until one
+// with a changed tile arrives, and identical frames only add their ticks to it.
+struct SpanFrames
+{
+    std::vector<uint8_t> frame, pending;
+    uint64_t pendingTicks = 0;
+    TileHasher* tiles = nullptr;
+    uint64_t merged = 0;
+
+    uint8_t* Next() { return frame.data(); }
+
+    void Add(WearMap& wear, uint64_t ticks)
+    {
+        if (!tiles)
+        {
+            wear.AccumulateTicks(frame.data(), ticks);
+            return;
+        }
+        tiles->Hash(frame.data());
+        // Equal hashes only nominate a merge; the bytes decide, so a collision cannot
+        // change the map
+        if (pendingTicks && tiles->ChangedCount() == 0 && std::memcmp(frame.data(), pending.data(), frame.size()) == 0)
+        {
+            pendingTicks += ticks;
+            merged++;
+            return;
+        }
+        Flush(wear);
+        frame.swap(pending);
+        pendingTicks = ticks;
+    }
+
+    void Flush(WearMap& wear)
+    {
+        wear.AccumulateTicks(pending.data(), pendingTicks);
+        pendingTicks = 0;
+    }
+};
+}
+
+static bool AccumulateSpan(const ArchiveFile& file, const Span& span, int64_t lastFrameHns,
+    SpanFrames& frames, WearMap& wear)
+{
+    // Spans start over, so their results do not depend on how a file was split
+    if (frames.tiles)
+        frames.tiles->Reset(wear.Width(), wear.Height());
+    bool ok = true;
+    if (file.tile)
+    {
+        // Sequential codec: the span is the whole file
+        TileArchiveReader reader;
+        ok = reader.Open(file.path, 1);
+        for (size_t i = span.first; ok && i < span.end; ++i)
+        {
+            ok = reader.ReadNextFrame(frames.Next());
+            if (ok)
+                frames.Add(wear, FrameTicks(file, i, lastFrameHns));
+        }
+    }
+    else
+    {
+        RawBgraReader reader;
+        ok = reader.Open(file.path);
+        for (size_t i = span.first; ok && i < span.end; ++i)
+        {
+            ok = reader.ReadFrame(i, frames.Next());
+            if (ok)
+                frames.Add(wear, FrameTicks(file, i, lastFrameHns));
+        }
+    }
+    if (frames.pendingTicks)
+        frames.Flush(wear);
+    return ok;
+}
+
+OfflineAnalysisResult AnalyzeArchives(const std::vector<std::string>& paths, const OfflineAnalysisConfig& config,
+    WearMap& wear)
+{
+    OfflineAnalysisResult result;
+    const auto start = Clock::now();
+
+    std::vector<ArchiveFile> files(paths.size());
+    size_t rawFrames = 0;
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        uint32_t width = 0, height = 0;
+        files[i].path = paths[i];
+        if (!OpenArchive(files[i], width, height) ||
+            (i > 0 && (width != result.width || height != result.height)))
+        {
+            result.error = paths[i];
+            return result;
+        }
+        result.width = width;
+        result.height = height;
+        result.frames += files[i].timestamps.size();
+        if (!files[i].tile)
+            rawFrames += files[i].timestamps.size();
+    }
+
+    WorkerPool pool(config.threads);
+    result.threads = pool.Threads();
+    const size_t spanFrames = config.spanFrames ? config.spanFrames
+                                                : (std::max)(size_t(1), rawFrames / (size_t(pool.Threads()) * 4));
+    std::vector<Span> spans;
+    for (size_t f = 0; f < files.size(); ++f)
+    {
+        const size_t count = files[f].timestamps.size();
+        const size_t step = files[f].tile ? (std::max)(count, size_t(1)) : spanFrames;
+        for (size_t first = 0; first < count; first += step)
+            spans.push_back({ f, first, (std::min)(count, first + step) });
+    }
+    result.spans = uint32_t(spans.size());
+
+    // One map per slot, not per span: a 1080p map is about 75 MB
+    const size_t slots = (std::max)(size_t(1), (std::min)(size_t(pool.Threads()), spans.size()));
+    std::vector<WearMap> maps(slots);
+    std::atomic<size_t> nextSpan{ 0 };
+    std::atomic<uint64_t> merged{ 0 };
+    std::mutex errorMutex;
+    pool.ParallelFor(slots, [&](size_t slot) {
+        maps[slot].Reset(result.width, result.height, config.wearExponent);
+        const size_t frameBytes = size_t(result.width) * result.height * 4;
+        TileHasher tiles;
+        SpanFrames frames;
+        frames.frame.resize(frameBytes);
+        if (config.mergeUnchanged)
+        {
+            frames.pending.resize(frameBytes);
+            frames.tiles = &tiles;
+        }
+        for (size_t s = nextSpan++; s < spans.size(); s = nextSpan++)
+        {
+            if (!AccumulateSpan(files[spans[s].file], spans[s], config.lastFrameHns, frames, maps[slot]))
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (result.error.empty())
+                    result.error = files[spans[s].file].path;
+            }
+        }
+        merged += frames.merged;
+    });
+
+    // Tree reduction: round k adds map i + 2^k into map i for every i divisible by 2^(k+1)
+    const auto mergeStart = Clock::now();
+    for (size_t step = 1; step < slots; step *= 2)
+    {
+        pool.ParallelFor((slots + 2 * step - 1) / (2 * step), [&](size_t pair) {
+            const size_t dst = pair * 2 * step, src = dst + step;
+            if (src < slots)
+            {
+                maps[dst].Merge(maps[src]);
+                maps[src] = WearMap();
+            }
+        });
+    }
+    wear = std::move(maps[0]);
+
+    const auto end = Clock::now();
+    result.mergeSeconds = std::chrono::duration<double>(end - mergeStart).count();
+    result.wallSeconds = std::chrono::duration<double>(end - start).count();
+    result.mediaSeconds = wear.TotalSeconds();
+    result.framesMerged = merged;
+    result.ok = result.error.empty();
+    return result;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "WearMap.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Wear of recorded lossless archives (RawBgraSink and TileArchiveSink files, e.g. the
+// segments of one recording), analysed in parallel:
+//
+//  - the archives are split into spans: raw files into time chunks of consecutive frames
+//    (random access through the index), tile files whole, since each decodes on its own
+//  - WorkerPool slots take spans in order and accumulate them into one WearMap per slot
+//  - the slot maps are merged pairwise in a tree, log2(slots) parallel rounds
+//
+// A frame stays on screen until the next one of its file. Its duration in ticks is taken
+// from absolute timestamps, tick(next) - tick(frame) with tick(t) = t / 1000 hns, so the
+// ticks of any run of frames only depend on its end points and WearMap addition is exact:
+// the result is bit-identical for every thread count, span size and merge order.
+//
+// Archives carry no dirty rects, so with mergeUnchanged every decoded frame is tile-hashed
+// (TileHash.h) and a run of frames without a changed tile, confirmed byte for byte against
+// the frame before, is accumulated once with the sum of their ticks: the same integer
+// ticks, so the same map, for the cost of a hash and a compare of the unchanged frames.
+struct OfflineAnalysisConfig
+{
+    unsigned threads = 0;        // WorkerPool size, 0 = hardware concurrency
+    uint32_t spanFrames = 0;     // frames per raw span, 0 = about 4 spans per thread
+    float wearExponent = 1.54f;
+    // How long the last frame of each file stayed on screen; the index does not record it
+    int64_t lastFrameHns = 0;
+    bool mergeUnchanged = true;
+};
+
+struct OfflineAnalysisResult
+{
+    bool ok = false;
+    std::string error;           // first file that failed, when !ok
+    uint32_t width = 0, height = 0;
+    uint64_t frames = 0;
+    uint64_t framesMerged = 0;   // frames whose ticks went to an identical predecessor
+    uint32_t spans = 0;
+    unsigned threads = 0;
+    double mediaSeconds = 0.0;   // WearMap::TotalSeconds of the result
+    double wallSeconds = 0.0;    // accumulate + merge
+    double mergeSeconds = 0.0;
+};
+
+// wear is reset to the archives' size; all of them must have the same one.
+OfflineAnalysisResult AnalyzeArchives(const std::vector<std::string>& paths, const OfflineAnalysisConfig& config,
+    WearMap& wear);
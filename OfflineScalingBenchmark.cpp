@@ -0,0 +1,109 @@
+#include "BenchmarkModes.h"
+
+#include "ArchiveSinks.h"
+#include "OfflineAnalysis.h"
+#include "WearMap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+OfflineScalingBenchmark MeasureOfflineScaling(const BenchmarkConfig& config, unsigned maxThreads)
+{
+    OfflineScalingBenchmark bench;
+    if (maxThreads == 0)
+        maxThreads = (std::max)(1u, std::thread::hardware_concurrency());
+
+    // Timestamps off the 1 ms tick grid, so spans split between ticks
+    const std::string path = config.sinkPath + ".raw";
+    {
+        const double fps = config.fps > 0.0 ? config.fps : 60.0;
+        const SyntheticDesktop desktop(config.workload, config.width, config.height);
+        std::vector<uint8_t> frame(size_t(config.width) * config.height * 4);
+        RawBgraSink sink(config.width, config.height);
+        if (!sink.Open(path))
+            return bench;
+        bool written = true;
+        for (uint32_t i = 0; i < config.frames && written; ++i)
+        {
+            desktop.Render(i, frame.data());
+            written = sink.WriteFrame(frame.data(), std::llround(i * 1e7 / fps));
+        }
+        if (!sink.Close() || !written)
+            return bench;
+    }
+
+    OfflineAnalysisConfig analysis;
+    analysis.threads = 1;
+    analysis.spanFrames = (std::max)(config.frames, 1u);
+    WearMap reference;
+    OfflineAnalysisResult sequential = AnalyzeArchives({ path }, analysis, reference);
+    bench.ok = sequential.ok;
+    bench.frames = sequential.frames;
+    bench.mediaSeconds = sequential.mediaSeconds;
+    bench.referenceSeconds = sequential.wallSeconds;
+    bench.framesMerged = sequential.framesMerged;
+
+    analysis.mergeUnchanged = false;
+    WearMap unmerged;
+    OfflineAnalysisResult plain = AnalyzeArchives({ path }, analysis, unmerged);
+    bench.unmergedSeconds = plain.wallSeconds;
+    bench.ok = bench.ok && plain.ok && SamePlanes(unmerged, reference);
+    analysis.mergeUnchanged = true;
+
+    analysis.spanFrames = 0;
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+    for (unsigned threads : threadCounts)
+    {
+        analysis.threads = threads;
+        WearMap wear;
+        OfflineAnalysisResult result = AnalyzeArchives({ path }, analysis, wear);
+        OfflineScalingRun run;
+        run.threads = result.threads;
+        run.spans = result.spans;
+        run.wallSeconds = result.wallSeconds;
+        run.mergeSeconds = result.mergeSeconds;
+        run.speedup = result.wallSeconds > 0.0 ? bench.referenceSeconds / result.wallSeconds : 0.0;
+        run.identical = result.ok && SamePlanes(wear, reference);
+        bench.ok = bench.ok && run.identical;
+        bench.runs.push_back(run);
+    }
+
+    std::remove(path.c_str());
+    std::remove((path + ".idx").c_str());
+    return bench;
+}
+
+std::string FormatOfflineScalingJson(const OfflineScalingBenchmark& bench)
+{
+    char buf[256];
+    std::snprintf(buf, sizeof(buf),
+        "{\"benchmark\":\"offline_analysis\",\"ok\":%s,\"frames\":%llu,\"media_s\":%.3f,\"sequential_s\":%.3f,"
+        "\"frames_merged\":%llu,\"unmerged_s\":%.3f,\"runs\":[",
+        bench.ok ? "true" : "false", (unsigned long long)bench.frames, bench.mediaSeconds, bench.referenceSeconds,
+        (unsigned long long)bench.framesMerged, bench.unmergedSeconds);
+    std::string json = buf;
+    for (size_t i = 0; i < bench.runs.size(); ++i)
+    {
+        const OfflineScalingRun& r = bench.runs[i];
+        std::snprintf(buf, sizeof(buf),
+            "%s\n  {\"threads\":%u,\"spans\":%u,\"wall_s\":%.3f,\"merge_s\":%.3f,\"speedup\":%.2f,\"identical\":%s}",
+            i ? "," : "", r.threads, r.spans, r.wallSeconds, r.mergeSeconds, r.speedup, r.identical ? "true" : "false");
+        json += buf;
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+bool RunOfflineScalingMode(const BenchmarkOptions& options, std::string& json)
+{
+    BenchmarkConfig config = options.config;
+    config.workload = options.workloads.front();
+    OfflineScalingBenchmark bench = MeasureOfflineScaling(config, options.maxThreads);
+    json = FormatOfflineScalingJson(bench);
+    return bench.ok;
+}
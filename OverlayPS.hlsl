@@ -0,0 +1,33 @@
+// Preview with the wear heatmap overlay; compiled at build time into OverlayPS.h
+// (g_overlayPS). inferno() is the polynomial of Colormap.cpp (CPU reference).
+
+Texture2D tex : register(t0);
+Texture2D<float> heat : register(t1);
+SamplerState samp : register(s0);
+cbuffer Overlay : register(b0) { float invMaxWear; float alpha; float2 pad; };
+
+static const float3 INFERNO_C[7] = {
+    float3(  0.0002189403691192265,  0.001651004631001012, -0.01948089843709184),
+    float3(  0.1065134194856116,     0.5639564367884091,    3.932712388889277),
+    float3( 11.60249308247187,      -3.972853965665698,   -15.9423941062914),
+    float3(-41.70399613139459,      17.43639888205313,     44.35414519872813),
+    float3( 77.162935699427,       -33.40235894210092,    -81.80730925738993),
+    float3(-71.31942824499214,      32.62606426397723,     73.20951985803202),
+    float3( 25.13112622477341,     -12.24266895238567,    -23.07032500287172)
+};
+
+float3 inferno(float t)
+{
+    t = saturate(t);
+    float3 v = INFERNO_C[6];
+    [unroll] for (int k = 5; k >= 0; --k) v = INFERNO_C[k] + t * v;
+    return saturate(v);
+}
+
+float4 main(float4 pos : SV_POSITION, float2 uv : TEXCOORD) : SV_Target
+{
+    float4 color = tex.Sample(samp, uv);
+    float wear = heat.Sample(samp, uv) * invMaxWear;
+    color.rgb = lerp(color.rgb, inferno(wear), alpha * (invMaxWear > 0));
+    return color;
+}
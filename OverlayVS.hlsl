@@ -0,0 +1,12 @@
+// Fullscreen quad of the preview; compiled at build time into OverlayVS.h (g_overlayVS)
+
+struct VS_IN { float3 pos : POSITION; float2 uv : TEXCOORD; };
+struct PS_IN { float4 pos : SV_POSITION; float2 uv : TEXCOORD; };
+
+PS_IN main(VS_IN input)
+{
+    PS_IN o;
+    o.pos = float4(input.pos, 1);
+    o.uv = input.uv;
+    return o;
+}
@@ -0,0 +1,459 @@
+#include "BenchmarkModes.h"
+
+#include "ArchiveSinks.h"
+#include "CapturePipeline.h"
+#include "CaptureSession.h"
+#include "FrameArena.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* STAGE_NAMES[STAGE_COUNT] = { "capture", "stats", "wear", "sink" };
+
+const char* BenchmarkSinkName(BenchmarkSink sink)
+{
+    switch (sink)
+    {
+    case BenchmarkSink::Null: return "null";
+    case BenchmarkSink::Raw:  return "raw";
+    case BenchmarkSink::Y4m:  return "y4m";
+    case BenchmarkSink::Tile: return "tile";
+    }
+    return "unknown";
+}
+
+static uint64_t PeakRssBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters = {};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return uint64_t(usage.ru_maxrss) * 1024; // kilobytes on Linux
+#endif
+}
+
+// dTLB load and store misses of the calling thread in user mode, from the CPU's
+// performance counters. Linux only; unavailable in most VMs and with
+// perf_event_paranoid > 2.
+class TlbMissCounter
+{
+public:
+    TlbMissCounter()
+    {
+#ifdef __linux__
+        for (int op = 0; op < 2; ++op)
+        {
+            perf_event_attr attr = {};
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB
+                | (uint64_t(op ? PERF_COUNT_HW_CACHE_OP_WRITE : PERF_COUNT_HW_CACHE_OP_READ) << 8)
+                | (uint64_t(PERF_COUNT_HW_CACHE_RESULT_MISS) << 16);
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            m_fd[op] = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+    }
+    ~TlbMissCounter()
+    {
+#ifdef __linux__
+        for (int fd : m_fd)
+            if (fd >= 0)
+                close(fd);
+#endif
+    }
+
+    TlbMissCounter(const TlbMissCounter&) = delete;
+    TlbMissCounter& operator=(const TlbMissCounter&) = delete;
+
+    // Store misses are not counted on every CPU; loads are enough to report
+    bool Available() const { return m_fd[0] >= 0; }
+
+    void Start()
+    {
+#ifdef __linux__
+        for (int fd : m_fd)
+            if (fd >= 0)
+            {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+    }
+
+    // Misses since Start, -1 when not available
+    int64_t Stop()
+    {
+        if (!Available())
+            return -1;
+        int64_t total = 0;
+#ifdef __linux__
+        for (int fd : m_fd)
+        {
+            uint64_t count = 0;
+            if (fd >= 0 && ioctl(fd, PERF_EVENT_IOC_DISABLE, 0) == 0 && read(fd, &count, sizeof(count)) == sizeof(count))
+                total += int64_t(count);
+        }
+#endif
+        return total;
+    }
+
+private:
+    int m_fd[2] = { -1, -1 };
+};
+
+StageTiming Summarize(std::vector<int64_t>& samples)
+{
+    StageTiming timing;
+    if (samples.empty())
+        return timing;
+
+    double sum = 0.0;
+    for (int64_t ns : samples)
+        sum += double(ns);
+    timing.meanNs = sum / double(samples.size());
+
+    auto at = [&](double q)
+    {
+        size_t rank = (std::min)(samples.size() - 1, size_t(q * double(samples.size() - 1) + 0.5));
+        std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+        return double(samples[rank]);
+    };
+    timing.p50Ns = at(0.50);
+    timing.p99Ns = at(0.99);
+    timing.maxNs = double(*std::max_element(samples.begin(), samples.end()));
+    return timing;
+}
+
+static const char* SinkExtension(BenchmarkSink sink)
+{
+    switch (sink)
+    {
+    case BenchmarkSink::Raw: return ".raw";
+    case BenchmarkSink::Y4m: return ".y4m";
+    case BenchmarkSink::Tile: return ".olt";
+    case BenchmarkSink::Null: break;
+    }
+    return "";
+}
+
+static std::unique_ptr<IFrameSink> MakeSink(const BenchmarkConfig& config)
+{
+    const uint32_t fps = config.fps > 0.0 ? uint32_t(config.fps + 0.5) : 60;
+    switch (config.sink)
+    {
+    case BenchmarkSink::Raw:
+        return std::make_unique<RawBgraSink>(config.width, config.height);
+    case BenchmarkSink::Y4m:
+        return std::make_unique<Y4mSink>(config.width, config.height, fps);
+    case BenchmarkSink::Tile:
+        return std::make_unique<TileArchiveSink>(config.width, config.height);
+    case BenchmarkSink::Null:
+        break;
+    }
+    return std::make_unique<NullSink>(config.width, config.height);
+}
+
+// The first frame of an archive against the frame given to the sink, B, G and R of every
+// pixel in row order: a sink that flipped or reordered rows fails
+static bool ArchiveStartsWith(BenchmarkSink sink, const std::string& path, const std::vector<uint8_t>& bgra,
+    uint32_t width, uint32_t height)
+{
+    const size_t count = size_t(width) * height;
+    std::vector<uint8_t> frame(count * 4);
+    if (sink == BenchmarkSink::Raw)
+    {
+        RawBgraReader reader;
+        if (!reader.Open(path) || !reader.ReadFrame(0, frame.data()))
+            return false;
+    }
+    else if (sink == BenchmarkSink::Tile)
+    {
+        TileArchiveReader reader;
+        if (!reader.Open(path) || !reader.ReadNextFrame(frame.data()))
+            return false;
+    }
+    else if (sink == BenchmarkSink::Y4m)
+    {
+        // Header line, "FRAME\n", then the G, B and R planes
+        std::ifstream file(path, std::ios::binary);
+        std::string header;
+        char tag[6];
+        std::vector<uint8_t> planes(count * 3);
+        if (!std::getline(file, header) || !file.read(tag, sizeof(tag)) ||
+            !file.read(reinterpret_cast<char*>(planes.data()), std::streamsize(planes.size())))
+            return false;
+        for (size_t i = 0; i < count; ++i)
+        {
+            frame[i * 4 + 0] = planes[count + i];
+            frame[i * 4 + 1] = planes[i];
+            frame[i * 4 + 2] = planes[2 * count + i];
+        }
+    }
+    else
+    {
+        return true;
+    }
+    for (size_t i = 0; i < count; ++i)
+        if (std::memcmp(&frame[i * 4], &bgra[i * 4], 3) != 0)
+            return false;
+    return true;
+}
+
+// What the benchmark needs from the measured frames, gathered on the capture thread by
+// ProbeSink around every sink the recording opens: all fields but the atomics are read
+// only after CapturePipeline::Stop has joined that thread.
+struct PipelineProbe
+{
+    const BenchmarkConfig* config = nullptr;
+    SyntheticCaptureSource* source = nullptr;
+    std::atomic<uint64_t> written{ 0 };
+    std::atomic<uint64_t> sinkBytes{ 0 }; // of the sinks that got frames, at Close on the segment worker
+    std::string path;              // of the sink that got the first frame
+    std::vector<uint8_t> firstFrame;
+    std::vector<int64_t> latencyNs;
+    Clock::time_point measureStart, measureEnd;
+    uint64_t traceFrom = 0, traceTo = UINT64_MAX;
+    uint64_t skippedBefore = 0, skippedAfter = 0;
+    std::unique_ptr<TlbMissCounter> tlbMisses; // opened on the capture thread, which it counts
+    int64_t dtlbMisses = -1;
+};
+
+class ProbeSink : public IFrameSink
+{
+public:
+    ProbeSink(PipelineProbe& probe, std::unique_ptr<IFrameSink> sink) : m_probe(probe), m_sink(std::move(sink)) {}
+
+    bool Open(const std::string& path) override
+    {
+        m_path = path;
+        return m_sink->Open(path);
+    }
+    bool WriteFrame(const uint8_t* bgra, int64_t timestampHns) override
+    {
+        const BenchmarkConfig& config = *m_probe.config;
+        const uint64_t n = m_probe.written.load(std::memory_order_relaxed);
+        const uint64_t total = uint64_t(config.warmupFrames) + config.frames;
+        if (n == 0)
+        {
+            m_probe.path = m_path;
+            if (config.sink != BenchmarkSink::Null)
+                m_probe.firstFrame.assign(bgra, bgra + size_t(config.width) * config.height * 4);
+        }
+        if (n == config.warmupFrames)
+        {
+            m_probe.measureStart = Clock::now();
+            m_probe.traceFrom = Trace::Now();
+            m_probe.skippedBefore = m_probe.source->FramesSkipped();
+            m_probe.tlbMisses = std::make_unique<TlbMissCounter>();
+            m_probe.tlbMisses->Start();
+        }
+
+        const bool ok = m_sink->WriteFrame(bgra, timestampHns);
+        if (n >= config.warmupFrames && n < total)
+            m_probe.latencyNs.push_back(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_probe.source->LastFrameDue()).count());
+        if (n + 1 == total)
+        {
+            m_probe.measureEnd = Clock::now();
+            m_probe.traceTo = Trace::Now();
+            m_probe.skippedAfter = m_probe.source->FramesSkipped();
+            m_probe.dtlbMisses = m_probe.tlbMisses ? m_probe.tlbMisses->Stop() : -1;
+        }
+        m_probe.written.store(n + 1, std::memory_order_release);
+        m_written = true;
+        return ok;
+    }
+    bool Close() override
+    {
+        const bool ok = m_sink->Close();
+        if (m_written)
+            m_probe.sinkBytes += m_sink->BytesWritten();
+        return ok;
+    }
+    uint64_t BytesWritten() const override { return m_sink->BytesWritten(); }
+    bool IsKeyframeBoundary() const override { return m_sink->IsKeyframeBoundary(); }
+    void Remove(const std::string& path) override { m_sink->Remove(path); }
+
+private:
+    PipelineProbe& m_probe;
+    std::unique_ptr<IFrameSink> m_sink;
+    std::string m_path;
+    bool m_written = false;
+};
+
+BenchmarkResult RunPipelineBenchmark(const BenchmarkConfig& config)
+{
+    BenchmarkResult result;
+    result.config = config;
+
+    auto source = std::make_unique<SyntheticCaptureSource>(config.workload, config.width, config.height,
+        config.fps, config.loopFrames);
+    PipelineProbe probe;
+    probe.config = &config;
+    probe.source = source.get();
+    CaptureSession session(std::move(source));
+    if (!session.Start())
+        return result;
+    result.sourceBytes = probe.source->LoopBytes();
+
+    // The source paces like a display: the pipeline asks as fast as it may and CaptureNext
+    // waits for the next frame to come due
+    PipelineConfig pipelineConfig;
+    pipelineConfig.rate.minFps = pipelineConfig.rate.maxFps = 1e6;
+    pipelineConfig.levelBins = config.levelBins;
+    pipelineConfig.frameArena = config.frameArena;
+    pipelineConfig.segments.directory = ".";
+    pipelineConfig.segments.prefix = config.sinkPath;
+    pipelineConfig.segments.maxSegmentSeconds = 0.0;
+    pipelineConfig.segments.extension = SinkExtension(config.sink);
+    pipelineConfig.sinkFactory = [&] { return std::unique_ptr<IFrameSink>(new ProbeSink(probe, MakeSink(config))); };
+
+    // Stage timing comes from the pipeline's own trace points over the measured frames
+    const bool traced = Trace::IsEnabled();
+    Trace::Enable(true);
+    const uint64_t total = uint64_t(config.warmupFrames) + config.frames;
+    bool ok;
+    {
+        CapturePipeline pipeline(session, pipelineConfig);
+        ok = pipeline.Start();
+        while (ok && probe.written.load(std::memory_order_acquire) < total)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            ok = pipeline.IsRunning();
+        }
+        pipeline.Stop();
+        const PipelineStats stats = pipeline.Stats();
+        ok = ok && stats.recording.openFailures == 0 && stats.recording.closeFailures == 0;
+        result.arenaBacking = stats.frameBuffers;
+    }
+    const std::vector<Trace::StageSummary> stages = Trace::Summarize(probe.traceFrom, probe.traceTo);
+    if (!traced)
+        Trace::Enable(false);
+    session.Stop();
+
+    result.sinkBytes = probe.sinkBytes;
+    result.dtlbMisses = probe.dtlbMisses;
+    if (config.sink != BenchmarkSink::Null)
+    {
+        result.archiveUpright = ok && ArchiveStartsWith(config.sink, probe.path, probe.firstFrame, config.width, config.height);
+        ok = ok && result.archiveUpright;
+        std::remove(probe.path.c_str());
+        std::remove((probe.path + ".idx").c_str());
+    }
+
+    static const char* const STAGE_POINTS[STAGE_COUNT] = { "RowCopy", "FrameDifference", "Integrate", "SinkWrite" };
+    for (int s = 0; s < STAGE_COUNT; ++s)
+        for (const Trace::StageSummary& stage : stages)
+            if (stage.name == STAGE_POINTS[s])
+                result.stages[s] = { stage.meanUs * 1000.0, stage.p50Us * 1000.0, stage.p99Us * 1000.0, stage.maxUs * 1000.0 };
+
+    result.ok = ok && probe.written >= total;
+    result.frames = probe.latencyNs.size();
+    result.drops = probe.skippedAfter - probe.skippedBefore;
+    result.wallSeconds = std::chrono::duration<double>(probe.measureEnd - probe.measureStart).count();
+    result.sustainedFps = result.wallSeconds > 0.0 ? double(result.frames) / result.wallSeconds : 0.0;
+    result.latency = Summarize(probe.latencyNs);
+    result.peakRssBytes = PeakRssBytes();
+    return result;
+}
+
+static void AppendTiming(std::string& json, const char* name, const StageTiming& timing)
+{
+    char buf[192];
+    std::snprintf(buf, sizeof(buf), "\"%s\":{\"mean_ns\":%.0f,\"p50_ns\":%.0f,\"p99_ns\":%.0f,\"max_ns\":%.0f}",
+        name, timing.meanNs, timing.p50Ns, timing.p99Ns, timing.maxNs);
+    json += buf;
+}
+
+std::string FormatBenchmarkJson(const std::vector<BenchmarkResult>& results)
+{
+    std::string json = "{\"benchmark\":\"pipeline\",\"results\":[";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchmarkResult& r = results[i];
+        char buf[640];
+        std::snprintf(buf, sizeof(buf),
+            "%s\n{\"workload\":\"%s\",\"width\":%u,\"height\":%u,\"target_fps\":%.3f,\"sink\":\"%s\",\"level_bins\":%u,"
+            "\"ok\":%s,\"frames\":%llu,\"drops\":%llu,\"wall_seconds\":%.4f,\"sustained_fps\":%.2f,"
+            "\"sink_bytes\":%llu,\"archive_upright\":%s,\"peak_rss_bytes\":%llu,\"source_bytes\":%llu,\"frame_buffers\":\"%s\",\"dtlb_misses\":%lld,",
+            i ? "," : "", SyntheticWorkloadName(r.config.workload), r.config.width, r.config.height, r.config.fps,
+            BenchmarkSinkName(r.config.sink), r.config.levelBins, r.ok ? "true" : "false",
+            (unsigned long long)r.frames, (unsigned long long)r.drops, r.wallSeconds, r.sustainedFps,
+            (unsigned long long)r.sinkBytes, r.archiveUpright ? "true" : "false", (unsigned long long)r.peakRssBytes, (unsigned long long)r.sourceBytes,
+            r.config.frameArena ? FrameArenaBackingName(r.arenaBacking) : "vector", (long long)r.dtlbMisses);
+        json += buf;
+
+        AppendTiming(json, "latency", r.latency);
+        json += ",\"stages\":{";
+        for (int s = 0; s < STAGE_COUNT; ++s)
+        {
+            if (s)
+                json += ",";
+            AppendTiming(json, STAGE_NAMES[s], r.stages[s]);
+        }
+        json += "}}";
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+bool SamePlanes(const WearMap& a, const WearMap& b)
+{
+    const size_t bytes = size_t(a.Width()) * a.Height() * sizeof(double);
+    if (a.Width() != b.Width() || a.Height() != b.Height() || a.TotalSeconds() != b.TotalSeconds())
+        return false;
+    for (int c = 0; c < 3; ++c)
+        if (std::memcmp(a.Plane(c), b.Plane(c), bytes) != 0)
+            return false;
+    return true;
+}
+
+bool RunPipelineMode(const BenchmarkOptions& options, std::string& json)
+{
+    BenchmarkConfig config = options.config;
+    if (!options.tracePath.empty())
+        Trace::Enable(true);
+    bool ok = true;
+    std::vector<BenchmarkResult> results;
+    for (SyntheticWorkload workload : options.workloads)
+    {
+        config.workload = workload;
+        results.push_back(RunPipelineBenchmark(config));
+        ok = ok && results.back().ok;
+    }
+    if (!options.tracePath.empty())
+    {
+        Trace::Enable(false);
+        ok = Trace::SaveChromeJson(options.tracePath) && ok;
+    }
+    json = FormatBenchmarkJson(results);
+    return ok;
+}
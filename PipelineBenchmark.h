@@ -0,0 +1,647 @@
+#pragma once
+
+#include "AppAttribution.h"
+#include "CaptureRateController.h"
+#include "ColdStart.h"
+#include "FrameArena.h"
+#include "FrameProxy.h"
+#include "GopParallelSink.h"
+#include "HdrFormats.h"
+#include "HeatmapExport.h"
+#include "LifetimeProjection.h"
+#include "PointerWear.h"
+#include "SegmentedRecorder.h"
+#include "SyntheticDesktop.h"
+#include "WearIntegral.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// End-to-end benchmark of the capture pipeline on SyntheticCaptureSource: no GPU, no
+// display, runs the same on Linux and Windows. A CapturePipeline with default settings
+// and a recording into the sink captures the frames, and each stage is timed by its
+// trace points (Trace.h) over the measured frames:
+//
+//   capture  RowCopy, the source's readback copy
+//   stats    FrameDifference
+//   wear     Integrate: WearMap, pointer, LevelHistogram when levelBins > 0
+//   sink     SinkWrite, IFrameSink::WriteFrame in the SegmentedRecorder
+//
+// With fps > 0 frames come due on a wall-clock schedule and frames missed while a stage
+// was busy count as drops; latency is from a frame coming due to its sink write
+// returning. fps = 0 runs flat out.
+
+enum class BenchmarkSink
+{
+    Null,
+    Raw,  // RawBgraSink
+    Y4m,  // Y4mSink
+    Tile  // TileArchiveSink
+};
+
+const char* BenchmarkSinkName(BenchmarkSink sink);
+
+struct BenchmarkConfig
+{
+    SyntheticWorkload workload = SyntheticWorkload::StaticDesktop;
+    uint32_t width = 1920, height = 1080;
+    double fps = 60.0;            // 0 = unpaced
+    uint32_t frames = 300;        // measured frames
+    uint32_t warmupFrames = 30;   // run first, not measured
+    uint32_t loopFrames = 32;     // distinct frames rendered up front
+    BenchmarkSink sink = BenchmarkSink::Null;
+    std::string sinkPath = "bench_sink"; // file sinks write here (plus segment number and extension), deleted after
+    uint32_t levelBins = 0;
+    bool frameArena = true;       // PipelineConfig::frameArena; false = std::vector frame buffers
+};
+
+// Nanoseconds per frame of one stage
+struct StageTiming
+{
+    double meanNs = 0.0;
+    double p50Ns = 0.0;
+    double p99Ns = 0.0;
+    double maxNs = 0.0;
+};
+
+enum BenchmarkStage
+{
+    STAGE_CAPTURE,
+    STAGE_STATS,
+    STAGE_WEAR,
+    STAGE_SINK,
+    STAGE_COUNT
+};
+
+struct BenchmarkResult
+{
+    BenchmarkConfig config;
+    bool ok = false;
+    uint64_t frames = 0;          // measured frames processed
+    uint64_t drops = 0;           // frames that came due but were never captured
+    double wallSeconds = 0.0;
+    double sustainedFps = 0.0;    // frames / wallSeconds
+    StageTiming stages[STAGE_COUNT];
+    StageTiming latency;          // due -> written
+    uint64_t sinkBytes = 0;
+    bool archiveUpright = true;   // a file sink's first frame reads back as captured, top row first
+    uint64_t peakRssBytes = 0;    // process-wide high-water mark after the run
+    uint64_t sourceBytes = 0;     // of which the rendered loop
+    FrameArenaBacking arenaBacking = FrameArenaBacking::None; // the pipeline's frame buffers, None = std::vector
+    int64_t dtlbMisses = -1;      // dTLB misses over the measured frames; -1 = no counters
+};
+
+BenchmarkResult RunPipelineBenchmark(const BenchmarkConfig& config);
+
+// {"benchmark":"pipeline","results":[...]}, one object per run, stable keys
+std::string FormatBenchmarkJson(const std::vector<BenchmarkResult>& results);
+
+// The pipeline on config.workload with its frame buffers from a FrameArena and from
+// std::vector, unpaced so that only throughput differs, alternating twice and keeping the
+// faster run of each. dTLB misses need perf counters (-1 without); the throughput and
+// per-stage differences are reported either way.
+struct FrameArenaComparison
+{
+    BenchmarkResult arena, vectors;
+    double fpsGainPercent = 0.0;     // arena sustained fps over the vectors'
+    double captureGainPercent = 0.0; // capture stage mean, vectors' over the arena's
+    double wearGainPercent = 0.0;    // wear stage mean, the same
+    int64_t dtlbMissesSaved = -1;    // vectors' - arena's, -1 without counters
+};
+
+FrameArenaComparison MeasureFrameArena(const BenchmarkConfig& config);
+std::string FormatFrameArenaJson(const FrameArenaComparison& comparison);
+
+// Cost of one TRACE_SCOPE around a few nanoseconds of work: without a scope, with tracing
+// disabled at run time and enabled. Disabled must stay within noise of the baseline.
+// Then threads threads name themselves and run a scope, all at once with tracing
+// disabled and one after another with it enabled: the first must take no ring, the
+// others must share one as each exits.
+struct TraceOverhead
+{
+    uint64_t iterations = 0;
+    double baselineNs = 0.0; // per iteration
+    double disabledNs = 0.0;
+    double enabledNs = 0.0;
+    uint32_t threads = 0;
+    size_t idleThreadRings = 0;   // rings allocated by the threads while disabled
+    size_t tracedThreadRings = 0; // and while enabled
+};
+
+TraceOverhead MeasureTraceOverhead(uint64_t iterations = 50000000, uint32_t threads = 32);
+std::string FormatTraceOverheadJson(const TraceOverhead& overhead);
+
+// Per-frame cost of the HDR readback kernels on a synthetic frame (the workload's desktop
+// with a 1000 nit highlight) encoded in each format: DecodeFrame into levels + BGRA view,
+// MeasureLuminance with and without F16C, and WearMap::AccumulateLevels against the
+// 8-bit Accumulate.
+struct HdrKernelTiming
+{
+    CapturePixelFormat format = CapturePixelFormat::Bgra8;
+    double decodeNs = 0.0;         // per frame, best of the repetitions
+    double luminanceNs = 0.0;      // default dispatch
+    double luminanceScalarNs = 0.0;
+    float peakNits = 0.0f;
+    bool simdMatches = true;       // default dispatch agrees with the scalar kernel
+};
+
+struct HdrKernelBenchmark
+{
+    uint32_t width = 0, height = 0;
+    bool f16c = false;
+    std::vector<HdrKernelTiming> formats;
+    double accumulateNs = 0.0;       // WearMap::Accumulate on the BGRA view
+    double accumulateLevelsNs = 0.0; // WearMap::AccumulateLevels on the level codes
+};
+
+HdrKernelBenchmark MeasureHdrKernels(SyntheticWorkload workload, uint32_t width, uint32_t height, uint32_t repetitions = 20);
+std::string FormatHdrKernelJson(const HdrKernelBenchmark& bench);
+
+// WearMap's integer accumulation against a long double reference (only double under
+// MSVC, still well below the error measured): accuracyFrames random 32x32 frames shown
+// for random 1/240 - 1/30 s, with a static interval of several seconds now and then,
+// summed both ways and as float32 planes (the old path, for comparison). Then the per-frame cost of Accumulate on the workload's desktop at
+// width x height, against the float32 accumulate it replaced.
+struct WearAccuracyBenchmark
+{
+    uint64_t frames = 0;
+    double maxRelativeError = 0.0;      // worst subpixel, WearMap vs the reference
+    double floatMaxRelativeError = 0.0; // the same for float32 planes
+    double totalTimeError = 0.0;        // seconds, |TotalSeconds - sum of frame times|
+    uint32_t width = 0, height = 0;
+    double accumulateNs = 0.0;          // per frame, best of the repetitions
+    double floatAccumulateNs = 0.0;
+};
+
+WearAccuracyBenchmark MeasureWearAccuracy(SyntheticWorkload workload, uint32_t width, uint32_t height,
+    uint64_t accuracyFrames = 200000, uint32_t repetitions = 20);
+std::string FormatWearAccuracyJson(const WearAccuracyBenchmark& bench);
+
+// LevelHistogram::Evaluate against the exact WearMap, per bin count, workload and
+// exponent, over config.frames frames at 1 / config.fps s (60 fps when unpaced) at
+// config.width x config.height. Errors are relative: max over subpixels with more than
+// 5% of full-drive stress, total over the panel. Then a long session (30 s frames at
+// 320x180) with 256 bins, where only the counter rounding differs from the WearMap, a
+// Save / Load round trip, and Evaluate of a 16-bin 4K histogram on maxThreads threads.
+struct LevelHistogramRun
+{
+    uint32_t bins = 0;
+    SyntheticWorkload workload = SyntheticWorkload::StaticDesktop;
+    float exponent = 0.0f;
+    double maxErrorPercent = 0.0;
+    double totalErrorPercent = 0.0;
+};
+
+struct LevelHistogramBenchmark
+{
+    uint32_t width = 0, height = 0;
+    uint64_t frames = 0;
+    std::vector<LevelHistogramRun> runs;
+    double longSeconds = 0.0;
+    int longScale = 0;                 // LevelHistogram::Scale at the end
+    double longMaxErrorPercent = 0.0;
+    double longTotalErrorPercent = 0.0;
+    bool reloaded = false;             // Load(Save) evaluates identically
+    unsigned evaluateThreads = 0;
+    double evaluate4kMs = 0.0;         // best of 3
+    double evaluate4kGBps = 0.0;       // counters read per second
+};
+
+LevelHistogramBenchmark MeasureLevelHistogram(const BenchmarkConfig& config,
+    const std::vector<SyntheticWorkload>& workloads, unsigned maxThreads);
+std::string FormatLevelHistogramJson(const LevelHistogramBenchmark& bench);
+
+// LifetimeProjection on a 4K map of random stress (a tenth of it zero, some values
+// repeated): every Summarize percentile against std::nth_element on the plane, and the
+// ProjectMap / Summarize times. Then at beta = 1 HoursToThreshold of a session of
+// frames random 1-50 ms long against summing each frame's damage dt * f / tau and
+// repeating the session until exp(-sum) reaches the threshold; f is the WearMap LUT,
+// frame times whole ticks, so both sides see the same stress.
+struct LifetimeBenchmark
+{
+    uint32_t width = 0, height = 0;
+    uint64_t percentiles = 0;          // channel x threshold x fraction checked
+    uint64_t percentileMismatches = 0; // not bit-identical to nth_element
+    double projectMapMs = 0.0;         // best of 3, L80
+    double summarizeMs = 0.0;          // best of 3, default thresholds and fractions
+    uint64_t frames = 0;
+    double betaOneMaxRelativeError = 0.0; // worst subpixel, channel and threshold
+};
+
+LifetimeBenchmark MeasureLifetime(uint64_t frames = 20000);
+std::string FormatLifetimeJson(const LifetimeBenchmark& bench);
+
+// OfflineAnalysis of a raw archive of the workload (config.frames frames at config.fps,
+// written to config.sinkPath + ".raw" and deleted after) with 1, 2, 4, ... threads up to
+// maxThreads (0 = hardware concurrency). Every run is compared bit for bit against the
+// sequential reference: one thread, one span, and that against one without merging
+// unchanged frames.
+struct OfflineScalingRun
+{
+    unsigned threads = 0;
+    uint32_t spans = 0;
+    double wallSeconds = 0.0;
+    double mergeSeconds = 0.0;
+    double speedup = 0.0;          // reference wall time / wallSeconds
+    bool identical = false;
+};
+
+struct OfflineScalingBenchmark
+{
+    bool ok = false;
+    uint64_t frames = 0;
+    double mediaSeconds = 0.0;
+    double referenceSeconds = 0.0;
+    uint64_t framesMerged = 0;     // reference frames added to an identical predecessor
+    double unmergedSeconds = 0.0;  // the reference without mergeUnchanged
+    std::vector<OfflineScalingRun> runs;
+};
+
+OfflineScalingBenchmark MeasureOfflineScaling(const BenchmarkConfig& config, unsigned maxThreads = 0);
+std::string FormatOfflineScalingJson(const OfflineScalingBenchmark& bench);
+
+// MediaRanker on a wear map of config.width x config.height (every workload shown for a
+// while) against clips synthetic signatures: resampling the map once, then ranking the
+// whole library by each objective with SSE and scalar dot products.
+struct RankingBenchmark
+{
+    uint32_t clips = 0;
+    double resampleMs = 0.0;       // MediaRanker::SetWear
+    double wornSimdMs = 0.0, wornScalarMs = 0.0;
+    double evenSimdMs = 0.0, evenScalarMs = 0.0;
+    bool sameBest = false;         // SIMD and scalar agree on the best clip of both objectives
+    bool saveLoad = false;         // MediaLibrary::Save / Load round trip is exact
+};
+
+RankingBenchmark MeasureMediaRanking(const BenchmarkConfig& config, uint32_t clips = 5000);
+std::string FormatRankingJson(const RankingBenchmark& bench);
+
+// AppAttribution on a synthetic window-rectangle stream: four applications whose windows
+// move and restack every layoutFrames frames over the workload, checked against a
+// per-pixel label map reference (wear growth per pixel summed by the app owning it).
+struct AttributionBenchmark
+{
+    uint64_t frames = 0;
+    uint64_t layouts = 0;
+    double setLayoutMs = 0.0;      // mean AppAttribution::SetLayout (settle + new pieces)
+    double labelMapMs = 0.0;       // mean reference cost per layout change
+    double maxRelativeError = 0.0; // per application against the reference
+    std::vector<AppLedgerEntry> ledger;
+};
+
+AttributionBenchmark MeasureAttribution(const BenchmarkConfig& config, uint32_t layoutFrames = 15);
+std::string FormatAttributionJson(const AttributionBenchmark& bench);
+
+// WearIntegral beside a WearMap: taking a map over once, keeping up with every workload
+// frame by frame (by tiles rewritten), and random rectangle queries against scans of the
+// planes (SumWearRect), which also check the sums. A second integral fed the changed tiles
+// of TileHasher instead of comparing frames must answer every query identically.
+struct IntegralRun
+{
+    SyntheticWorkload workload = SyntheticWorkload::StaticDesktop;
+    uint64_t frames = 0;
+    double tilesPerFrame = 0.0;    // mean tiles rewritten, of TilesX() * TilesY()
+    double accumulateMs = 0.0;     // mean WearMap::Accumulate, for scale
+    double updateMs = 0.0;         // mean WearIntegral::Accumulate
+    double hintedUpdateMs = 0.0;   // the same with the hasher's changed tiles
+};
+
+struct IntegralBenchmark
+{
+    uint32_t tiles = 0;
+    double resetMs = 0.0;          // WearIntegral::Reset
+    std::vector<IntegralRun> runs;
+    uint32_t queries = 0;
+    double queryNs = 0.0;          // mean Query
+    double batchNs = 0.0;          // QueryBatch, per rectangle
+    double scanNs = 0.0;           // SumWearRect over the same rectangles
+    double maxRelativeError = 0.0; // against the scans, relative to the whole map
+    bool hottestMatches = false;   // MaxTile is the tile a scan finds
+    bool hintedMatches = false;    // the hinted integral's batch equals the other's
+};
+
+IntegralBenchmark MeasureWearIntegral(const BenchmarkConfig& config, const std::vector<SyntheticWorkload>& workloads,
+    uint32_t queries = 10000);
+std::string FormatIntegralJson(const IntegralBenchmark& bench);
+
+// HeatmapExport of a wear map of config.width x config.height (every workload shown for a
+// while): colouring with SSE2 and scalar, contours, PNG on 1 and threads threads, float
+// TIFF. The PNG must not depend on the thread count. The same map at 320x180 must give
+// the PNG whose hash is committed here, or with a golden path, the PNG at
+// config.width x config.height must equal that file byte for byte; a missing file fails.
+struct HeatmapBenchmark
+{
+    uint32_t threads = 0;
+    double renderMs = 0.0;         // RenderHeatmap without contours, SSE2
+    double renderScalarMs = 0.0;
+    double contoursMs = 0.0;       // what contourLevels adds to RenderHeatmap
+    size_t contourSegments = 0;
+    double pngSerialMs = 0.0;      // EncodePng on the calling thread
+    double pngParallelMs = 0.0;    // EncodePng on threads threads
+    double tiffMs = 0.0;           // EncodeWearTiff, Float32
+    size_t pngBytes = 0;
+    bool simdMatches = false;
+    bool deterministic = false;
+    uint64_t goldenHash = 0;       // FNV-1a of the 320x180 PNG
+    std::string golden;            // "match", "mismatch" or "missing" (golden path)
+};
+
+HeatmapBenchmark MeasureHeatmapExport(const BenchmarkConfig& config, unsigned threads = 0,
+    const std::string& goldenPath = std::string());
+std::string FormatHeatmapJson(const HeatmapBenchmark& bench);
+
+// FrameDownscaler on a frame of config.width x config.height (first workload) laid out
+// like a mapped readback (top-down, 256-byte row pitch), per factor: the proxy alone
+// with SSE2 and scalar, fused into the row copy as with an archive, and straight from the
+// readback without one; against the plain row copy, and WearMap::Accumulate at both sizes.
+struct ProxyRun
+{
+    uint32_t factor = 0;
+    uint32_t proxyWidth = 0, proxyHeight = 0;
+    double simdMs = 0.0;           // Downscale of a copied frame
+    double scalarMs = 0.0;
+    double fusedMs = 0.0;          // row copy + AddRow per row (archive requested)
+    double proxyOnlyMs = 0.0;      // AddRow from the readback, no copy (no archive)
+    double wearMs = 0.0;           // WearMap::Accumulate of the proxy
+    bool simdMatches = false;      // SSE2 and scalar give the same bytes
+};
+
+struct ProxyBenchmark
+{
+    uint32_t width = 0, height = 0;
+    double copyMs = 0.0;           // the row copy alone
+    double wearMs = 0.0;           // WearMap::Accumulate of the full frame
+    std::vector<ProxyRun> runs;
+};
+
+ProxyBenchmark MeasureFrameProxy(const BenchmarkConfig& config);
+std::string FormatProxyJson(const ProxyBenchmark& bench);
+
+// Cold start pieces that run without Windows: RefCountedInit over rotations segments
+// whose encoders each take a reference, alone and under a process lease (startup stands
+// in for MFStartup with a fixed delay); a CaptureSession's Start (Open + Warm) and time to
+// its first frame on SyntheticCaptureSource; and that first frame copied into a fresh
+// buffer against a FrameArena slot, which Reset already touched.
+struct ColdStartBenchmark
+{
+    uint32_t rotations = 0;
+    double startupMs = 0.0;             // the simulated platform init
+    uint64_t startupsPerSegment = 0;    // no lease: one per rotation
+    uint64_t startupsLeased = 0;        // under a lease: one
+    double perSegmentInitMs = 0.0;      // spent in startup
+    double leasedInitMs = 0.0;
+    bool balanced = false;              // no references left, a shutdown per startup
+    double openMs = 0.0;                // CaptureSessionStats
+    double warmMs = 0.0;
+    double firstFrameMs = 0.0;
+    double firstCopyColdMs = 0.0;       // CaptureNext into untouched memory
+    double firstCopyArenaMs = 0.0;      // CaptureNext into a FrameArena slot
+};
+
+ColdStartBenchmark MeasureColdStart(const BenchmarkConfig& config, uint32_t rotations = 20);
+std::string FormatColdStartJson(const ColdStartBenchmark& bench);
+
+// TileHasher per workload on config.frames frames at config.width x config.height: on a
+// frame laid out like a mapped readback (top-down, 256-byte row pitch), the row copy
+// alone against the copy that hashes in the same pass, and the hash alone with SSE2 and
+// scalar. What the hash adds to the copy must stay below the tile compare with a copy of
+// the previous frame that it spares WearIntegral and TileEncoder each. Then over the frame
+// sequence, the tiles and frames found unchanged (the work the pipeline skips), each
+// tile's verdict checked against memcmp with the previous frame.
+struct TileHashRun
+{
+    SyntheticWorkload workload = SyntheticWorkload::StaticDesktop;
+    double copyMs = 0.0;           // the row copy alone
+    double fusedMs = 0.0;          // row copy + AddRow(row, copy)
+    double overheadPercent = 0.0;  // (fusedMs - copyMs) / copyMs
+    double compareMs = 0.0;        // memcmp of every tile with an identical previous frame
+    bool withinBudget = false;     // fusedMs - copyMs <= compareMs
+    double simdMs = 0.0;           // Hash of a copied frame
+    double scalarMs = 0.0;
+    bool simdMatches = false;      // SSE2 and scalar give the same hashes
+    uint64_t frames = 0;
+    double tileSkipRatio = 0.0;    // unchanged tiles / tiles, after the first frame
+    double frameSkipRatio = 0.0;   // frames without a changed tile / frames after the first
+    uint64_t missed = 0;           // tiles that changed but hashed the same
+    uint64_t spurious = 0;         // identical tiles reported as changed
+};
+
+struct TileHashBenchmark
+{
+    uint32_t width = 0, height = 0;
+    std::vector<TileHashRun> runs;
+};
+
+TileHashBenchmark MeasureTileHash(const BenchmarkConfig& config, const std::vector<SyntheticWorkload>& workloads);
+std::string FormatTileHashJson(const TileHashBenchmark& bench);
+
+// TileEncoder / TileDecoder round trip per workload over config.frames frames at
+// config.width x config.height, with the Huffman stage and without it, and with it given
+// TileHasher's changed tiles: every decoded frame is compared byte for byte with the one
+// encoded. Rendering and hashing are not timed.
+struct TileCodecRun
+{
+    SyntheticWorkload workload = SyntheticWorkload::StaticDesktop;
+    bool huffman = true;
+    bool hashedTiles = false;   // EncodeFrame given TileHasher::Changed()
+    uint64_t frames = 0;
+    uint64_t rawBytes = 0;
+    uint64_t encodedBytes = 0;
+    double ratio = 0.0;         // rawBytes / encodedBytes
+    double encodeMBps = 0.0;    // raw MB per second of EncodeFrame
+    double decodeMBps = 0.0;
+    uint64_t mismatches = 0;    // frames that failed to decode or decoded differently
+};
+
+struct TileCodecBenchmark
+{
+    uint32_t width = 0, height = 0;
+    std::vector<TileCodecRun> runs;
+};
+
+TileCodecBenchmark MeasureTileCodec(const BenchmarkConfig& config, const std::vector<SyntheticWorkload>& workloads);
+std::string FormatTileCodecJson(const TileCodecBenchmark& bench);
+
+// CaptureSession lifecycle under stress, on sources that do to it what only a real
+// desktop does otherwise: every few frames they lose access and come back at the same or
+// the other of two sizes, and some reopens fail. sessions threads capture at once, each
+// from its own session, while a control thread per session stops and restarts it. Every
+// frame must carry the size of the buffer it was written into with the guard bytes behind
+// it intact, frame ids must rise across restarts and the stats must count what the
+// callers saw. Then a CapturePipeline with a recording runs on such a source for
+// pipelineMs and must follow the mode changes with its wear map.
+struct SessionStressBenchmark
+{
+    uint32_t sessions = 0;
+    uint64_t calls = 0;            // CaptureNext, over all sessions
+    uint64_t frames = 0;
+    uint64_t restarts = 0;         // CaptureSessionStats::restarts
+    uint64_t resized = 0;          // CaptureNext returned Resized
+    uint64_t faults = 0;           // reopens that failed, the session was started again
+    uint64_t cycles = 0;           // Stop / Start from the control threads
+    double seconds = 0.0;
+    bool framesSized = false;      // every frame the size of its buffer, guard bytes intact
+    bool idsRising = false;        // frame ids strictly increasing per session
+    bool statsMatch = false;       // frames, restarts and mode changes as the sources made them
+    bool resetClears = false;      // Reset leaves the session Idle with zero stats
+    uint32_t pipelineModeChanges = 0;
+    uint64_t pipelineFrames = 0;
+    bool pipelineFollows = false;  // wear map at the session's last size, recording closed
+};
+
+SessionStressBenchmark MeasureSessionStress(uint32_t sessions = 4, uint32_t calls = 20000, uint32_t pipelineMs = 600);
+std::string FormatSessionStressJson(const SessionStressBenchmark& bench);
+
+// SegmentedRecorder on a stub encoder that writes a 16-byte packet per frame, has a
+// keyframe every gopFrames frames and takes a while to open and finalize, fed frames
+// timestamped at 60 fps but paced faster than real time. Cuts must fall on keyframes with
+// every frame in exactly one segment, in order and without timestamp gaps; two failed
+// opens must be retried on the worker with backoff while WriteFrame goes on into the
+// current segment. Segments without frames must not stay on disk. The files go to
+// directory and are deleted after.
+struct SegmentBenchmark
+{
+    uint64_t frames = 0;
+    uint32_t gopFrames = 0;
+    uint32_t segments = 0;
+    SegmentStats stats;
+    double maxWriteMs = 0.0;       // slowest WriteFrame, switches included
+    double failedOpenMs = 0.0;     // how long each failing open takes
+    bool ordered = false;          // every frame once, in order, segments back to back
+    bool keyframeCuts = false;     // cuts on keyframes, no segment shorter than the limit
+    bool filesMatch = false;       // one file per segment holding its frames
+    bool emptyRemoved = false;     // Begin + End without a frame leaves no file
+};
+
+SegmentBenchmark MeasureSegments(const std::string& directory, uint32_t frames = 3000);
+std::string FormatSegmentJson(const SegmentBenchmark& bench);
+
+// The headless daemon's control protocol (ControlProtocol.h) without the named pipe: a
+// script of command lines, with the odd casing, whitespace and bad arguments, runs
+// against a CapturePipeline on SyntheticCaptureSource at config.width x config.height,
+// and every reply must start and contain what the script expects. ControlLineBuffer gets
+// the script split at awkward byte boundaries and must reassemble it, and an overlong
+// line must make it refuse the client. Afterwards the pipeline's region queries (its wear
+// integral) must agree with scans of its map.
+struct ControlBenchmark
+{
+    uint32_t commands = 0;
+    std::vector<std::string> failed; // commands with an unexpected reply
+    double statsUs = 0.0;            // mean stats round trip while running
+    bool linesSplit = false;         // every line reassembled from 1..7 byte pieces
+    bool overlongRefused = false;    // MAX_LINE bytes without a newline refused, one less taken
+    bool regionsMatch = false;       // QueryWear within 1e-9 of the map's total of SumWearRect
+};
+
+ControlBenchmark MeasureControlProtocol(const BenchmarkConfig& config);
+std::string FormatControlJson(const ControlBenchmark& bench);
+
+// GopParallelSink on StubChunkEncoder with 1, 2 and 4 encoders, gopFrames frames per
+// chunk and a partial chunk at the end; every twelfth chunk finishes late so later ones
+// wait to be written. The file must equal the chunks encoded one after another by a
+// single encoder, the finished chunks held back must stay under 2 * encoders and the
+// frame copies under the derived queue bound. The file goes to directory and is deleted.
+struct GopParallelRun
+{
+    unsigned encoders = 0;
+    uint64_t chunks = 0;
+    uint32_t maxQueuedFrames = 0;  // the bound the sink derives: encoders * gopFrames
+    GopParallelStats stats;
+    double ms = 0.0;
+    bool matches = false;          // byte-identical to the sequential encode
+};
+
+struct GopParallelBenchmark
+{
+    uint32_t width = 0, height = 0;
+    uint32_t frames = 0, gopFrames = 0;
+    std::vector<GopParallelRun> runs;
+};
+
+GopParallelBenchmark MeasureGopParallel(const std::string& directory, uint32_t frames = 301, uint32_t gopFrames = 8);
+std::string FormatGopParallelJson(const GopParallelBenchmark& bench);
+
+// PointerWear over a synthetic pointer track of steps intervals on the first workload at
+// width x height: a random walk that leaves the frame on every side, hides now and then
+// and cycles through monochrome, colour and masked-colour shapes, over desktop frames
+// that change every 100 steps. The map and integral it keeps must match, bit for bit and
+// to 1e-9 of the wear, what the frames with the pointer composited into them add.
+struct PointerWearBenchmark
+{
+    uint32_t width = 0, height = 0;
+    uint32_t steps = 0;
+    uint32_t covered = 0;          // steps with a visible pointer on the frame
+    double pointerUs = 0.0;        // PointerWear::Accumulate into map and integral, per step
+    double compositedUs = 0.0;     // drawing the pointer into a copy of the frame instead
+    bool identical = false;        // planes and total time equal to the composited frames'
+    bool integralMatches = false;  // WearIntegral queries equal a scan of those planes
+};
+
+PointerWearBenchmark MeasurePointerWear(SyntheticWorkload workload, uint32_t width, uint32_t height, uint32_t steps = 3000);
+std::string FormatPointerWearJson(const PointerWearBenchmark& bench);
+
+// CaptureRateController replayed over rate traces against a capture at a fixed maxFps:
+// synthetic traces at config.maxFps that are idle all the time, 20% and 80% of the time
+// active (BuildSyntheticRateTrace, captureSeconds / analysisSeconds per frame), the 20%
+// one again after a SaveRateTrace / LoadRateTrace round trip, and a recorded trace when
+// tracePath is set. Saved = the cost of the baseline frames the controller skipped.
+struct RateControllerRun
+{
+    std::string trace;             // idle, mostly_idle, busy, reloaded or the file
+    RateControllerReport report;
+    double savedPercent = 0.0;     // capture + analysis saved / baseline cost
+};
+
+struct RateControllerBenchmark
+{
+    RateControllerConfig config;
+    double seconds = 0.0;          // length of the synthetic traces
+    bool reloaded = false;         // the round-tripped trace replays like the original
+    bool loaded = true;            // tracePath loaded (true without one)
+    std::vector<RateControllerRun> runs;
+};
+
+RateControllerBenchmark MeasureRateController(const std::string& tracePath, double seconds = 600.0,
+    double captureSeconds = 0.002, double analysisSeconds = 0.008);
+std::string FormatRateControllerJson(const RateControllerBenchmark& bench);
+
+#ifdef PIPELINE_BENCH_X11
+// X11CaptureSource against a live display, normally Xvfb at the size to measure:
+//
+//   Xvfb :99 -screen 0 3840x2160x24 &
+//   ./pipeline_bench --x11 --display=:99 --workload=video --frames=300
+//
+// An X11Presenter draws the first workload's frames onto the root window, changed
+// bounding box only, and a CaptureSession captures each one: with XDAMAGE and with a grab
+// on every call. Every captured frame is compared with the one presented.
+struct X11CaptureRun
+{
+    bool damage = false;           // XDAMAGE drove the capture
+    uint64_t frames = 0;           // presented
+    uint64_t captured = 0;         // CaptureNext returned Frame
+    uint64_t timeouts = 0;         // nothing changed (damage only)
+    StageTiming capture;           // CaptureNext of a Frame: event, XShmGetImage, copy
+    double captureFps = 0.0;       // 1e9 / capture.meanNs
+    double dirtyFraction = 0.0;    // mean over captured frames
+    double wearMs = 0.0;           // mean WearMap::Accumulate
+    bool matches = false;          // every captured frame equals the frame presented
+};
+
+struct X11CaptureBenchmark
+{
+    std::string display;
+    uint32_t width = 0, height = 0;
+    std::vector<X11CaptureRun> runs;
+};
+
+// config.width / height are ignored: the display's size is measured
+X11CaptureBenchmark MeasureX11Capture(const BenchmarkConfig& config, const std::string& display);
+std::string FormatX11CaptureJson(const X11CaptureBenchmark& bench);
+#endif
+
+// pipeline_bench / --bench: one mode, --NAME or --mode=NAME, default the pipeline with one
+// run per workload; the modes and options are in BenchmarkCommandLine.cpp and --help
+// prints them. --bench itself is skipped; any other unknown argument or bad value prints
+// the usage and returns 2. Otherwise returns 0 when the mode's self-check passed.
+int RunBenchmarkCommandLine(const std::vector<std::string>& args, const std::string& defaultOut = "-");
@@ -0,0 +1,21 @@
+// Stand-alone pipeline benchmark for machines without Windows or a GPU. The Windows
+// executable runs the same benchmark with --bench. Linux / macOS:
+//
+//   g++ -std=c++17 -O2 -pthread -o pipeline_bench PipelineBenchmarkMain.cpp BenchmarkCommandLine.cpp
+//       *Benchmark.cpp SyntheticDesktop.cpp CaptureSession.cpp CaptureRateController.cpp
+//       WearMap.cpp LevelHistogram.cpp ArchiveSinks.cpp TileCodec.cpp WorkerPool.cpp Trace.cpp FrameArena.cpp
+//       HdrFormats.cpp OfflineAnalysis.cpp MediaRanking.cpp AppAttribution.cpp WearIntegral.cpp
+//       HeatmapExport.cpp Colormap.cpp FrameProxy.cpp ColdStart.cpp TileHash.cpp CapturePipeline.cpp
+//       SegmentedRecorder.cpp GopParallelSink.cpp ControlProtocol.cpp FrameSink.cpp PointerWear.cpp
+//       LifetimeProjection.cpp
+//   ./pipeline_bench --size=1920x1080 --fps=60 --frames=600 --out=bench.json
+//
+// The X11 capture benchmark (--x11) additionally needs -DPIPELINE_BENCH_X11
+// X11CaptureSource.cpp -lX11 -lXext -lXfixes -lXdamage.
+
+#include "PipelineBenchmark.h"
+
+int main(int argc, char** argv)
+{
+    return RunBenchmarkCommandLine(std::vector<std::string>(argv + 1, argv + argc));
+}
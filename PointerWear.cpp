@@ -0,0 +1,142 @@
+#include "PointerWear.h"
+
+#include "WearIntegral.h"
+#include "WearMap.h"
+
+#include <algorithm>
+
+bool DecodePointerShape(PointerShapeType type, uint32_t width, uint32_t height, uint32_t pitch,
+    const uint8_t* data, bool bottomUp, PointerShape& out)
+{
+    const uint32_t rows = type == PointerShapeType::Monochrome ? height / 2 : height;
+    if (!data || width == 0 || rows == 0)
+        return false;
+    if (type != PointerShapeType::Monochrome && type != PointerShapeType::Color && type != PointerShapeType::MaskedColor)
+        return false;
+
+    out.width = width;
+    out.height = rows;
+    out.bgra.assign(size_t(width) * rows * 4, 0);
+    out.xorMask.assign(size_t(width) * rows, 0);
+
+    for (uint32_t y = 0; y < rows; ++y)
+    {
+        const uint32_t dstY = bottomUp ? rows - 1 - y : y;
+        uint8_t* px = out.bgra.data() + size_t(dstY) * width * 4;
+        uint8_t* mask = out.xorMask.data() + size_t(dstY) * width;
+
+        if (type == PointerShapeType::Monochrome)
+        {
+            const uint8_t* andRow = data + size_t(y) * pitch;
+            const uint8_t* xorRow = data + size_t(y + rows) * pitch;
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const uint8_t bit = uint8_t(0x80 >> (x & 7));
+                const bool andBit = (andRow[x / 8] & bit) != 0;
+                const bool xorBit = (xorRow[x / 8] & bit) != 0;
+                // AND 1: keep the desktop, inverted if XOR; AND 0: black or white
+                if (andBit)
+                {
+                    if (xorBit)
+                    {
+                        px[x * 4 + 0] = px[x * 4 + 1] = px[x * 4 + 2] = 0xFF;
+                        mask[x] = 1;
+                    }
+                }
+                else
+                {
+                    const uint8_t v = xorBit ? 0xFF : 0x00;
+                    px[x * 4 + 0] = px[x * 4 + 1] = px[x * 4 + 2] = v;
+                    px[x * 4 + 3] = 0xFF;
+                }
+            }
+            continue;
+        }
+
+        const uint8_t* src = data + size_t(y) * pitch;
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            px[x * 4 + 0] = src[x * 4 + 0];
+            px[x * 4 + 1] = src[x * 4 + 1];
+            px[x * 4 + 2] = src[x * 4 + 2];
+            if (type == PointerShapeType::Color)
+            {
+                px[x * 4 + 3] = src[x * 4 + 3];
+            }
+            else if (src[x * 4 + 3] == 0xFF)
+            {
+                mask[x] = 1;
+            }
+            else
+            {
+                px[x * 4 + 3] = 0xFF;
+            }
+        }
+    }
+    return true;
+}
+
+bool CompositePointer(const uint8_t* bgra, uint32_t width, uint32_t height, const PointerState& pointer,
+    PointerRect& rect, std::vector<uint8_t>& out)
+{
+    if (!pointer.visible || !pointer.shape)
+        return false;
+    const PointerShape& shape = *pointer.shape;
+
+    // Clip to the frame; the pointer may hang over any edge
+    const int64_t left = (std::max)(int64_t(pointer.x), int64_t(0));
+    const int64_t top = (std::max)(int64_t(pointer.y), int64_t(0));
+    const int64_t right = (std::min)(int64_t(pointer.x) + shape.width, int64_t(width));
+    const int64_t bottom = (std::min)(int64_t(pointer.y) + shape.height, int64_t(height));
+    if (left >= right || top >= bottom)
+        return false;
+
+    rect.x = uint32_t(left);
+    rect.y = uint32_t(top);
+    rect.width = uint32_t(right - left);
+    rect.height = uint32_t(bottom - top);
+    out.resize(size_t(rect.width) * rect.height * 4);
+
+    for (uint32_t y = 0; y < rect.height; ++y)
+    {
+        const uint32_t shapeY = uint32_t(int64_t(rect.y + y) - pointer.y);
+        const uint32_t shapeX = uint32_t(int64_t(rect.x) - pointer.x);
+        const uint8_t* under = bgra + (size_t(rect.y + y) * width + rect.x) * 4;
+        const uint8_t* over = shape.bgra.data() + (size_t(shapeY) * shape.width + shapeX) * 4;
+        const uint8_t* mask = shape.xorMask.data() + size_t(shapeY) * shape.width + shapeX;
+        uint8_t* dst = out.data() + size_t(y) * rect.width * 4;
+
+        for (uint32_t x = 0; x < rect.width; ++x)
+        {
+            const uint8_t* d = under + x * 4;
+            const uint8_t* s = over + x * 4;
+            uint8_t* o = dst + x * 4;
+            if (mask[x])
+            {
+                o[0] = d[0] ^ s[0];
+                o[1] = d[1] ^ s[1];
+                o[2] = d[2] ^ s[2];
+            }
+            else
+            {
+                const uint32_t a = s[3];
+                o[0] = uint8_t((s[0] * a + d[0] * (255 - a) + 127) / 255);
+                o[1] = uint8_t((s[1] * a + d[1] * (255 - a) + 127) / 255);
+                o[2] = uint8_t((s[2] * a + d[2] * (255 - a) + 127) / 255);
+            }
+            o[3] = d[3];
+        }
+    }
+    return true;
+}
+
+void PointerWear::Accumulate(WearMap& wear, const uint8_t* bgra, const PointerState& pointer, uint64_t ticks,
+    WearIntegral* integral)
+{
+    PointerRect rect;
+    if (ticks == 0 || !CompositePointer(bgra, wear.Width(), wear.Height(), pointer, rect, m_composite))
+        return;
+    wear.AccumulateOverlay(bgra, rect.x, rect.y, rect.width, rect.height, m_composite.data(), ticks);
+    if (integral)
+        integral->AccumulateOverlay(bgra, rect.x, rect.y, rect.width, rect.height, m_composite.data(), ticks);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "CaptureSource.h"
+
+#include <cstdint>
+#include <vector>
+
+class WearIntegral;
+class WearMap;
+
+// DXGI_OUTDUPL_POINTER_SHAPE_TYPE values
+enum class PointerShapeType : uint32_t
+{
+    Monochrome = 1,  // 1 bpp AND mask rows, then as many XOR mask rows; height counts both
+    Color = 2,       // 32 bpp BGRA, straight alpha
+    MaskedColor = 4  // 32 bpp BGRX; alpha 0xFF = XOR the color, 0 = replace with it
+};
+
+// Normalize a backend pointer image into out (id is left alone). bottomUp flips the rows,
+// for sources whose frames are bottom-up. False for an unknown type or empty shape.
+bool DecodePointerShape(PointerShapeType type, uint32_t width, uint32_t height, uint32_t pitch,
+    const uint8_t* data, bool bottomUp, PointerShape& out);
+
+// The part of a frame the pointer covers
+struct PointerRect
+{
+    uint32_t x = 0, y = 0, width = 0, height = 0;
+};
+
+// The frame pixels under the pointer with the pointer drawn over them, packed into out
+// (rect.width * rect.height BGRA). False when the pointer is hidden or off the frame.
+bool CompositePointer(const uint8_t* bgra, uint32_t width, uint32_t height, const PointerState& pointer,
+    PointerRect& rect, std::vector<uint8_t>& out);
+
+// Pointer wear without drawing the pointer into frames. After the wear map accumulated a
+// frame for some ticks, Accumulate replaces what the subpixels under the pointer added
+// with what the composited pixels would have: the cost is the pointer rectangle (32x32 to
+// 256x256) instead of a second full frame. An integral kept beside the map gets the same
+// overlay.
+class PointerWear
+{
+public:
+    void Accumulate(WearMap& wear, const uint8_t* bgra, const PointerState& pointer, uint64_t ticks,
+        WearIntegral* integral = nullptr);
+
+private:
+    std::vector<uint8_t> m_composite;
+};
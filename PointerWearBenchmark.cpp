@@ -0,0 +1,152 @@
+#include "BenchmarkModes.h"
+
+#include "WearMap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+
+// Pointer images of every DXGI type, from random bits with a few fully opaque, fully
+// transparent and XOR pixels guaranteed
+static std::vector<std::shared_ptr<const PointerShape>> BenchPointerShapes(std::mt19937& rng)
+{
+    std::vector<std::shared_ptr<const PointerShape>> shapes;
+    const struct
+    {
+        PointerShapeType type;
+        uint32_t width, height;
+    } SHAPES[] = { { PointerShapeType::Monochrome, 32, 64 }, { PointerShapeType::Color, 48, 48 },
+        { PointerShapeType::MaskedColor, 32, 32 } };
+    for (const auto& spec : SHAPES)
+    {
+        const bool mono = spec.type == PointerShapeType::Monochrome;
+        const uint32_t pitch = mono ? spec.width / 8 : spec.width * 4;
+        std::vector<uint8_t> data(size_t(pitch) * spec.height);
+        for (uint8_t& byte : data)
+            byte = uint8_t(rng());
+        if (!mono)
+            for (size_t i = 3; i < data.size(); i += 16)
+                data[i] = i % 48 == 3 ? 0x00 : 0xFF;
+
+        auto shape = std::make_shared<PointerShape>();
+        if (!DecodePointerShape(spec.type, spec.width, spec.height, pitch, data.data(), false, *shape))
+            continue;
+        shape->id = shapes.size() + 1;
+        shapes.push_back(shape);
+    }
+    return shapes;
+}
+
+PointerWearBenchmark MeasurePointerWear(SyntheticWorkload workload, uint32_t width, uint32_t height, uint32_t steps)
+{
+    PointerWearBenchmark bench;
+    bench.width = width;
+    bench.height = height;
+    bench.steps = steps;
+
+    const size_t frameBytes = size_t(width) * height * 4;
+    const SyntheticDesktop desktop(workload, width, height);
+    std::mt19937 rng(40);
+    const std::vector<std::shared_ptr<const PointerShape>> shapes = BenchPointerShapes(rng);
+    if (shapes.empty())
+        return bench;
+
+    WearMap overlaid, composited;
+    overlaid.Reset(width, height);
+    composited.Reset(width, height);
+    WearIntegral integral;
+    integral.Reset(overlaid);
+    PointerWear pointerWear;
+
+    std::vector<uint8_t> frame(frameBytes), scratch(frameBytes), patch;
+    PointerState pointer;
+    pointer.shape = shapes[0];
+    int32_t x = int32_t(width / 2), y = int32_t(height / 2);
+    int64_t pointerNs = 0, compositedNs = 0;
+    for (uint32_t step = 0; step < steps; ++step)
+    {
+        if (step % 100 == 0)
+            desktop.Render(step / 100, frame.data());
+        if (step % 250 == 0)
+            pointer.shape = shapes[(step / 250) % shapes.size()];
+        // Steps of up to 40 px, pulled back once well past an edge
+        x += int32_t(rng() % 81) - 40;
+        y += int32_t(rng() % 81) - 40;
+        if (x < -96 || x > int32_t(width) + 32)
+            x = int32_t(width / 2);
+        if (y < -96 || y > int32_t(height) + 32)
+            y = int32_t(height / 2);
+        pointer.x = x;
+        pointer.y = y;
+        pointer.visible = rng() % 16 != 0;
+        const uint64_t ticks = 1 + rng() % 400;
+
+        overlaid.AccumulateTicks(frame.data(), ticks);
+        integral.Accumulate(frame.data(), ticks);
+        auto start = Clock::now();
+        pointerWear.Accumulate(overlaid, frame.data(), pointer, ticks, &integral);
+        auto mid = Clock::now();
+
+        // The reference: the pointer drawn into a copy of the frame
+        std::memcpy(scratch.data(), frame.data(), frameBytes);
+        PointerRect rect;
+        if (CompositePointer(frame.data(), width, height, pointer, rect, patch))
+        {
+            bench.covered++;
+            for (uint32_t row = 0; row < rect.height; ++row)
+                std::memcpy(&scratch[(size_t(rect.y + row) * width + rect.x) * 4], &patch[size_t(row) * rect.width * 4],
+                    size_t(rect.width) * 4);
+        }
+        auto end = Clock::now();
+        composited.AccumulateTicks(scratch.data(), ticks);
+
+        pointerNs += std::chrono::duration_cast<std::chrono::nanoseconds>(mid - start).count();
+        compositedNs += std::chrono::duration_cast<std::chrono::nanoseconds>(end - mid).count();
+    }
+    bench.pointerUs = steps ? double(pointerNs) / steps / 1000.0 : 0.0;
+    bench.compositedUs = steps ? double(compositedNs) / steps / 1000.0 : 0.0;
+    bench.identical = SamePlanes(overlaid, composited);
+
+    // Random rectangles, the whole map and single pixels against a scan of the planes
+    bench.integralMatches = true;
+    const double* planes[3] = { composited.Plane(0), composited.Plane(1), composited.Plane(2) };
+    const double total = composited.TotalSeconds() * 3.0 * double(width) * height;
+    for (int q = 0; q < 200 && bench.integralMatches; ++q)
+    {
+        WearRect rect;
+        rect.x = q == 0 ? 0 : rng() % width;
+        rect.y = q == 0 ? 0 : rng() % height;
+        rect.width = q == 0 ? width : q % 3 == 0 ? 1 : 1 + rng() % (width - rect.x);
+        rect.height = q == 0 ? height : q % 3 == 0 ? 1 : 1 + rng() % (height - rect.y);
+        double sum = 0.0;
+        for (uint32_t row = rect.y; row < rect.y + rect.height; ++row)
+            for (uint32_t col = rect.x; col < rect.x + rect.width; ++col)
+                for (const double* plane : planes)
+                    sum += plane[size_t(row) * width + col];
+        sum *= WearMap::UnitSeconds();
+        bench.integralMatches = std::fabs(integral.Query(rect).sum - sum) <= 1e-9 * (std::max)(total, 1.0);
+    }
+    return bench;
+}
+
+std::string FormatPointerWearJson(const PointerWearBenchmark& bench)
+{
+    char buf[384];
+    std::snprintf(buf, sizeof(buf),
+        "{\"benchmark\":\"pointer_wear\",\"width\":%u,\"height\":%u,\"steps\":%u,\"covered\":%u,\"pointer_us\":%.2f,"
+        "\"composited_us\":%.2f,\"identical\":%s,\"integral_matches\":%s}\n",
+        bench.width, bench.height, bench.steps, bench.covered, bench.pointerUs, bench.compositedUs,
+        bench.identical ? "true" : "false", bench.integralMatches ? "true" : "false");
+    return buf;
+}
+
+bool RunPointerWearMode(const BenchmarkOptions& options, std::string& json)
+{
+    PointerWearBenchmark bench = MeasurePointerWear(options.workloads.front(), options.config.width, options.config.height);
+    json = FormatPointerWearJson(bench);
+    return bench.identical && bench.integralMatches && bench.covered > 0;
+}
@@ -0,0 +1,104 @@
+#include "BenchmarkModes.h"
+
+#include <cstdio>
+#include <cstring>
+
+ProxyBenchmark MeasureFrameProxy(const BenchmarkConfig& config)
+{
+    ProxyBenchmark bench;
+    const uint32_t width = config.width, height = config.height;
+    bench.width = width;
+    bench.height = height;
+
+    // A mapped readback: rows padded to 256 bytes, top row first (CaptureSource.h)
+    const size_t rowBytes = size_t(width) * 4;
+    const size_t pitch = (rowBytes + 255) & ~size_t(255);
+    std::vector<uint8_t> frame(rowBytes * height), readback(pitch * height);
+    const SyntheticDesktop desktop(config.workload, width, height);
+    desktop.Render(7, frame.data());
+    for (uint32_t y = 0; y < height; ++y)
+        std::memcpy(readback.data() + size_t(y) * pitch, frame.data() + size_t(y) * rowBytes, rowBytes);
+
+    std::vector<uint8_t> dst(rowBytes * height);
+    bench.copyMs = BestOf(5, [&] {
+        for (uint32_t y = 0; y < height; ++y)
+            std::memcpy(dst.data() + size_t(y) * rowBytes, readback.data() + size_t(y) * pitch, rowBytes);
+    }) / 1e6;
+
+    WearMap wear;
+    wear.Reset(width, height);
+    bench.wearMs = BestOf(3, [&] { wear.Accumulate(dst.data(), 1.0 / 60.0); }) / 1e6;
+
+    for (uint32_t factor : { 2u, 4u, 8u, 16u })
+    {
+        ProxyRun run;
+        run.factor = factor;
+        FrameDownscaler simd, scalar;
+        if (!simd.Reset(width, height, factor, true) || !scalar.Reset(width, height, factor, false))
+            continue;
+        run.proxyWidth = simd.ProxyWidth();
+        run.proxyHeight = simd.ProxyHeight();
+        std::vector<uint8_t> proxy(size_t(run.proxyWidth) * run.proxyHeight * 4), check(proxy.size());
+
+        run.scalarMs = BestOf(3, [&] { scalar.Downscale(dst.data(), check.data()); }) / 1e6;
+        run.simdMs = BestOf(5, [&] { simd.Downscale(dst.data(), proxy.data()); }) / 1e6;
+        run.simdMatches = proxy == check;
+
+        run.fusedMs = BestOf(5, [&] {
+            simd.Begin(proxy.data());
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                uint8_t* row = dst.data() + size_t(y) * rowBytes;
+                std::memcpy(row, readback.data() + size_t(y) * pitch, rowBytes);
+                simd.AddRow(row);
+            }
+        }) / 1e6;
+        run.simdMatches = run.simdMatches && proxy == check;
+
+        run.proxyOnlyMs = BestOf(5, [&] {
+            simd.Begin(proxy.data());
+            for (uint32_t y = 0; y < height; ++y)
+                simd.AddRow(readback.data() + size_t(y) * pitch);
+        }) / 1e6;
+        run.simdMatches = run.simdMatches && proxy == check;
+
+        WearMap proxyWear;
+        proxyWear.Reset(run.proxyWidth, run.proxyHeight);
+        run.wearMs = BestOf(5, [&] { proxyWear.Accumulate(proxy.data(), 1.0 / 60.0); }) / 1e6;
+        bench.runs.push_back(run);
+    }
+    return bench;
+}
+
+std::string FormatProxyJson(const ProxyBenchmark& bench)
+{
+    char buf[320];
+    std::snprintf(buf, sizeof(buf),
+        "{\"benchmark\":\"frame_proxy\",\"width\":%u,\"height\":%u,\"copy_ms\":%.3f,\"wear_ms\":%.3f,\"runs\":[",
+        bench.width, bench.height, bench.copyMs, bench.wearMs);
+    std::string json = buf;
+    for (size_t i = 0; i < bench.runs.size(); ++i)
+    {
+        const ProxyRun& run = bench.runs[i];
+        std::snprintf(buf, sizeof(buf),
+            "%s\n  {\"factor\":%u,\"proxy\":\"%ux%u\",\"simd_ms\":%.3f,\"scalar_ms\":%.3f,\"fused_ms\":%.3f,"
+            "\"proxy_only_ms\":%.3f,\"wear_ms\":%.3f,\"simd_matches\":%s}",
+            i ? "," : "", run.factor, run.proxyWidth, run.proxyHeight, run.simdMs, run.scalarMs, run.fusedMs,
+            run.proxyOnlyMs, run.wearMs, run.simdMatches ? "true" : "false");
+        json += buf;
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+bool RunProxyMode(const BenchmarkOptions& options, std::string& json)
+{
+    BenchmarkConfig config = options.config;
+    config.workload = options.workloads.front();
+    ProxyBenchmark bench = MeasureFrameProxy(config);
+    bool ok = !bench.runs.empty();
+    for (const ProxyRun& run : bench.runs)
+        ok = ok && run.simdMatches;
+    json = FormatProxyJson(bench);
+    return ok;
+}
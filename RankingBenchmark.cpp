@@ -0,0 +1,114 @@
+#include "BenchmarkModes.h"
+
+#include "MediaRanking.h"
+#include "WearMap.h"
+
+#include <cstdio>
+#include <random>
+#include <utility>
+
+RankingBenchmark MeasureMediaRanking(const BenchmarkConfig& config, uint32_t clips)
+{
+    RankingBenchmark bench;
+    bench.clips = clips;
+    const SyntheticWorkload workloads[] = { SyntheticWorkload::StaticDesktop, SyntheticWorkload::ScrollingText,
+        SyntheticWorkload::Video, SyntheticWorkload::GameHud };
+
+    // The panel: hours of static desktop, less of the rest
+    WearMap wear;
+    wear.Reset(config.width, config.height);
+    std::vector<uint8_t> frame(size_t(config.width) * config.height * 4);
+    double hours = 8.0;
+    for (SyntheticWorkload workload : workloads)
+    {
+        SyntheticDesktop(workload, config.width, config.height).Render(0, frame.data());
+        wear.Accumulate(frame.data(), hours * 3600.0);
+        hours /= 2.0;
+    }
+
+    // Library: variants of the workloads' own signatures, rescaled per channel and with a
+    // bright patch in a random cell block
+    MediaLibrary library;
+    const uint32_t clipWidth = 320, clipHeight = 180;
+    std::vector<uint8_t> clipFrame(size_t(clipWidth) * clipHeight * 4);
+    for (SyntheticWorkload workload : workloads)
+    {
+        const SyntheticDesktop desktop(workload, clipWidth, clipHeight);
+        WearMap clipWear;
+        clipWear.Reset(clipWidth, clipHeight);
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            desktop.Render(i, clipFrame.data());
+            clipWear.Accumulate(clipFrame.data(), 1.0 / 30.0);
+        }
+        library.Add(SyntheticWorkloadName(workload), clipWear);
+    }
+    const std::vector<MediaSignature> bases = library.clips;
+    const size_t cells = size_t(library.gridWidth) * library.gridHeight;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> gain(0.2f, 1.2f);
+    library.clips.clear();
+    for (uint32_t i = 0; i < clips; ++i)
+    {
+        MediaSignature clip = bases[i % bases.size()];
+        clip.name += "_" + std::to_string(i);
+        const uint32_t px = rng() % library.gridWidth, py = rng() % library.gridHeight;
+        for (int c = 0; c < 3; ++c)
+        {
+            const float g = gain(rng);
+            for (size_t j = 0; j < cells; ++j)
+            {
+                const uint32_t x = uint32_t(j % library.gridWidth), y = uint32_t(j / library.gridWidth);
+                const bool patch = x >= px && x < px + 8 && y >= py && y < py + 6;
+                clip.rates[c * cells + j] = patch ? 1.0f : clip.rates[c * cells + j] * g;
+            }
+        }
+        library.clips.push_back(std::move(clip));
+    }
+
+    MediaRanker ranker;
+    auto start = Clock::now();
+    ranker.SetWear(wear, library.gridWidth, library.gridHeight);
+    bench.resampleMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    RankingConfig ranking;
+    std::vector<MediaScore> simd, scalar;
+    bench.sameBest = true;
+    for (RankingObjective objective : { RankingObjective::WornRegions, RankingObjective::Evenness })
+    {
+        ranking.objective = objective;
+        ranking.allowSimd = true;
+        const double simdMs = BestOf(5, [&] { simd = ranker.Rank(library, ranking); }) / 1e6;
+        ranking.allowSimd = false;
+        const double scalarMs = BestOf(5, [&] { scalar = ranker.Rank(library, ranking); }) / 1e6;
+        bench.sameBest = bench.sameBest && !simd.empty() && simd.size() == scalar.size() &&
+            simd.front().clip == scalar.front().clip;
+        (objective == RankingObjective::WornRegions ? bench.wornSimdMs : bench.evenSimdMs) = simdMs;
+        (objective == RankingObjective::WornRegions ? bench.wornScalarMs : bench.evenScalarMs) = scalarMs;
+    }
+
+    const std::string path = config.sinkPath + ".olsig";
+    MediaLibrary loaded;
+    bench.saveLoad = library.Save(path) && loaded.Load(path) && loaded.clips.size() == library.clips.size() &&
+        loaded.clips.back().name == library.clips.back().name && loaded.clips.back().rates == library.clips.back().rates;
+    std::remove(path.c_str());
+    return bench;
+}
+
+std::string FormatRankingJson(const RankingBenchmark& bench)
+{
+    char buf[512];
+    std::snprintf(buf, sizeof(buf),
+        "{\"benchmark\":\"media_ranking\",\"clips\":%u,\"resample_ms\":%.2f,\"worn_simd_ms\":%.3f,"
+        "\"worn_scalar_ms\":%.3f,\"even_simd_ms\":%.3f,\"even_scalar_ms\":%.3f,\"same_best\":%s,\"save_load\":%s}\n",
+        bench.clips, bench.resampleMs, bench.wornSimdMs, bench.wornScalarMs, bench.evenSimdMs, bench.evenScalarMs,
+        bench.sameBest ? "true" : "false", bench.saveLoad ? "true" : "false");
+    return buf;
+}
+
+bool RunRankingMode(const BenchmarkOptions& options, std::string& json)
+{
+    RankingBenchmark bench = MeasureMediaRanking(options.config, options.clips);
+    json = FormatRankingJson(bench);
+    return bench.sameBest && bench.saveLoad;
+}
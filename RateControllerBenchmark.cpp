@@ -0,0 +1,99 @@
+#include "BenchmarkModes.h"
+
+#include <cstdio>
+
+static RateControllerRun ReplayRun(const std::string& name, const std::vector<RateTraceSample>& trace,
+    const RateControllerConfig& config)
+{
+    RateControllerRun run;
+    run.trace = name;
+    run.report = ReplayRateTrace(trace, config);
+    const RateControllerReport& r = run.report;
+    const double baseline = r.captureSecondsSpent + r.analysisSecondsSpent + r.captureSecondsSaved + r.analysisSecondsSaved;
+    run.savedPercent = baseline > 0.0 ? (r.captureSecondsSaved + r.analysisSecondsSaved) / baseline * 100.0 : 0.0;
+    return run;
+}
+
+RateControllerBenchmark MeasureRateController(const std::string& tracePath, double seconds,
+    double captureSeconds, double analysisSeconds)
+{
+    RateControllerBenchmark bench;
+    bench.seconds = seconds;
+    const RateControllerConfig& config = bench.config;
+
+    const struct
+    {
+        const char* name;
+        double activeRatio;
+    } synthetic[] = { { "idle", 0.0 }, { "mostly_idle", 0.2 }, { "busy", 0.8 } };
+    std::vector<RateTraceSample> mostlyIdle;
+    for (const auto& s : synthetic)
+    {
+        std::vector<RateTraceSample> trace =
+            BuildSyntheticRateTrace(seconds, config.maxFps, s.activeRatio, captureSeconds, analysisSeconds);
+        bench.runs.push_back(ReplayRun(s.name, trace, config));
+        if (s.activeRatio == 0.2)
+            mostlyIdle = trace;
+    }
+
+    // The file format must not change the replay
+    const std::string path = "bench_rate_trace.csv";
+    std::vector<RateTraceSample> reloaded;
+    if (SaveRateTrace(path.c_str(), mostlyIdle) && LoadRateTrace(path.c_str(), reloaded) &&
+        reloaded.size() == mostlyIdle.size())
+    {
+        bench.runs.push_back(ReplayRun("reloaded", reloaded, config));
+        bench.reloaded = bench.runs.back().report.framesProcessed == bench.runs[1].report.framesProcessed;
+    }
+    std::remove(path.c_str());
+
+    if (!tracePath.empty())
+    {
+        std::vector<RateTraceSample> recorded;
+        bench.loaded = LoadRateTrace(tracePath.c_str(), recorded) && !recorded.empty();
+        if (bench.loaded)
+            bench.runs.push_back(ReplayRun(tracePath, recorded, config));
+    }
+    return bench;
+}
+
+std::string FormatRateControllerJson(const RateControllerBenchmark& bench)
+{
+    char buf[768];
+    std::snprintf(buf, sizeof(buf),
+        "{\"benchmark\":\"rate_controller\",\"min_fps\":%.1f,\"max_fps\":%.1f,\"seconds\":%.0f,"
+        "\"reloaded\":%s,\"loaded\":%s,\"runs\":[",
+        bench.config.minFps, bench.config.maxFps, bench.seconds, bench.reloaded ? "true" : "false",
+        bench.loaded ? "true" : "false");
+    std::string json = buf;
+    for (size_t i = 0; i < bench.runs.size(); ++i)
+    {
+        const RateControllerRun& run = bench.runs[i];
+        const RateControllerReport& r = run.report;
+        // The trace name may be a path: keep it to characters JSON takes as they are
+        std::string name;
+        for (char c : run.trace)
+            name += c == '"' || c == '\\' || (unsigned char)c < 0x20 ? '_' : c;
+        std::snprintf(buf, sizeof(buf),
+            "%s\n  {\"trace\":\"%s\",\"elapsed_s\":%.3f,\"baseline_frames\":%llu,\"frames\":%llu,"
+            "\"capture_spent_s\":%.3f,\"capture_saved_s\":%.3f,\"analysis_spent_s\":%.3f,"
+            "\"analysis_saved_s\":%.3f,\"saved_percent\":%.1f}",
+            i ? "," : "", name.c_str(), r.elapsedSeconds, (unsigned long long)r.baselineFrames,
+            (unsigned long long)r.framesProcessed, r.captureSecondsSpent, r.captureSecondsSaved,
+            r.analysisSecondsSpent, r.analysisSecondsSaved, run.savedPercent);
+        json += buf;
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+bool RunRateControllerMode(const BenchmarkOptions& options, std::string& json)
+{
+    RateControllerBenchmark bench = MeasureRateController(options.rateTracePath);
+    json = FormatRateControllerJson(bench);
+    // An idle desktop must cost less than the fixed rate, and nothing may cost more
+    bool ok = bench.reloaded && bench.loaded && !bench.runs.empty() && bench.runs.front().savedPercent > 0.0;
+    for (const RateControllerRun& run : bench.runs)
+        ok = ok && run.report.framesProcessed <= run.report.baselineFrames;
+    return ok;
+}
@@ -0,0 +1,183 @@
+#include "BenchmarkModes.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+// Fake encoder for SegmentedRecorder: per frame a packet of the frame number (the first
+// 8 bytes of the frame) and the segment timestamp, a keyframe every gopFrames frames.
+// Opens listed in failOpens (counted from 0 over all sinks) fail after failMs.
+struct StubSegmentPlan
+{
+    uint32_t gopFrames = 30;
+    int openMs = 2, failMs = 40, closeMs = 5;
+    std::vector<uint32_t> failOpens;
+    std::atomic<uint32_t> opens{ 0 };
+};
+
+class StubSegmentSink : public IFrameSink
+{
+public:
+    explicit StubSegmentSink(StubSegmentPlan& plan) : m_plan(plan) {}
+
+    bool Open(const std::string& path) override
+    {
+        const uint32_t open = m_plan.opens++;
+        if (std::find(m_plan.failOpens.begin(), m_plan.failOpens.end(), open) != m_plan.failOpens.end())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(m_plan.failMs));
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(m_plan.openMs));
+        m_file.open(path, std::ios::binary | std::ios::trunc);
+        return bool(m_file);
+    }
+    bool WriteFrame(const uint8_t* bgra, int64_t timestampHns) override
+    {
+        m_file.write(reinterpret_cast<const char*>(bgra), 8);
+        m_file.write(reinterpret_cast<const char*>(&timestampHns), 8);
+        m_frames++;
+        return bool(m_file);
+    }
+    bool Close() override
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(m_plan.closeMs));
+        m_file.close();
+        return !m_file.fail();
+    }
+    uint64_t BytesWritten() const override { return m_frames * 16; }
+    bool IsKeyframeBoundary() const override { return m_frames % m_plan.gopFrames == 0; }
+
+private:
+    StubSegmentPlan& m_plan;
+    std::ofstream m_file;
+    uint64_t m_frames = 0;
+};
+
+static std::string StubSegmentPath(const std::string& directory, uint32_t index)
+{
+    char name[48];
+    std::snprintf(name, sizeof(name), "/bench_segment_%05u.stub", index);
+    return directory + name;
+}
+
+static bool FileExists(const std::string& path)
+{
+    return bool(std::ifstream(path));
+}
+
+SegmentBenchmark MeasureSegments(const std::string& directory, uint32_t frames)
+{
+    static const int64_t FRAME_HNS = 10000000 / 60;
+    SegmentBenchmark bench;
+    StubSegmentPlan plan;
+    bench.gopFrames = plan.gopFrames;
+    bench.failedOpenMs = plan.failMs;
+    // Begin opens 0 and pre-opens 1: the fourth pre-open fails, and its first retry
+    plan.failOpens = { 4, 5 };
+
+    SegmentConfig config;
+    config.directory = directory;
+    config.prefix = "bench_segment";
+    config.extension = ".stub";
+    config.maxSegmentSeconds = 2.0;
+    config.openRetrySeconds = 0.01;
+    auto factory = [&plan] { return std::unique_ptr<IFrameSink>(new StubSegmentSink(plan)); };
+
+    std::vector<uint8_t> frame(64, 0);
+    std::vector<SegmentInfo> segments;
+    {
+        SegmentedRecorder recorder(factory, config);
+        if (!recorder.Begin())
+            return bench;
+        for (uint64_t i = 0; i < frames; ++i)
+        {
+            std::memcpy(frame.data(), &i, 8);
+            auto start = Clock::now();
+            recorder.WriteFrame(frame.data(), int64_t(i) * FRAME_HNS);
+            bench.maxWriteMs = (std::max)(bench.maxWriteMs,
+                std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        recorder.End();
+        bench.frames = frames;
+        bench.stats = recorder.Stats();
+        segments = recorder.Segments();
+    }
+    bench.segments = uint32_t(segments.size());
+
+    // Segments close in order on one worker, so Segments() is in stream order
+    bench.ordered = bench.keyframeCuts = bench.filesMatch = !segments.empty();
+    uint64_t next = 0;
+    for (size_t s = 0; s < segments.size(); ++s)
+    {
+        const SegmentInfo& segment = segments[s];
+        bench.ordered = bench.ordered && segment.finalized && segment.firstTimestampHns == int64_t(next) * FRAME_HNS &&
+            segment.lastTimestampHns == int64_t(next + segment.frames - 1) * FRAME_HNS;
+        if (s + 1 < segments.size())
+            bench.keyframeCuts = bench.keyframeCuts && segment.frames % plan.gopFrames == 0 &&
+                double(segment.frames) * FRAME_HNS >= config.maxSegmentSeconds * 1e7;
+
+        std::ifstream file(StubSegmentPath(directory, uint32_t(s)), std::ios::binary);
+        std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        bench.filesMatch = bench.filesMatch && segment.path == StubSegmentPath(directory, uint32_t(s)) &&
+            bytes.size() == segment.frames * 16;
+        for (uint64_t f = 0; f < segment.frames && bench.filesMatch; ++f, ++next)
+        {
+            uint64_t number;
+            int64_t timestampHns;
+            std::memcpy(&number, &bytes[size_t(f) * 16], 8);
+            std::memcpy(&timestampHns, &bytes[size_t(f) * 16 + 8], 8);
+            bench.ordered = bench.ordered && number == next && timestampHns == int64_t(f) * FRAME_HNS;
+        }
+    }
+    bench.ordered = bench.ordered && next == frames;
+    // Neither the segment pre-opened at End nor anything after the last one is left
+    bench.filesMatch = bench.filesMatch && !FileExists(StubSegmentPath(directory, bench.segments));
+    for (uint32_t s = 0; s <= bench.segments; ++s)
+        std::remove(StubSegmentPath(directory, s).c_str());
+
+    // Begin opens and pre-opens, End without a frame: both files go again
+    {
+        plan.failOpens.clear();
+        SegmentedRecorder recorder(factory, config);
+        bench.emptyRemoved = recorder.Begin() && recorder.End() && recorder.Segments().empty() &&
+            !FileExists(StubSegmentPath(directory, 0)) && !FileExists(StubSegmentPath(directory, 1));
+    }
+    for (uint32_t s = 0; s < 2; ++s)
+        std::remove(StubSegmentPath(directory, s).c_str());
+    return bench;
+}
+
+std::string FormatSegmentJson(const SegmentBenchmark& bench)
+{
+    char buf[768];
+    std::snprintf(buf, sizeof(buf),
+        "{\"benchmark\":\"segments\",\"frames\":%llu,\"gop_frames\":%u,\"segments\":%u,\"rotations\":%u,"
+        "\"max_switch_ms\":%.3f,\"mean_switch_ms\":%.3f,\"max_switch_gap_hns\":%lld,\"max_finalize_ms\":%.2f,"
+        "\"open_failures\":%u,\"deferred_cuts\":%u,\"max_write_ms\":%.3f,\"failed_open_ms\":%.0f,"
+        "\"ordered\":%s,\"keyframe_cuts\":%s,\"files_match\":%s,\"empty_removed\":%s}\n",
+        (unsigned long long)bench.frames, bench.gopFrames, bench.segments, bench.stats.rotations,
+        bench.stats.maxSwitchSeconds * 1000.0,
+        bench.stats.rotations ? bench.stats.totalSwitchSeconds * 1000.0 / bench.stats.rotations : 0.0,
+        (long long)bench.stats.maxSwitchGapHns, bench.stats.maxFinalizeSeconds * 1000.0, bench.stats.openFailures,
+        bench.stats.deferredCuts, bench.maxWriteMs, bench.failedOpenMs,
+        bench.ordered ? "true" : "false", bench.keyframeCuts ? "true" : "false", bench.filesMatch ? "true" : "false",
+        bench.emptyRemoved ? "true" : "false");
+    return buf;
+}
+
+bool RunSegmentMode(const BenchmarkOptions&, std::string& json)
+{
+    SegmentBenchmark bench = MeasureSegments(".");
+    json = FormatSegmentJson(bench);
+    // A blocked WriteFrame would sit out a whole failing open
+    return bench.ordered && bench.keyframeCuts && bench.filesMatch && bench.emptyRemoved &&
+        bench.stats.openFailures == 2 && bench.stats.deferredCuts > 0 &&
+        bench.stats.maxSwitchGapHns == 10000000 / 60 && bench.maxWriteMs < bench.failedOpenMs / 2;
+}
@@ -0,0 +1,290 @@
+#include "SegmentedRecorder.h"
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+static const int64_t HNS_PER_SECOND = 10000000LL;
+
+SegmentedRecorder::SegmentedRecorder(FrameSinkFactory factory, SegmentConfig config)
+    : m_factory(std::move(factory)), m_config(std::move(config))
+{
+}
+
+SegmentedRecorder::~SegmentedRecorder()
+{
+    End();
+}
+
+std::string SegmentedRecorder::SegmentPath(uint32_t index) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "_%05u", index);
+    return m_config.directory + "/" + m_config.prefix + name + m_config.extension;
+}
+
+bool SegmentedRecorder::Begin()
+{
+    if (m_active || m_worker.joinable())
+        return false;
+
+    m_stopWorker = false;
+    m_retrySeconds = m_config.openRetrySeconds;
+    m_retryAt = std::chrono::steady_clock::now();
+    m_worker = std::thread(&SegmentedRecorder::WorkerLoop, this);
+
+    // The first segment is opened before Begin returns; it is not retried
+    std::unique_lock<std::mutex> lock(m_mutex);
+    const uint32_t attempts = m_openAttempts;
+    m_nextPending = true;
+    m_cv.notify_all();
+    m_cv.wait(lock, [&] { return m_next || m_openAttempts != attempts; });
+
+    if (!m_next)
+    {
+        m_nextPending = false;
+        m_stopWorker = true;
+        m_cv.notify_all();
+        lock.unlock();
+        m_worker.join();
+        return false;
+    }
+
+    m_current = std::move(*m_next);
+    m_next.reset();
+
+    // Pre-open the following segment right away so the first rotation never waits
+    m_nextPending = true;
+    m_cv.notify_all();
+
+    m_active = true;
+    return true;
+}
+
+bool SegmentedRecorder::ShouldRotate(int64_t timestampHns) const
+{
+    if (m_current.info.frames == 0 || !m_current.sink->IsKeyframeBoundary())
+        return false;
+
+    if (m_rotationRequested)
+        return true;
+
+    if (m_config.maxSegmentSeconds > 0.0 &&
+        timestampHns - m_current.info.firstTimestampHns >= int64_t(m_config.maxSegmentSeconds * HNS_PER_SECOND))
+        return true;
+
+    return m_config.maxSegmentBytes > 0 && m_current.sink->BytesWritten() >= m_config.maxSegmentBytes;
+}
+
+bool SegmentedRecorder::Rotate()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Still opening, or waiting to retry a failed open: keep writing into the current
+    // segment and cut on a later keyframe boundary
+    if (!m_next)
+    {
+        m_stats.deferredCuts++;
+        return false;
+    }
+
+    m_current.info.bytes = m_current.sink->BytesWritten();
+    m_toClose.push_back(std::move(m_current));
+    m_current = std::move(*m_next);
+    m_next.reset();
+
+    m_nextPending = true;
+    m_cv.notify_all();
+    return true;
+}
+
+bool SegmentedRecorder::WriteFrame(const uint8_t* bgra, int64_t timestampHns, const uint8_t* changedTiles)
+{
+    if (!m_active)
+        return false;
+
+    bool rotated = false;
+    double switchSeconds = 0.0;
+    if (ShouldRotate(timestampHns))
+    {
+        TRACE_SCOPE("SegmentSwitch");
+        auto switchStart = std::chrono::steady_clock::now();
+        rotated = Rotate();
+        switchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - switchStart).count();
+        if (rotated)
+            m_rotationRequested = false;
+    }
+
+    if (m_current.info.frames == 0)
+        m_current.info.firstTimestampHns = timestampHns;
+
+    // Every segment starts at t = 0 so it plays on its own
+    bool ok;
+    {
+        TRACE_SCOPE("SinkWrite");
+        const int64_t timestamp = timestampHns - m_current.info.firstTimestampHns;
+        ok = changedTiles && m_current.info.frames ? m_current.sink->WriteFrameWithTiles(bgra, timestamp, changedTiles)
+                                                   : m_current.sink->WriteFrame(bgra, timestamp);
+    }
+    m_current.info.frames++;
+    m_current.info.lastTimestampHns = timestampHns;
+
+    if (rotated)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.rotations++;
+        m_stats.totalSwitchSeconds += switchSeconds;
+        m_stats.maxSwitchSeconds = std::max(m_stats.maxSwitchSeconds, switchSeconds);
+        m_stats.maxSwitchGapHns = std::max(m_stats.maxSwitchGapHns, timestampHns - m_lastTimestampHns);
+    }
+
+    m_lastTimestampHns = timestampHns;
+    return ok;
+}
+
+void SegmentedRecorder::RetireCurrent()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_current.info.bytes = m_current.sink->BytesWritten();
+    m_toClose.push_back(std::move(m_current));
+    m_current = OpenSegment();
+    m_cv.notify_all();
+}
+
+bool SegmentedRecorder::End()
+{
+    if (!m_worker.joinable())
+        return false;
+
+    if (m_active)
+    {
+        RetireCurrent();
+        m_active = false;
+    }
+
+    std::unique_ptr<OpenSegment> unused;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_nextPending = false; // no more retries
+        m_cv.wait(lock, [&] { return m_toClose.empty() && !m_opening; });
+        unused = std::move(m_next);
+        m_stopWorker = true;
+        m_cv.notify_all();
+    }
+    m_worker.join();
+
+    // The pre-opened segment never received a frame
+    if (unused)
+    {
+        unused->sink->Close();
+        unused->sink->Remove(unused->info.path);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats.closeFailures == 0;
+}
+
+void SegmentedRecorder::WorkerLoop()
+{
+    if (m_config.onWorkerStart)
+        m_config.onWorkerStart();
+    Trace::SetThreadName("segment-worker");
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        auto openDue = [&] { return m_nextPending && !m_next && std::chrono::steady_clock::now() >= m_retryAt; };
+        auto ready = [&] { return m_stopWorker || !m_toClose.empty() || openDue(); };
+        if (m_nextPending && !m_next)
+            m_cv.wait_until(lock, m_retryAt, ready);
+        else
+            m_cv.wait(lock, ready);
+
+        if (!m_toClose.empty())
+        {
+            OpenSegment segment = std::move(m_toClose.front());
+            m_toClose.erase(m_toClose.begin());
+            lock.unlock();
+
+            auto t0 = std::chrono::steady_clock::now();
+            bool ok;
+            {
+                TRACE_SCOPE("SegmentFinalize");
+                ok = segment.sink->Close();
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            segment.info.bytes = std::max(segment.info.bytes, segment.sink->BytesWritten());
+            segment.info.finalized = ok;
+            // Ended before its first frame: nothing worth keeping
+            if (segment.info.frames == 0)
+                segment.sink->Remove(segment.info.path);
+            segment.sink.reset();
+
+            lock.lock();
+            if (segment.info.frames > 0)
+                m_segments.push_back(segment.info);
+            m_stats.maxFinalizeSeconds = std::max(m_stats.maxFinalizeSeconds, seconds);
+            if (!ok)
+                m_stats.closeFailures++;
+            m_cv.notify_all();
+            continue;
+        }
+
+        if (openDue())
+        {
+            // A retry reuses the index, so numbering has no gaps
+            uint32_t index = m_nextIndex;
+            m_opening = true;
+            lock.unlock();
+
+            auto segment = std::make_unique<OpenSegment>();
+            segment->index = index;
+            segment->info.path = SegmentPath(index);
+            TRACE_SCOPE("SegmentOpen");
+            segment->sink = m_factory();
+            bool ok = segment->sink && segment->sink->Open(segment->info.path);
+
+            lock.lock();
+            m_opening = false;
+            m_openAttempts++;
+            if (ok)
+            {
+                m_nextIndex++;
+                m_next = std::move(segment);
+                m_nextPending = false;
+                m_retrySeconds = m_config.openRetrySeconds;
+            }
+            else
+            {
+                m_stats.openFailures++;
+                m_retryAt = std::chrono::steady_clock::now() +
+                    std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::duration<double>(m_retrySeconds));
+                m_retrySeconds = (std::min)(m_retrySeconds * 2.0, m_config.maxOpenRetrySeconds);
+            }
+            m_cv.notify_all();
+            continue;
+        }
+
+        if (m_stopWorker)
+            break;
+    }
+    lock.unlock();
+
+    if (m_config.onWorkerExit)
+        m_config.onWorkerExit();
+}
+
+SegmentStats SegmentedRecorder::Stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+std::vector<SegmentInfo> SegmentedRecorder::Segments() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_segments;
+}
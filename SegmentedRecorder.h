@@ -0,0 +1,119 @@
+#pragma once
+
+#include "FrameSink.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SegmentConfig
+{
+    std::string directory = ".";
+    std::string prefix = "capture";
+    std::string extension = ".mp4";
+    double maxSegmentSeconds = 600.0; // 0 = no time limit
+    uint64_t maxSegmentBytes = 0;     // 0 = no size limit
+    // A failed open of the next segment is retried on the worker after openRetrySeconds,
+    // doubling up to maxOpenRetrySeconds; frames keep going into the current segment.
+    double openRetrySeconds = 0.5;
+    double maxOpenRetrySeconds = 30.0;
+    // Run on the worker thread around its lifetime (e.g. CoInitializeEx / CoUninitialize)
+    std::function<void()> onWorkerStart;
+    std::function<void()> onWorkerExit;
+};
+
+struct SegmentInfo
+{
+    std::string path;
+    uint64_t frames = 0;
+    int64_t firstTimestampHns = 0; // recording time, before per-segment rebasing
+    int64_t lastTimestampHns = 0;
+    uint64_t bytes = 0;
+    bool finalized = false;
+};
+
+struct SegmentStats
+{
+    uint32_t rotations = 0;
+    double maxSwitchSeconds = 0.0;   // WriteFrame stall while switching writers, before the first write
+    double totalSwitchSeconds = 0.0;
+    int64_t maxSwitchGapHns = 0;     // timestamp distance between last old and first new frame
+    double maxFinalizeSeconds = 0.0; // Close() on the worker, off the capture thread
+    uint32_t openFailures = 0;
+    uint32_t deferredCuts = 0;       // keyframe boundaries passed uncut because the next writer was not open yet
+    uint32_t closeFailures = 0;
+};
+
+// Splits a recording into independent files every maxSegmentSeconds / maxSegmentBytes,
+// cutting only on keyframe boundaries. The next writer is opened ahead of time and old
+// ones are finalized on a worker thread, so the capture thread never waits on file
+// creation or Finalize: when the next writer is not open yet (or failed to open and is
+// being retried) the cut simply waits for it. Every closed segment is complete on disk:
+// a crash loses at most the segment being written. Segments that never received a frame
+// are deleted. Segment numbering continues across Begin/End cycles.
+class SegmentedRecorder
+{
+public:
+    SegmentedRecorder(FrameSinkFactory factory, SegmentConfig config);
+    ~SegmentedRecorder();
+
+    SegmentedRecorder(const SegmentedRecorder&) = delete;
+    SegmentedRecorder& operator=(const SegmentedRecorder&) = delete;
+
+    bool Begin();
+    // changedTiles: see IFrameSink::WriteFrameWithTiles, against the frame written before
+    bool WriteFrame(const uint8_t* bgra, int64_t timestampHns, const uint8_t* changedTiles = nullptr);
+    // Cut at the next keyframe boundary regardless of the limits (flush to disk). Thread safe.
+    void RequestRotation() { m_rotationRequested = true; }
+    // Finalize the current segment and wait for every pending close.
+    bool End();
+
+    SegmentStats Stats() const;
+    std::vector<SegmentInfo> Segments() const;
+
+private:
+    struct OpenSegment
+    {
+        std::unique_ptr<IFrameSink> sink;
+        uint32_t index = 0;
+        SegmentInfo info;
+    };
+
+    std::string SegmentPath(uint32_t index) const;
+    bool ShouldRotate(int64_t timestampHns) const;
+    bool Rotate();
+    void RetireCurrent();
+    void WorkerLoop();
+
+    FrameSinkFactory m_factory;
+    SegmentConfig m_config;
+
+    // Capture thread only
+    OpenSegment m_current;
+    bool m_active = false;
+    int64_t m_lastTimestampHns = 0;
+
+    // Shared with the worker and control threads
+    std::atomic<bool> m_rotationRequested{ false };
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::unique_ptr<OpenSegment> m_next;
+    bool m_nextPending = false; // the worker should open m_next, from m_retryAt on
+    bool m_opening = false;     // the worker is opening it right now
+    uint32_t m_openAttempts = 0;
+    std::chrono::steady_clock::time_point m_retryAt;
+    double m_retrySeconds = 0.0;
+    uint32_t m_nextIndex = 0;
+    std::vector<OpenSegment> m_toClose;
+    std::vector<SegmentInfo> m_segments;
+    SegmentStats m_stats;
+    bool m_stopWorker = false;
+    std::thread m_worker;
+};
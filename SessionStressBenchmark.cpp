@@ -0,0 +1,221 @@
+#include "BenchmarkModes.h"
+
+#include "CapturePipeline.h"
+#include "CaptureSession.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+
+// Loses access every lostEvery acquires and comes back at the other size every second
+// time; every failEvery-th reopen after a loss fails (0 = never). Each frame starts with
+// its width and height. Calls are serialized by the session's lock.
+class FlakyCaptureSource : public ICaptureSource
+{
+public:
+    FlakyCaptureSource(uint32_t lostEvery, uint32_t failEvery) : m_lostEvery(lostEvery), m_failEvery(failEvery) {}
+
+    bool Open() override
+    {
+        if (!m_lost)
+            return true;
+        m_lost = false;
+        if (m_failEvery && ++m_reopens % m_failEvery == 0)
+        {
+            failedReopens++;
+            return false;
+        }
+        reopened++;
+        if (m_width != m_lostWidth)
+            resizedReopens++;
+        return true;
+    }
+    void Close() override {}
+    uint32_t Width() const override { return m_width; }
+    uint32_t Height() const override { return m_height; }
+
+    CaptureResult AcquireFrame(uint8_t* dst, CaptureFrameInfo*) override
+    {
+        if (++m_calls % m_lostEvery == 0)
+        {
+            m_lost = true;
+            m_lostWidth = m_width;
+            if (++m_losses % 2 == 0)
+                std::swap(m_width, m_height);
+            return CaptureResult::AccessLost;
+        }
+        if (dst)
+        {
+            std::memset(dst, int(m_calls & 0xFF), size_t(m_width) * m_height * 4);
+            std::memcpy(dst, &m_width, 4);
+            std::memcpy(dst + 4, &m_height, 4);
+        }
+        frames++;
+        return CaptureResult::Frame;
+    }
+
+    uint64_t frames = 0, reopened = 0, resizedReopens = 0, failedReopens = 0;
+
+private:
+    uint32_t m_lostEvery, m_failEvery;
+    uint32_t m_width = 160, m_height = 96;
+    uint32_t m_lostWidth = 0;
+    uint64_t m_calls = 0, m_losses = 0, m_reopens = 0;
+    bool m_lost = false;
+};
+
+SessionStressBenchmark MeasureSessionStress(uint32_t sessions, uint32_t calls, uint32_t pipelineMs)
+{
+    static const size_t GUARD = 64;
+    SessionStressBenchmark bench;
+    bench.sessions = sessions;
+
+    struct Worker
+    {
+        FlakyCaptureSource* source = nullptr;
+        std::unique_ptr<CaptureSession> session;
+        uint64_t frames = 0, resized = 0, cycles = 0;
+        bool sized = true, rising = true;
+    };
+    std::vector<Worker> workers(sessions);
+    for (Worker& worker : workers)
+    {
+        auto source = std::make_unique<FlakyCaptureSource>(7, 5);
+        worker.source = source.get();
+        worker.session = std::make_unique<CaptureSession>(std::move(source));
+    }
+
+    auto capture = [calls](Worker& worker, std::atomic<bool>& done) {
+        CaptureSession& session = *worker.session;
+        session.Start();
+        uint32_t width = session.Width(), height = session.Height();
+        std::vector<uint8_t> buffer(size_t(width) * height * 4 + GUARD, 0xA5);
+        bool haveId = false;
+        uint64_t lastId = 0;
+        for (uint32_t i = 0; i < calls; ++i)
+        {
+            CaptureFrameInfo info;
+            CaptureResult result = session.CaptureNext(buffer.data(), &info);
+            if (result == CaptureResult::Frame)
+            {
+                uint32_t stamp[2];
+                std::memcpy(stamp, buffer.data(), sizeof(stamp));
+                const size_t bytes = size_t(width) * height * 4;
+                worker.sized = worker.sized && stamp[0] == width && stamp[1] == height &&
+                    std::all_of(buffer.begin() + bytes, buffer.end(), [](uint8_t b) { return b == 0xA5; });
+                worker.rising = worker.rising && (!haveId || info.frameId > lastId);
+                haveId = true;
+                lastId = info.frameId;
+                worker.frames++;
+                continue;
+            }
+            if (result == CaptureResult::Resized)
+                worker.resized++;
+            else if (result != CaptureResult::Error)
+                continue;
+            // Stopped by the control thread or faulted: either may come back at another size
+            if (session.State() != CaptureSessionState::Running)
+                session.Start();
+            if (result == CaptureResult::Resized && session.Width() == width && session.Height() == height)
+                worker.sized = false;
+            width = session.Width();
+            height = session.Height();
+            buffer.assign(size_t(width) * height * 4 + GUARD, 0xA5);
+        }
+        done = true;
+    };
+    auto control = [](Worker& worker, std::atomic<bool>& done) {
+        while (!done)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            worker.session->Stop();
+            worker.session->Start();
+            worker.cycles++;
+        }
+    };
+
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    std::unique_ptr<std::atomic<bool>[]> done(new std::atomic<bool>[sessions]);
+    for (uint32_t i = 0; i < sessions; ++i)
+    {
+        done[i] = false;
+        threads.emplace_back(capture, std::ref(workers[i]), std::ref(done[i]));
+        threads.emplace_back(control, std::ref(workers[i]), std::ref(done[i]));
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    bench.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    bench.framesSized = bench.idsRising = bench.statsMatch = bench.resetClears = true;
+    for (Worker& worker : workers)
+    {
+        const CaptureSessionStats stats = worker.session->Stats();
+        bench.calls += calls;
+        bench.frames += worker.frames;
+        bench.restarts += stats.restarts;
+        bench.resized += worker.resized;
+        bench.faults += worker.source->failedReopens;
+        bench.cycles += worker.cycles;
+        bench.framesSized = bench.framesSized && worker.sized;
+        bench.idsRising = bench.idsRising && worker.rising;
+        bench.statsMatch = bench.statsMatch && stats.frames == worker.frames && worker.source->frames == worker.frames &&
+            stats.restarts == worker.source->reopened && worker.resized == worker.source->resizedReopens;
+
+        worker.session->Reset();
+        const CaptureSessionStats cleared = worker.session->Stats();
+        bench.resetClears = bench.resetClears && worker.session->State() == CaptureSessionState::Idle &&
+            cleared.frames == 0 && cleared.restarts == 0 && cleared.errors == 0;
+    }
+
+    // The pipeline follows the mode changes with a recording that ends at the first one;
+    // the frames change every time, so the rate controller keeps the fastest rate
+    CaptureSession session(std::make_unique<FlakyCaptureSource>(7, 0));
+    PipelineConfig config;
+    config.wearIntegral = true;
+    config.levelBins = 4;
+    config.segments.prefix = "bench_stress";
+    config.sinkFactory = [] { return std::unique_ptr<IFrameSink>(new NullSink(160, 96)); };
+    CapturePipeline pipeline(session, config);
+    if (!pipeline.Start())
+        return bench;
+    std::this_thread::sleep_for(std::chrono::milliseconds(pipelineMs));
+    pipeline.Stop();
+    const PipelineStats stats = pipeline.Stats();
+    const WearMap wear = pipeline.WearSnapshot();
+    bench.pipelineModeChanges = stats.modeChanges;
+    bench.pipelineFrames = stats.capture.frames;
+    bench.pipelineFollows = stats.modeChanges > 0 && wear.Width() == session.Width() &&
+        wear.Height() == session.Height() && stats.segmentsClosed > 0;
+    return bench;
+}
+
+std::string FormatSessionStressJson(const SessionStressBenchmark& bench)
+{
+    char buf[768];
+    std::snprintf(buf, sizeof(buf),
+        "{\"benchmark\":\"session_stress\",\"sessions\":%u,\"calls\":%llu,\"frames\":%llu,\"restarts\":%llu,"
+        "\"resized\":%llu,\"faults\":%llu,\"cycles\":%llu,\"seconds\":%.3f,\"frames_sized\":%s,\"ids_rising\":%s,"
+        "\"stats_match\":%s,\"reset_clears\":%s,\"pipeline_mode_changes\":%u,\"pipeline_frames\":%llu,"
+        "\"pipeline_follows\":%s}\n",
+        bench.sessions, (unsigned long long)bench.calls, (unsigned long long)bench.frames,
+        (unsigned long long)bench.restarts, (unsigned long long)bench.resized, (unsigned long long)bench.faults,
+        (unsigned long long)bench.cycles, bench.seconds, bench.framesSized ? "true" : "false",
+        bench.idsRising ? "true" : "false", bench.statsMatch ? "true" : "false", bench.resetClears ? "true" : "false",
+        bench.pipelineModeChanges, (unsigned long long)bench.pipelineFrames, bench.pipelineFollows ? "true" : "false");
+    return buf;
+}
+
+bool RunSessionStressMode(const BenchmarkOptions& options, std::string& json)
+{
+    SessionStressBenchmark bench = MeasureSessionStress(options.maxThreads ? uint32_t(options.maxThreads) : 4);
+    json = FormatSessionStressJson(bench);
+    return bench.framesSized && bench.idsRising && bench.statsMatch && bench.resetClears && bench.resized > 0 &&
+        bench.faults > 0 && bench.pipelineFollows;
+}
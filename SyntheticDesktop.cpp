@@ -0,0 +1,231 @@
+#include "SyntheticDesktop.h"
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+static const int GLYPH_W = 8, GLYPH_H = 16;
+
+static uint32_t Hash(uint32_t x)
+{
+    x ^= x >> 16; x *= 0x7feb352dU;
+    x ^= x >> 15; x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+const char* SyntheticWorkloadName(SyntheticWorkload workload)
+{
+    switch (workload)
+    {
+    case SyntheticWorkload::StaticDesktop: return "static_desktop";
+    case SyntheticWorkload::ScrollingText: return "scrolling_text";
+    case SyntheticWorkload::Video:         return "video";
+    case SyntheticWorkload::GameHud:       return "game_hud";
+    }
+    return "unknown";
+}
+
+SyntheticDesktop::SyntheticDesktop(SyntheticWorkload workload, uint32_t width, uint32_t height, uint32_t seed)
+    : m_workload(workload), m_width(width), m_height(height), m_seed(seed)
+{
+}
+
+void SyntheticDesktop::FillRect(uint8_t* bgra, int x, int y, int w, int h, uint32_t color) const
+{
+    int x0 = std::max(x, 0), y0 = std::max(y, 0);
+    int x1 = std::min(x + w, int(m_width)), y1 = std::min(y + h, int(m_height));
+    for (int py = y0; py < y1; ++py)
+    {
+        uint32_t* row = (uint32_t*)(bgra + (size_t(py) * m_width) * 4);
+        std::fill(row + x0, row + std::max(x0, x1), color);
+    }
+}
+
+// Lines of pseudo-random glyphs; line n always has the same content, so scrolling by a
+// line moves pixels exactly like a real editor does
+void SyntheticDesktop::DrawText(uint8_t* bgra, int x, int y, int w, int h, uint64_t firstLine,
+    uint32_t ink, uint32_t paper) const
+{
+    FillRect(bgra, x, y, w, h, paper);
+    for (int line = 0; line * GLYPH_H < h; ++line)
+    {
+        uint32_t lineHash = Hash(uint32_t(firstLine + line) * 2654435761U ^ m_seed);
+        int length = int(lineHash % uint32_t(std::max(1, w / GLYPH_W)));
+        for (int col = 0; col < length; ++col)
+        {
+            uint32_t glyph = Hash(lineHash + col);
+            if ((glyph & 7) == 0)
+                continue; // space
+            for (int gy = 2; gy < GLYPH_H - 2; ++gy)
+            {
+                int py = y + line * GLYPH_H + gy;
+                if (py < 0 || py >= y + h || py >= int(m_height))
+                    continue;
+                uint32_t bits = Hash(glyph + gy) & 0x7e; // 6 px wide strokes
+                uint32_t* row = (uint32_t*)(bgra + size_t(py) * m_width * 4);
+                for (int gx = 0; gx < GLYPH_W; ++gx)
+                {
+                    int px = x + col * GLYPH_W + gx;
+                    if ((bits >> gx) & 1 && px >= 0 && px < std::min(x + w, int(m_width)))
+                        row[px] = ink;
+                }
+            }
+        }
+    }
+}
+
+// Smooth moving gradients plus mild noise: the statistics of video or 3D content
+void SyntheticDesktop::DrawMotion(uint8_t* bgra, int x, int y, int w, int h, uint64_t frame) const
+{
+    int x0 = std::max(x, 0), y0 = std::max(y, 0);
+    int x1 = std::min(x + w, int(m_width)), y1 = std::min(y + h, int(m_height));
+    uint32_t t = uint32_t(frame);
+    for (int py = y0; py < y1; ++py)
+    {
+        uint8_t* px = bgra + (size_t(py) * m_width + x0) * 4;
+        for (int ix = x0; ix < x1; ++ix, px += 4)
+        {
+            uint32_t noise = Hash(uint32_t(py) * 65599U + uint32_t(ix) + t * 0x9e3779b9U) & 15;
+            px[0] = uint8_t((ix + 3 * t) * 255 / std::max(1, w) + noise);
+            px[1] = uint8_t((py + 2 * t) * 255 / std::max(1, h) + noise);
+            px[2] = uint8_t(((ix + py) / 2 + 5 * t) + noise);
+            px[3] = 255;
+        }
+    }
+}
+
+void SyntheticDesktop::Render(uint64_t frame, uint8_t* bgra) const
+{
+    const int W = int(m_width), H = int(m_height);
+    const int taskbar = std::max(24, H / 30);
+
+    if (m_workload == SyntheticWorkload::GameHud)
+    {
+        DrawMotion(bgra, 0, 0, W, H, frame);
+        // Health bar, minimap and ammo counter never move: the pixels that burn in
+        FillRect(bgra, W / 40, H - H / 12, W / 4, H / 40, 0xff20c020);
+        FillRect(bgra, W - W / 6 - W / 40, H / 30, W / 6, W / 6, 0xff303030);
+        DrawText(bgra, W - W / 8, H - H / 10, W / 10, GLYPH_H * 2, 7, 0xffffffff, 0xff000000);
+        return;
+    }
+
+    // Desktop, taskbar and two windows
+    FillRect(bgra, 0, 0, W, H - taskbar, 0xff2b5797);
+    FillRect(bgra, 0, H - taskbar, W, taskbar, 0xff1f1f1f);
+    FillRect(bgra, W / 20, H / 20, W / 2, H * 3 / 4, 0xff3c3c3c);
+    FillRect(bgra, W / 20, H / 20, W / 2, GLYPH_H * 2, 0xff202020);
+    FillRect(bgra, W / 2, H / 8, W * 9 / 20, H * 2 / 3, 0xfff0f0f0);
+    FillRect(bgra, W / 2, H / 8, W * 9 / 20, GLYPH_H * 2, 0xffd0d0d0);
+
+    uint64_t scroll = m_workload == SyntheticWorkload::ScrollingText ? frame / 4 : 0;
+    DrawText(bgra, W / 20 + 8, H / 20 + GLYPH_H * 2 + 4, W / 2 - 16, H * 3 / 4 - GLYPH_H * 2 - 8,
+        scroll, 0xffd4d4d4, 0xff1e1e1e);
+    DrawText(bgra, W / 2 + 8, H / 8 + GLYPH_H * 2 + 4, W * 9 / 20 - 16, H * 2 / 3 - GLYPH_H * 2 - 8,
+        1000, 0xff101010, 0xfff0f0f0);
+
+    // Clock ticks once a second at 80 fps, caret blinks twice a second
+    DrawText(bgra, W - 10 * GLYPH_W, H - taskbar + (taskbar - GLYPH_H) / 2, 8 * GLYPH_W, GLYPH_H,
+        frame / 80, 0xffffffff, 0xff1f1f1f);
+    if ((frame / 20) % 2 == 0)
+        FillRect(bgra, W / 2 + 40, H / 8 + GLYPH_H * 3, 2, GLYPH_H, 0xff000000);
+
+    if (m_workload == SyntheticWorkload::Video)
+    {
+        int vw = W / 2, vh = vw * 9 / 16;
+        DrawMotion(bgra, W / 4, H / 4, vw, vh, frame);
+    }
+}
+
+SyntheticCaptureSource::SyntheticCaptureSource(SyntheticWorkload workload, uint32_t width, uint32_t height,
+    double fps, uint32_t loopFrames, uint32_t seed)
+    : m_desktop(workload, width, height, seed), m_width(width), m_height(height),
+      m_loopFrames(std::max(loopFrames, 1u)), m_fps(fps)
+{
+}
+
+bool SyntheticCaptureSource::Open()
+{
+    const size_t frameBytes = size_t(m_width) * m_height * 4;
+    if (m_loop.empty())
+    {
+        m_loop.assign(m_loopFrames, std::vector<uint8_t>(frameBytes));
+        for (uint32_t i = 0; i < m_loopFrames; ++i)
+            m_desktop.Render(i, m_loop[i].data());
+
+        // Dirty area at DXGI-like granularity; the loop wraps, so frame 0 follows the last
+        const uint32_t TILE = 64;
+        const uint32_t tilesX = (m_width + TILE - 1) / TILE, tilesY = (m_height + TILE - 1) / TILE;
+        m_dirty.assign(m_loopFrames, 0.0);
+        for (uint32_t i = 0; i < m_loopFrames; ++i)
+        {
+            const uint8_t* cur = m_loop[i].data();
+            const uint8_t* prev = m_loop[(i + m_loopFrames - 1) % m_loopFrames].data();
+            uint32_t changed = 0;
+            for (uint32_t ty = 0; ty < tilesY; ++ty)
+                for (uint32_t tx = 0; tx < tilesX; ++tx)
+                {
+                    const uint32_t x0 = tx * TILE, w = std::min(TILE, m_width - x0);
+                    bool differs = false;
+                    for (uint32_t y = ty * TILE; y < std::min(m_height, (ty + 1) * TILE) && !differs; ++y)
+                    {
+                        size_t offset = (size_t(y) * m_width + x0) * 4;
+                        differs = std::memcmp(cur + offset, prev + offset, size_t(w) * 4) != 0;
+                    }
+                    changed += differs;
+                }
+            m_dirty[i] = double(changed) / (double(tilesX) * tilesY);
+        }
+    }
+
+    m_start = std::chrono::steady_clock::now();
+    m_next = 0;
+    m_skipped = 0;
+    return true;
+}
+
+void SyntheticCaptureSource::Close()
+{
+    m_loop.clear();
+    m_loop.shrink_to_fit();
+}
+
+CaptureResult SyntheticCaptureSource::AcquireFrame(uint8_t* dst, CaptureFrameInfo* info)
+{
+    if (m_loop.empty())
+        return CaptureResult::Error;
+
+    uint64_t index = m_next;
+    auto now = std::chrono::steady_clock::now();
+    if (m_fps > 0.0)
+    {
+        auto due = m_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(double(m_next) / m_fps));
+        if (now < due)
+        {
+            std::this_thread::sleep_until(due);
+            now = std::chrono::steady_clock::now();
+        }
+        // The newest frame that is due; the ones in between were never seen
+        index = std::max(m_next, uint64_t(std::chrono::duration<double>(now - m_start).count() * m_fps));
+        m_skipped += index - m_next;
+        m_lastDue = m_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(double(index) / m_fps));
+    }
+    else
+    {
+        m_lastDue = now;
+    }
+    m_next = index + 1;
+
+    const size_t slot = size_t(index % m_loopFrames);
+    {
+        TRACE_SCOPE("RowCopy");
+        std::memcpy(dst, m_loop[slot].data(), m_loop[slot].size());
+    }
+    if (info)
+        info->dirtyFraction = index == 0 ? 1.0 : m_dirty[slot];
+    return CaptureResult::Frame;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "CaptureSource.h"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Deterministic desktop-like frames for benchmarks and codec checks without a GPU or a
+// display. Every frame is a pure function of (workload, size, seed, frame index).
+enum class SyntheticWorkload
+{
+    StaticDesktop, // windows with text; only a clock and a caret change
+    ScrollingText, // editor window scrolling one line every few frames
+    Video,         // static desktop with a 16:9 full-motion region
+    GameHud        // full-screen motion under a static HUD
+};
+
+const char* SyntheticWorkloadName(SyntheticWorkload workload);
+
+class SyntheticDesktop
+{
+public:
+    SyntheticDesktop(SyntheticWorkload workload, uint32_t width, uint32_t height, uint32_t seed = 1);
+
+    // Top-down BGRA, width * height * 4 bytes
+    void Render(uint64_t frame, uint8_t* bgra) const;
+
+private:
+    void FillRect(uint8_t* bgra, int x, int y, int w, int h, uint32_t color) const;
+    void DrawText(uint8_t* bgra, int x, int y, int w, int h, uint64_t firstLine, uint32_t ink, uint32_t paper) const;
+    void DrawMotion(uint8_t* bgra, int x, int y, int w, int h, uint64_t frame) const;
+
+    SyntheticWorkload m_workload;
+    uint32_t m_width, m_height, m_seed;
+};
+
+// ICaptureSource over a SyntheticDesktop, so the whole pipeline runs without a GPU.
+// A loop of frames is rendered on Open (the "GPU" side); AcquireFrame only copies, like
+// the readback of the DXGI source. With fps > 0 frames are due on a wall-clock schedule:
+// AcquireFrame waits for the next one, and frames that came due while the caller was
+// busy are skipped and counted, like a real desktop moving on without the capture.
+class SyntheticCaptureSource : public ICaptureSource
+{
+public:
+    SyntheticCaptureSource(SyntheticWorkload workload, uint32_t width, uint32_t height,
+        double fps = 0.0, uint32_t loopFrames = 32, uint32_t seed = 1);
+
+    bool Open() override;
+    void Close() override;
+    uint32_t Width() const override { return m_width; }
+    uint32_t Height() const override { return m_height; }
+    CaptureResult AcquireFrame(uint8_t* dst, CaptureFrameInfo* info) override;
+
+    uint64_t FramesSkipped() const { return m_skipped; }
+    // When the last acquired frame came due (its acquire time when unpaced)
+    std::chrono::steady_clock::time_point LastFrameDue() const { return m_lastDue; }
+    // Memory held by the rendered loop
+    size_t LoopBytes() const { return m_loop.size() * size_t(m_width) * m_height * 4; }
+
+private:
+    SyntheticDesktop m_desktop;
+    uint32_t m_width, m_height, m_loopFrames;
+    double m_fps;
+    std::vector<std::vector<uint8_t>> m_loop;
+    std::vector<double> m_dirty; // fraction of 64x64 tiles changed from the previous loop frame
+    std::chrono::steady_clock::time_point m_start, m_lastDue;
+    uint64_t m_next = 0;
+    uint64_t m_skipped = 0;
+};
@@ -0,0 +1,585 @@
+#include "TileCodec.h"
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+using namespace TileCodec;
+
+namespace
+{
+    constexpr size_t TILE_PIXELS = size_t(TILE_SIZE) * TILE_SIZE;
+    constexpr uint8_t MODE_SPATIAL = 0;
+    constexpr uint8_t MODE_TEMPORAL = 1;
+    constexpr uint8_t MODE_HUFFMAN = 0x80; // flag: the zero-run/literal stream is Huffman coded
+    // A literal run swallows zero runs shorter than this; two varints cost more
+    constexpr size_t MIN_ZERO_RUN = 3;
+    // Code lengths are limited so that one table lookup decodes any symbol
+    constexpr uint32_t MAX_CODE_BITS = 11;
+    constexpr size_t LENGTH_TABLE_BYTES = 128; // 256 lengths, 4 bits each
+    // Below this the length table cannot pay for itself
+    constexpr size_t MIN_HUFFMAN_BYTES = 192;
+
+    struct TileRect
+    {
+        uint32_t x, y, w, h;
+    };
+
+    TileRect TileAt(size_t tile, uint32_t tilesX, uint32_t width, uint32_t height)
+    {
+        TileRect r;
+        r.x = uint32_t(tile % tilesX) * TILE_SIZE;
+        r.y = uint32_t(tile / tilesX) * TILE_SIZE;
+        r.w = std::min(TILE_SIZE, width - r.x);
+        r.h = std::min(TILE_SIZE, height - r.y);
+        return r;
+    }
+
+    void PutVarint(std::vector<uint8_t>& out, uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            out.push_back(uint8_t(v) | 0x80);
+            v >>= 7;
+        }
+        out.push_back(uint8_t(v));
+    }
+
+    bool GetVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v)
+    {
+        v = 0;
+        for (int shift = 0; shift < 64 && p < end; shift += 7)
+        {
+            uint8_t b = *p++;
+            v |= uint64_t(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    void PutU32(uint8_t* dst, uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i)
+            dst[i] = uint8_t(v >> (8 * i));
+    }
+
+    uint32_t GetU32(const uint8_t* src)
+    {
+        return uint32_t(src[0]) | uint32_t(src[1]) << 8 | uint32_t(src[2]) << 16 | uint32_t(src[3]) << 24;
+    }
+
+    // BGRA tile -> planes G, B-G, R-G, A of n = w * h bytes each
+    void ForwardTransform(const uint8_t* frame, size_t stride, const TileRect& r, uint8_t* planes)
+    {
+        const size_t n = size_t(r.w) * r.h;
+        uint8_t* g = planes;
+        uint8_t* b = planes + n;
+        uint8_t* red = planes + 2 * n;
+        uint8_t* a = planes + 3 * n;
+        for (uint32_t y = 0; y < r.h; ++y)
+        {
+            const uint8_t* src = frame + (r.y + y) * stride + size_t(r.x) * 4;
+            for (uint32_t x = 0; x < r.w; ++x, src += 4)
+            {
+                size_t i = size_t(y) * r.w + x;
+                g[i] = src[1];
+                b[i] = uint8_t(src[0] - src[1]);
+                red[i] = uint8_t(src[2] - src[1]);
+                a[i] = src[3];
+            }
+        }
+    }
+
+    void InverseTransform(const uint8_t* planes, const TileRect& r, uint8_t* frame, size_t stride)
+    {
+        const size_t n = size_t(r.w) * r.h;
+        const uint8_t* g = planes;
+        const uint8_t* b = planes + n;
+        const uint8_t* red = planes + 2 * n;
+        const uint8_t* a = planes + 3 * n;
+        for (uint32_t y = 0; y < r.h; ++y)
+        {
+            uint8_t* dst = frame + (r.y + y) * stride + size_t(r.x) * 4;
+            for (uint32_t x = 0; x < r.w; ++x, dst += 4)
+            {
+                size_t i = size_t(y) * r.w + x;
+                dst[0] = uint8_t(b[i] + g[i]);
+                dst[1] = g[i];
+                dst[2] = uint8_t(red[i] + g[i]);
+                dst[3] = a[i];
+            }
+        }
+    }
+
+    // Left neighbour, or the pixel above for the first column
+    void SpatialResidual(const uint8_t* planes, uint32_t w, uint32_t h, uint8_t* residual)
+    {
+        const size_t n = size_t(w) * h;
+        for (int c = 0; c < 4; ++c)
+        {
+            const uint8_t* src = planes + c * n;
+            uint8_t* dst = residual + c * n;
+            for (uint32_t y = 0; y < h; ++y)
+            {
+                const uint8_t* row = src + size_t(y) * w;
+                uint8_t* out = dst + size_t(y) * w;
+                out[0] = uint8_t(row[0] - (y > 0 ? row[-int(w)] : 0));
+                for (uint32_t x = 1; x < w; ++x)
+                    out[x] = uint8_t(row[x] - row[x - 1]);
+            }
+        }
+    }
+
+    void SpatialReconstruct(uint8_t* planes, uint32_t w, uint32_t h)
+    {
+        const size_t n = size_t(w) * h;
+        for (int c = 0; c < 4; ++c)
+        {
+            uint8_t* p = planes + c * n;
+            for (uint32_t y = 0; y < h; ++y)
+            {
+                uint8_t* row = p + size_t(y) * w;
+                row[0] = uint8_t(row[0] + (y > 0 ? row[-int(w)] : 0));
+                for (uint32_t x = 1; x < w; ++x)
+                    row[x] = uint8_t(row[x] + row[x - 1]);
+            }
+        }
+    }
+
+    void RunLengthEncode(const uint8_t* data, size_t n, std::vector<uint8_t>& out)
+    {
+        size_t i = 0;
+        while (i < n)
+        {
+            size_t zeros = 0;
+            while (i + zeros < n && data[i + zeros] == 0)
+                ++zeros;
+            i += zeros;
+
+            // Literals up to the next zero run worth coding on its own
+            size_t start = i, run = 0;
+            while (i < n)
+            {
+                run = data[i] == 0 ? run + 1 : 0;
+                ++i;
+                if (run == MIN_ZERO_RUN)
+                {
+                    i -= run;
+                    break;
+                }
+            }
+            size_t literals = i - start; // a short zero tail stays literal
+
+            PutVarint(out, zeros);
+            PutVarint(out, literals);
+            out.insert(out.end(), data + start, data + start + literals);
+        }
+    }
+
+    bool RunLengthDecode(const uint8_t* p, const uint8_t* end, uint8_t* data, size_t n)
+    {
+        size_t i = 0;
+        while (i < n)
+        {
+            uint64_t zeros, literals;
+            if (!GetVarint(p, end, zeros) || zeros > n - i)
+                return false;
+            std::memset(data + i, 0, size_t(zeros));
+            i += size_t(zeros);
+
+            if (!GetVarint(p, end, literals) || literals > n - i || literals > uint64_t(end - p))
+                return false;
+            std::memcpy(data + i, p, size_t(literals));
+            p += literals;
+            i += size_t(literals);
+        }
+        return p == end;
+    }
+
+    // Huffman code lengths for the byte frequencies, none longer than MAX_CODE_BITS: the
+    // two-queue construction on the sorted leaves, repeated on halved counts until the
+    // deepest leaf fits.
+    void HuffmanLengths(const uint32_t* counts, uint8_t* lengths)
+    {
+        uint32_t freq[256];
+        std::memcpy(freq, counts, sizeof(freq));
+        std::memset(lengths, 0, 256);
+        uint16_t symbols[256];
+        size_t used = 0;
+        for (uint32_t s = 0; s < 256; ++s)
+            if (freq[s])
+                symbols[used++] = uint16_t(s);
+        if (used == 1)
+        {
+            lengths[symbols[0]] = 1;
+            return;
+        }
+
+        for (;;)
+        {
+            std::sort(symbols, symbols + used, [&](uint16_t a, uint16_t b) { return freq[a] < freq[b]; });
+            // Nodes 0..used-1 are the leaves in order, used.. the internal nodes as made
+            uint64_t weight[511];
+            uint16_t parent[511];
+            for (size_t i = 0; i < used; ++i)
+                weight[i] = freq[symbols[i]];
+            size_t leaf = 0, inner = used, made = used;
+            auto smallest = [&]() {
+                const size_t node = leaf < used && (inner == made || weight[leaf] <= weight[inner]) ? leaf++ : inner++;
+                return node;
+            };
+            while (made < 2 * used - 1)
+            {
+                const size_t a = smallest(), b = smallest();
+                weight[made] = weight[a] + weight[b];
+                parent[a] = parent[b] = uint16_t(made);
+                ++made;
+            }
+            // Depths from the root down: parents are always made after their children
+            uint8_t depth[511];
+            depth[made - 1] = 0;
+            uint32_t deepest = 0;
+            for (size_t n = made - 1; n-- > 0;)
+            {
+                depth[n] = uint8_t(depth[parent[n]] + 1);
+                if (n < used)
+                    deepest = std::max<uint32_t>(deepest, depth[n]);
+            }
+            if (deepest <= MAX_CODE_BITS)
+            {
+                for (size_t i = 0; i < used; ++i)
+                    lengths[symbols[i]] = depth[i];
+                return;
+            }
+            for (size_t i = 0; i < used; ++i)
+                freq[symbols[i]] = (freq[symbols[i]] >> 1) | 1;
+        }
+    }
+
+    // Canonical codes, bit-reversed for an LSB-first bit stream. False when the lengths
+    // overfill the code space.
+    bool CanonicalCodes(const uint8_t* lengths, uint16_t* codes)
+    {
+        uint32_t count[MAX_CODE_BITS + 1] = {};
+        for (int s = 0; s < 256; ++s)
+        {
+            if (lengths[s] > MAX_CODE_BITS)
+                return false;
+            count[lengths[s]]++;
+        }
+        count[0] = 0;
+        uint32_t next[MAX_CODE_BITS + 2] = {};
+        uint32_t code = 0, space = 0;
+        for (uint32_t len = 1; len <= MAX_CODE_BITS; ++len)
+        {
+            code = (code + count[len - 1]) << 1;
+            next[len] = code;
+            space += count[len] << (MAX_CODE_BITS - len);
+        }
+        if (space > (1u << MAX_CODE_BITS))
+            return false;
+        for (int s = 0; s < 256; ++s)
+        {
+            const uint32_t len = lengths[s];
+            if (!len)
+                continue;
+            uint32_t c = next[len]++, reversed = 0;
+            for (uint32_t b = 0; b < len; ++b)
+                reversed |= ((c >> b) & 1) << (len - 1 - b);
+            codes[s] = uint16_t(reversed);
+        }
+        return true;
+    }
+
+    // stream -> varint size, the code lengths and the codes; false when that is no smaller
+    bool HuffmanEncode(const uint8_t* stream, size_t n, std::vector<uint8_t>& out)
+    {
+        uint32_t counts[256] = {};
+        for (size_t i = 0; i < n; ++i)
+            counts[stream[i]]++;
+        uint8_t lengths[256];
+        uint16_t codes[256];
+        HuffmanLengths(counts, lengths);
+        if (!CanonicalCodes(lengths, codes))
+            return false;
+        uint64_t bits = 0;
+        for (int s = 0; s < 256; ++s)
+            bits += uint64_t(counts[s]) * lengths[s];
+        if (10 + LENGTH_TABLE_BYTES + (bits + 7) / 8 >= n)
+            return false;
+
+        PutVarint(out, n);
+        for (int s = 0; s < 256; s += 2)
+            out.push_back(uint8_t(lengths[s] | lengths[s + 1] << 4));
+        uint64_t acc = 0;
+        uint32_t filled = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            acc |= uint64_t(codes[stream[i]]) << filled;
+            filled += lengths[stream[i]];
+            while (filled >= 8)
+            {
+                out.push_back(uint8_t(acc));
+                acc >>= 8;
+                filled -= 8;
+            }
+        }
+        if (filled)
+            out.push_back(uint8_t(acc));
+        return true;
+    }
+
+    bool HuffmanDecode(const uint8_t* p, const uint8_t* end, std::vector<uint8_t>& stream)
+    {
+        uint64_t n;
+        if (!GetVarint(p, end, n) || n > TILE_PIXELS * 4 * 3 || size_t(end - p) < LENGTH_TABLE_BYTES)
+            return false;
+        uint8_t lengths[256];
+        for (int s = 0; s < 256; s += 2)
+        {
+            lengths[s] = p[s / 2] & 15;
+            lengths[s + 1] = p[s / 2] >> 4;
+        }
+        p += LENGTH_TABLE_BYTES;
+        uint16_t codes[256];
+        if (!CanonicalCodes(lengths, codes))
+            return false;
+        // Every MAX_CODE_BITS-bit window -> symbol | length << 8; 0 = no code
+        uint16_t table[1u << MAX_CODE_BITS] = {};
+        for (int s = 0; s < 256; ++s)
+            for (uint32_t i = codes[s]; lengths[s] && i < (1u << MAX_CODE_BITS); i += 1u << lengths[s])
+                table[i] = uint16_t(s | lengths[s] << 8);
+
+        stream.resize(size_t(n));
+        uint64_t acc = 0;
+        uint32_t filled = 0;
+        size_t consumedBits = 0;
+        const size_t availableBits = size_t(end - p) * 8;
+        for (size_t i = 0; i < n; ++i)
+        {
+            while (filled <= 56)
+            {
+                acc |= uint64_t(p < end ? *p : 0) << filled; // zeros past the end, checked below
+                p += p < end;
+                filled += 8;
+            }
+            const uint16_t entry = table[acc & ((1u << MAX_CODE_BITS) - 1)];
+            const uint32_t len = entry >> 8;
+            if (!len)
+                return false;
+            stream[i] = uint8_t(entry);
+            acc >>= len;
+            filled -= len;
+            consumedBits += len;
+        }
+        return consumedBits <= availableBits;
+    }
+
+    bool TileEqual(const uint8_t* a, const uint8_t* b, size_t stride, const TileRect& r)
+    {
+        for (uint32_t y = 0; y < r.h; ++y)
+        {
+            size_t offset = (r.y + y) * stride + size_t(r.x) * 4;
+            if (std::memcmp(a + offset, b + offset, size_t(r.w) * 4) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    void CopyTile(const uint8_t* src, uint8_t* dst, size_t stride, const TileRect& r)
+    {
+        for (uint32_t y = 0; y < r.h; ++y)
+        {
+            size_t offset = (r.y + y) * stride + size_t(r.x) * 4;
+            std::memcpy(dst + offset, src + offset, size_t(r.w) * 4);
+        }
+    }
+}
+
+TileEncoder::TileEncoder(uint32_t width, uint32_t height, unsigned threads, WorkerPool* pool)
+    : m_width(width), m_height(height),
+      m_tilesX((width + TILE_SIZE - 1) / TILE_SIZE), m_tilesY((height + TILE_SIZE - 1) / TILE_SIZE),
+      m_ownPool(pool ? nullptr : new WorkerPool(threads)), m_pool(pool ? pool : m_ownPool.get()),
+      m_previous(size_t(width) * height * 4), m_tileData(size_t(m_tilesX) * m_tilesY)
+{
+}
+
+TileEncoder::~TileEncoder() = default;
+
+bool TileEncoder::EncodeFrame(const uint8_t* bgra, std::vector<uint8_t>& out, const uint8_t* changedTiles)
+{
+    const bool key = m_forceKey;
+    m_forceKey = false;
+    const size_t stride = size_t(m_width) * 4;
+    std::atomic<uint64_t> skipped{ 0 };
+
+    m_pool->ParallelFor(m_tileData.size(), [&](size_t tile) {
+        TileRect r = TileAt(tile, m_tilesX, m_width, m_height);
+        std::vector<uint8_t>& data = m_tileData[tile];
+        data.clear();
+
+        if (!key && (changedTiles ? !changedTiles[tile] : TileEqual(bgra, m_previous.data(), stride, r)))
+        {
+            ++skipped;
+            return;
+        }
+
+        const size_t n = size_t(r.w) * r.h * 4;
+        uint8_t current[TILE_PIXELS * 4], residual[TILE_PIXELS * 4];
+        ForwardTransform(bgra, stride, r, current);
+
+        data.push_back(MODE_SPATIAL);
+        SpatialResidual(current, r.w, r.h, residual);
+        RunLengthEncode(residual, n, data);
+
+        if (!key)
+        {
+            thread_local std::vector<uint8_t> temporal;
+            uint8_t previous[TILE_PIXELS * 4];
+            ForwardTransform(m_previous.data(), stride, r, previous);
+            for (size_t i = 0; i < n; ++i)
+                residual[i] = uint8_t(current[i] - previous[i]);
+
+            temporal.clear();
+            temporal.push_back(MODE_TEMPORAL);
+            RunLengthEncode(residual, n, temporal);
+            if (temporal.size() < data.size())
+                data.swap(temporal);
+        }
+
+        if (m_huffman && data.size() > MIN_HUFFMAN_BYTES)
+        {
+            thread_local std::vector<uint8_t> coded;
+            coded.clear();
+            coded.push_back(uint8_t(data[0] | MODE_HUFFMAN));
+            if (HuffmanEncode(data.data() + 1, data.size() - 1, coded) && coded.size() < data.size())
+                data.swap(coded);
+        }
+
+        CopyTile(bgra, m_previous.data(), stride, r);
+    });
+
+    m_tilesSkipped += skipped;
+    m_tilesCoded += m_tileData.size() - skipped;
+
+    out.resize(FRAME_HEADER_BYTES);
+    out[0] = 'T';
+    out[1] = 'F';
+    out[2] = key ? 1 : 0;
+    out[3] = 0;
+    PutU32(&out[4], m_width);
+    PutU32(&out[8], m_height);
+
+    size_t payload = 0;
+    for (const auto& data : m_tileData)
+    {
+        PutVarint(out, data.size());
+        payload += data.size();
+    }
+    out.reserve(out.size() + payload);
+    for (const auto& data : m_tileData)
+        out.insert(out.end(), data.begin(), data.end());
+    return key;
+}
+
+TileDecoder::TileDecoder(uint32_t width, uint32_t height, unsigned threads, WorkerPool* pool)
+    : m_width(width), m_height(height),
+      m_tilesX((width + TILE_SIZE - 1) / TILE_SIZE), m_tilesY((height + TILE_SIZE - 1) / TILE_SIZE),
+      m_ownPool(pool ? nullptr : new WorkerPool(threads)), m_pool(pool ? pool : m_ownPool.get()),
+      m_frame(size_t(width) * height * 4)
+{
+}
+
+TileDecoder::~TileDecoder() = default;
+
+bool TileDecoder::DecodeFrame(const uint8_t* data, size_t size, uint8_t* bgra)
+{
+    if (size < FRAME_HEADER_BYTES || data[0] != 'T' || data[1] != 'F' ||
+        GetU32(data + 4) != m_width || GetU32(data + 8) != m_height)
+        return false;
+    const bool key = (data[2] & 1) != 0;
+    if (!key && !m_haveFrame)
+        return false;
+
+    const uint8_t* p = data + FRAME_HEADER_BYTES;
+    const uint8_t* end = data + size;
+    const size_t tiles = size_t(m_tilesX) * m_tilesY;
+    m_offsets.resize(tiles);
+    m_sizes.resize(tiles);
+    for (size_t t = 0; t < tiles; ++t)
+    {
+        uint64_t tileSize;
+        if (!GetVarint(p, end, tileSize) || (key && tileSize == 0))
+            return false;
+        m_sizes[t] = size_t(tileSize);
+    }
+    size_t offset = size_t(p - data);
+    for (size_t t = 0; t < tiles; ++t)
+    {
+        m_offsets[t] = offset;
+        offset += m_sizes[t];
+        if (offset > size)
+            return false;
+    }
+
+    const size_t stride = size_t(m_width) * 4;
+    std::atomic<bool> ok{ true };
+    m_pool->ParallelFor(tiles, [&](size_t tile) {
+        if (m_sizes[tile] == 0)
+            return; // unchanged, m_frame still holds it
+
+        TileRect r = TileAt(tile, m_tilesX, m_width, m_height);
+        const size_t n = size_t(r.w) * r.h * 4;
+        const uint8_t* src = data + m_offsets[tile];
+        const uint8_t* stream = src + 1;
+        const uint8_t* streamEnd = src + m_sizes[tile];
+        const uint8_t mode = uint8_t(src[0] & ~MODE_HUFFMAN);
+        if (src[0] & MODE_HUFFMAN)
+        {
+            thread_local std::vector<uint8_t> decoded;
+            if (!HuffmanDecode(stream, streamEnd, decoded))
+            {
+                ok = false;
+                return;
+            }
+            stream = decoded.data();
+            streamEnd = decoded.data() + decoded.size();
+        }
+        uint8_t planes[TILE_PIXELS * 4];
+        if (!RunLengthDecode(stream, streamEnd, planes, n))
+        {
+            ok = false;
+            return;
+        }
+
+        if (mode == MODE_TEMPORAL && !key)
+        {
+            uint8_t previous[TILE_PIXELS * 4];
+            ForwardTransform(m_frame.data(), stride, r, previous);
+            for (size_t i = 0; i < n; ++i)
+                planes[i] = uint8_t(planes[i] + previous[i]);
+        }
+        else if (mode == MODE_SPATIAL)
+        {
+            SpatialReconstruct(planes, r.w, r.h);
+        }
+        else
+        {
+            ok = false;
+            return;
+        }
+        InverseTransform(planes, r, m_frame.data(), stride);
+    });
+
+    if (!ok)
+    {
+        m_haveFrame = false; // the reference is now partially updated
+        return false;
+    }
+    m_haveFrame = true;
+    std::memcpy(bgra, m_frame.data(), m_frame.size());
+    return true;
+}
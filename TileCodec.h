@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class WorkerPool;
+
+// Lossless inter-frame codec for desktop captures (top-down BGRA).
+//
+// The frame is cut into 64x64 tiles. A tile identical to the one in the previous frame
+// costs one byte; any other tile is coded as the better of
+//   spatial:  left-neighbour prediction (above for the first column)
+//   temporal: difference to the same pixel of the previous frame
+// after a subtract-green transform (B-G, R-G), plane by plane, then a zero-run/literal
+// stage with varint lengths. Flat UI, text on a plain background and partially updated
+// tiles turn into long zero runs. What remains of photos and video is mostly small
+// literals, so a stream longer than a few hundred bytes is Huffman coded (canonical, code
+// lengths <= 11 bits, one table lookup per byte) when that makes the tile smaller.
+// Tiles are independent, so encode and decode run on a WorkerPool. Keyframes (first
+// frame, ForceKeyframe) use neither skip nor temporal mode.
+//
+// Frame layout:  "TF" flags(bit0 = key) 0  width:u32  height:u32
+//                varint size per tile (0 = unchanged)  tile payloads in tile order
+// Tile payload:  mode:u8 (0 spatial, 1 temporal; bit7 = Huffman)  zero-run/literal stream
+// Huffman:       varint stream size  128 bytes of 4-bit code lengths (byte 0 low nibble
+//                first)  codes, LSB first
+namespace TileCodec
+{
+    constexpr uint32_t TILE_SIZE = 64;
+    constexpr size_t FRAME_HEADER_BYTES = 12;
+}
+
+class TileEncoder
+{
+public:
+    // threads = 0: hardware concurrency. pool, when given, is used instead of a private one.
+    TileEncoder(uint32_t width, uint32_t height, unsigned threads = 0, WorkerPool* pool = nullptr);
+    ~TileEncoder();
+
+    // Appends nothing, replaces out with the encoded frame. Returns true for a keyframe.
+    // changedTiles, per tile in row-major order, nonzero where bgra differs from the frame
+    // encoded before (TileHasher::Changed() of the same frames), is trusted in place of
+    // comparing the tiles; the copy of the previous frame stays for temporal prediction.
+    bool EncodeFrame(const uint8_t* bgra, std::vector<uint8_t>& out, const uint8_t* changedTiles = nullptr);
+    void ForceKeyframe() { m_forceKey = true; }
+    // On by default; off writes the streams of older builds (decoders read both)
+    void SetHuffman(bool enabled) { m_huffman = enabled; }
+
+    uint64_t TilesSkipped() const { return m_tilesSkipped; }
+    uint64_t TilesCoded() const { return m_tilesCoded; }
+
+private:
+    uint32_t m_width, m_height, m_tilesX, m_tilesY;
+    std::unique_ptr<WorkerPool> m_ownPool;
+    WorkerPool* m_pool;
+    std::vector<uint8_t> m_previous;
+    std::vector<std::vector<uint8_t>> m_tileData; // per tile, reused between frames
+    bool m_forceKey = true;
+    bool m_huffman = true;
+    uint64_t m_tilesSkipped = 0, m_tilesCoded = 0;
+};
+
+class TileDecoder
+{
+public:
+    TileDecoder(uint32_t width, uint32_t height, unsigned threads = 0, WorkerPool* pool = nullptr);
+    ~TileDecoder();
+
+    // Decode one frame into bgra (width * height * 4). Inter frames need the previous
+    // frame of the same stream to have been decoded by this decoder.
+    bool DecodeFrame(const uint8_t* data, size_t size, uint8_t* bgra);
+
+private:
+    uint32_t m_width, m_height, m_tilesX, m_tilesY;
+    std::unique_ptr<WorkerPool> m_ownPool;
+    WorkerPool* m_pool;
+    std::vector<uint8_t> m_frame;
+    std::vector<size_t> m_offsets, m_sizes;
+    bool m_haveFrame = false;
+};
@@ -0,0 +1,98 @@
+#include "BenchmarkModes.h"
+
+#include "TileCodec.h"
+#include "TileHash.h"
+
+#include <cstdio>
+#include <cstring>
+
+TileCodecBenchmark MeasureTileCodec(const BenchmarkConfig& config, const std::vector<SyntheticWorkload>& workloads)
+{
+    TileCodecBenchmark bench;
+    const uint32_t width = config.width, height = config.height;
+    bench.width = width;
+    bench.height = height;
+    const size_t frameBytes = size_t(width) * height * 4;
+
+    for (SyntheticWorkload workload : workloads)
+    {
+        const SyntheticDesktop desktop(workload, width, height);
+        std::vector<uint8_t> frame(frameBytes), decoded(frameBytes), encoded;
+        const struct
+        {
+            bool huffman, hashedTiles;
+        } variants[] = { { true, false }, { false, false }, { true, true } };
+        for (const auto& variant : variants)
+        {
+            TileCodecRun run;
+            run.workload = workload;
+            run.huffman = variant.huffman;
+            run.hashedTiles = variant.hashedTiles;
+            TileEncoder encoder(width, height);
+            TileDecoder decoder(width, height);
+            TileHasher hasher;
+            hasher.Reset(width, height);
+            encoder.SetHuffman(variant.huffman);
+            double encodeSeconds = 0.0, decodeSeconds = 0.0;
+            for (uint32_t i = 0; i < config.frames; ++i)
+            {
+                desktop.Render(i, frame.data());
+                if (variant.hashedTiles)
+                    hasher.Hash(frame.data());
+                auto start = Clock::now();
+                encoder.EncodeFrame(frame.data(), encoded, variant.hashedTiles ? hasher.Changed().data() : nullptr);
+                auto encodedAt = Clock::now();
+                const bool ok = decoder.DecodeFrame(encoded.data(), encoded.size(), decoded.data());
+                auto decodedAt = Clock::now();
+                encodeSeconds += std::chrono::duration<double>(encodedAt - start).count();
+                decodeSeconds += std::chrono::duration<double>(decodedAt - encodedAt).count();
+                run.mismatches += ok && std::memcmp(frame.data(), decoded.data(), frameBytes) == 0 ? 0 : 1;
+                run.encodedBytes += encoded.size();
+            }
+            run.frames = config.frames;
+            run.rawBytes = uint64_t(frameBytes) * config.frames;
+            run.ratio = run.encodedBytes ? double(run.rawBytes) / double(run.encodedBytes) : 0.0;
+            run.encodeMBps = encodeSeconds > 0.0 ? double(run.rawBytes) / 1e6 / encodeSeconds : 0.0;
+            run.decodeMBps = decodeSeconds > 0.0 ? double(run.rawBytes) / 1e6 / decodeSeconds : 0.0;
+            bench.runs.push_back(run);
+        }
+    }
+    return bench;
+}
+
+std::string FormatTileCodecJson(const TileCodecBenchmark& bench)
+{
+    char buf[512];
+    std::snprintf(buf, sizeof(buf), "{\"benchmark\":\"tile_codec\",\"width\":%u,\"height\":%u,\"runs\":[",
+        bench.width, bench.height);
+    std::string json = buf;
+    for (size_t i = 0; i < bench.runs.size(); ++i)
+    {
+        const TileCodecRun& run = bench.runs[i];
+        std::snprintf(buf, sizeof(buf),
+            "%s\n  {\"workload\":\"%s\",\"huffman\":%s,\"hashed_tiles\":%s,\"frames\":%llu,\"raw_bytes\":%llu,\"encoded_bytes\":%llu,"
+            "\"ratio\":%.2f,\"encode_mb_s\":%.1f,\"decode_mb_s\":%.1f,\"mismatches\":%llu}",
+            i ? "," : "", SyntheticWorkloadName(run.workload), run.huffman ? "true" : "false",
+            run.hashedTiles ? "true" : "false", (unsigned long long)run.frames, (unsigned long long)run.rawBytes, (unsigned long long)run.encodedBytes,
+            run.ratio, run.encodeMBps, run.decodeMBps, (unsigned long long)run.mismatches);
+        json += buf;
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+bool RunTileCodecMode(const BenchmarkOptions& options, std::string& json)
+{
+    TileCodecBenchmark bench = MeasureTileCodec(options.config, options.workloads);
+    bool ok = !bench.runs.empty();
+    for (size_t i = 0; i < bench.runs.size(); ++i)
+    {
+        // With the hasher's tiles the stream must be the one the encoder's compare gives
+        const TileCodecRun& run = bench.runs[i];
+        ok = ok && run.frames > 0 && run.mismatches == 0;
+        if (run.hashedTiles)
+            ok = ok && i >= 2 && run.encodedBytes == bench.runs[i - 2].encodedBytes;
+    }
+    json = FormatTileCodecJson(bench);
+    return ok;
+}
@@ -0,0 +1,221 @@
+#include "TileHash.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TILEHASH_SSE 1
+#else
+#define TILEHASH_SSE 0
+#endif
+
+namespace
+{
+// Per row of a tile, 16 bytes of key per 16 bytes of the row segment (TILE * 4 bytes) and
+// one more for the second NH sum, drawn independently for every position in the tile so
+// rows that trade places change the sums too
+constexpr uint32_t CHUNKS = TileHasher::TILE * 4 / 16;
+constexpr uint32_t KEY_WORDS = (CHUNKS + 1) * 4;
+
+struct alignas(16) HashKeys
+{
+    uint32_t words[TileHasher::TILE][KEY_WORDS];
+
+    HashKeys()
+    {
+        // splitmix64
+        uint64_t state = 0x243F6A8885A308D3ull;
+        auto next = [&] {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        };
+        for (auto& row : words)
+            for (uint32_t& word : row)
+                word = uint32_t(next());
+    }
+};
+
+const HashKeys g_keys;
+}
+
+// Bijective in x for any h, so a part that changed always moves the hash
+static inline uint64_t Fold(uint64_t h, uint64_t x)
+{
+    h = (h ^ x) * 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 32);
+}
+
+// murmur3 fmix64
+static inline uint64_t Finish(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    return h ^ (h >> 33);
+}
+
+bool TileHasher::Reset(uint32_t width, uint32_t height, bool allowSimd)
+{
+    if (width == 0 || height == 0)
+        return false;
+
+    m_width = width;
+    m_height = height;
+    m_tilesX = (width + TILE - 1) / TILE;
+    m_tilesY = (height + TILE - 1) / TILE;
+#if TILEHASH_SSE
+    m_simd = allowSimd;
+#else
+    (void)allowSimd;
+    m_simd = false;
+#endif
+    m_state.assign(m_tilesX, TileState());
+    m_hashes.assign(size_t(m_tilesX) * m_tilesY, 0);
+    m_changed.assign(m_hashes.size(), 1);
+    m_changedCount = uint32_t(m_hashes.size());
+    m_changedArea = uint64_t(width) * height;
+    m_havePrevious = false;
+    m_row = 0;
+    return true;
+}
+
+bool TileHasher::Resize(uint32_t width, uint32_t height)
+{
+    if (width == m_width && height == m_height && width && height)
+        return true;
+    return Reset(width, height, m_width ? m_simd : true);
+}
+
+double TileHasher::ChangedFraction() const
+{
+    return m_width ? double(m_changedArea) / (double(m_width) * m_height) : 1.0;
+}
+
+void TileHasher::Begin()
+{
+    m_row = 0;
+}
+
+// count pixels of one tile row segment into its tile's NH sums, stored to copy on the way
+// when there is one. Per pair of 16-byte chunks v, w starting at chunk c, in 32-bit words
+// and 32 x 32 -> 64-bit products:
+//   nh[0], nh[1] += (v + k[c]) . (w + k[c + 1])      words 0-1, 2-3
+//   nh[2], nh[3] += (v + k[c + 1]) . (w + k[c + 2])
+template <bool Copy>
+static void HashSegment(const uint8_t* pixels, uint8_t* copy, uint32_t count, const uint32_t* keys, bool simd,
+    uint64_t nh[4])
+{
+    uint32_t c = 0;
+#if TILEHASH_SSE
+    if (simd)
+    {
+        const uint32_t whole = count / 8 * 2;
+        __m128i nh0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(nh));
+        __m128i nh1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(nh + 2));
+        for (; c < whole; c += 2)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + size_t(c) * 16));
+            const __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + size_t(c) * 16 + 16));
+            if (Copy)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(copy + size_t(c) * 16), v);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(copy + size_t(c) * 16 + 16), w);
+            }
+            const __m128i k0 = _mm_load_si128(reinterpret_cast<const __m128i*>(keys + c * 4));
+            const __m128i k1 = _mm_load_si128(reinterpret_cast<const __m128i*>(keys + c * 4 + 4));
+            const __m128i k2 = _mm_load_si128(reinterpret_cast<const __m128i*>(keys + c * 4 + 8));
+            const __m128i a = _mm_add_epi32(v, k0), b = _mm_add_epi32(w, k1);
+            const __m128i d = _mm_add_epi32(v, k1), e = _mm_add_epi32(w, k2);
+            nh0 = _mm_add_epi64(nh0, _mm_add_epi64(_mm_mul_epu32(a, b),
+                _mm_mul_epu32(_mm_shuffle_epi32(a, 0xF5), _mm_shuffle_epi32(b, 0xF5))));
+            nh1 = _mm_add_epi64(nh1, _mm_add_epi64(_mm_mul_epu32(d, e),
+                _mm_mul_epu32(_mm_shuffle_epi32(d, 0xF5), _mm_shuffle_epi32(e, 0xF5))));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(nh), nh0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(nh + 2), nh1);
+    }
+#else
+    (void)simd;
+#endif
+    // The scalar pairs, then the last one zero-padded when the segment ends inside one
+    uint32_t v[8];
+    for (; c * 4 < count; c += 2)
+    {
+        const size_t bytes = size_t((std::min)(8u, count - c * 4)) * 4;
+        std::memset(v, 0, sizeof(v));
+        std::memcpy(v, pixels + size_t(c) * 16, bytes);
+        if (Copy)
+            std::memcpy(copy + size_t(c) * 16, v, bytes);
+        const uint32_t* k = keys + c * 4;
+        for (int i = 0; i < 4; ++i)
+        {
+            nh[i / 2] += uint64_t(uint32_t(v[i] + k[i])) * uint32_t(v[4 + i] + k[4 + i]);
+            nh[2 + i / 2] += uint64_t(uint32_t(v[i] + k[4 + i])) * uint32_t(v[4 + i] + k[8 + i]);
+        }
+    }
+}
+
+void TileHasher::AddRow(const uint8_t* row, uint8_t* copy)
+{
+    if (m_row >= m_height)
+        return;
+    const uint32_t rowInTile = m_row % TILE;
+    if (rowInTile == 0)
+        std::fill(m_state.begin(), m_state.end(), TileState());
+    const uint32_t* keys = g_keys.words[rowInTile];
+
+    for (uint32_t tx = 0; tx < m_tilesX; ++tx)
+    {
+        const size_t offset = size_t(tx) * TILE * 4;
+        const uint32_t count = (std::min)(TILE, m_width - tx * TILE);
+        TileState& state = m_state[tx];
+        if (copy)
+            HashSegment<true>(row + offset, copy + offset, count, keys, m_simd, state.nh);
+        else
+            HashSegment<false>(row + offset, nullptr, count, keys, m_simd, state.nh);
+    }
+
+    m_row++;
+    if (m_row % TILE == 0 || m_row == m_height)
+        EndTileRow((m_row - 1) / TILE);
+}
+
+void TileHasher::EndTileRow(uint32_t tileRow)
+{
+    if (tileRow == 0)
+    {
+        m_changedCount = 0;
+        m_changedArea = 0;
+    }
+    const uint32_t rows = (std::min)(TILE, m_height - tileRow * TILE);
+    for (uint32_t tx = 0; tx < m_tilesX; ++tx)
+    {
+        const size_t i = size_t(tileRow) * m_tilesX + tx;
+        const TileState& state = m_state[tx];
+        uint64_t hash = rows;
+        for (uint64_t sum : state.nh)
+            hash = Fold(hash, sum);
+        hash = Finish(hash);
+        const bool changed = !m_havePrevious || hash != m_hashes[i];
+        m_hashes[i] = hash;
+        m_changed[i] = changed;
+        if (changed)
+        {
+            m_changedCount++;
+            m_changedArea += uint64_t((std::min)(TILE, m_width - tx * TILE)) * rows;
+        }
+    }
+    if (tileRow + 1 == m_tilesY)
+        m_havePrevious = true;
+}
+
+void TileHasher::Hash(const uint8_t* bgra, size_t pitch)
+{
+    Begin();
+    for (uint32_t y = 0; y < m_height; ++y)
+        AddRow(bgra + size_t(y) * pitch);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-tile content hashes of capture frames, compared frame to frame: change detection
+// where the source has no dirty rects (replayed archives, X11 without XDAMAGE, DXGI frames
+// without metadata) or reports more than changed.
+//
+//  - TILE x TILE tiles, the TileCodec grid; edge tiles cover what is left
+//  - rows are fed one at a time like FrameDownscaler, so a source hashes each row while it
+//    is still in cache from the readback copy
+//  - per tile, 32 bytes at a time: two Toeplitz NH sums of 32 x 32 -> 64-bit products of
+//    (pixels + key) pairs, the keys drawn per position in the tile (SSE2 _mm_mul_epu32),
+//    mixed into a 64-bit hash when the tile's last row is in. The scalar path gives the
+//    same hashes
+//  - a tile whose hash differs from the previous frame's has certainly changed; one that
+//    matches is unchanged but for a collision of about 2^-64 per tile, so exact consumers
+//    (WearIntegral::Accumulate, TileEncoder::EncodeFrame) take Changed() in place of
+//    their own compare with a copy of the previous frame. The keys are fixed: no defence
+//    against content crafted to collide
+class TileHasher
+{
+public:
+    static constexpr uint32_t TILE = 64;
+
+    // Forgets the previous frame: every tile of the next one counts as changed
+    bool Reset(uint32_t width, uint32_t height, bool allowSimd = true);
+    // Reset unless the hasher already has that size
+    bool Resize(uint32_t width, uint32_t height);
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    uint32_t TilesX() const { return m_tilesX; }
+    uint32_t TilesY() const { return m_tilesY; }
+
+    // Start a frame, then Height() rows of Width() BGRA pixels, top to bottom. With copy,
+    // the row is also stored there in the same pass: the readback copy and the hash read
+    // every byte once.
+    void Begin();
+    void AddRow(const uint8_t* row, uint8_t* copy = nullptr);
+    // Begin + every row of a frame with rows pitch bytes apart
+    void Hash(const uint8_t* bgra, size_t pitch);
+    void Hash(const uint8_t* bgra) { Hash(bgra, size_t(m_width) * 4); }
+
+    // After a frame's last row: per tile, row-major, 1 where it differs from the previous
+    // frame hashed
+    const std::vector<uint8_t>& Changed() const { return m_changed; }
+    uint32_t ChangedCount() const { return m_changedCount; }
+    // Area of the changed tiles / frame area
+    double ChangedFraction() const;
+    uint64_t TileHash(uint32_t tile) const { return m_hashes[tile]; }
+
+private:
+    struct TileState
+    {
+        uint64_t nh[4] = {};
+    };
+
+    void EndTileRow(uint32_t tileRow);
+
+    uint32_t m_width = 0, m_height = 0;
+    uint32_t m_tilesX = 0, m_tilesY = 0;
+    bool m_simd = false;
+    bool m_havePrevious = false;
+    uint32_t m_row = 0;
+
+    std::vector<TileState> m_state;  // per tile of the current tile row
+    std::vector<uint64_t> m_hashes;  // per tile, the last frame
+    std::vector<uint8_t> m_changed;
+    uint32_t m_changedCount = 0;
+    uint64_t m_changedArea = 0;
+};
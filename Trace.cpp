@@ -0,0 +1,315 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace Trace
+{
+    std::atomic<bool> g_enabled{ false };
+}
+
+namespace
+{
+    // Fields are relaxed atomics so a dump may read a ring while its thread writes: on
+    // x86 these are plain moves. Events overwritten during a dump are detected by the
+    // head moving past them and discarded.
+    struct RingEvent
+    {
+        std::atomic<const char*> name{ nullptr };
+        std::atomic<uint64_t> begin{ 0 };
+        std::atomic<uint64_t> end{ 0 };
+        std::atomic<uint64_t> frame{ 0 };
+    };
+
+    struct TraceRing
+    {
+        uint32_t tid = 0;
+        std::atomic<const char*> threadName{ nullptr };
+        std::atomic<uint64_t> head{ 0 };    // events ever written; only the owner thread stores
+        std::atomic<uint64_t> cleared{ 0 }; // head at the last Clear; older events are hidden
+        std::unique_ptr<RingEvent[]> events{ new RingEvent[Trace::RING_EVENTS] };
+    };
+
+    struct Event
+    {
+        const char* name;
+        uint64_t begin, end, frame;
+        uint32_t tid;
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<TraceRing>> rings;
+        std::vector<TraceRing*> freeRings; // of exited threads, events still in dumps until taken
+        uint32_t nextTid = 1;
+        // Calibration point taken by Enable
+        uint64_t tsc0 = 0;
+        std::chrono::steady_clock::time_point clock0;
+    };
+
+    Registry& GetRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    // Hands the ring back when its thread exits
+    struct RingOwner
+    {
+        TraceRing* ring = nullptr;
+
+        ~RingOwner()
+        {
+            if (!ring)
+                return;
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.freeRings.push_back(ring);
+        }
+    };
+
+    thread_local RingOwner t_owner;
+    thread_local const char* t_threadName = nullptr;
+    thread_local uint64_t t_frame = 0;
+
+    // Taken on the thread's first event, so threads that never record while tracing is
+    // enabled hold no ring
+    TraceRing& ThisThreadRing()
+    {
+        if (!t_owner.ring)
+        {
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            TraceRing* ring;
+            if (!registry.freeRings.empty())
+            {
+                // The previous owner's events go: they would show under this thread's tid
+                ring = registry.freeRings.back();
+                registry.freeRings.pop_back();
+                ring->cleared.store(ring->head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+            else
+            {
+                registry.rings.push_back(std::make_unique<TraceRing>());
+                ring = registry.rings.back().get();
+            }
+            ring->tid = registry.nextTid++;
+            ring->threadName.store(t_threadName, std::memory_order_relaxed);
+            t_owner.ring = ring;
+        }
+        return *t_owner.ring;
+    }
+
+    // Consistent copy of every ring, oldest first per thread
+    std::vector<Event> Snapshot(std::vector<std::pair<uint32_t, const char*>>* threads = nullptr)
+    {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        std::vector<Event> events;
+        for (auto& ring : registry.rings)
+        {
+            if (threads)
+                threads->emplace_back(ring->tid, ring->threadName.load(std::memory_order_relaxed));
+
+            const uint64_t head = ring->head.load(std::memory_order_acquire);
+            const uint64_t first = (std::max)(ring->cleared.load(std::memory_order_relaxed),
+                head > Trace::RING_EVENTS ? head - Trace::RING_EVENTS : 0);
+            const size_t start = events.size();
+            for (uint64_t i = first; i < head; ++i)
+            {
+                const RingEvent& e = ring->events[i & (Trace::RING_EVENTS - 1)];
+                events.push_back({ e.name.load(std::memory_order_relaxed), e.begin.load(std::memory_order_relaxed),
+                    e.end.load(std::memory_order_relaxed), e.frame.load(std::memory_order_relaxed), ring->tid });
+            }
+
+            // Slots the owner reused (or was writing) while we copied hold newer events than
+            // their index says
+            const uint64_t after = ring->head.load(std::memory_order_acquire) + 1;
+            const uint64_t stale = after > first + Trace::RING_EVENTS ? after - first - Trace::RING_EVENTS : 0;
+            events.erase(events.begin() + start, events.begin() + start + size_t((std::min<uint64_t>)(stale, head - first)));
+        }
+        return events;
+    }
+
+    // Nanoseconds per TSC tick, measured between Enable and now
+    double NsPerTick()
+    {
+#if TRACE_HAS_TSC
+        Registry& registry = GetRegistry();
+        const uint64_t ticks = Trace::Now() - registry.tsc0;
+        const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - registry.clock0).count();
+        return ticks > 0 && ns > 0.0 ? ns / double(ticks) : 1.0;
+#else
+        return 1.0;
+#endif
+    }
+}
+
+void Trace::Enable(bool enabled)
+{
+    if (enabled && !IsEnabled())
+    {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.tsc0 = Now();
+        registry.clock0 = std::chrono::steady_clock::now();
+    }
+    g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Trace::Clear()
+{
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    // Only the owner may move head; hide what is there instead
+    for (auto& ring : registry.rings)
+        ring->cleared.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+size_t Trace::RingCount()
+{
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.rings.size();
+}
+
+void Trace::SetFrame(uint64_t frameId)
+{
+    t_frame = frameId;
+}
+
+uint64_t Trace::CurrentFrame()
+{
+    return t_frame;
+}
+
+void Trace::SetThreadName(const char* name)
+{
+    t_threadName = name;
+    if (t_owner.ring)
+        t_owner.ring->threadName.store(name, std::memory_order_relaxed);
+}
+
+void Trace::Record(const char* name, uint64_t begin, uint64_t end, uint64_t frameId)
+{
+    TraceRing& ring = ThisThreadRing();
+    const uint64_t head = ring.head.load(std::memory_order_relaxed);
+    RingEvent& e = ring.events[head & (RING_EVENTS - 1)];
+    e.name.store(name, std::memory_order_relaxed);
+    e.begin.store(begin, std::memory_order_relaxed);
+    e.end.store(end, std::memory_order_relaxed);
+    e.frame.store(frameId, std::memory_order_relaxed);
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+std::string Trace::ExportChromeJson()
+{
+    std::vector<std::pair<uint32_t, const char*>> threads;
+    std::vector<Event> events = Snapshot(&threads);
+    const double nsPerTick = NsPerTick();
+    const uint64_t origin = GetRegistry().tsc0;
+
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    char buf[256];
+    bool first = true;
+    for (auto& thread : threads)
+    {
+        if (!thread.second)
+            continue;
+        std::snprintf(buf, sizeof(buf), "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",", thread.first, thread.second);
+        json += buf;
+        first = false;
+    }
+    for (const Event& e : events)
+    {
+        // Events from before the last Enable have no calibration; clamp them to its start
+        const double ts = e.begin > origin ? double(e.begin - origin) * nsPerTick / 1000.0 : 0.0;
+        const double dur = e.end > e.begin ? double(e.end - e.begin) * nsPerTick / 1000.0 : 0.0;
+        std::snprintf(buf, sizeof(buf),
+            "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}",
+            first ? "" : ",", e.name ? e.name : "?", e.tid, ts, dur, (unsigned long long)e.frame);
+        json += buf;
+        first = false;
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+bool Trace::SaveChromeJson(const std::string& path)
+{
+    std::ofstream file(path, std::ios::trunc);
+    file << ExportChromeJson();
+    file.close();
+    return !file.fail();
+}
+
+std::vector<Trace::StageSummary> Trace::Summarize(uint64_t from, uint64_t to)
+{
+    std::vector<Event> events = Snapshot();
+    const double nsPerTick = NsPerTick();
+
+    std::map<std::string, std::vector<double>> byName;
+    for (const Event& e : events)
+        if (e.begin >= from && e.begin < to)
+            byName[e.name ? e.name : "?"].push_back(e.end > e.begin ? double(e.end - e.begin) * nsPerTick / 1000.0 : 0.0);
+
+    std::vector<StageSummary> stages;
+    for (auto& entry : byName)
+    {
+        std::vector<double>& us = entry.second;
+        StageSummary stage;
+        stage.name = entry.first;
+        stage.count = us.size();
+
+        double sum = 0.0;
+        for (double d : us)
+        {
+            sum += d;
+            int bucket = 0;
+            while (bucket < HISTOGRAM_BUCKETS - 1 && d >= double(1ull << bucket))
+                ++bucket;
+            stage.histogram[bucket]++;
+        }
+        stage.meanUs = sum / double(us.size());
+
+        std::sort(us.begin(), us.end());
+        auto at = [&](double q) { return us[(std::min)(us.size() - 1, size_t(q * double(us.size() - 1) + 0.5))]; };
+        stage.p50Us = at(0.50);
+        stage.p99Us = at(0.99);
+        stage.maxUs = us.back();
+        stages.push_back(stage);
+    }
+    return stages;
+}
+
+std::string Trace::FormatSummary(const std::vector<StageSummary>& stages)
+{
+    std::string text;
+    char buf[256];
+    for (const StageSummary& stage : stages)
+    {
+        std::snprintf(buf, sizeof(buf), "%s count=%llu mean_us=%.1f p50_us=%.1f p99_us=%.1f max_us=%.1f hist_log2_us=",
+            stage.name.c_str(), (unsigned long long)stage.count, stage.meanUs, stage.p50Us, stage.p99Us, stage.maxUs);
+        text += buf;
+
+        // Buckets up to the last non-empty one
+        int last = HISTOGRAM_BUCKETS - 1;
+        while (last > 0 && stage.histogram[last] == 0)
+            --last;
+        for (int b = 0; b <= last; ++b)
+        {
+            std::snprintf(buf, sizeof(buf), b ? ",%u" : "%u", stage.histogram[b]);
+            text += buf;
+        }
+        text += "\n";
+    }
+    return text;
+}
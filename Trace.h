@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define TRACE_HAS_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_HAS_TSC 1
+#else
+#include <chrono>
+#define TRACE_HAS_TSC 0
+#endif
+
+// Hot-path tracing: scoped trace points written to per-thread lock-free rings with TSC
+// timestamps, each tagged with the frame id it worked on. Dumped on demand as Chrome
+// trace JSON (chrome://tracing, Perfetto) and summarized as per-stage latency histograms.
+//
+//   Trace::SetFrame(info.frameId);         // the id travels with the thread
+//   { TRACE_SCOPE("CopyResource"); ... }
+//
+// Recording is off until Enable(true). A disabled scope is one relaxed atomic load and a
+// branch; building with OLEPPY_TRACE=0 removes the scopes entirely. Names must be string
+// literals (only the pointer is stored). Each thread keeps its last RING_EVENTS events in
+// a ring taken on its first event while recording; threads that never record cost no
+// memory. A ring outlives its thread, so short-lived workers still show up in a dump,
+// until a new thread takes it over.
+#ifndef OLEPPY_TRACE
+#define OLEPPY_TRACE 1
+#endif
+
+namespace Trace
+{
+    constexpr size_t RING_EVENTS = 1 << 14;
+    constexpr int HISTOGRAM_BUCKETS = 24; // bucket b: durations in [2^(b-1), 2^b) us, b = 0: < 1 us
+
+    extern std::atomic<bool> g_enabled;
+
+    inline bool IsEnabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+    inline uint64_t Now()
+    {
+#if TRACE_HAS_TSC
+        return __rdtsc();
+#else
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    // Start or stop recording. Enabling recalibrates the TSC against the steady clock.
+    void Enable(bool enabled);
+    // Drop every recorded event (rings stay allocated).
+    void Clear();
+    // Rings allocated so far, of live and exited threads
+    size_t RingCount();
+
+    // Frame id that scopes on this thread are tagged with until the next SetFrame.
+    void SetFrame(uint64_t frameId);
+    uint64_t CurrentFrame();
+    // Shown as the thread name in the Chrome trace. Allocates nothing.
+    void SetThreadName(const char* name);
+
+    void Record(const char* name, uint64_t begin, uint64_t end, uint64_t frameId);
+
+    struct StageSummary
+    {
+        std::string name;
+        uint64_t count = 0;
+        double meanUs = 0.0, p50Us = 0.0, p99Us = 0.0, maxUs = 0.0;
+        uint32_t histogram[HISTOGRAM_BUCKETS] = {};
+    };
+
+    // Chrome trace event format, complete ("X") events with args.frame
+    std::string ExportChromeJson();
+    bool SaveChromeJson(const std::string& path);
+    // Per trace point name, sorted by name; only events that began in [from, to) (Now()
+    // values) when given, e.g. the measured part of a run
+    std::vector<StageSummary> Summarize(uint64_t from = 0, uint64_t to = UINT64_MAX);
+    // "name count=.. mean_us=.. p50_us=.. p99_us=.. max_us=.." lines
+    std::string FormatSummary(const std::vector<StageSummary>& stages);
+}
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name)
+    {
+        if (Trace::IsEnabled())
+        {
+            m_name = name;
+            m_frame = Trace::CurrentFrame();
+            m_begin = Trace::Now();
+        }
+    }
+    TraceScope(const char* name, uint64_t frameId)
+    {
+        if (Trace::IsEnabled())
+        {
+            m_name = name;
+            m_frame = frameId;
+            m_begin = Trace::Now();
+        }
+    }
+    ~TraceScope()
+    {
+        if (m_name)
+            Trace::Record(m_name, m_begin, Trace::Now(), m_frame);
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_name = nullptr;
+    uint64_t m_frame = 0;
+    uint64_t m_begin = 0;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#if OLEPPY_TRACE
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+#define TRACE_SCOPE_FRAME(name, frameId) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name, frameId)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_SCOPE_FRAME(name, frameId) ((void)0)
+#endif
@@ -0,0 +1,96 @@
+#include "BenchmarkModes.h"
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+// Keeps the loop result alive
+static volatile uint64_t g_timeLoopSink;
+
+// A few dependent multiply-adds per iteration, enough that the loop is not optimized away
+template <bool Scoped>
+static double TimeLoop(uint64_t iterations)
+{
+    uint64_t x = 1;
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i)
+    {
+        if (Scoped)
+        {
+            TRACE_SCOPE("TraceOverhead");
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+        }
+        else
+        {
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    g_timeLoopSink = x;
+    return ns / double(iterations);
+}
+
+TraceOverhead MeasureTraceOverhead(uint64_t iterations, uint32_t threads)
+{
+    TraceOverhead overhead;
+    overhead.iterations = iterations;
+    const bool wasEnabled = Trace::IsEnabled();
+
+    // Best of three rounds of each, interleaved so frequency changes hit all alike
+    overhead.baselineNs = overhead.disabledNs = overhead.enabledNs = 1e30;
+    for (int round = 0; round < 3; ++round)
+    {
+        Trace::Enable(false);
+        overhead.baselineNs = (std::min)(overhead.baselineNs, TimeLoop<false>(iterations));
+        overhead.disabledNs = (std::min)(overhead.disabledNs, TimeLoop<true>(iterations));
+        Trace::Enable(true);
+        overhead.enabledNs = (std::min)(overhead.enabledNs, TimeLoop<true>(iterations));
+    }
+
+    auto worker = [] {
+        Trace::SetThreadName("trace-bench");
+        TRACE_SCOPE("TraceBenchThread");
+    };
+    overhead.threads = threads;
+    Trace::Enable(false);
+    size_t rings = Trace::RingCount();
+    std::vector<std::thread> workers;
+    for (uint32_t i = 0; i < threads; ++i)
+        workers.emplace_back(worker);
+    for (std::thread& thread : workers)
+        thread.join();
+    overhead.idleThreadRings = Trace::RingCount() - rings;
+
+    Trace::Enable(true);
+    rings = Trace::RingCount();
+    for (uint32_t i = 0; i < threads; ++i)
+        std::thread(worker).join();
+    overhead.tracedThreadRings = Trace::RingCount() - rings;
+
+    Trace::Enable(wasEnabled);
+    Trace::Clear();
+    return overhead;
+}
+
+std::string FormatTraceOverheadJson(const TraceOverhead& overhead)
+{
+    char buf[256];
+    std::snprintf(buf, sizeof(buf),
+        "{\"benchmark\":\"trace_overhead\",\"iterations\":%llu,\"baseline_ns\":%.3f,\"disabled_ns\":%.3f,"
+        "\"enabled_ns\":%.3f,\"disabled_overhead_ns\":%.3f,\"enabled_overhead_ns\":%.3f,\"threads\":%u,"
+        "\"idle_thread_rings\":%llu,\"traced_thread_rings\":%llu}\n",
+        (unsigned long long)overhead.iterations, overhead.baselineNs, overhead.disabledNs, overhead.enabledNs,
+        overhead.disabledNs - overhead.baselineNs, overhead.enabledNs - overhead.baselineNs, overhead.threads,
+        (unsigned long long)overhead.idleThreadRings, (unsigned long long)overhead.tracedThreadRings);
+    return buf;
+}
+
+bool RunTraceOverheadMode(const BenchmarkOptions&, std::string& json)
+{
+    TraceOverhead overhead = MeasureTraceOverhead();
+    json = FormatTraceOverheadJson(overhead);
+    return overhead.idleThreadRings == 0 && overhead.tracedThreadRings <= 1;
+}
@@ -0,0 +1,115 @@
+#include "BenchmarkModes.h"
+
+#include "WearMap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+WearAccuracyBenchmark MeasureWearAccuracy(SyntheticWorkload workload, uint32_t width, uint32_t height,
+    uint64_t accuracyFrames, uint32_t repetitions)
+{
+    static const uint32_t SIZE = 32;
+    static const size_t SUBPIXELS = size_t(SIZE) * SIZE * 3;
+    WearAccuracyBenchmark bench;
+    bench.frames = accuracyFrames;
+    bench.width = width;
+    bench.height = height;
+
+    WearMap wear;
+    wear.Reset(SIZE, SIZE);
+    long double referenceLut[256];
+    float floatLut[256];
+    for (int v = 0; v < 256; ++v)
+    {
+        referenceLut[v] = std::pow((long double)v / 255.0L, (long double)wear.Exponent());
+        floatLut[v] = float(referenceLut[v]);
+    }
+
+    std::vector<long double> reference(SUBPIXELS, 0.0L);
+    std::vector<float> floats(SUBPIXELS, 0.0f);
+    long double referenceSeconds = 0.0L;
+    std::vector<uint8_t> frame(size_t(SIZE) * SIZE * 4);
+    std::mt19937_64 rng(35);
+    std::uniform_real_distribution<double> frameTime(1.0 / 240.0, 1.0 / 30.0);
+    for (uint64_t f = 0; f < accuracyFrames; ++f)
+    {
+        for (size_t i = 0; i < frame.size(); i += 8)
+        {
+            const uint64_t bits = rng();
+            std::memcpy(&frame[i], &bits, 8);
+        }
+        const double dt = f % 1000 == 999 ? 2.0 + frameTime(rng) * 60.0 : frameTime(rng);
+        wear.Accumulate(frame.data(), dt);
+        referenceSeconds += dt;
+        for (size_t p = 0; p < size_t(SIZE) * SIZE; ++p)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                // Plane 0 is R, at byte 2 of BGRA
+                const uint8_t value = frame[p * 4 + 2 - c];
+                reference[c * SIZE * SIZE + p] += referenceLut[value] * dt;
+                floats[c * SIZE * SIZE + p] += floatLut[value] * float(dt);
+            }
+        }
+    }
+
+    for (int c = 0; c < 3; ++c)
+    {
+        const double* plane = wear.Plane(c);
+        for (size_t p = 0; p < size_t(SIZE) * SIZE; ++p)
+        {
+            const long double expected = reference[c * SIZE * SIZE + p];
+            if (expected <= 0.0L)
+                continue;
+            const long double error = std::fabs((long double)plane[p] * WearMap::UnitSeconds() - expected) / expected;
+            const long double floatError = std::fabs((long double)floats[c * SIZE * SIZE + p] - expected) / expected;
+            bench.maxRelativeError = (std::max)(bench.maxRelativeError, double(error));
+            bench.floatMaxRelativeError = (std::max)(bench.floatMaxRelativeError, double(floatError));
+        }
+    }
+    bench.totalTimeError = double(std::fabs((long double)wear.TotalSeconds() - referenceSeconds));
+
+    // Throughput on a real desktop frame; the float path is the plain LUT multiply-add
+    const SyntheticDesktop desktop(workload, width, height);
+    std::vector<uint8_t> bgra(size_t(width) * height * 4);
+    desktop.Render(0, bgra.data());
+    WearMap full;
+    full.Reset(width, height);
+    bench.accumulateNs = BestOf(repetitions, [&] { full.Accumulate(bgra.data(), 1.0 / 60.0); });
+    std::vector<float> planes[3];
+    for (auto& plane : planes)
+        plane.assign(size_t(width) * height, 0.0f);
+    bench.floatAccumulateNs = BestOf(repetitions, [&] {
+        const float dt = 1.0f / 60.0f;
+        for (size_t p = 0; p < size_t(width) * height; ++p)
+        {
+            planes[0][p] += floatLut[bgra[p * 4 + 2]] * dt;
+            planes[1][p] += floatLut[bgra[p * 4 + 1]] * dt;
+            planes[2][p] += floatLut[bgra[p * 4 + 0]] * dt;
+        }
+    });
+    return bench;
+}
+
+std::string FormatWearAccuracyJson(const WearAccuracyBenchmark& bench)
+{
+    char buf[384];
+    std::snprintf(buf, sizeof(buf),
+        "{\"benchmark\":\"wear_accuracy\",\"frames\":%llu,\"max_relative_error\":%.3g,"
+        "\"float_max_relative_error\":%.3g,\"total_time_error_s\":%.3g,\"width\":%u,\"height\":%u,"
+        "\"accumulate_ns\":%.0f,\"float_accumulate_ns\":%.0f}\n",
+        (unsigned long long)bench.frames, bench.maxRelativeError, bench.floatMaxRelativeError, bench.totalTimeError,
+        bench.width, bench.height, bench.accumulateNs, bench.floatAccumulateNs);
+    return buf;
+}
+
+bool RunWearAccuracyMode(const BenchmarkOptions& options, std::string& json)
+{
+    WearAccuracyBenchmark bench = MeasureWearAccuracy(options.workloads.front(), options.config.width, options.config.height);
+    json = FormatWearAccuracyJson(bench);
+    // LUT quantization is 0.5 / 65535 of a level; frame time is carried to one tick
+    return bench.maxRelativeError < 1e-4 && bench.totalTimeError <= WearMap::TICK_SECONDS;
+}
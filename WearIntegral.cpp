@@ -0,0 +1,368 @@
+#include "WearIntegral.h"
+
+#include <algorithm>
+#include <cstring>
+
+void WearIntegral::Reset(const WearMap& wear)
+{
+    m_width = wear.Width();
+    m_height = wear.Height();
+    m_tilesX = (m_width + TILE - 1) / TILE;
+    m_tilesY = (m_height + TILE - 1) / TILE;
+    for (uint32_t v = 0; v < 256; ++v)
+        m_lut[v] = wear.LutValue(uint8_t(v));
+    m_levelLut.resize(WearMap::LEVEL_CODES);
+    for (uint32_t code = 0; code < WearMap::LEVEL_CODES; ++code)
+        m_levelLut[code] = wear.LevelLutValue(uint16_t(code));
+    m_now = 0.0;
+
+    // The wear so far becomes the committed part; no rate until the first frame
+    const size_t count = size_t(m_width) * m_height;
+    m_localA.assign(count, 0.0);
+    m_localB.assign(count, 0.0);
+    const double* planes[3] = { wear.Plane(0), wear.Plane(1), wear.Plane(2) };
+    for (uint32_t y = 0; y < m_height; ++y)
+    {
+        const bool tileTop = y % TILE == 0;
+        for (uint32_t x0 = 0; x0 < m_width; x0 += TILE)
+        {
+            const uint32_t x1 = (std::min)(x0 + TILE, m_width);
+            double running = 0.0;
+            for (uint32_t x = x0; x < x1; ++x)
+            {
+                const size_t i = size_t(y) * m_width + x;
+                running += planes[0][i] + planes[1][i] + planes[2][i];
+                m_localA[i] = (tileTop ? 0.0 : m_localA[i - m_width]) + running;
+            }
+        }
+    }
+
+    m_rowA.assign(size_t(m_height) * (m_tilesX + 1), 0.0);
+    m_rowB.assign(m_rowA.size(), 0.0);
+    m_columnA.assign(size_t(m_tilesY + 1) * m_width, 0.0);
+    m_columnB.assign(m_columnA.size(), 0.0);
+    m_tileA.assign(size_t(m_tilesX + 1) * (m_tilesY + 1), 0.0);
+    m_tileB.assign(m_tileA.size(), 0.0);
+    m_changed.assign(size_t(m_tilesX) * m_tilesY, 1);
+    m_firstChangedInRow.assign(m_tilesY, 0);
+    m_firstChangedInColumn.assign(m_tilesX, 0);
+    RebuildPrefixes();
+
+    m_previous.clear();
+    m_havePrevious = false;
+    m_maxTileValid = false;
+}
+
+// Compare against the frame the rates are from, tile row segment by segment, and copy
+// what changed over it
+void WearIntegral::MarkChangedTiles(const uint8_t* frame, std::vector<uint8_t>& previous, size_t bytesPerPixel)
+{
+    const size_t frameBytes = size_t(m_width) * m_height * bytesPerPixel;
+    if (!m_havePrevious || previous.size() != frameBytes)
+    {
+        previous.assign(frame, frame + frameBytes);
+        m_havePrevious = true;
+        std::fill(m_changed.begin(), m_changed.end(), uint8_t(1));
+        IndexChangedTiles();
+        return;
+    }
+
+    std::fill(m_changed.begin(), m_changed.end(), uint8_t(0));
+    const size_t rowBytes = size_t(m_width) * bytesPerPixel;
+    for (uint32_t y = 0; y < m_height; ++y)
+    {
+        uint8_t* changed = m_changed.data() + size_t(y / TILE) * m_tilesX;
+        const uint8_t* src = frame + y * rowBytes;
+        uint8_t* dst = previous.data() + y * rowBytes;
+        for (uint32_t tx = 0; tx < m_tilesX; ++tx)
+        {
+            const size_t offset = size_t(tx) * TILE * bytesPerPixel;
+            const size_t bytes = size_t((std::min)(TILE, m_width - tx * TILE)) * bytesPerPixel;
+            if (!changed[tx] && std::memcmp(src + offset, dst + offset, bytes) != 0)
+                changed[tx] = 1;
+            if (changed[tx])
+                std::memcpy(dst + offset, src + offset, bytes);
+        }
+    }
+    IndexChangedTiles();
+}
+
+void WearIntegral::IndexChangedTiles()
+{
+    std::fill(m_firstChangedInRow.begin(), m_firstChangedInRow.end(), UINT32_MAX);
+    std::fill(m_firstChangedInColumn.begin(), m_firstChangedInColumn.end(), UINT32_MAX);
+    for (uint32_t ty = 0; ty < m_tilesY; ++ty)
+        for (uint32_t tx = 0; tx < m_tilesX; ++tx)
+            if (m_changed[size_t(ty) * m_tilesX + tx])
+            {
+                m_firstChangedInRow[ty] = (std::min)(m_firstChangedInRow[ty], tx);
+                m_firstChangedInColumn[tx] = (std::min)(m_firstChangedInColumn[tx], ty);
+            }
+}
+
+// New rates for the changed tiles from now on. The rate table changes from B to B' at
+// now, so A absorbs now * (B - B') and A + now * B stays continuous.
+template <typename Rate>
+uint32_t WearIntegral::Update(const Rate& rate, uint64_t ticks)
+{
+    static const double zeros[TILE] = {};
+    const double now = m_now;
+    uint32_t rewritten = 0;
+    for (uint32_t ty = 0; ty < m_tilesY; ++ty)
+    {
+        if (m_firstChangedInRow[ty] == UINT32_MAX)
+            continue;
+        const uint8_t* changed = m_changed.data() + size_t(ty) * m_tilesX;
+        for (uint32_t tx = m_firstChangedInRow[ty]; tx < m_tilesX; ++tx)
+            rewritten += changed[tx];
+
+        // Row by row through the band so the row above is still in cache
+        const uint32_t y0 = ty * TILE, y1 = (std::min)(y0 + TILE, m_height);
+        for (uint32_t y = y0; y < y1; ++y)
+        {
+            const size_t line = size_t(y) * m_width;
+            double* a = m_localA.data() + line;
+            double* b = m_localB.data() + line;
+            for (uint32_t tx = m_firstChangedInRow[ty]; tx < m_tilesX; ++tx)
+            {
+                if (!changed[tx])
+                    continue;
+                const uint32_t x0 = tx * TILE, x1 = (std::min)(x0 + TILE, m_width);
+                const double* above = y > y0 ? b - m_width + x0 : zeros;
+                double running = 0.0;
+                for (uint32_t x = x0; x < x1; ++x)
+                {
+                    running += double(rate(line + x));
+                    const double next = above[x - x0] + running;
+                    a[x] += now * (b[x] - next);
+                    b[x] = next;
+                }
+            }
+        }
+    }
+    if (rewritten)
+        RebuildPrefixes();
+    m_now += double(ticks);
+    m_maxTileValid = false;
+    return rewritten;
+}
+
+uint32_t WearIntegral::Accumulate(const uint8_t* bgra, uint64_t ticks, const uint8_t* changedTiles)
+{
+    if (ticks == 0 || !m_width)
+        return 0;
+    if (m_previousLevels)
+        m_havePrevious = false;
+    m_previousLevels = false;
+    if (!changedTiles)
+    {
+        MarkChangedTiles(bgra, m_previous, 4);
+    }
+    else
+    {
+        // The caller compared with the frame before: no copy of it to keep
+        if (m_havePrevious)
+            std::copy(changedTiles, changedTiles + m_changed.size(), m_changed.begin());
+        else
+            std::fill(m_changed.begin(), m_changed.end(), uint8_t(1));
+        m_havePrevious = true;
+        IndexChangedTiles();
+        std::vector<uint8_t>().swap(m_previous);
+    }
+    return Update([&](size_t i) {
+        const uint8_t* px = bgra + i * 4;
+        return m_lut[px[0]] + m_lut[px[1]] + m_lut[px[2]];
+    }, ticks);
+}
+
+uint32_t WearIntegral::AccumulateLevels(const uint16_t* levels, uint64_t ticks)
+{
+    if (ticks == 0 || !m_width)
+        return 0;
+    if (!m_previousLevels)
+        m_havePrevious = false;
+    m_previousLevels = true;
+    MarkChangedTiles(reinterpret_cast<const uint8_t*>(levels), m_previous, 4 * sizeof(uint16_t));
+    const uint32_t mask = WearMap::LEVEL_CODES - 1;
+    return Update([&](size_t i) {
+        const uint16_t* px = levels + i * 4;
+        return m_levelLut[px[0] & mask] + m_levelLut[px[1] & mask] + m_levelLut[px[2] & mask];
+    }, ticks);
+}
+
+void WearIntegral::AccumulateOverlay(const uint8_t* bgra, uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+    const uint8_t* overlay, uint64_t ticks)
+{
+    if (ticks == 0 || x >= m_width || y >= m_height)
+        return;
+    w = (std::min)(w, m_width - x);
+    h = (std::min)(h, m_height - y);
+
+    // A fixed amount added once: the committed part of the tiles under the rectangle grows
+    // by the table of the difference, which stays constant right of and below it
+    std::fill(m_changed.begin(), m_changed.end(), uint8_t(0));
+    std::fill(m_firstChangedInRow.begin(), m_firstChangedInRow.end(), UINT32_MAX);
+    std::fill(m_firstChangedInColumn.begin(), m_firstChangedInColumn.end(), UINT32_MAX);
+    const double t = double(ticks);
+    std::vector<double> column(TILE);
+    for (uint32_t ty = y / TILE; ty <= (y + h - 1) / TILE; ++ty)
+    {
+        for (uint32_t tx = x / TILE; tx <= (x + w - 1) / TILE; ++tx)
+        {
+            const uint32_t tileX1 = (std::min)((tx + 1) * TILE, m_width);
+            const uint32_t tileY1 = (std::min)((ty + 1) * TILE, m_height);
+            const uint32_t startX = (std::max)(x, tx * TILE), startY = (std::max)(y, ty * TILE);
+            std::fill(column.begin(), column.end(), 0.0);
+            for (uint32_t py = startY; py < tileY1; ++py)
+            {
+                double running = 0.0;
+                for (uint32_t px = startX; px < tileX1; ++px)
+                {
+                    if (py < y + h && px < x + w)
+                    {
+                        const uint8_t* under = bgra + (size_t(py) * m_width + px) * 4;
+                        const uint8_t* over = overlay + (size_t(py - y) * w + (px - x)) * 4;
+                        for (int c = 0; c < 3; ++c)
+                            running += (double(m_lut[over[c]]) - double(m_lut[under[c]])) * t;
+                    }
+                    column[px - tx * TILE] += running;
+                    m_localA[size_t(py) * m_width + px] += column[px - tx * TILE];
+                }
+            }
+            m_changed[size_t(ty) * m_tilesX + tx] = 1;
+            m_firstChangedInRow[ty] = (std::min)(m_firstChangedInRow[ty], tx);
+            m_firstChangedInColumn[tx] = (std::min)(m_firstChangedInColumn[tx], ty);
+        }
+    }
+    RebuildPrefixes();
+    m_maxTileValid = false;
+}
+
+// Band prefixes right of / below the first changed tile of every tile row / column, then
+// the (small) whole-tile table
+void WearIntegral::RebuildPrefixes()
+{
+    const size_t rowStride = m_tilesX + 1;
+    for (uint32_t ty = 0; ty < m_tilesY; ++ty)
+    {
+        const uint32_t first = m_firstChangedInRow[ty];
+        if (first == UINT32_MAX)
+            continue;
+        for (uint32_t y = ty * TILE; y < (std::min)((ty + 1) * TILE, m_height); ++y)
+        {
+            double* rowA = m_rowA.data() + y * rowStride;
+            double* rowB = m_rowB.data() + y * rowStride;
+            const size_t line = size_t(y) * m_width;
+            for (uint32_t tx = first; tx < m_tilesX; ++tx)
+            {
+                const size_t right = line + (std::min)((tx + 1) * TILE, m_width) - 1;
+                rowA[tx + 1] = rowA[tx] + m_localA[right];
+                rowB[tx + 1] = rowB[tx] + m_localB[right];
+            }
+        }
+    }
+    // Column prefixes one tile row after the other, each a contiguous row of width
+    for (uint32_t ty = 0; ty < m_tilesY; ++ty)
+    {
+        const size_t bottom = size_t((std::min)((ty + 1) * TILE, m_height) - 1) * m_width;
+        const double* columnA = m_columnA.data() + size_t(ty) * m_width;
+        const double* columnB = m_columnB.data() + size_t(ty) * m_width;
+        double* nextA = m_columnA.data() + size_t(ty + 1) * m_width;
+        double* nextB = m_columnB.data() + size_t(ty + 1) * m_width;
+        for (uint32_t tx = 0; tx < m_tilesX; ++tx)
+        {
+            if (m_firstChangedInColumn[tx] > ty)
+                continue;
+            for (uint32_t x = tx * TILE; x < (std::min)((tx + 1) * TILE, m_width); ++x)
+            {
+                nextA[x] = columnA[x] + m_localA[bottom + x];
+                nextB[x] = columnB[x] + m_localB[bottom + x];
+            }
+        }
+    }
+    for (uint32_t ty = 0; ty < m_tilesY; ++ty)
+    {
+        const size_t bottom = size_t((std::min)((ty + 1) * TILE, m_height) - 1) * m_width;
+        for (uint32_t tx = 0; tx < m_tilesX; ++tx)
+        {
+            const size_t corner = bottom + (std::min)((tx + 1) * TILE, m_width) - 1;
+            const size_t i = (ty + 1) * rowStride + tx + 1;
+            m_tileA[i] = m_tileA[i - 1] + m_tileA[i - rowStride] - m_tileA[i - rowStride - 1] + m_localA[corner];
+            m_tileB[i] = m_tileB[i - 1] + m_tileB[i - rowStride] - m_tileB[i - rowStride - 1] + m_localB[corner];
+        }
+    }
+}
+
+void WearIntegral::Prefix(int64_t x, int64_t y, double& a, double& b) const
+{
+    if (x < 0 || y < 0)
+    {
+        a = b = 0.0;
+        return;
+    }
+    const uint32_t tx = uint32_t(x) / TILE, ty = uint32_t(y) / TILE;
+    const size_t tile = size_t(ty) * (m_tilesX + 1) + tx;
+    const size_t row = size_t(y) * (m_tilesX + 1) + tx;
+    const size_t column = size_t(ty) * m_width + size_t(x);
+    const size_t local = size_t(y) * m_width + size_t(x);
+    a = m_tileA[tile] + m_rowA[row] + m_columnA[column] + m_localA[local];
+    b = m_tileB[tile] + m_rowB[row] + m_columnB[column] + m_localB[local];
+}
+
+WearRegion WearIntegral::Query(const WearRect& rect) const
+{
+    WearRegion region;
+    if (rect.x >= m_width || rect.y >= m_height || !rect.width || !rect.height)
+        return region;
+    const int64_t x0 = rect.x, y0 = rect.y;
+    const int64_t x1 = (std::min)(int64_t(rect.x) + rect.width, int64_t(m_width)) - 1;
+    const int64_t y1 = (std::min)(int64_t(rect.y) + rect.height, int64_t(m_height)) - 1;
+
+    double a[4], b[4];
+    Prefix(x1, y1, a[0], b[0]);
+    Prefix(x0 - 1, y1, a[1], b[1]);
+    Prefix(x1, y0 - 1, a[2], b[2]);
+    Prefix(x0 - 1, y0 - 1, a[3], b[3]);
+    const double sumA = a[0] - a[1] - a[2] + a[3];
+    const double sumB = b[0] - b[1] - b[2] + b[3];
+    region.sum = (sumA + m_now * sumB) * WearMap::UnitSeconds();
+    region.mean = region.sum / double((x1 - x0 + 1) * (y1 - y0 + 1));
+    return region;
+}
+
+void WearIntegral::QueryBatch(const WearRect* rects, size_t count, WearRegion* out) const
+{
+    for (size_t i = 0; i < count; ++i)
+        out[i] = Query(rects[i]);
+}
+
+WearTile WearIntegral::MaxTile() const
+{
+    if (m_maxTileValid)
+        return m_maxTile;
+
+    m_maxTile = WearTile();
+    double best = -1.0;
+    for (uint32_t ty = 0; ty < m_tilesY; ++ty)
+    {
+        for (uint32_t tx = 0; tx < m_tilesX; ++tx)
+        {
+            // The tile's own table at its last pixel is the tile total
+            const uint32_t x1 = (std::min)((tx + 1) * TILE, m_width), y1 = (std::min)((ty + 1) * TILE, m_height);
+            const size_t corner = size_t(y1 - 1) * m_width + x1 - 1;
+            const double total = m_localA[corner] + m_now * m_localB[corner];
+            if (total > best)
+            {
+                best = total;
+                m_maxTile.rect = { tx * TILE, ty * TILE, x1 - tx * TILE, y1 - ty * TILE };
+            }
+        }
+    }
+    if (best >= 0.0)
+    {
+        m_maxTile.wear.sum = best * WearMap::UnitSeconds();
+        m_maxTile.wear.mean = m_maxTile.wear.sum / double(m_maxTile.rect.width * m_maxTile.rect.height);
+    }
+    m_maxTileValid = true;
+    return m_maxTile;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "WearMap.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct WearRect
+{
+    uint32_t x = 0, y = 0, width = 0, height = 0;
+};
+
+struct WearRegion
+{
+    double sum = 0.0;   // R + G + B stress-seconds over the rectangle
+    double mean = 0.0;  // per pixel, like WearMap::Downsample
+};
+
+struct WearTile
+{
+    WearRect rect;
+    WearRegion wear;
+};
+
+// Summed-area table of a WearMap's R + G + B, for "total or mean wear in this rectangle"
+// in O(1) at any resolution. Fed the same frames and ticks as the map, it stays in step
+// without ever being rebuilt:
+//
+//  - while a frame is on screen every pixel grows linearly, so the table is kept as
+//    A + now * B, B being the table of the frame's per-tick rates; a static frame only
+//    advances now
+//  - the table is tiled (TILE x TILE): a new frame rewrites the tiles whose pixels
+//    changed and the tile-level prefixes right of and below them, not the whole table
+//  - a prefix is the sum of four parts: whole tiles above-left, the tiles left of the
+//    corner in its tile row, the tiles above it in its tile column, and the corner tile
+//
+// Values are doubles; a query is exact to about 1e-15 of the whole map's wear.
+class WearIntegral
+{
+public:
+    static constexpr uint32_t TILE = 64;
+
+    // Take the wear accumulated so far and the map's LUTs; the map can be used as usual
+    // afterwards, as long as every later Accumulate* is mirrored here.
+    void Reset(const WearMap& wear);
+
+    // Mirrors of WearMap::AccumulateTicks / AccumulateLevelTicks / AccumulateOverlay, with
+    // the ticks the map returned. Returns the tiles rewritten.
+    //
+    // Without changedTiles the frame is compared with a copy of the one before, kept here
+    // (4 bytes per pixel). With it (TilesX() x TilesY(), row-major, nonzero where the
+    // frame differs from the one given to the last Accumulate, like TileHasher::Changed()
+    // of the same frames at the same size) no copy is kept.
+    uint32_t Accumulate(const uint8_t* bgra, uint64_t ticks, const uint8_t* changedTiles = nullptr);
+    uint32_t AccumulateLevels(const uint16_t* levels, uint64_t ticks);
+    void AccumulateOverlay(const uint8_t* bgra, uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+        const uint8_t* overlay, uint64_t ticks);
+
+    // Clipped to the map; an empty rectangle is all zeros
+    WearRegion Query(const WearRect& rect) const;
+    void QueryBatch(const WearRect* rects, size_t count, WearRegion* out) const;
+    // The TILE x TILE tile with the most wear (edge tiles are smaller). Every tile grows
+    // with now, so the first call after each Accumulate* scans all tile totals (O(tiles));
+    // later calls return the cached result until the next one.
+    WearTile MaxTile() const;
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    uint32_t TilesX() const { return m_tilesX; }
+    uint32_t TilesY() const { return m_tilesY; }
+
+private:
+    template <typename Rate>
+    uint32_t Update(const Rate& rate, uint64_t ticks);
+    void MarkChangedTiles(const uint8_t* frame, std::vector<uint8_t>& previous, size_t bytesPerPixel);
+    void IndexChangedTiles();
+    // Table over [0, x] x [0, y], as coefficients of now
+    void Prefix(int64_t x, int64_t y, double& a, double& b) const;
+    void RebuildPrefixes();
+
+    uint32_t m_width = 0, m_height = 0;
+    uint32_t m_tilesX = 0, m_tilesY = 0;
+    uint32_t m_lut[256] = {};
+    std::vector<uint32_t> m_levelLut;
+    double m_now = 0.0;                 // ticks since Reset
+
+    // Per pixel, tile-local tables: committed part and rate part
+    std::vector<double> m_localA, m_localB;
+    // Band prefixes: per row, the tiles left of tile t in that tile row (tilesX + 1 each);
+    // per tile row t, for every column the tiles above t in that column (width each)
+    std::vector<double> m_rowA, m_rowB, m_columnA, m_columnB;
+    // Whole tiles, (tilesX + 1) x (tilesY + 1)
+    std::vector<double> m_tileA, m_tileB;
+
+    std::vector<uint8_t> m_previous;    // frame or level codes the rates are from, unless
+                                        // the caller passes the changed tiles
+    bool m_previousLevels = false;
+    bool m_havePrevious = false;
+    std::vector<uint8_t> m_changed;     // per tile, this update
+    std::vector<uint32_t> m_firstChangedInRow, m_firstChangedInColumn;
+
+    mutable bool m_maxTileValid = false;
+    mutable WearTile m_maxTile;
+};
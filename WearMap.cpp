@@ -0,0 +1,268 @@
+#include "WearMap.h"
+
+#include <algorithm>
+#include <cmath>
+
+void WearMap::Reset(uint32_t width, uint32_t height, float exponent)
+{
+    m_width = width;
+    m_height = height;
+    m_exponent = exponent;
+    m_totalTicks = 0;
+    m_tickRemainder = 0.0;
+    m_laneLoad = 0;
+
+    for (int v = 0; v < 256; ++v)
+        m_lut[v] = uint16_t(std::lround(std::pow(v / 255.0, double(exponent)) * LUT_SCALE));
+    // Same rounding as m_lut, so code 4 * v and value v add the same
+    m_levelLut.resize(LEVEL_CODES);
+    for (uint32_t code = 0; code < LEVEL_CODES; ++code)
+        m_levelLut[code] = uint32_t(std::llround(std::pow(code / double(LEVEL_CODE_WHITE), double(exponent)) * LUT_SCALE));
+
+    for (int c = 0; c < 3; ++c)
+    {
+        m_lanes[c].assign(size_t(width) * height, 0);
+        m_planes[c].assign(size_t(width) * height, 0.0);
+    }
+}
+
+void WearMap::Flush() const
+{
+    if (m_laneLoad == 0)
+        return;
+
+    const size_t count = size_t(m_width) * m_height;
+    for (int c = 0; c < 3; ++c)
+    {
+        uint32_t* lane = m_lanes[c].data();
+        double* plane = m_planes[c].data();
+        for (size_t i = 0; i < count; ++i)
+        {
+            plane[i] += double(lane[i]);
+            lane[i] = 0;
+        }
+    }
+    m_laneLoad = 0;
+}
+
+// False when one interval alone could overflow a lane: the caller adds to the planes
+bool WearMap::ReserveLanes(uint64_t ticks, uint32_t maxLut)
+{
+    const uint64_t load = ticks * maxLut;
+    if (ticks > UINT32_MAX / (std::max)(maxLut, 1u))
+        return false;
+    if (m_laneLoad + load > UINT32_MAX)
+        Flush();
+    m_laneLoad += load;
+    return true;
+}
+
+uint64_t WearMap::TakeTicks(double dtSeconds)
+{
+    if (dtSeconds <= 0.0)
+        return 0;
+
+    // Carry the sub-tick remainder so total time stays exact to one tick
+    double exactTicks = dtSeconds / TICK_SECONDS + m_tickRemainder;
+    uint64_t ticks = uint64_t(exactTicks);
+    m_tickRemainder = exactTicks - double(ticks);
+    return ticks;
+}
+
+// Long static intervals bypass the lanes; lut * ticks is still an exact integer
+void WearMap::AddDirect(const uint8_t* bgra, uint64_t ticks)
+{
+    const size_t count = size_t(m_width) * m_height;
+    double* r = m_planes[0].data();
+    double* g = m_planes[1].data();
+    double* b = m_planes[2].data();
+    const double t = double(ticks);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint8_t* px = bgra + i * 4;
+        b[i] += m_lut[px[0]] * t;
+        g[i] += m_lut[px[1]] * t;
+        r[i] += m_lut[px[2]] * t;
+    }
+}
+
+uint64_t WearMap::Accumulate(const uint8_t* bgra, double dtSeconds)
+{
+    uint64_t ticks = TakeTicks(dtSeconds);
+    AccumulateTicks(bgra, ticks);
+    return ticks;
+}
+
+void WearMap::AccumulateTicks(const uint8_t* bgra, uint64_t ticks)
+{
+    if (ticks == 0)
+        return;
+    m_totalTicks += ticks;
+
+    if (!ReserveLanes(ticks, LUT_SCALE))
+    {
+        AddDirect(bgra, ticks);
+        return;
+    }
+
+    // One table lookup and one 32-bit add per subpixel; lut * ticks < 2^32 by LANE_TICKS
+    uint32_t scaled[256];
+    for (int v = 0; v < 256; ++v)
+        scaled[v] = uint32_t(m_lut[v]) * uint32_t(ticks);
+
+    const size_t count = size_t(m_width) * m_height;
+    uint32_t* r = m_lanes[0].data();
+    uint32_t* g = m_lanes[1].data();
+    uint32_t* b = m_lanes[2].data();
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint8_t* px = bgra + i * 4;
+        b[i] += scaled[px[0]];
+        g[i] += scaled[px[1]];
+        r[i] += scaled[px[2]];
+    }
+}
+
+uint64_t WearMap::AccumulateLevels(const uint16_t* levels, double dtSeconds)
+{
+    uint64_t ticks = TakeTicks(dtSeconds);
+    AccumulateLevelTicks(levels, ticks);
+    return ticks;
+}
+
+void WearMap::AccumulateLevelTicks(const uint16_t* levels, uint64_t ticks)
+{
+    if (ticks == 0)
+        return;
+    m_totalTicks += ticks;
+
+    const size_t count = size_t(m_width) * m_height;
+    double* planes[3] = { m_planes[0].data(), m_planes[1].data(), m_planes[2].data() };
+    if (!ReserveLanes(ticks, m_levelLut.back()))
+    {
+        const double t = double(ticks);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint16_t* px = levels + i * 4;
+            planes[2][i] += m_levelLut[px[0] & (LEVEL_CODES - 1)] * t;
+            planes[1][i] += m_levelLut[px[1] & (LEVEL_CODES - 1)] * t;
+            planes[0][i] += m_levelLut[px[2] & (LEVEL_CODES - 1)] * t;
+        }
+        return;
+    }
+
+    // 16 KB table, stays in L1 like the 8-bit one
+    std::vector<uint32_t> scaled(LEVEL_CODES);
+    for (uint32_t code = 0; code < LEVEL_CODES; ++code)
+        scaled[code] = m_levelLut[code] * uint32_t(ticks);
+
+    uint32_t* r = m_lanes[0].data();
+    uint32_t* g = m_lanes[1].data();
+    uint32_t* b = m_lanes[2].data();
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint16_t* px = levels + i * 4;
+        b[i] += scaled[px[0] & (LEVEL_CODES - 1)];
+        g[i] += scaled[px[1] & (LEVEL_CODES - 1)];
+        r[i] += scaled[px[2] & (LEVEL_CODES - 1)];
+    }
+}
+
+// The difference can be negative (a dark pointer over white), so it goes straight into the
+// planes: still an integer, and the plane plus its lane never drops below zero
+void WearMap::AccumulateOverlay(const uint8_t* bgra, uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+    const uint8_t* overlay, uint64_t ticks)
+{
+    if (ticks == 0 || x >= m_width || y >= m_height)
+        return;
+    w = (std::min)(w, m_width - x);
+    h = (std::min)(h, m_height - y);
+
+    const double t = double(ticks);
+    double* r = m_planes[0].data();
+    double* g = m_planes[1].data();
+    double* b = m_planes[2].data();
+    for (uint32_t row = 0; row < h; ++row)
+    {
+        const size_t first = size_t(y + row) * m_width + x;
+        const uint8_t* under = bgra + first * 4;
+        const uint8_t* over = overlay + size_t(row) * w * 4;
+        for (uint32_t col = 0; col < w; ++col)
+        {
+            const size_t i = first + col;
+            b[i] += double(int32_t(m_lut[over[col * 4 + 0]]) - m_lut[under[col * 4 + 0]]) * t;
+            g[i] += double(int32_t(m_lut[over[col * 4 + 1]]) - m_lut[under[col * 4 + 1]]) * t;
+            r[i] += double(int32_t(m_lut[over[col * 4 + 2]]) - m_lut[under[col * 4 + 2]]) * t;
+        }
+    }
+}
+
+bool WearMap::Merge(const WearMap& other)
+{
+    if (other.m_width != m_width || other.m_height != m_height || other.m_exponent != m_exponent)
+        return false;
+
+    Flush();
+    other.Flush();
+    const size_t count = size_t(m_width) * m_height;
+    for (int c = 0; c < 3; ++c)
+    {
+        double* dst = m_planes[c].data();
+        const double* src = other.m_planes[c].data();
+        for (size_t i = 0; i < count; ++i)
+            dst[i] += src[i];
+    }
+    m_totalTicks += other.m_totalTicks;
+    return true;
+}
+
+bool WearMap::Assign(std::vector<double> planes[3], uint64_t totalTicks)
+{
+    const size_t count = size_t(m_width) * m_height;
+    for (int c = 0; c < 3; ++c)
+        if (planes[c].size() != count)
+            return false;
+
+    for (int c = 0; c < 3; ++c)
+    {
+        m_planes[c].swap(planes[c]);
+        std::fill(m_lanes[c].begin(), m_lanes[c].end(), 0u);
+    }
+    m_laneLoad = 0;
+    m_totalTicks = totalTicks;
+    m_tickRemainder = 0.0;
+    return true;
+}
+
+float WearMap::Downsample(uint32_t factor, std::vector<float>& out, uint32_t& outWidth, uint32_t& outHeight) const
+{
+    Flush();
+    factor = std::max(factor, 1u);
+    outWidth = (m_width + factor - 1) / factor;
+    outHeight = (m_height + factor - 1) / factor;
+    std::vector<double> sums(size_t(outWidth) * outHeight, 0.0);
+
+    // Sum rows into their block row first, then scale by the block area
+    for (uint32_t y = 0; y < m_height; ++y)
+    {
+        double* dst = sums.data() + size_t(y / factor) * outWidth;
+        size_t row = size_t(y) * m_width;
+        for (uint32_t x = 0; x < m_width; ++x)
+            dst[x / factor] += m_planes[0][row + x] + m_planes[1][row + x] + m_planes[2][row + x];
+    }
+
+    out.resize(sums.size());
+    float maxValue = 0.0f;
+    for (uint32_t by = 0; by < outHeight; ++by)
+    {
+        uint32_t rows = std::min(factor, m_height - by * factor);
+        for (uint32_t bx = 0; bx < outWidth; ++bx)
+        {
+            uint32_t cols = std::min(factor, m_width - bx * factor);
+            size_t i = size_t(by) * outWidth + bx;
+            out[i] = float(sums[i] * UnitSeconds() / double(rows * cols));
+            maxValue = std::max(maxValue, out[i]);
+        }
+    }
+    return maxValue;
+}
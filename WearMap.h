@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Per-subpixel wear accumulator.
+// Every plane holds sum((value / 255)^exponent * seconds), i.e. the stress-time
+// integral of the README damage model before the tau/beta constants are applied.
+//
+// Storage is mixed precision so that 10^6+ frames add up exactly:
+//  - (value / 255)^exponent is quantized to 16 bits (LUT_SCALE = 1.0) and frame time to
+//    TICK_SECONDS, so one frame adds an integer lut * ticks per subpixel
+//  - per-frame adds go into uint32 lanes (no multiply, no float, 4 bytes per subpixel)
+//  - lanes are flushed into double planes before they could overflow; the planes hold
+//    integers below 2^53, so every add and every Merge is exact and order independent
+// Plane values are in units of UnitSeconds(). A plane saturates after 2^53 units, about
+// 159 days at full drive per subpixel.
+class WearMap
+{
+public:
+    static constexpr double TICK_SECONDS = 1e-4;
+    static constexpr uint32_t LUT_SCALE = 65535;
+    // Extended-range input for HDR capture (see HdrFormats.h): level codes on the 8-bit
+    // scale times 4, so LEVEL_CODE_WHITE is SDR white (code value 255) and the codes
+    // above it are highlights, up to (4095 / 1020)^2.2 = 21x its luminance
+    static constexpr uint32_t LEVEL_CODES = 4096;
+    static constexpr uint32_t LEVEL_CODE_WHITE = 1020;
+
+    void Reset(uint32_t width, uint32_t height, float exponent = 1.54f);
+
+    // Integrate a BGRA frame that stayed on screen for dtSeconds; returns the ticks it
+    // was rounded to. A static interval is a single call with the whole interval, not one
+    // call per frame.
+    uint64_t Accumulate(const uint8_t* bgra, double dtSeconds);
+    // Same with the duration already in ticks. Callers that derive ticks from absolute
+    // timestamps (see OfflineAnalysis) get results independent of how frames are grouped.
+    void AccumulateTicks(const uint8_t* bgra, uint64_t ticks);
+    // Same for level codes below LEVEL_CODES, 4 per pixel in BGRX order. A code of 4 * v
+    // adds exactly what the 8-bit value v adds.
+    uint64_t AccumulateLevels(const uint16_t* levels, double dtSeconds);
+    void AccumulateLevelTicks(const uint16_t* levels, uint64_t ticks);
+
+    // The rectangle (x, y, w, h) of a frame accumulated for ticks was really showing
+    // overlay (w * h BGRA, packed): swap its contribution for the overlay's. For what
+    // capture delivers outside the frame, like the mouse pointer (see PointerWear).
+    void AccumulateOverlay(const uint8_t* bgra, uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+        const uint8_t* overlay, uint64_t ticks);
+
+    // Add another map of the same size and exponent (e.g. a chunk analysed elsewhere).
+    bool Merge(const WearMap& other);
+    // Replace the content with planes computed elsewhere (LevelHistogram::Evaluate), in
+    // UnitSeconds() units, width * height integers each. Reset to the right size first.
+    bool Assign(std::vector<double> planes[3], uint64_t totalTicks);
+    // Swap the planes out for a caller that overwrites them and hands them back through
+    // Assign, so that re-evaluating into the same map allocates nothing. Until then the
+    // map holds whatever planes came in.
+    void SwapPlanes(std::vector<double> planes[3]) { for (int c = 0; c < 3; ++c) m_planes[c].swap(planes[c]); }
+
+    // Mean R+G+B wear in seconds of every factor x factor block (edge blocks cover what is
+    // left), row-major into out; returns the largest value. Cheap enough for a live overlay.
+    float Downsample(uint32_t factor, std::vector<float>& out, uint32_t& outWidth, uint32_t& outHeight) const;
+
+    // Exact integer stress-time in units of UnitSeconds(); 0 = R, 1 = G, 2 = B.
+    // Pending lanes are flushed first, so this is not safe against a concurrent Accumulate.
+    const double* Plane(int channel) const { Flush(); return m_planes[channel].data(); }
+    static constexpr double UnitSeconds() { return TICK_SECONDS / LUT_SCALE; }
+    // What one tick of an 8-bit value / level code adds, in UnitSeconds() units
+    uint32_t LutValue(uint8_t value) const { return m_lut[value]; }
+    uint32_t LevelLutValue(uint16_t code) const { return m_levelLut[code & (LEVEL_CODES - 1)]; }
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    float Exponent() const { return m_exponent; }
+    double TotalSeconds() const { return double(m_totalTicks) * TICK_SECONDS; }
+
+private:
+    void Flush() const;
+    uint64_t TakeTicks(double dtSeconds);
+    bool ReserveLanes(uint64_t ticks, uint32_t maxLut);
+    void AddDirect(const uint8_t* bgra, uint64_t ticks);
+
+    uint32_t m_width = 0, m_height = 0;
+    float m_exponent = 1.54f;
+    uint16_t m_lut[256] = {};
+    std::vector<uint32_t> m_levelLut; // LEVEL_CODES entries, may exceed LUT_SCALE
+    uint64_t m_totalTicks = 0;
+    double m_tickRemainder = 0.0; // frame time not yet turned into ticks
+
+    // Lanes are flushed before the largest value they could hold passes UINT32_MAX:
+    // LANE_TICKS ticks of full drive on the 8-bit path, fewer for HDR highlights
+    static constexpr uint64_t LANE_TICKS = UINT32_MAX / LUT_SCALE;
+    mutable std::vector<uint32_t> m_lanes[3];
+    mutable uint64_t m_laneLoad = 0;
+    mutable std::vector<double> m_planes[3];
+};
@@ -0,0 +1,81 @@
+#include "WindowSampler.h"
+
+#include <dwmapi.h>
+
+#pragma comment(lib, "dwmapi.lib")
+
+BOOL CALLBACK WindowSampler::CollectWindow(HWND hwnd, LPARAM param)
+{
+    if (!IsWindowVisible(hwnd) || IsIconic(hwnd))
+        return TRUE;
+    if (GetWindowLongW(hwnd, GWL_EXSTYLE) & WS_EX_TRANSPARENT)
+        return TRUE;
+    DWORD cloaked = 0;
+    if (SUCCEEDED(DwmGetWindowAttribute(hwnd, DWMWA_CLOAKED, &cloaked, sizeof(cloaked))) && cloaked)
+        return TRUE;
+    reinterpret_cast<WindowSampler*>(param)->m_windows.push_back(hwnd);
+    return TRUE;
+}
+
+const std::string& WindowSampler::ProcessName(DWORD pid)
+{
+    auto it = m_names.find(pid);
+    if (it != m_names.end())
+        return it->second;
+    if (m_names.size() > 4096)
+        m_names.clear(); // ids of exited processes get reused
+
+    std::string name = "pid " + std::to_string(pid);
+    if (HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid))
+    {
+        wchar_t path[MAX_PATH];
+        DWORD length = MAX_PATH;
+        if (QueryFullProcessImageNameW(process, 0, path, &length))
+        {
+            const wchar_t* file = wcsrchr(path, L'\\');
+            file = file ? file + 1 : path;
+            int bytes = WideCharToMultiByte(CP_UTF8, 0, file, -1, nullptr, 0, nullptr, nullptr);
+            if (bytes > 1)
+            {
+                name.assign(size_t(bytes - 1), '\0');
+                WideCharToMultiByte(CP_UTF8, 0, file, -1, &name[0], bytes, nullptr, nullptr);
+            }
+        }
+        CloseHandle(process);
+    }
+    return m_names.emplace(pid, name).first->second;
+}
+
+bool WindowSampler::Sample(const RECT& desktop, bool bottomUp, std::vector<AppWindow>& out)
+{
+    m_windows.clear();
+    if (!EnumWindows(&WindowSampler::CollectWindow, reinterpret_cast<LPARAM>(this)))
+        return false;
+
+    const HWND foreground = GetForegroundWindow();
+    const LONG outputHeight = desktop.bottom - desktop.top;
+    out.clear();
+    for (HWND hwnd : m_windows)
+    {
+        // The visible frame; GetWindowRect includes the invisible resize borders
+        RECT rect;
+        if (FAILED(DwmGetWindowAttribute(hwnd, DWMWA_EXTENDED_FRAME_BOUNDS, &rect, sizeof(rect))) &&
+            !GetWindowRect(hwnd, &rect))
+            continue;
+        if (rect.right <= desktop.left || rect.left >= desktop.right ||
+            rect.bottom <= desktop.top || rect.top >= desktop.bottom)
+            continue;
+
+        DWORD pid = 0;
+        GetWindowThreadProcessId(hwnd, &pid);
+        AppWindow window;
+        window.app = ProcessName(pid);
+        window.x = rect.left - desktop.left;
+        window.width = rect.right - rect.left;
+        window.height = rect.bottom - rect.top;
+        window.y = bottomUp ? outputHeight - (rect.bottom - desktop.top) : rect.top - desktop.top;
+        window.foreground = hwnd == foreground;
+        out.push_back(std::move(window));
+    }
+    return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <windows.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AppAttribution.h"
+
+// Top-level window rectangles and process names for AppAttribution. EnumWindows walks
+// the Z order front to back; hidden, minimized, cloaked (other virtual desktops, suspended
+// UWP apps) and click-through windows are skipped. Process names are cached per process
+// id, so a sample is one enumeration plus a DWM query per window.
+class WindowSampler
+{
+public:
+    // desktop: the captured output in desktop coordinates. bottomUp = frame rows are
+    // stored last row first; capture frames are top-down (ICaptureSource), so false.
+    bool Sample(const RECT& desktop, bool bottomUp, std::vector<AppWindow>& out);
+
+private:
+    static BOOL CALLBACK CollectWindow(HWND hwnd, LPARAM param);
+    const std::string& ProcessName(DWORD pid);
+
+    std::vector<HWND> m_windows;
+    std::unordered_map<DWORD, std::string> m_names;
+};
@@ -2,7 +2,6 @@
 #include <d3d11.h>
 #include <dxgi1_2.h>
 #include <wrl/client.h>
-#include <d3dcompiler.h>
 #include <iostream>
 
 #include <mfapi.h>
@@ -12,12 +11,12 @@
 #include <mftransform.h>
 #include <vector>
 #include <chrono>
+#include <algorithm>
 #include <thread>
 
 #include <dxgi.h>
 
 #pragma comment(lib, "d3d11.lib")    // for D3D11CreateDeviceAndSwapChain
-#pragma comment(lib, "d3dcompiler.lib") // for D3DCompile
 #pragma comment(lib, "dxgi.lib")     // for DXGI functions (optional, but common)
 #pragma comment(lib, "Mfplat.lib")
 #pragma comment(lib, "Mf.lib")
@@ -33,6 +32,26 @@
 #include <condition_variable>
 #include <atomic>
 
+#include "ArchiveSinks.h"
+#include "ColdStart.h"
+#include "CapturePipeline.h"
+#include "CaptureSession.h"
+#include "ControlPipeServer.h"
+#include "ControlProtocol.h"
+#include "DxgiCaptureSource.h"
+#include "FrameArena.h"
+#include "GopParallelSink.h"
+#include "HeatmapExport.h"
+#include "LifetimeProjection.h"
+#include "OfflineAnalysis.h"
+#include "PipelineBenchmark.h"
+#include "Trace.h"
+#include "WindowSampler.h"
+
+// Shader bytecode compiled by the build (FxCompile, see OverlayVS.hlsl / OverlayPS.hlsl)
+#include "OverlayPS.h"
+#include "OverlayVS.h"
+
 //#include <vpl/mfxvideo.h>
 //#include <vpl/mfxdispatcher.h>
 #define CHECK_MFX(st) do { if ((st) != MFX_ERR_NONE && (st) != MFX_ERR_MORE_DATA && (st) != MFX_ERR_MORE_SURFACE) { return E_FAIL; } } while(0)
@@ -40,12 +59,14 @@
 
 using Microsoft::WRL::ComPtr;
 
+// Launch milestones, from (about) process start; logged with the pipeline statistics
+static StartupTimeline g_startup;
+
 HWND g_hWnd = nullptr;
 ComPtr<ID3D11Device> g_device;
 ComPtr<ID3D11DeviceContext> g_context;
 ComPtr<IDXGISwapChain> g_swapchain;
 ComPtr<ID3D11RenderTargetView> g_rtv;
-ComPtr<IDXGIOutputDuplication> g_duplication;
 ComPtr<ID3D11InputLayout> g_inputLayout;
 ComPtr<ID3D11Buffer> g_vertexBuffer;
 ComPtr<ID3D11VertexShader> g_vertexShader;
@@ -64,6 +85,7 @@ static std::mutex g_logMutex;
 
 static void LogAssertion(LogFileType type, const char* msg)
 {
+    TRACE_SCOPE("Log");
     const char* filename = nullptr;
     switch (type) {
     case LogFileType::General:  filename = "log_general.txt"; break;
@@ -117,16 +139,42 @@ bool InitWindow(HINSTANCE hInstance) {
     return true;
 }
 
-static constexpr UINT BUFFER_COUNT = 3;
-ComPtr<ID3D11Texture2D> g_desktopCopies[BUFFER_COUNT];
+// Preview: a downscaled, rate-limited view of the frames the capture pipeline already
+// acquired (shared from DxgiCaptureSource's preview ring) with the live wear map on top.
+struct PreviewConfig {
+    double fps = 10.0;
+    UINT width = 640, height = 360;      // swapchain size; DXGI stretches it to the window
+    double heatmapRefreshSeconds = 0.5;
+    UINT heatmapFactor = 8;              // desktop pixels per heat texel, per axis
+    float overlayAlpha = 0.6f;
+};
+
+static PreviewConfig g_preview;
+
+struct OverlayConstants {
+    float invMaxWear;
+    float alpha;
+    float pad[2];
+};
+
+// Shared textures opened on the preview device, keyed by the handle they came from
+static constexpr UINT BUFFER_COUNT = DxgiCaptureSource::PREVIEW_COUNT;
+HANDLE g_sharedHandles[BUFFER_COUNT] = {};
 ComPtr<ID3D11ShaderResourceView> g_srvs[BUFFER_COUNT];
 UINT g_frameIndex = 0;
-ComPtr<ID3D11Texture2D> g_cpuReadbacks[BUFFER_COUNT];
-UINT g_cpuIndex = 0;
+
+ComPtr<ID3D11Texture2D> g_heatTexture;
+ComPtr<ID3D11ShaderResourceView> g_heatSrv;
+ComPtr<ID3D11Buffer> g_overlayConstants;
+UINT g_heatWidth = 0, g_heatHeight = 0;
+std::vector<float> g_heatTexels;
+std::chrono::steady_clock::time_point g_lastHeatUpdate;
 
 bool InitD3D() {
     DXGI_SWAP_CHAIN_DESC scd = {};
     scd.BufferCount = 3;
+    scd.BufferDesc.Width = g_preview.width;
+    scd.BufferDesc.Height = g_preview.height;
     scd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
     scd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
     scd.OutputWindow = g_hWnd;
@@ -146,104 +194,79 @@ bool InitD3D() {
     return true;
 }
 
-bool InitDuplication() {
-    ComPtr<IDXGIDevice> dxgiDevice;
-    g_device.As(&dxgiDevice);
-
-    ComPtr<IDXGIAdapter> adapter;
-    dxgiDevice->GetAdapter(&adapter);
-
-    ComPtr<IDXGIOutput> output;
-    adapter->EnumOutputs(0, &output);
-
-    ComPtr<IDXGIOutput1> output1;
-    output.As(&output1);
-
-    HRESULT hr = output1->DuplicateOutput(g_device.Get(), &g_duplication);
-    if (FAILED(hr)) return false;
-
-    // Create GPU-resident texture for desktop copy
-    DXGI_OUTDUPL_DESC duplDesc;
-    g_duplication->GetDesc(&duplDesc);
-    D3D11_TEXTURE2D_DESC desc = {};
-    desc.Width = duplDesc.ModeDesc.Width;
-    desc.Height = duplDesc.ModeDesc.Height;
-    desc.MipLevels = 1;
-    desc.ArraySize = 1;
-    desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM; // match desktop
-    desc.SampleDesc.Count = 1;
-    desc.Usage = D3D11_USAGE_DEFAULT;
-    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-    desc.CPUAccessFlags = 0;
-    desc.MiscFlags = 0;
-
-    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Format = desc.Format;
-    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-    srvDesc.Texture2D.MipLevels = 1;
-    
+// Find or open the preview-device view of a shared frame from the capture device
+static ID3D11ShaderResourceView* PreviewSrvFor(HANDLE handle) {
     for (UINT i = 0; i < BUFFER_COUNT; ++i)
-    {
-        g_device->CreateTexture2D(&desc, nullptr, &g_desktopCopies[i]);
-        g_device->CreateShaderResourceView(
-            g_desktopCopies[i].Get(), &srvDesc, &g_srvs[i]);
-    }
-
-    D3D11_TEXTURE2D_DESC desc_staging = {};
-    desc_staging.Width = duplDesc.ModeDesc.Width;
-    desc_staging.Height = duplDesc.ModeDesc.Height;
-    desc_staging.MipLevels = 1;
-    desc_staging.ArraySize = 1;
-    desc_staging.Format = DXGI_FORMAT_B8G8R8A8_UNORM; // matches DXGI duplication
-    desc_staging.SampleDesc.Count = 1;
-    desc_staging.Usage = D3D11_USAGE_STAGING;
-    desc_staging.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
-    desc_staging.BindFlags = 0;
-    desc_staging.MiscFlags = 0;
+        if (g_sharedHandles[i] == handle)
+            return g_srvs[i].Get();
+
+    // A new handle means the source was reopened: evict round-robin
+    UINT idx = g_frameIndex++ % BUFFER_COUNT;
+    g_sharedHandles[idx] = nullptr;
+    g_srvs[idx].Reset();
+
+    ComPtr<ID3D11Texture2D> tex;
+    if (FAILED(g_device->OpenSharedResource(handle, __uuidof(ID3D11Texture2D), (void**)&tex)))
+        return nullptr;
+    if (FAILED(g_device->CreateShaderResourceView(tex.Get(), nullptr, &g_srvs[idx])))
+        return nullptr;
+    g_sharedHandles[idx] = handle;
+    return g_srvs[idx].Get();
+}
 
-    for (UINT i = 0; i < BUFFER_COUNT; ++i)
-    {
-        HRESULT hr = g_device->CreateTexture2D(&desc_staging, nullptr, &g_cpuReadbacks[i]);
-        if (FAILED(hr))
-            return false;
+// Reupload the downsampled wear map; returns 1 / max wear for the shader
+static float UpdateHeatTexture(const CapturePipeline& pipeline) {
+    static float invMax = 0.0f;
+    auto now = std::chrono::steady_clock::now();
+    if (g_heatTexture && std::chrono::duration<double>(now - g_lastHeatUpdate).count() < g_preview.heatmapRefreshSeconds)
+        return invMax;
+    g_lastHeatUpdate = now;
+
+    uint32_t w = 0, h = 0;
+    float maxWear = pipeline.WearOverview(g_preview.heatmapFactor, g_heatTexels, w, h);
+    if (w == 0 || h == 0)
+        return invMax = 0.0f;
+
+    if (!g_heatTexture || w != g_heatWidth || h != g_heatHeight) {
+        D3D11_TEXTURE2D_DESC desc = {};
+        desc.Width = w;
+        desc.Height = h;
+        desc.MipLevels = 1;
+        desc.ArraySize = 1;
+        desc.Format = DXGI_FORMAT_R32_FLOAT;
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_DYNAMIC;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+        g_heatTexture.Reset();
+        g_heatSrv.Reset();
+        if (FAILED(g_device->CreateTexture2D(&desc, nullptr, &g_heatTexture)) ||
+            FAILED(g_device->CreateShaderResourceView(g_heatTexture.Get(), nullptr, &g_heatSrv)))
+            return invMax = 0.0f;
+        g_heatWidth = w;
+        g_heatHeight = h;
     }
 
-    g_cpuIndex = 0;
-
-    return true;
+    D3D11_MAPPED_SUBRESOURCE mapped = {};
+    if (SUCCEEDED(g_context->Map(g_heatTexture.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+        for (UINT y = 0; y < h; ++y)
+            memcpy((uint8_t*)mapped.pData + y * mapped.RowPitch, &g_heatTexels[size_t(y) * w], w * sizeof(float));
+        g_context->Unmap(g_heatTexture.Get(), 0);
+    }
+    return invMax = maxWear > 0.0f ? 1.0f / maxWear : 0.0f;
 }
 
 bool InitShaders() {
-    const char* vsCode =
-        "struct VS_IN { float3 pos : POSITION; float2 uv : TEXCOORD; };"
-        "struct PS_IN { float4 pos : SV_POSITION; float2 uv : TEXCOORD; };"
-        "PS_IN main(VS_IN input) { PS_IN o; o.pos=float4(input.pos,1); o.uv=input.uv; return o; }";
-
-    const char* psCode =
-        "Texture2D tex : register(t0); SamplerState samp : register(s0);"
-        "float4 main(float4 pos:SV_POSITION,float2 uv:TEXCOORD):SV_Target{"
-        "float4 color=tex.Sample(samp,uv);"
-        "color.rgb=lerp(color.rgb,float3(1,0,0),0.2);" // red overlay
-        "return color;}";
-
-    ComPtr<ID3DBlob> vsBlob, psBlob, errBlob;
-    if (FAILED(D3DCompile(vsCode, strlen(vsCode), nullptr, nullptr, nullptr, "main", "vs_5_0", 0, 0, &vsBlob, &errBlob))) {
-        if (errBlob) std::cerr << (char*)errBlob->GetBufferPointer() << "\n";
+    if (FAILED(g_device->CreateVertexShader(g_overlayVS, sizeof(g_overlayVS), nullptr, &g_vertexShader)) ||
+        FAILED(g_device->CreatePixelShader(g_overlayPS, sizeof(g_overlayPS), nullptr, &g_pixelShader)))
         return false;
-    }
-    if (FAILED(D3DCompile(psCode, strlen(psCode), nullptr, nullptr, nullptr, "main", "ps_5_0", 0, 0, &psBlob, &errBlob))) {
-        if (errBlob) std::cerr << (char*)errBlob->GetBufferPointer() << "\n";
-        return false;
-    }
-
-    g_device->CreateVertexShader(vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), nullptr, &g_vertexShader);
-    g_device->CreatePixelShader(psBlob->GetBufferPointer(), psBlob->GetBufferSize(), nullptr, &g_pixelShader);
 
     D3D11_INPUT_ELEMENT_DESC layout[] = {
         {"POSITION",0,DXGI_FORMAT_R32G32B32_FLOAT,0,0,D3D11_INPUT_PER_VERTEX_DATA,0},
         {"TEXCOORD",0,DXGI_FORMAT_R32G32_FLOAT,0,12,D3D11_INPUT_PER_VERTEX_DATA,0}
     };
-    g_device->CreateInputLayout(layout, 2, vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), &g_inputLayout);
+    g_device->CreateInputLayout(layout, 2, g_overlayVS, sizeof(g_overlayVS), &g_inputLayout);
 
     // Fullscreen quad
     Vertex quad[6] = {
@@ -258,6 +281,12 @@ bool InitShaders() {
     initData.pSysMem = quad;
     g_device->CreateBuffer(&bd, &initData, &g_vertexBuffer);
 
+    D3D11_BUFFER_DESC cbd = {};
+    cbd.ByteWidth = sizeof(OverlayConstants);
+    cbd.Usage = D3D11_USAGE_DEFAULT;
+    cbd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    if (FAILED(g_device->CreateBuffer(&cbd, nullptr, &g_overlayConstants))) return false;
+
     D3D11_SAMPLER_DESC sampDesc = {};
     sampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
     sampDesc.AddressU = sampDesc.AddressV = sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
@@ -266,28 +295,19 @@ bool InitShaders() {
     return true;
 }
 
-void RenderFrame() {
-    DXGI_OUTDUPL_FRAME_INFO frameInfo;
-    ComPtr<IDXGIResource> desktopResource;
+// Draws the latest shared frame; called at g_preview.fps, never acquires frames itself
+void RenderFrame(DxgiCaptureSource& source, const CapturePipeline& pipeline) {
+    if (HANDLE latest = source.LatestPreviewHandle())
+        g_srv = PreviewSrvFor(latest);
 
-    if (SUCCEEDED(g_duplication->AcquireNextFrame(16, &frameInfo, &desktopResource))) {
-        ComPtr<ID3D11Texture2D> frameTex;
-        desktopResource.As(&frameTex);
-        UINT idx = g_frameIndex % BUFFER_COUNT;
-
-        g_context->CopyResource(
-            g_desktopCopies[idx].Get(),
-            frameTex.Get()
-        );
-
-        g_srv = g_srvs[idx];
-        g_frameIndex++;
-        g_duplication->ReleaseFrame();
-    }
+    OverlayConstants constants = {};
+    constants.invMaxWear = UpdateHeatTexture(pipeline);
+    constants.alpha = g_preview.overlayAlpha;
+    g_context->UpdateSubresource(g_overlayConstants.Get(), 0, nullptr, &constants, 0, 0);
 
     g_context->OMSetRenderTargets(1, g_rtv.GetAddressOf(), nullptr);
     D3D11_VIEWPORT vp = {};
-    vp.Width = 1280; vp.Height = 720; vp.MinDepth = 0; vp.MaxDepth = 1;
+    vp.Width = FLOAT(g_preview.width); vp.Height = FLOAT(g_preview.height); vp.MinDepth = 0; vp.MaxDepth = 1;
     g_context->RSSetViewports(1, &vp);
 
     FLOAT clearColor[4] = { 0.1f,0.1f,0.1f,1.0f };
@@ -300,17 +320,25 @@ void RenderFrame() {
 
     g_context->VSSetShader(g_vertexShader.Get(), nullptr, 0);
     g_context->PSSetShader(g_pixelShader.Get(), nullptr, 0);
-    g_context->PSSetShaderResources(0, 1, g_srv.GetAddressOf());
+    ID3D11ShaderResourceView* srvs[2] = { g_srv.Get(), g_heatSrv.Get() };
+    g_context->PSSetShaderResources(0, 2, srvs);
+    g_context->PSSetConstantBuffers(0, 1, g_overlayConstants.GetAddressOf());
     g_context->PSSetSamplers(0, 1, g_sampler.GetAddressOf());
 
-    g_context->Draw(6, 0);
-    g_swapchain->Present(1, 0);
+    if (g_srv)
+        g_context->Draw(6, 0);
+    // The preview is paced by its own rate limit, so don't block on vsync
+    g_swapchain->Present(0, 0);
 }
 
 #define HR(x) { HRESULT hr__ = (x); if (FAILED(hr__)) { std::cerr << "Error: " << std::hex << hr__ << std::endl; return hr__; } }
 
 static const LONGLONG HNS_PER_SEC = 10000000LL;
 
+// MFStartup / MFShutdown for every sink writer. wWinMain holds a lease for the whole run,
+// so segment rotations and repeated encodes only count references.
+static RefCountedInit g_mediaFoundation([] { return SUCCEEDED(MFStartup(MF_VERSION)); }, [] { MFShutdown(); });
+
 // width, height, fps are your frame info
 HRESULT EncodeCpuFramesToMp4(
     const uint8_t* const* frameData, // array of frame pointers, each BGRA
@@ -320,7 +348,9 @@ HRESULT EncodeCpuFramesToMp4(
     UINT32 fps,
     LPCWSTR filename)
 {
-    HR(MFStartup(MF_VERSION));
+    InitLease mediaFoundation;
+    if (!mediaFoundation.Acquire(g_mediaFoundation))
+        return E_FAIL;
 
     ComPtr<IMFSinkWriter> writer;
     HR(MFCreateSinkWriterFromURL(filename, nullptr, nullptr, &writer));
@@ -344,6 +374,8 @@ HRESULT EncodeCpuFramesToMp4(
     HR(MFCreateMediaType(&inType));
     HR(inType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video));
     HR(inType->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_RGB32)); // RGB32 (BGRA)
+    // Top-down rows: without a stride Media Foundation takes RGB as a bottom-up DIB
+    HR(inType->SetUINT32(MF_MT_DEFAULT_STRIDE, width * 4));
     HR(inType->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive));
     HR(MFSetAttributeSize(inType.Get(), MF_MT_FRAME_SIZE, width, height));
     HR(MFSetAttributeRatio(inType.Get(), MF_MT_FRAME_RATE, fps, 1));
@@ -385,72 +417,154 @@ HRESULT EncodeCpuFramesToMp4(
     }
 
     HR(writer->Finalize());
-    MFShutdown();
-
     return S_OK;
 }
 
-bool CaptureNextDXGIFrameToCpu(uint8_t* dstBuffer, UINT width, UINT height)
+// IMFMediaBuffer over a FrameArena slot: the sink writer holds samples for a few frames
+// after WriteSample, and the slot goes back to the arena when it lets go of the last one.
+// The arena is shared so it outlives buffers still queued when the encoder is destroyed.
+class ArenaMediaBuffer : public IMFMediaBuffer
 {
-    DXGI_OUTDUPL_FRAME_INFO frameInfo = {};
-    ComPtr<IDXGIResource> desktopResource;
-
-    HRESULT hr = g_duplication->AcquireNextFrame(16, &frameInfo, &desktopResource);
-    if (FAILED(hr))
-        return false;
-
-    ComPtr<ID3D11Texture2D> frameTex;
-    desktopResource.As(&frameTex);
-
-    UINT idx = g_cpuIndex % BUFFER_COUNT;
-    g_context->CopyResource(g_cpuReadbacks[idx].Get(), frameTex.Get());
-
-    UINT mapIdx = (g_cpuIndex + BUFFER_COUNT - 1) % BUFFER_COUNT;
+public:
+    static HRESULT Create(std::shared_ptr<FrameArena> arena, IMFMediaBuffer** buffer) {
+        uint8_t* slot = arena->Acquire();
+        if (!slot)
+            return E_OUTOFMEMORY;
+        *buffer = new ArenaMediaBuffer(std::move(arena), slot);
+        return S_OK;
+    }
 
-    D3D11_MAPPED_SUBRESOURCE mapped = {};
-    if (SUCCEEDED(g_context->Map(g_cpuReadbacks[mapIdx].Get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped)))
-    {
-        const UINT bytesPerPixel = 4;
-        uint8_t* dstRow = dstBuffer;
-        uint8_t* srcRow = (uint8_t*)mapped.pData + (height - 1) * mapped.RowPitch; // start from last row
-
-        for (UINT y = 0; y < height; ++y)
-        {
-            memcpy(dstRow, srcRow, width * bytesPerPixel);
-            dstRow += width * bytesPerPixel;
-            srcRow -= mapped.RowPitch; // move up one row
+    STDMETHODIMP QueryInterface(REFIID riid, void** object) override {
+        if (!object)
+            return E_POINTER;
+        if (riid == __uuidof(IUnknown) || riid == __uuidof(IMFMediaBuffer)) {
+            *object = static_cast<IMFMediaBuffer*>(this);
+            AddRef();
+            return S_OK;
         }
+        *object = nullptr;
+        return E_NOINTERFACE;
+    }
+    STDMETHODIMP_(ULONG) AddRef() override { return ++m_refs; }
+    STDMETHODIMP_(ULONG) Release() override {
+        ULONG refs = --m_refs;
+        if (refs == 0)
+            delete this;
+        return refs;
+    }
 
-        g_context->Unmap(g_cpuReadbacks[mapIdx].Get(), 0);
+    STDMETHODIMP Lock(BYTE** data, DWORD* maxLength, DWORD* currentLength) override {
+        if (!data)
+            return E_POINTER;
+        *data = m_slot;
+        if (maxLength) *maxLength = DWORD(m_arena->SlotBytes());
+        if (currentLength) *currentLength = m_length;
+        return S_OK;
+    }
+    STDMETHODIMP Unlock() override { return S_OK; }
+    STDMETHODIMP GetCurrentLength(DWORD* length) override {
+        if (!length)
+            return E_POINTER;
+        *length = m_length;
+        return S_OK;
+    }
+    STDMETHODIMP SetCurrentLength(DWORD length) override {
+        if (length > m_arena->SlotBytes())
+            return E_INVALIDARG;
+        m_length = length;
+        return S_OK;
+    }
+    STDMETHODIMP GetMaxLength(DWORD* length) override {
+        if (!length)
+            return E_POINTER;
+        *length = DWORD(m_arena->SlotBytes());
+        return S_OK;
     }
 
-    g_cpuIndex++;
-    g_duplication->ReleaseFrame();
-    return SUCCEEDED(hr);
-}
+private:
+    ArenaMediaBuffer(std::shared_ptr<FrameArena> arena, uint8_t* slot) : m_arena(std::move(arena)), m_slot(slot) {}
+    ~ArenaMediaBuffer() { m_arena->Release(m_slot); }
 
+    std::atomic<ULONG> m_refs{ 1 };
+    std::shared_ptr<FrameArena> m_arena;
+    uint8_t* m_slot;
+    DWORD m_length = 0;
+};
 
-class CpuMp4Encoder
+// Software H.264 in MP4 (8 Mbps, 4:2:0): small and playable everywhere, but lossy, so
+// analysis runs fan out to a lossless sink as well (see MakePipelineConfig). Every file is
+// a separate sink writer, so each one starts with an IDR frame and any frame is a valid
+// cut point for SegmentedRecorder.
+class CpuMp4Encoder : public IFrameSink
 {
 public:
-    HRESULT Begin(UINT width, UINT height, UINT fps, const wchar_t* filename);
-    HRESULT WriteFrame(const uint8_t* rgbaData, LONGLONG timestampHns);
+    CpuMp4Encoder(UINT width, UINT height, UINT fps) : m_width(width), m_height(height), m_fps(fps) {}
+
+    bool Open(const std::string& path) override;
+    bool WriteFrame(const uint8_t* bgra, int64_t timestampHns) override;
+    bool Close() override;
+    uint64_t BytesWritten() const override;
+
+    HRESULT Begin(const wchar_t* filename);
+    // Write into a byte stream instead of a file; containerType is an MFTranscodeContainerType_*
+    HRESULT Begin(IMFByteStream* stream, REFGUID containerType);
+    HRESULT WriteSample(const uint8_t* bgraData, LONGLONG timestampHns);
     HRESULT End();
 
 private:
+    HRESULT AddStreams();
+
     ComPtr<IMFSinkWriter> m_writer;
     DWORD m_streamIndex = 0;
-    UINT m_width = 0, m_height = 0;
+    UINT m_width, m_height, m_fps;
+    // Input sample buffers, allocated with the writer; WriteSample falls back to
+    // MFCreateMemoryBuffer if the writer ever holds more than SAMPLE_SLOTS of them
+    static const uint32_t SAMPLE_SLOTS = 8;
+    std::shared_ptr<FrameArena> m_sampleArena;
+    InitLease m_mediaFoundation; // from Begin to End
 };
-HRESULT CpuMp4Encoder::Begin(UINT width, UINT height, UINT fps, const wchar_t* filename)
+bool CpuMp4Encoder::Open(const std::string& path)
 {
-    m_width = width;
-    m_height = height;
-
-    HR(MFStartup(MF_VERSION));
+    std::wstring widePath(path.size() + 1, L'\0');
+    int len = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &widePath[0], int(widePath.size()));
+    if (len == 0)
+        return false;
+    widePath.resize(len - 1);
+    return SUCCEEDED(Begin(widePath.c_str()));
+}
+bool CpuMp4Encoder::WriteFrame(const uint8_t* bgra, int64_t timestampHns)
+{
+    return m_writer && SUCCEEDED(WriteSample(bgra, timestampHns));
+}
+bool CpuMp4Encoder::Close()
+{
+    return m_writer && SUCCEEDED(End());
+}
+HRESULT CpuMp4Encoder::Begin(const wchar_t* filename)
+{
+    if (!m_mediaFoundation.Acquire(g_mediaFoundation))
+        return E_FAIL;
 
     // Create the sink writer
     HR(MFCreateSinkWriterFromURL(filename, nullptr, nullptr, &m_writer));
+    return AddStreams();
+}
+HRESULT CpuMp4Encoder::Begin(IMFByteStream* stream, REFGUID containerType)
+{
+    if (!m_mediaFoundation.Acquire(g_mediaFoundation))
+        return E_FAIL;
+
+    ComPtr<IMFAttributes> attributes;
+    HR(MFCreateAttributes(&attributes, 1));
+    HR(attributes->SetGUID(MF_TRANSCODE_CONTAINERTYPE, containerType));
+    HR(MFCreateSinkWriterFromURL(nullptr, stream, attributes.Get(), &m_writer));
+    return AddStreams();
+}
+HRESULT CpuMp4Encoder::AddStreams()
+{
+    m_sampleArena = std::make_shared<FrameArena>();
+    if (!m_sampleArena->Reset(size_t(m_width) * m_height * 4, SAMPLE_SLOTS))
+        return E_OUTOFMEMORY;
 
     // Output (encoded) media type
     ComPtr<IMFMediaType> outType;
@@ -459,8 +573,8 @@ HRESULT CpuMp4Encoder::Begin(UINT width, UINT height, UINT fps, const wchar_t* f
     HR(outType->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_H264));
     HR(outType->SetUINT32(MF_MT_AVG_BITRATE, 8000000)); // 8 Mbps
     HR(outType->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive));
-    HR(MFSetAttributeSize(outType.Get(), MF_MT_FRAME_SIZE, width, height));
-    HR(MFSetAttributeRatio(outType.Get(), MF_MT_FRAME_RATE, fps, 1));
+    HR(MFSetAttributeSize(outType.Get(), MF_MT_FRAME_SIZE, m_width, m_height));
+    HR(MFSetAttributeRatio(outType.Get(), MF_MT_FRAME_RATE, m_fps, 1));
     HR(MFSetAttributeRatio(outType.Get(), MF_MT_PIXEL_ASPECT_RATIO, 1, 1));
     HR(m_writer->AddStream(outType.Get(), &m_streamIndex));
 
@@ -469,22 +583,26 @@ HRESULT CpuMp4Encoder::Begin(UINT width, UINT height, UINT fps, const wchar_t* f
     HR(MFCreateMediaType(&inType));
     HR(inType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video));
     HR(inType->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_RGB32));
+    // Capture frames are top-down; without a stride Media Foundation takes RGB as a
+    // bottom-up DIB and the video would play upside down
+    HR(inType->SetUINT32(MF_MT_DEFAULT_STRIDE, m_width * 4));
     HR(inType->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive));
-    HR(MFSetAttributeSize(inType.Get(), MF_MT_FRAME_SIZE, width, height));
-    HR(MFSetAttributeRatio(inType.Get(), MF_MT_FRAME_RATE, fps, 1));
+    HR(MFSetAttributeSize(inType.Get(), MF_MT_FRAME_SIZE, m_width, m_height));
+    HR(MFSetAttributeRatio(inType.Get(), MF_MT_FRAME_RATE, m_fps, 1));
     HR(MFSetAttributeRatio(inType.Get(), MF_MT_PIXEL_ASPECT_RATIO, 1, 1));
     HR(m_writer->SetInputMediaType(m_streamIndex, inType.Get(), nullptr));
 
     HR(m_writer->BeginWriting());
     return S_OK;
 }
-HRESULT CpuMp4Encoder::WriteFrame(const uint8_t* bgraData, LONGLONG timestampHns)
+HRESULT CpuMp4Encoder::WriteSample(const uint8_t* bgraData, LONGLONG timestampHns)
 {
+    TRACE_SCOPE("WriteSample");
     const UINT32 frameSize = m_width * m_height * 4; // BGRA
 
     ComPtr<IMFMediaBuffer> buffer;
-    // Create MF memory buffer of correct size
-    HR(MFCreateMemoryBuffer(frameSize, &buffer));
+    if (FAILED(ArenaMediaBuffer::Create(m_sampleArena, &buffer)))
+        HR(MFCreateMemoryBuffer(frameSize, &buffer));
 
     BYTE* dst = nullptr;
     DWORD maxLen = 0, curLen = 0;
@@ -509,35 +627,372 @@ HRESULT CpuMp4Encoder::WriteFrame(const uint8_t* bgraData, LONGLONG timestampHns
 HRESULT CpuMp4Encoder::End()
 {
     HR(m_writer->Finalize());
-    MFShutdown();
+    m_writer.Reset();
+    m_sampleArena.reset();
+    m_mediaFoundation.Release();
     return S_OK;
 }
+uint64_t CpuMp4Encoder::BytesWritten() const
+{
+    if (!m_writer)
+        return 0;
+
+    MF_SINK_WRITER_STATISTICS stats = {};
+    stats.cb = sizeof(stats);
+    if (FAILED(m_writer->GetStatistics(m_streamIndex, &stats)))
+        return 0;
+    return stats.qwByteCountProcessed;
+}
 
-HRESULT EncodeCpuFramesWrapper()
+// One closed GOP of a GOP-parallel recording: a fresh H.264 encoder per chunk (so it starts
+// with an IDR and references nothing outside), muxed as MPEG-2 TS into memory. TS chunks
+// with absolute timestamps concatenate into one valid stream, unlike MP4.
+class MfChunkEncoder : public IChunkEncoder
 {
-    CpuMp4Encoder encoder;
-    encoder.Begin(1920, 1080, 80, L"hour_capture.mp4");
+public:
+    MfChunkEncoder(UINT width, UINT height, UINT fps) : m_encoder(width, height, fps) {}
 
-    std::vector<uint8_t> frame(1920 * 1080 * 4);
+    bool Begin(uint64_t) override
+    {
+        m_memory.Reset();
+        ComPtr<IMFByteStream> byteStream;
+        if (FAILED(CreateStreamOnHGlobal(nullptr, TRUE, &m_memory)) ||
+            FAILED(MFCreateMFByteStreamOnStream(m_memory.Get(), &byteStream)))
+            return false;
+        return SUCCEEDED(m_encoder.Begin(byteStream.Get(), MFTranscodeContainerType_MPEG2));
+    }
+    bool EncodeFrame(const uint8_t* bgra, int64_t timestampHns) override
+    {
+        return SUCCEEDED(m_encoder.WriteSample(bgra, timestampHns));
+    }
+    bool End(std::vector<uint8_t>& bitstream) override
+    {
+        if (FAILED(m_encoder.End()))
+            return false;
 
-    auto start = std::chrono::steady_clock::now();
-    auto end = start + std::chrono::minutes(1);
+        STATSTG stat = {};
+        LARGE_INTEGER zero = {};
+        if (FAILED(m_memory->Stat(&stat, STATFLAG_NONAME)) || FAILED(m_memory->Seek(zero, STREAM_SEEK_SET, nullptr)))
+            return false;
+        bitstream.resize(size_t(stat.cbSize.QuadPart));
+        ULONG read = 0;
+        HRESULT hr = m_memory->Read(bitstream.data(), ULONG(bitstream.size()), &read);
+        m_memory.Reset();
+        return SUCCEEDED(hr) && read == bitstream.size();
+    }
 
-    while (std::chrono::steady_clock::now() < end)
-    {
-        auto now = std::chrono::steady_clock::now();
-        LONGLONG ts =
-            std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count() / 100;
+private:
+    CpuMp4Encoder m_encoder;
+    ComPtr<IStream> m_memory;
+};
+
+// Lossless copy written next to every MP4 segment, for re-running wear models later
+enum class LosslessArchive {
+    None,
+    Tile, // TileCodec (.olt), typically a few percent of raw on desktop content
+    Y4m   // uncompressed 4:4:4 (.y4m), readable by standard tools
+};
+
+struct RecordingOptions {
+    LosslessArchive lossless = LosslessArchive::None;
+    bool gopParallel = false; // several H.264 encoders on closed-GOP chunks, .ts output
+    UINT levelBins = 0;       // time-at-level histogram saved at the end (--level-bins=16)
+    bool trace = false;       // hot-path tracing from the start, dumped to trace.json at the end
+    CapturePixelFormat captureFormat = CapturePixelFormat::Bgra8; // --hdr=scrgb|hdr10, wear past SDR white
+    bool wearIntegral = false; // --wear-integral: O(1) region / hotspot queries (control pipe)
+    UINT proxyFactor = 1;      // --proxy=4: wear and statistics on a 1/4 x 1/4 area average
+    bool archive = true;       // --no-archive: analysis only, nothing recorded
+};
+
+// Whole arguments of the command line, so "--trace" does not match "--trace=..." or
+// "--trace-overhead". CommandLineToArgvW of an empty string is the executable path.
+static std::vector<std::wstring> CommandLineArguments(const wchar_t* cmdLine)
+{
+    std::vector<std::wstring> args;
+    if (!cmdLine || !*cmdLine) return args;
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(cmdLine, &argc);
+    for (int i = 0; argv && i < argc; ++i)
+        args.push_back(argv[i]);
+    LocalFree(argv);
+    return args;
+}
+
+static bool HasArgument(const std::vector<std::wstring>& args, const wchar_t* name)
+{
+    return std::find(args.begin(), args.end(), name) != args.end();
+}
 
-        if (CaptureNextDXGIFrameToCpu(frame.data(), 1920, 1080))
-            encoder.WriteFrame(frame.data(), ts);
-        else
-            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+static RecordingOptions ParseRecordingOptions(const std::vector<std::wstring>& args)
+{
+    RecordingOptions options;
+    for (const std::wstring& arg : args) {
+        const std::wstring value = arg.find(L'=') != std::wstring::npos ? arg.substr(arg.find(L'=') + 1) : L"";
+        if (arg == L"--lossless=y4m") options.lossless = LosslessArchive::Y4m;
+        else if (arg == L"--lossless" || arg == L"--lossless=tile") options.lossless = LosslessArchive::Tile;
+        else if (arg == L"--gop-parallel") options.gopParallel = true;
+        else if (arg == L"--trace") options.trace = true;
+        else if (arg.compare(0, 13, L"--level-bins=") == 0) options.levelBins = UINT(wcstoul(value.c_str(), nullptr, 10));
+        else if (arg == L"--hdr=hdr10") options.captureFormat = CapturePixelFormat::Rgb10A2;
+        else if (arg == L"--hdr" || arg == L"--hdr=scrgb") options.captureFormat = CapturePixelFormat::Rgba16F;
+        else if (arg == L"--wear-integral") options.wearIntegral = true;
+        else if (arg.compare(0, 8, L"--proxy=") == 0) options.proxyFactor = UINT(wcstoul(value.c_str(), nullptr, 10));
+        else if (arg == L"--no-archive") options.archive = false;
     }
+    return options;
+}
 
-    encoder.End();
+// capture -> wear -> MP4 segments, shared by the windowed and the head-less mode
+PipelineConfig MakePipelineConfig(UINT width, UINT height, const RecordingOptions& options, DxgiCaptureSource* source)
+{
+    PipelineConfig config;
 
-    return S_OK;
+    // Wear per application: window layout twice a second, on the capture thread like the
+    // source itself (which may move the output on a mode change)
+    auto windows = std::make_shared<WindowSampler>();
+    config.windowSampler = [=](std::vector<AppWindow>& out) {
+        return windows->Sample(source->DesktopRect(), false, out);
+    };
+
+    // Capture at up to 80 fps while the desktop changes, back off to 2 fps while it is static
+    config.rate.minFps = 2.0;
+    config.rate.maxFps = 80.0;
+    config.levelBins = options.levelBins;
+    config.wearIntegral = options.wearIntegral;
+    config.proxyFactor = options.proxyFactor;
+
+    // Analysis only: no recorder, and with a proxy no full frame is copied out of the
+    // readback at all
+    if (!options.archive)
+        return config;
+
+    // New file every 10 minutes or 2 GB; finished segments survive a crash
+    config.segments.prefix = "hour_capture";
+    config.segments.maxSegmentSeconds = 600.0;
+    config.segments.maxSegmentBytes = 2ull << 30;
+    config.segments.onWorkerStart = [] { CoInitializeEx(nullptr, COINIT_MULTITHREADED); };
+    config.segments.onWorkerExit = [] { CoUninitialize(); };
+
+    // The video sink: one sink writer, or one per CPU pair on closed-GOP chunks of up to
+    // 1 s for resolutions / rates a single software encoder cannot sustain
+    FrameSinkFactory video =
+        [=] { return std::unique_ptr<IFrameSink>(new CpuMp4Encoder(width, height, 80)); };
+    std::string videoExtension = ".mp4";
+    if (options.gopParallel) {
+        GopParallelConfig gop;
+        gop.encoders = (std::max)(2u, std::thread::hardware_concurrency() / 2);
+        // The sink queues encoders * gopFrames frame copies: keep them near 1 GiB, which
+        // shortens the GOP at 4K or with many encoders
+        const uint64_t budgetFrames = (1ull << 30) / (uint64_t(width) * height * 4 * gop.encoders);
+        gop.gopFrames = uint32_t((std::min)(uint64_t(80), (std::max)(uint64_t(8), budgetFrames)));
+        video = [=] {
+            return std::unique_ptr<IFrameSink>(new GopParallelSink(width, height,
+                [=] { return std::unique_ptr<IChunkEncoder>(new MfChunkEncoder(width, height, 80)); }, gop));
+        };
+        videoExtension = ".ts";
+    }
+    config.segments.extension = videoExtension;
+    config.sinkFactory = video;
+
+    const LosslessArchive lossless = options.lossless;
+    if (lossless == LosslessArchive::Y4m) {
+        // ~6 MB per 1080p frame: cut by time only, a byte limit would rotate every few seconds
+        config.segments.maxSegmentSeconds = 60.0;
+        config.segments.maxSegmentBytes = 0;
+    }
+    if (lossless != LosslessArchive::None) {
+        config.sinkFactory = [=] {
+            auto fanOut = std::make_unique<FanOutSink>();
+            fanOut->Add(video(), videoExtension);
+            if (lossless == LosslessArchive::Y4m)
+                fanOut->Add(std::make_unique<Y4mSink>(width, height, 80), ".y4m");
+            else
+                fanOut->Add(std::make_unique<TileArchiveSink>(width, height), ".olt");
+            return std::unique_ptr<IFrameSink>(std::move(fanOut));
+        };
+    }
+
+    return config;
+}
+
+static void LogPipelineStats(const CapturePipeline& pipeline)
+{
+    PipelineStats stats = pipeline.Stats();
+    char buf[256];
+    std::snprintf(buf, sizeof(buf),
+        "Segmented recording: %llu segments, %u rotations, max switch %.3f ms, max gap %.3f ms, max finalize %.1f ms",
+        stats.segmentsClosed, stats.recording.rotations, stats.recording.maxSwitchSeconds * 1000.0,
+        stats.recording.maxSwitchGapHns / 10000.0, stats.recording.maxFinalizeSeconds * 1000.0);
+    LogAssertion(LogFileType::Encoder, buf);
+
+    std::snprintf(buf, sizeof(buf),
+        "Adaptive capture: %llu of %llu frames, saved %.2f s capture / %.2f s analysis vs fixed rate",
+        stats.rate.framesProcessed, stats.rate.baselineFrames,
+        stats.rate.captureSecondsSaved, stats.rate.analysisSecondsSaved);
+    LogAssertion(LogFileType::General, buf);
+
+    // Time to the first captured frame: the session measures from its Start
+    if (stats.capture.firstFrameSeconds > 0.0 && g_startup.Seconds("capture_start") >= 0.0)
+        g_startup.Mark("first_frame", g_startup.Seconds("capture_start") + stats.capture.firstFrameSeconds);
+    std::snprintf(buf, sizeof(buf), "Startup: %s (capture open %.1f ms, warm-up %.1f ms)",
+        g_startup.Format().c_str(), stats.capture.openSeconds * 1000.0, stats.capture.warmSeconds * 1000.0);
+    LogAssertion(LogFileType::General, buf);
+
+    // What repeating this session would do to the panel (README model, T_50 = 20000 h)
+    WearMap wear = pipeline.WearSnapshot();
+    if (wear.TotalSeconds() > 0.0) {
+        std::string lifetime = FormatLifetimeSummary(
+            LifetimeProjection().Summarize(wear, { 0.9, 0.8, 0.5 }, { 0.0, 0.01, 0.5 }));
+        LogAssertion(LogFileType::General, ("Lifetime projection: " + lifetime.substr(3)).c_str());
+    }
+
+    std::vector<AppLedgerEntry> ledger = pipeline.AttributionLedger();
+    if (!ledger.empty())
+        LogAssertion(LogFileType::General, ("Wear per application (x,y,w,h:stress_s):\n" +
+            FormatAttributionLedger(ledger)).c_str());
+
+    WearTile hottest;
+    if (pipeline.HottestTile(hottest)) {
+        std::snprintf(buf, sizeof(buf), "Most worn tile: x=%u y=%u %ux%u, %.1f stress-s, %.3f s per pixel",
+            hottest.rect.x, hottest.rect.y, hottest.rect.width, hottest.rect.height, hottest.wear.sum,
+            hottest.wear.mean);
+        LogAssertion(LogFileType::General, buf);
+    }
+}
+
+// Chrome trace of the hot path plus per-stage latencies in the log
+static void DumpTrace()
+{
+    std::vector<Trace::StageSummary> stages = Trace::Summarize();
+    if (stages.empty())
+        return;
+    Trace::SaveChromeJson("trace.json");
+    LogAssertion(LogFileType::General, ("Trace stages (trace.json):\n" + Trace::FormatSummary(stages)).c_str());
+}
+
+// Time at every drive level per subpixel, for re-running the session under other models
+static void SaveLevelHistogram(const CapturePipeline& pipeline)
+{
+    if (pipeline.SaveLevelHistogram("wear_levels.olh"))
+        LogAssertion(LogFileType::General, "Saved level histogram to wear_levels.olh");
+}
+
+// The README's heatmap and contour plot plus the raw stress-seconds, written next to the
+// segments instead of post-processing them in Python.
+static void ExportWearImages(const WearMap& wear, const std::string& prefix)
+{
+    if (wear.TotalSeconds() <= 0.0)
+        return;
+    HeatmapOptions heatmap;
+    heatmap.contourLevels = 8;
+    const std::string png = prefix + "_heatmap.png", tiff = prefix + "_seconds.tif";
+    const bool ok = ExportHeatmapPng(wear, heatmap, png) && ExportWearTiff(wear, TiffSample::Float32, false, tiff);
+    LogAssertion(LogFileType::General, ok ? ("Saved " + png + " and " + tiff).c_str() : "Wear image export failed");
+}
+
+// Ends the timed CPU encode of the windowed mode
+static void FinishCpuEncode(CapturePipeline& pipeline, const CaptureSession& session)
+{
+    pipeline.Stop();
+
+    if (session.State() == CaptureSessionState::Faulted)
+        LogAssertion(LogFileType::General, "Capture session faulted, stopping capture");
+    LogPipelineStats(pipeline);
+    SaveRateTrace("rate_trace.csv", pipeline.RateTrace());
+    SaveLevelHistogram(pipeline);
+    ExportWearImages(pipeline.WearSnapshot(), "wear");
+    DumpTrace();
+}
+
+// Head-less daemon: no window, swapchain, shaders or preview copies, only
+// capture -> wear -> encode, controlled over a local named pipe (see ControlProtocol.h).
+int RunHeadlessDaemon(const RecordingOptions& options)
+{
+    InitLease mediaFoundation(g_mediaFoundation);
+    g_startup.Mark("media_foundation");
+
+    auto dxgiSource = std::make_unique<DxgiCaptureSource>(0);
+    dxgiSource->RequestFormat(options.captureFormat);
+    DxgiCaptureSource* source = dxgiSource.get();
+    CaptureSession session(std::move(dxgiSource));
+    g_startup.Mark("capture_start");
+    if (!session.Start())
+        return -1;
+    g_startup.Mark("capture");
+
+    CapturePipeline pipeline(session, MakePipelineConfig(session.Width(), session.Height(), options, source));
+    if (!pipeline.Start())
+        return -1;
+    g_startup.Mark("pipeline");
+
+    HRESULT hr = RunControlPipeServer(L"\\\\.\\pipe\\oleppy", pipeline);
+    pipeline.Stop();
+    LogPipelineStats(pipeline);
+    SaveLevelHistogram(pipeline);
+    ExportWearImages(pipeline.WearSnapshot(), "wear");
+    DumpTrace();
+    session.Stop();
+    return SUCCEEDED(hr) ? 0 : -1;
+}
+
+// Synthetic end-to-end benchmark (PipelineBenchmark.h); JSON goes to benchmark.json unless
+// --out= says otherwise, there is no console to print to
+static int RunBenchmark(const wchar_t* cmdLine)
+{
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(cmdLine, &argc);
+    std::vector<std::string> args;
+    for (int i = 0; argv && i < argc; ++i) {
+        int len = WideCharToMultiByte(CP_UTF8, 0, argv[i], -1, nullptr, 0, nullptr, nullptr);
+        std::string arg(len > 0 ? len - 1 : 0, '\0');
+        if (len > 1)
+            WideCharToMultiByte(CP_UTF8, 0, argv[i], -1, &arg[0], len, nullptr, nullptr);
+        args.push_back(arg);
+    }
+    LocalFree(argv);
+
+    int rc = RunBenchmarkCommandLine(args, "benchmark.json");
+    LogAssertion(LogFileType::General, rc == 0 ? "Benchmark finished" : "Benchmark failed");
+    return rc;
+}
+
+// --analyze file... : wear of recorded lossless archives (raw / tile segments) on all
+// cores, logged as a lifetime projection instead of capturing
+static int RunOfflineAnalysis(const wchar_t* cmdLine)
+{
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(cmdLine, &argc);
+    std::vector<std::string> paths;
+    bool collecting = false;
+    for (int i = 0; argv && i < argc; ++i) {
+        if (wcscmp(argv[i], L"--analyze") == 0) { collecting = true; continue; }
+        if (!collecting || wcsncmp(argv[i], L"--", 2) == 0) { collecting = false; continue; }
+        int len = WideCharToMultiByte(CP_UTF8, 0, argv[i], -1, nullptr, 0, nullptr, nullptr);
+        std::string path(len > 0 ? len - 1 : 0, '\0');
+        if (len > 1)
+            WideCharToMultiByte(CP_UTF8, 0, argv[i], -1, &path[0], len, nullptr, nullptr);
+        paths.push_back(path);
+    }
+    LocalFree(argv);
+
+    WearMap wear;
+    OfflineAnalysisResult result = AnalyzeArchives(paths, OfflineAnalysisConfig(), wear);
+    if (!result.ok) {
+        LogAssertion(LogFileType::General, ("Offline analysis failed on " + result.error).c_str());
+        return 1;
+    }
+
+    char buf[256];
+    std::snprintf(buf, sizeof(buf), "Offline analysis: %llu frames, %.1f s of media in %.2f s (%u spans, %u threads)",
+        (unsigned long long)result.frames, result.mediaSeconds, result.wallSeconds, result.spans, result.threads);
+    LogAssertion(LogFileType::General, buf);
+    if (wear.TotalSeconds() > 0.0) {
+        std::string lifetime = FormatLifetimeSummary(
+            LifetimeProjection().Summarize(wear, { 0.9, 0.8, 0.5 }, { 0.0, 0.01, 0.5 }));
+        LogAssertion(LogFileType::General, ("Lifetime projection: " + lifetime.substr(3)).c_str());
+    }
+    ExportWearImages(wear, "analysis");
+    return 0;
 }
 
 //bool CaptureNextDXGIFrameToGpu(ID3D11Device* device, ID3D11DeviceContext* context, ID3D11Texture2D** outTex)
@@ -1351,26 +1806,99 @@ HRESULT EncodeCpuFramesWrapper()
 //}
 
 
-int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int) {
+int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR pCmdLine, int) {
     if (FAILED(CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE))) return -1;
+    const std::vector<std::wstring> args = CommandLineArguments(pCmdLine);
+    const RecordingOptions options = ParseRecordingOptions(args);
+    if (HasArgument(args, L"--bench")) {
+        int rc = RunBenchmark(pCmdLine);
+        CoUninitialize();
+        return rc;
+    }
+    if (HasArgument(args, L"--analyze")) {
+        int rc = RunOfflineAnalysis(pCmdLine);
+        CoUninitialize();
+        return rc;
+    }
+    Trace::Enable(options.trace);
+    if (HasArgument(args, L"--daemon")) {
+        int rc = RunHeadlessDaemon(options);
+        CoUninitialize();
+        return rc;
+    }
+    // Media Foundation for the whole run: encoders only take references
+    InitLease mediaFoundation(g_mediaFoundation);
+    g_startup.Mark("media_foundation");
     if (!InitWindow(hInstance)) return -1;
+    g_startup.Mark("window");
     if (!InitD3D()) return -1;
-    if (!InitDuplication()) return -1;
+    g_startup.Mark("device");
+
+    // The capture source keeps a private device: the pipeline thread uses its immediate
+    // context, so the preview only sees the frames it publishes through shared handles
+    auto dxgiSource = std::make_unique<DxgiCaptureSource>(0);
+    dxgiSource->SetPreviewRate(g_preview.fps);
+    // The preview samples HDR frames as they come (linear scRGB or PQ), without tone mapping
+    dxgiSource->RequestFormat(options.captureFormat);
+    DxgiCaptureSource* previewSource = dxgiSource.get();
+    CaptureSession session(std::move(dxgiSource));
+    g_startup.Mark("capture_start");
+    if (!session.Start()) return -1;
+    g_startup.Mark("capture");
     if (!InitShaders()) return -1;
-	if (FAILED(EncodeCpuFramesWrapper())) return -1;
+    g_startup.Mark("shaders");
+
+    PipelineConfig config = MakePipelineConfig(session.Width(), session.Height(), options, previewSource);
+    config.rate.recordTrace = true;
+    CapturePipeline pipeline(session, config);
+    if (!pipeline.Start()) return -1;
+    g_startup.Mark("pipeline");
 	//if (FAILED(EncodeD3D11FramesWrapper())) return -1;  //to-do implement triple buffer fallback for high core case
     //if (FAILED(EncodeD3D11FramesWrapper_NVENC())) return -1;
 
+    const auto previewInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / g_preview.fps));
+    const auto encodeEnd = std::chrono::steady_clock::now() + std::chrono::minutes(1);
+    auto nextPreview = std::chrono::steady_clock::now();
+    bool encoding = true;
+
     MSG msg = {};
     while (msg.message != WM_QUIT) {
         if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
             TranslateMessage(&msg);
             DispatchMessage(&msg);
+            continue;
         }
-        else {
-            RenderFrame();
+
+        auto now = std::chrono::steady_clock::now();
+        if (encoding && (now >= encodeEnd || !pipeline.IsRunning())) {
+            FinishCpuEncode(pipeline, session);
+            encoding = false;
+            // Capture and wear go on without the recording, so the preview and its
+            // overlay stay live
+            pipeline.EndRecording();
+            if (!pipeline.Start())
+                LogAssertion(LogFileType::General, "Capture did not restart after the recording, preview stopped");
+        }
+        if (now >= nextPreview) {
+            RenderFrame(*previewSource, pipeline);
+            nextPreview = (std::max)(nextPreview + previewInterval, now);
         }
+
+        // Sleep until the next preview frame unless a message arrives first
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(nextPreview - std::chrono::steady_clock::now());
+        if (wait.count() > 0)
+            MsgWaitForMultipleObjects(0, nullptr, FALSE, DWORD(wait.count()), QS_ALLINPUT);
+    }
+    if (encoding) {
+        FinishCpuEncode(pipeline, session);
+    } else {
+        // The wear images again, with everything the overlay showed after the recording
+        pipeline.Stop();
+        ExportWearImages(pipeline.WearSnapshot(), "wear");
     }
+    session.Stop();
+    mediaFoundation.Release();
     CoUninitialize();
     return 0;
 }
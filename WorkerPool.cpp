@@ -0,0 +1,82 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned threads)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 1; i < threads; ++i)
+        m_workers.emplace_back(&WorkerPool::WorkerLoop, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+void WorkerPool::RunItems(std::unique_lock<std::mutex>& lock)
+{
+    // Items are claimed one at a time under the lock and run outside it
+    while (m_next < m_count)
+    {
+        size_t i = m_next++;
+        lock.unlock();
+        (*m_fn)(i);
+        lock.lock();
+        if (++m_finished == m_count)
+            m_doneCv.notify_all();
+    }
+}
+
+void WorkerPool::WorkerLoop()
+{
+    unsigned seen = 0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_cv.wait(lock, [&] { return m_stop || m_generation != seen; });
+        if (m_stop)
+            return;
+        seen = m_generation;
+
+        ++m_busy;
+        RunItems(lock);
+        if (--m_busy == 0)
+            m_doneCv.notify_all();
+    }
+}
+
+void WorkerPool::ParallelFor(size_t count, const std::function<void(size_t)>& fn)
+{
+    if (count == 0)
+        return;
+    if (m_workers.empty() || count == 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+            fn(i);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_fn = &fn;
+    m_count = count;
+    m_next = 0;
+    m_finished = 0;
+    ++m_generation;
+    m_cv.notify_all();
+
+    RunItems(lock);
+
+    // Workers that woke late may still be between claiming nothing and going back to
+    // sleep; wait for them too so fn can go out of scope safely
+    m_doneCv.wait(lock, [&] { return m_finished == m_count && m_busy == 0; });
+    m_fn = nullptr;
+    m_count = 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads for data-parallel loops on the hot path (no per-call thread
+// creation). One ParallelFor at a time; the calling thread works along.
+class WorkerPool
+{
+public:
+    // threads = total parallelism including the caller; 0 = hardware concurrency
+    explicit WorkerPool(unsigned threads = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    unsigned Threads() const { return unsigned(m_workers.size()) + 1; }
+
+    // fn(i) for every i in [0, count), dynamically load balanced; returns when all are done
+    void ParallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+private:
+    void WorkerLoop();
+    void RunItems(std::unique_lock<std::mutex>& lock);
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::condition_variable m_doneCv;
+
+    const std::function<void(size_t)>* m_fn = nullptr;
+    size_t m_count = 0;
+    size_t m_next = 0;
+    size_t m_finished = 0;
+    unsigned m_generation = 0;
+    unsigned m_busy = 0;
+    bool m_stop = false;
+};
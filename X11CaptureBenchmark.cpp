@@ -0,0 +1,150 @@
+#include "BenchmarkModes.h"
+
+#include <cstdio>
+
+#ifdef PIPELINE_BENCH_X11
+#include "CaptureSession.h"
+#include "X11CaptureSource.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+
+static X11CaptureRun MeasureX11Run(const BenchmarkConfig& config, const std::string& display,
+    X11Presenter& presenter, const std::vector<std::vector<uint8_t>>& loop, bool damage)
+{
+    X11CaptureRun run;
+    const uint32_t width = presenter.Width(), height = presenter.Height();
+    const size_t frameBytes = size_t(width) * height * 4;
+
+    auto source = std::make_unique<X11CaptureSource>(display);
+    source->SetDamage(damage);
+    X11CaptureSource* x11 = source.get();
+    CaptureSession session(std::move(source));
+    FrameArena arena;
+    if (!presenter.Present(loop[0].data()) || !session.Start() || session.Width() != width ||
+        session.Height() != height || !arena.Reset(frameBytes, 1))
+        return run;
+    run.damage = x11->HasDamage();
+    uint8_t* frame = arena.Slot(0);
+    if (session.CaptureNext(frame) != CaptureResult::Frame) // the whole desktop first
+        return run;
+
+    WearMap wear;
+    wear.Reset(width, height);
+    std::vector<int64_t> captureNs;
+    captureNs.reserve(config.frames);
+    double dirty = 0.0, wearNs = 0.0;
+    run.matches = true;
+    for (uint32_t n = 1; n <= config.frames; ++n)
+    {
+        const std::vector<uint8_t>& presented = loop[n % loop.size()];
+        if (!presenter.Present(presented.data()))
+        {
+            run.matches = false;
+            break;
+        }
+        run.frames++;
+
+        CaptureFrameInfo info;
+        auto start = Clock::now();
+        const CaptureResult result = session.CaptureNext(frame, &info);
+        auto end = Clock::now();
+        if (result == CaptureResult::Timeout)
+        {
+            run.timeouts++;
+            continue;
+        }
+        if (result != CaptureResult::Frame)
+        {
+            run.matches = false;
+            break;
+        }
+        run.captured++;
+        captureNs.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        dirty += info.dirtyFraction;
+
+        start = Clock::now();
+        wear.Accumulate(frame, 1.0 / 60.0);
+        wearNs += double(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+
+        // Alpha is the source's own (opaque); the colour must be exactly what was drawn
+        for (size_t i = 0; i < frameBytes && run.matches; i += 4)
+            run.matches = std::memcmp(frame + i, presented.data() + i, 3) == 0;
+    }
+    session.Stop();
+
+    if (run.captured)
+    {
+        run.capture = Summarize(captureNs);
+        run.captureFps = run.capture.meanNs > 0.0 ? 1e9 / run.capture.meanNs : 0.0;
+        run.dirtyFraction = dirty / double(run.captured);
+        run.wearMs = wearNs / double(run.captured) / 1e6;
+    }
+    return run;
+}
+
+X11CaptureBenchmark MeasureX11Capture(const BenchmarkConfig& config, const std::string& display)
+{
+    X11CaptureBenchmark bench;
+    bench.display = display;
+    X11Presenter presenter;
+    if (!presenter.Open(display))
+        return bench;
+    bench.width = presenter.Width();
+    bench.height = presenter.Height();
+
+    SyntheticDesktop desktop(config.workload, bench.width, bench.height);
+    std::vector<std::vector<uint8_t>> loop((std::max)(config.loopFrames, 2u));
+    for (size_t i = 0; i < loop.size(); ++i)
+    {
+        loop[i].resize(size_t(bench.width) * bench.height * 4);
+        desktop.Render(i, loop[i].data());
+    }
+
+    for (bool damage : { true, false })
+        bench.runs.push_back(MeasureX11Run(config, display, presenter, loop, damage));
+    return bench;
+}
+
+std::string FormatX11CaptureJson(const X11CaptureBenchmark& bench)
+{
+    std::string json = "{\"benchmark\":\"x11_capture\",\"display\":\"" + bench.display + "\"";
+    char buf[512];
+    std::snprintf(buf, sizeof(buf), ",\"width\":%u,\"height\":%u,\"runs\":[", bench.width, bench.height);
+    json += buf;
+    for (size_t i = 0; i < bench.runs.size(); ++i)
+    {
+        const X11CaptureRun& run = bench.runs[i];
+        std::snprintf(buf, sizeof(buf),
+            "%s{\"damage\":%s,\"frames\":%llu,\"captured\":%llu,\"timeouts\":%llu,\"capture_mean_ms\":%.3f,"
+            "\"capture_p99_ms\":%.3f,\"capture_fps\":%.1f,\"dirty_fraction\":%.4f,\"wear_ms\":%.3f,"
+            "\"matches\":%s}",
+            i ? "," : "", run.damage ? "true" : "false", (unsigned long long)run.frames,
+            (unsigned long long)run.captured, (unsigned long long)run.timeouts, run.capture.meanNs / 1e6,
+            run.capture.p99Ns / 1e6, run.captureFps, run.dirtyFraction, run.wearMs, run.matches ? "true" : "false");
+        json += buf;
+    }
+    json += "]}\n";
+    return json;
+}
+
+bool RunX11CaptureMode(const BenchmarkOptions& options, std::string& json)
+{
+    BenchmarkConfig config = options.config;
+    config.workload = options.workloads.front();
+    X11CaptureBenchmark bench = MeasureX11Capture(config, options.display);
+    bool ok = !bench.runs.empty();
+    for (const X11CaptureRun& run : bench.runs)
+        ok = ok && run.captured > 0 && run.matches;
+    json = FormatX11CaptureJson(bench);
+    return ok;
+}
+#else
+bool RunX11CaptureMode(const BenchmarkOptions&, std::string&)
+{
+    std::fprintf(stderr, "bench: --x11 needs a build with PIPELINE_BENCH_X11 (see PipelineBenchmarkMain.cpp)\n");
+    return false;
+}
+#endif
@@ -0,0 +1,534 @@
+#include "X11CaptureSource.h"
+
+#include "PointerWear.h"
+#include "TileHash.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+#include <poll.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xfixes.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define X11_SSE 1
+#else
+#define X11_SSE 0
+#endif
+
+// Same budget as DXGI's AcquireNextFrame
+static constexpr int ACQUIRE_TIMEOUT_MS = 16;
+
+// Xlib's default error handler exits the process. Requests that can fail at run time
+// (XShmAttach on a remote display, XShmGetImage racing a resize) report through their
+// return value or an XSync instead, so errors are only recorded.
+static std::atomic<int> g_lastXError{ 0 };
+
+static int RecordXError(Display*, XErrorEvent* error)
+{
+    g_lastXError = error->error_code;
+    return 0;
+}
+
+static void InstallErrorHandler()
+{
+    static std::once_flag once;
+    std::call_once(once, [] { XSetErrorHandler(RecordXError); });
+}
+
+// The only pixel layout the copy handles: 32 bits per pixel, B G R X in memory
+static bool IsBgrx(const XImage* image)
+{
+    return image->bits_per_pixel == 32 && image->byte_order == LSBFirst && image->red_mask == 0xFF0000 &&
+        image->green_mask == 0xFF00 && image->blue_mask == 0xFF;
+}
+
+static void CopyOpaque(const uint8_t* src, uint8_t* dst, uint32_t width)
+{
+    uint32_t x = 0;
+#if X11_SSE
+    const __m128i alpha = _mm_set1_epi32(int(0xFF000000u));
+    for (; x + 4 <= width; x += 4)
+    {
+        const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + size_t(x) * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + size_t(x) * 4), _mm_or_si128(px, alpha));
+    }
+#endif
+    for (; x < width; ++x)
+    {
+        dst[size_t(x) * 4 + 0] = src[size_t(x) * 4 + 0];
+        dst[size_t(x) * 4 + 1] = src[size_t(x) * 4 + 1];
+        dst[size_t(x) * 4 + 2] = src[size_t(x) * 4 + 2];
+        dst[size_t(x) * 4 + 3] = 0xFF;
+    }
+}
+
+struct X11CaptureSource::X11State
+{
+    Display* display = nullptr;
+    Window root = 0;
+    XImage* image = nullptr;
+    XShmSegmentInfo shm = {};
+    bool attached = false;
+
+    int damageEvent = 0, damageError = 0;
+    Damage damage = 0;
+    XserverRegion region = 0;
+    int fixesEvent = 0, fixesError = 0;
+    bool fixes = false;
+};
+
+X11CaptureSource::X11CaptureSource(std::string display, int screen)
+    : m_displayName(std::move(display)), m_screen(screen)
+{
+}
+
+X11CaptureSource::~X11CaptureSource()
+{
+    Close();
+}
+
+bool X11CaptureSource::HasDamage() const
+{
+    return m_x && m_x->damage != 0;
+}
+
+bool X11CaptureSource::Open()
+{
+    Close();
+    InstallErrorHandler();
+
+    m_x = std::make_unique<X11State>();
+    X11State& x = *m_x;
+    x.display = XOpenDisplay(m_displayName.empty() ? nullptr : m_displayName.c_str());
+    if (!x.display)
+    {
+        Close();
+        return false;
+    }
+    const int screen = m_screen >= 0 && m_screen < ScreenCount(x.display) ? m_screen : DefaultScreen(x.display);
+    x.root = RootWindow(x.display, screen);
+
+    XWindowAttributes attributes = {};
+    if (!XShmQueryExtension(x.display) || !XGetWindowAttributes(x.display, x.root, &attributes) ||
+        attributes.width <= 0 || attributes.height <= 0)
+    {
+        Close();
+        return false;
+    }
+    m_width = uint32_t(attributes.width);
+    m_height = uint32_t(attributes.height);
+
+    // One shared segment for the life of the source. It is marked for removal as soon as
+    // both sides are attached, so it cannot outlive a crash.
+    x.image = XShmCreateImage(x.display, attributes.visual, unsigned(attributes.depth), ZPixmap, nullptr, &x.shm,
+        m_width, m_height);
+    if (!x.image || !IsBgrx(x.image))
+    {
+        Close();
+        return false;
+    }
+    x.shm.shmid = shmget(IPC_PRIVATE, size_t(x.image->bytes_per_line) * x.image->height, IPC_CREAT | 0600);
+    if (x.shm.shmid < 0)
+    {
+        Close();
+        return false;
+    }
+    x.shm.shmaddr = static_cast<char*>(shmat(x.shm.shmid, nullptr, 0));
+    if (x.shm.shmaddr == reinterpret_cast<char*>(-1))
+    {
+        x.shm.shmaddr = nullptr;
+        shmctl(x.shm.shmid, IPC_RMID, nullptr);
+        Close();
+        return false;
+    }
+    x.image->data = x.shm.shmaddr;
+    x.shm.readOnly = False;
+    g_lastXError = 0;
+    x.attached = XShmAttach(x.display, &x.shm) != 0;
+    XSync(x.display, False);
+    shmctl(x.shm.shmid, IPC_RMID, nullptr);
+    if (!x.attached || g_lastXError != 0)
+    {
+        x.attached = false;
+        Close();
+        return false;
+    }
+
+    // Size changes of the root window: AccessLost, the session reopens at the new size
+    XSelectInput(x.display, x.root, StructureNotifyMask);
+
+    int major = 0, minor = 0;
+    if (XFixesQueryExtension(x.display, &x.fixesEvent, &x.fixesError) &&
+        XFixesQueryVersion(x.display, &major, &minor) && major >= 2)
+    {
+        x.fixes = true;
+        XFixesSelectCursorInput(x.display, x.root, XFixesDisplayCursorNotifyMask);
+        if (m_useDamage && XDamageQueryExtension(x.display, &x.damageEvent, &x.damageError) &&
+            XDamageQueryVersion(x.display, &major, &minor))
+        {
+            // NonEmpty: one event when the damage becomes non-empty, then quiet until it
+            // is subtracted, however many draws land in between
+            x.region = XFixesCreateRegion(x.display, nullptr, 0);
+            x.damage = XDamageCreate(x.display, x.root, XDamageReportNonEmpty);
+        }
+    }
+    XSync(x.display, False);
+
+    m_pendingFull = true;
+    m_pointer = PointerState();
+    m_cursorSerial = 0;
+    m_row.resize(size_t(m_width) * 4);
+    if (x.fixes)
+        UpdatePointer(true);
+    return true;
+}
+
+void X11CaptureSource::Close()
+{
+    if (m_x)
+    {
+        X11State& x = *m_x;
+        if (x.display)
+        {
+            if (x.damage)
+                XDamageDestroy(x.display, x.damage);
+            if (x.region)
+                XFixesDestroyRegion(x.display, x.region);
+            if (x.attached)
+                XShmDetach(x.display, &x.shm);
+            XSync(x.display, False);
+        }
+        if (x.image)
+        {
+            x.image->data = nullptr; // the segment is not XDestroyImage's to free
+            XDestroyImage(x.image);
+        }
+        if (x.shm.shmaddr)
+            shmdt(x.shm.shmaddr);
+        if (x.display)
+            XCloseDisplay(x.display);
+        m_x.reset();
+    }
+    m_width = m_height = 0;
+}
+
+bool X11CaptureSource::Warm()
+{
+    if (!m_x || !m_x->image)
+        return false;
+    m_pointerBuffer.reserve(64 * 64 * 4);
+    return Grab();
+}
+
+bool X11CaptureSource::Grab()
+{
+    TRACE_SCOPE("XShmGetImage");
+    g_lastXError = 0;
+    return XShmGetImage(m_x->display, m_x->root, m_x->image, 0, 0, AllPlanes) && g_lastXError == 0;
+}
+
+bool X11CaptureSource::UpdatePointer(bool shapeChanged)
+{
+    X11State& x = *m_x;
+    bool changed = false;
+
+    if (shapeChanged && x.fixes)
+    {
+        XFixesCursorImage* cursor = XFixesGetCursorImage(x.display);
+        if (cursor)
+        {
+            if (cursor->cursor_serial != m_cursorSerial && cursor->width && cursor->height)
+            {
+                // Premultiplied ARGB in unsigned longs; PointerShapeType::Color is straight
+                m_pointerBuffer.resize(size_t(cursor->width) * cursor->height * 4);
+                for (size_t i = 0; i < size_t(cursor->width) * cursor->height; ++i)
+                {
+                    const uint32_t argb = uint32_t(cursor->pixels[i]);
+                    const uint32_t a = argb >> 24;
+                    uint8_t* px = m_pointerBuffer.data() + i * 4;
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        const uint32_t v = (argb >> (8 * c)) & 0xFF;
+                        px[c] = a ? uint8_t((std::min)(255u, (v * 255 + a / 2) / a)) : 0;
+                    }
+                    px[3] = uint8_t(a);
+                }
+                auto shape = std::make_shared<PointerShape>();
+                if (DecodePointerShape(PointerShapeType::Color, cursor->width, cursor->height, cursor->width * 4u,
+                        m_pointerBuffer.data(), false, *shape))
+                {
+                    shape->id = ++m_pointerShapes;
+                    m_pointer.shape = std::move(shape);
+                    m_cursorSerial = cursor->cursor_serial;
+                    m_hotX = cursor->xhot;
+                    m_hotY = cursor->yhot;
+                    changed = true;
+                }
+            }
+            XFree(cursor);
+        }
+    }
+
+    Window rootReturn = 0, child = 0;
+    int rootX = 0, rootY = 0, winX = 0, winY = 0;
+    unsigned int mask = 0;
+    const bool onScreen =
+        XQueryPointer(x.display, x.root, &rootReturn, &child, &rootX, &rootY, &winX, &winY, &mask) != 0;
+    const bool visible = onScreen && m_pointer.shape != nullptr;
+    if (visible != m_pointer.visible || rootX != m_pointerX || rootY != m_pointerY)
+        changed = true;
+    m_pointer.visible = visible;
+    m_pointerX = rootX;
+    m_pointerY = rootY;
+    m_pointer.x = rootX - m_hotX;
+    m_pointer.y = rootY - m_hotY;
+    return changed;
+}
+
+double X11CaptureSource::DamagedFraction()
+{
+    X11State& x = *m_x;
+    // Taken before the grab: anything drawn after this raises a new event and is grabbed
+    // next time, so no change is lost between the two
+    XDamageSubtract(x.display, x.damage, None, x.region);
+    int count = 0;
+    XRectangle* rects = XFixesFetchRegion(x.display, x.region, &count);
+    if (!rects)
+        return 1.0;
+
+    // Region rectangles do not overlap
+    double area = 0.0;
+    for (int i = 0; i < count; ++i)
+        area += double(rects[i].width) * rects[i].height;
+    XFree(rects);
+    return (std::min)(1.0, area / (double(m_width) * m_height));
+}
+
+void X11CaptureSource::CopyRows(uint8_t* dst, CaptureFrameInfo* info)
+{
+    TRACE_SCOPE("RowCopy");
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(m_x->image->data);
+    const size_t pitch = size_t(m_x->image->bytes_per_line);
+    const size_t rowBytes = size_t(m_width) * 4;
+
+    uint8_t* proxy = info ? info->proxy : nullptr;
+    if (proxy && (m_downscaler.Width() != m_width || m_downscaler.Height() != m_height ||
+                     m_downscaler.Factor() != info->proxyFactor) &&
+        !m_downscaler.Reset(m_width, m_height, info->proxyFactor))
+    {
+        proxy = nullptr; // left unwritten, proxyWritten stays false
+    }
+    TileHasher* tiles = info ? info->tiles : nullptr;
+    if (tiles && !tiles->Resize(m_width, m_height))
+        tiles = nullptr;
+    if (!dst && !proxy && !tiles)
+        return;
+
+    // The pad byte is only made opaque on the copy, so the hash reads the copied row,
+    // still in cache
+    if (proxy)
+        m_downscaler.Begin(proxy);
+    if (tiles)
+        tiles->Begin();
+    for (uint32_t y = 0; y < m_height; ++y)
+    {
+        // Without a dst the row only passes through m_row
+        uint8_t* row = dst ? dst + size_t(y) * rowBytes : m_row.data();
+        CopyOpaque(src + size_t(y) * pitch, row, m_width);
+        if (tiles)
+            tiles->AddRow(row);
+        if (proxy)
+            m_downscaler.AddRow(row);
+    }
+    if (proxy)
+        info->proxyWritten = true;
+    if (tiles)
+        info->tilesHashed = true;
+}
+
+CaptureResult X11CaptureSource::AcquireFrame(uint8_t* dst, CaptureFrameInfo* info)
+{
+    if (!m_x || !m_x->image)
+        return CaptureResult::Error;
+    X11State& x = *m_x;
+
+    bool damaged = m_pendingFull || !x.damage;
+    bool cursorChanged = false;
+    bool resized = false;
+    auto drain = [&] {
+        while (XPending(x.display) > 0)
+        {
+            XEvent event;
+            XNextEvent(x.display, &event);
+            if (x.damage && event.type == x.damageEvent + XDamageNotify)
+                damaged = true;
+            else if (x.fixes && event.type == x.fixesEvent + XFixesCursorNotify)
+                cursorChanged = true;
+            else if (event.type == ConfigureNotify && event.xconfigure.window == x.root &&
+                (uint32_t(event.xconfigure.width) != m_width || uint32_t(event.xconfigure.height) != m_height))
+                resized = true;
+        }
+    };
+
+    {
+        TRACE_SCOPE("WaitDamage");
+        drain();
+        if (!damaged && !resized)
+        {
+            pollfd fd = { ConnectionNumber(x.display), POLLIN, 0 };
+            if (poll(&fd, 1, ACQUIRE_TIMEOUT_MS) > 0)
+                drain();
+        }
+    }
+    if (resized)
+        return CaptureResult::AccessLost;
+
+    const bool pointerChanged = UpdatePointer(cursorChanged);
+    if (info)
+        info->pointer = m_pointer;
+    if (!damaged)
+        return pointerChanged ? CaptureResult::PointerMoved : CaptureResult::Timeout;
+
+    double dirty = 1.0;
+    if (x.damage)
+    {
+        const double damagedFraction = DamagedFraction();
+        dirty = m_pendingFull ? 1.0 : damagedFraction;
+    }
+    m_pendingFull = false;
+    if (info)
+        info->dirtyFraction = dirty;
+
+    if (!Grab())
+    {
+        // A resize racing the grab fails it with BadMatch before ConfigureNotify arrives
+        XWindowAttributes attributes = {};
+        if (XGetWindowAttributes(x.display, x.root, &attributes) &&
+            (uint32_t(attributes.width) != m_width || uint32_t(attributes.height) != m_height))
+            return CaptureResult::AccessLost;
+        m_pendingFull = true; // what the damage reported has not been read yet
+        return CaptureResult::Dropped;
+    }
+    CopyRows(dst, info);
+    return CaptureResult::Frame;
+}
+
+struct X11Presenter::X11State
+{
+    Display* display = nullptr;
+    Window root = 0;
+    Visual* visual = nullptr;
+    int depth = 0;
+    GC gc = nullptr;
+};
+
+X11Presenter::X11Presenter() = default;
+
+X11Presenter::~X11Presenter()
+{
+    Close();
+}
+
+bool X11Presenter::Open(const std::string& display)
+{
+    Close();
+    InstallErrorHandler();
+
+    m_x = std::make_unique<X11State>();
+    X11State& x = *m_x;
+    x.display = XOpenDisplay(display.empty() ? nullptr : display.c_str());
+    if (!x.display)
+    {
+        Close();
+        return false;
+    }
+    const int screen = DefaultScreen(x.display);
+    x.root = RootWindow(x.display, screen);
+    x.visual = DefaultVisual(x.display, screen);
+    x.depth = DefaultDepth(x.display, screen);
+    x.gc = DefaultGC(x.display, screen);
+    m_width = uint32_t(DisplayWidth(x.display, screen));
+    m_height = uint32_t(DisplayHeight(x.display, screen));
+
+    // Checked on a one-pixel image; Present wraps the caller's frames the same way
+    XImage* probe = XCreateImage(x.display, x.visual, unsigned(x.depth), ZPixmap, 0, nullptr, 1, 1, 32, 4);
+    const bool bgrx = probe && IsBgrx(probe);
+    if (probe)
+        XDestroyImage(probe);
+    if (!bgrx)
+    {
+        Close();
+        return false;
+    }
+    m_last.assign(size_t(m_width) * m_height * 4, 0);
+    m_presented = false;
+    return true;
+}
+
+void X11Presenter::Close()
+{
+    if (m_x && m_x->display)
+        XCloseDisplay(m_x->display);
+    m_x.reset();
+    m_width = m_height = 0;
+    m_last.clear();
+}
+
+bool X11Presenter::Present(const uint8_t* bgra)
+{
+    if (!m_x)
+        return false;
+    X11State& x = *m_x;
+    const size_t rowBytes = size_t(m_width) * 4;
+
+    // Bounding box of the pixels that differ from the last frame presented
+    uint32_t x0 = m_width, x1 = 0, y0 = m_height, y1 = 0;
+    for (uint32_t y = 0; y < m_height; ++y)
+    {
+        const uint32_t* row = reinterpret_cast<const uint32_t*>(bgra + y * rowBytes);
+        const uint32_t* last = reinterpret_cast<const uint32_t*>(m_last.data() + y * rowBytes);
+        if (m_presented && std::memcmp(row, last, rowBytes) == 0)
+            continue;
+        uint32_t first = 0, end = m_width;
+        if (m_presented)
+        {
+            while (row[first] == last[first])
+                first++;
+            while (row[end - 1] == last[end - 1])
+                end--;
+        }
+        x0 = (std::min)(x0, first);
+        x1 = (std::max)(x1, end);
+        y0 = (std::min)(y0, y);
+        y1 = y + 1;
+    }
+    if (y0 >= y1)
+        return true; // nothing changed
+
+    XImage* image = XCreateImage(x.display, x.visual, unsigned(x.depth), ZPixmap, 0,
+        const_cast<char*>(reinterpret_cast<const char*>(bgra)), m_width, m_height, 32, int(rowBytes));
+    if (!image)
+        return false;
+    g_lastXError = 0;
+    XPutImage(x.display, x.root, x.gc, image, int(x0), int(y0), int(x0), int(y0), x1 - x0, y1 - y0);
+    image->data = nullptr; // the caller's frame
+    XDestroyImage(image);
+    XSync(x.display, False);
+    if (g_lastXError != 0)
+        return false;
+
+    std::memcpy(m_last.data(), bgra, m_last.size());
+    m_presented = true;
+    return true;
+}
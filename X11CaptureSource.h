@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CaptureSource.h"
+#include "FrameProxy.h"
+
+// X11 backend for Linux workstations: the Linux counterpart of DxgiCaptureSource, feeding
+// the same CaptureSession / CapturePipeline stages. Not part of the Windows project; link
+// with -lX11 -lXext -lXfixes -lXdamage.
+//
+//  - the root window is read with XShmGetImage into one MIT-SHM segment created on Open,
+//    so a frame costs the server's blit and one copy out, and nothing is allocated per frame
+//  - XDAMAGE plays the part of DXGI's dirty rects: AcquireFrame waits for a damage event
+//    (Timeout after 16 ms, like AcquireNextFrame), and the damaged region gives
+//    dirtyFraction. Without the extension, or with SetDamage(false), every call grabs
+//  - the pointer is not in the root window image; XFIXES delivers its shape, which is
+//    reported outside the frame like DXGI's
+//  - frames are top-down like every ICaptureSource (CaptureSource.h); X leaves the pad byte
+//    of a 24-bit visual undefined, so alpha is set to 0xFF on the copy
+//  - a root window resize (RandR) returns AccessLost without touching dst. CaptureSession
+//    reopens the source at the new size and returns Resized, and CapturePipeline resizes
+//    its buffers and maps before the next frame (see CaptureSession::CaptureNext)
+//
+// Xlib's macros (None, Status, Bool, ...) stay in the .cpp: the header only holds pointers.
+class X11CaptureSource : public ICaptureSource
+{
+public:
+    // display: an X display name (":0", ":99"), empty = $DISPLAY; screen < 0 = its default
+    explicit X11CaptureSource(std::string display = std::string(), int screen = -1);
+    ~X11CaptureSource() override;
+
+    X11CaptureSource(const X11CaptureSource&) = delete;
+    X11CaptureSource& operator=(const X11CaptureSource&) = delete;
+
+    bool Open() override;
+    void Close() override;
+    // Grabs once, so the server and this process have faulted in the shared segment
+    bool Warm() override;
+    uint32_t Width() const override { return m_width; }
+    uint32_t Height() const override { return m_height; }
+    CaptureResult AcquireFrame(uint8_t* dst, CaptureFrameInfo* info) override;
+    // Rows are downscaled and hashed straight after their copy
+    bool WritesProxy() const override { return true; }
+    bool HashesTiles() const override { return true; }
+
+    // Call before Open. false grabs on every AcquireFrame even where XDAMAGE exists.
+    void SetDamage(bool use) { m_useDamage = use; }
+    // After Open: damage events drive the capture
+    bool HasDamage() const;
+
+private:
+    struct X11State;
+
+    bool Grab();
+    bool UpdatePointer(bool shapeChanged);
+    double DamagedFraction();
+    void CopyRows(uint8_t* dst, CaptureFrameInfo* info);
+
+    std::string m_displayName;
+    int m_screen;
+    bool m_useDamage = true;
+    std::unique_ptr<X11State> m_x;
+    uint32_t m_width = 0, m_height = 0;
+    bool m_pendingFull = false; // the first frame after Open is delivered whole
+
+    FrameDownscaler m_downscaler;
+    std::vector<uint8_t> m_row; // one opaque row for the proxy and hash when there is no dst
+
+    PointerState m_pointer;
+    int32_t m_pointerX = 0, m_pointerY = 0; // hot spot, root window coordinates
+    int32_t m_hotX = 0, m_hotY = 0;
+    unsigned long m_cursorSerial = 0;
+    std::vector<uint8_t> m_pointerBuffer;
+    uint64_t m_pointerShapes = 0;
+};
+
+// Draws BGRA frames onto the root window of a display through its own connection: the
+// "desktop" X11CaptureSource captures in tests and benchmarks against Xvfb. Present puts
+// only the bounding box of the pixels that changed since the previous frame, so the
+// damage the source sees is what a desktop-like workload changes.
+class X11Presenter
+{
+public:
+    X11Presenter();
+    ~X11Presenter();
+
+    X11Presenter(const X11Presenter&) = delete;
+    X11Presenter& operator=(const X11Presenter&) = delete;
+
+    // display as for X11CaptureSource; the root window must be a 32-bit BGRX visual
+    bool Open(const std::string& display = std::string());
+    void Close();
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+
+    // Width() * Height() top-down BGRA. Returns once the server has drawn it.
+    bool Present(const uint8_t* bgra);
+
+private:
+    struct X11State;
+
+    std::unique_ptr<X11State> m_x;
+    uint32_t m_width = 0, m_height = 0;
+    std::vector<uint8_t> m_last;
+    bool m_presented = false;
+};